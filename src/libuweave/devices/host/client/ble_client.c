@@ -0,0 +1,171 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/client/ble_client.h"
+
+#include "devices/host/provider/ble_loopback.h"
+#include "src/log.h"
+#include "src/message_in.h"
+#include "src/message_out.h"
+
+// Weave BLE protocol version spoken by the client.
+#define PROTOCOL_VERSION 1
+
+void ble_client_init(BleClient* client, size_t link_client) {
+  *client = (BleClient){.link_client = link_client,
+                        .state = kBleClientStateDisconnected};
+  uw_buffer_init(&client->in_buffer, client->in_data, sizeof(client->in_data));
+  uw_buffer_init(&client->out_buffer, client->out_data,
+                 sizeof(client->out_data));
+  uw_channel_init_(&client->channel, (UwChannelMessageConfig){},
+                   &client->in_buffer, &client->out_buffer,
+                   UW_BLE_PACKET_SIZE);
+}
+
+bool ble_client_connect(BleClient* client,
+                        const uint8_t* handshake,
+                        size_t handshake_length) {
+  if (client->state != kBleClientStateDisconnected ||
+      !ble_loopback_client_connect(client->link_client)) {
+    return false;
+  }
+
+  uint16_t mtu = ble_loopback_get_mtu();
+  uw_channel_reset_(&client->channel);
+  uw_channel_set_max_packet_size_(&client->channel, mtu);
+
+  UwMessageOut* message_out = uw_channel_get_message_out_(&client->channel);
+  uw_message_out_start_(message_out, kUwMessageTypeConnectionRequest);
+  if (!uw_message_out_append_uint16_(message_out, PROTOCOL_VERSION) ||
+      !uw_message_out_append_uint16_(message_out, PROTOCOL_VERSION) ||
+      !uw_message_out_append_uint16_(message_out, mtu) ||
+      !uw_message_out_append_bytes_(message_out, handshake,
+                                    handshake_length)) {
+    ble_client_disconnect(client);
+    return false;
+  }
+  uw_message_out_ready_(message_out);
+  client->state = kBleClientStateConnecting;
+  return true;
+}
+
+void ble_client_disconnect(BleClient* client) {
+  ble_loopback_client_disconnect(client->link_client);
+  uw_channel_reset_(&client->channel);
+  client->state = kBleClientStateDisconnected;
+}
+
+bool ble_client_send(BleClient* client, const uint8_t* data, size_t length) {
+  if (client->state != kBleClientStateConnected) {
+    return false;
+  }
+  UwMessageOut* message_out = uw_channel_get_message_out_(&client->channel);
+  if (uw_message_out_get_state_(message_out) == kUwMessageStateBusy) {
+    return false;
+  }
+  uw_message_out_reset_(message_out);
+  uw_message_out_start_(message_out, kUwMessageTypeData);
+  if (!uw_message_out_append_bytes_(message_out, data, length)) {
+    uw_message_out_reset_(message_out);
+    return false;
+  }
+  uw_message_out_ready_(message_out);
+  return true;
+}
+
+/**
+ * Writes packets of the outgoing message until it is sent or the link's queue
+ * is full, in which case the rest goes out on a later poll.
+ */
+static bool write_packets_(BleClient* client) {
+  while (uw_channel_get_out_state_(&client->channel) == kUwMessageStateBusy &&
+         ble_loopback_client_can_write(client->link_client)) {
+    uint8_t packet[UW_BLE_PACKET_SIZE];
+    UwBuffer packet_buffer;
+    uw_buffer_init(&packet_buffer, packet, sizeof(packet));
+    if (!uw_channel_get_next_packet_out_(&client->channel, &packet_buffer) ||
+        !ble_loopback_client_write(client->link_client, packet,
+                                   uw_buffer_get_length(&packet_buffer))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Copies a complete incoming message out and readies the channel. */
+static BleClientEvent take_message_(BleClient* client, UwBuffer* received) {
+  UwMessageIn* message_in = uw_channel_get_message_in_(&client->channel);
+  BleClientEvent event = kBleClientEventError;
+  UwBuffer payload;
+
+  switch (uw_message_in_get_type_(message_in)) {
+    case kUwMessageTypeConnectionConfirm: {
+      uint16_t version = 0;
+      uint16_t packet_size = 0;
+      if (client->state != kBleClientStateConnecting ||
+          !uw_message_in_read_uint16_(message_in, &version) ||
+          !uw_message_in_read_uint16_(message_in, &packet_size) ||
+          version != PROTOCOL_VERSION || packet_size > UW_BLE_PACKET_SIZE) {
+        UW_LOG_WARN("Invalid connection confirm\n");
+        break;
+      }
+      uw_channel_set_max_packet_size_(&client->channel, packet_size);
+      client->state = kBleClientStateConnected;
+      event = kBleClientEventConnected;
+      break;
+    }
+    case kUwMessageTypeData: {
+      event = kBleClientEventMessage;
+      break;
+    }
+    default: {
+      UW_LOG_WARN("Device sent an error or unknown message\n");
+      break;
+    }
+  }
+
+  if (event != kBleClientEventError) {
+    const uint8_t* bytes = NULL;
+    size_t length = 0;
+    uw_message_in_read_remaining_bytes_(message_in, &payload);
+    uw_buffer_get_const_bytes(&payload, &bytes, &length);
+    uw_buffer_reset(received);
+    if (!uw_buffer_append(received, bytes, length)) {
+      event = kBleClientEventError;
+    }
+  }
+  uw_message_in_reset_(message_in);
+  return event;
+}
+
+BleClientEvent ble_client_poll(BleClient* client, UwBuffer* received) {
+  if (client->state == kBleClientStateDisconnected) {
+    return kBleClientEventNone;
+  }
+  if (!ble_loopback_client_is_connected(client->link_client)) {
+    UW_LOG_INFO("Device closed the connection\n");
+    ble_client_disconnect(client);
+    return kBleClientEventError;
+  }
+  if (!write_packets_(client)) {
+    return kBleClientEventError;
+  }
+
+  uint8_t packet[UW_BLE_PACKET_SIZE];
+  size_t packet_length = 0;
+  while (ble_loopback_client_read(client->link_client, packet, sizeof(packet),
+                                  &packet_length)) {
+    UwBuffer packet_buffer;
+    uw_buffer_init(&packet_buffer, packet, sizeof(packet));
+    uw_buffer_set_length_(&packet_buffer, packet_length);
+    if (!uw_channel_append_packet_in_(&client->channel, &packet_buffer)) {
+      return kBleClientEventError;
+    }
+    if (uw_channel_get_in_state_(&client->channel) ==
+        kUwMessageStateComplete) {
+      return take_message_(client, received);
+    }
+  }
+  return kBleClientEventNone;
+}
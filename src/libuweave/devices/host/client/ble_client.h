@@ -0,0 +1,78 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_CLIENT_BLE_CLIENT_H_
+#define LIBUWEAVE_DEVICES_HOST_CLIENT_BLE_CLIENT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/buffer.h"
+#include "src/channel.h"
+#include "uweave/config.h"
+
+/**
+ * Client end of the Weave BLE packet protocol over the loopback provider.
+ *
+ * Sends the connection request (protocol version and packet size
+ * negotiation, carrying the caller's crypto handshake), splits outgoing
+ * messages into packets with packet_header.h headers and reassembles the
+ * device's replies.  It uses the same UwChannel as the device, so the two
+ * ends agree on framing by construction.  Payloads are passed through as
+ * given; encrypting them is up to the caller.
+ */
+
+typedef enum {
+  kBleClientStateDisconnected = 0,
+  kBleClientStateConnecting = 1,  // Connection request sent
+  kBleClientStateConnected = 2,   // Connection confirm received
+} BleClientState;
+
+typedef enum {
+  kBleClientEventNone = 0,
+  kBleClientEventConnected = 1,  // received holds the handshake reply
+  kBleClientEventMessage = 2,    // received holds a data message
+  kBleClientEventError = 3,      // The link or the protocol failed
+} BleClientEvent;
+
+typedef struct {
+  size_t link_client;  // Client number on the loopback link
+  BleClientState state;
+  UwChannel channel;
+  uint8_t in_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  uint8_t out_data[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+  UwBuffer in_buffer;
+  UwBuffer out_buffer;
+} BleClient;
+
+/** Sets up a client that connects as link_client of the loopback link. */
+void ble_client_init(BleClient* client, size_t link_client);
+
+/**
+ * Connects over the loopback link and queues a connection request with
+ * handshake as its crypto payload (e.g. the single byte
+ * UW_CRYPTO_MODE_PASSTHROUGH).  The packet size offered is the link MTU.
+ */
+bool ble_client_connect(BleClient* client,
+                        const uint8_t* handshake,
+                        size_t handshake_length);
+
+void ble_client_disconnect(BleClient* client);
+
+/**
+ * Queues a data message.  Fails while the previous message is still being
+ * written out, which ble_client_poll does; its reply need not have arrived.
+ * Replies come back in the order the messages were sent.
+ */
+bool ble_client_send(BleClient* client, const uint8_t* data, size_t length);
+
+/**
+ * Writes queued packets and reads any that have arrived.  When a message
+ * completes, copies its payload to received and returns the matching event.
+ * Call it repeatedly, alternating with uw_device_handle_events.
+ */
+BleClientEvent ble_client_poll(BleClient* client, UwBuffer* received);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_CLIENT_BLE_CLIENT_H_
@@ -0,0 +1,261 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/client/client_session.h"
+
+#include <string.h>
+
+#include "src/crypto_defines.h"
+#include "src/crypto_utils.h"
+#include "src/log.h"
+#include "src/macaroon.h"
+#include "src/macaroon_caveat.h"
+#include "src/macaroon_caveat_internal.h"
+#include "src/macaroon_context.h"
+#include "uweave/provider/crypto.h"
+
+#define RANDOM_LEN 12
+// Authentication challenge nonces, as built by src/channel_encryption.c.
+#define CHALLENGE_NONCE_LEN (1 + 2 * RANDOM_LEN)
+#define CHALLENGE_NONCE_SAT_PRIME 0x01
+#define CHALLENGE_NONCE_SIGNATURE 0x02
+
+#define MAX_DECODED_SAT_SIZE 256
+
+bool client_session_init(ClientSession* session,
+                         const uint8_t* sat,
+                         size_t sat_length) {
+  if (sat_length > sizeof(session->sat)) {
+    return false;
+  }
+  *session = (ClientSession){.sat_length = sat_length, .offer_rekey = true};
+  memcpy(session->sat, sat, sat_length);
+  return true;
+}
+
+bool client_session_write_hello(ClientSession* session,
+                                uint8_t mode,
+                                UwBuffer* handshake) {
+  switch (mode) {
+    case UW_CRYPTO_MODE_TOKEN_SHA256:
+    case UW_CRYPTO_MODE_TOKEN_SHA256_TICKET:
+      break;
+    case UW_CRYPTO_MODE_RESUME_TICKET:
+      if (!session->has_ticket) {
+        return false;
+      }
+      // Held back until the device confirms it; see handle_resume_confirm_.
+      session->has_ticket = false;
+      break;
+    default:
+      return false;
+  }
+
+  session->mode = mode;
+  session->rekey_count = 0;
+  session->state = (UwChannelEncryptionState){
+      .encryption_role = kUwChannelEncryptionRoleClient,
+      .phase = kUwChannelEncryptionPhasePassthrough,
+      .can_rekey = session->offer_rekey};
+  if (!uwp_crypto_getrandom(session->state.client_random, RANDOM_LEN)) {
+    return false;
+  }
+  // A device that accepts the flag can rekey; there is nothing to confirm.
+  uint8_t mode_byte = mode;
+  if (session->offer_rekey) {
+    mode_byte |= UW_CRYPTO_MODE_FLAG_REKEY;
+  }
+  return uw_buffer_append(handshake, &mode_byte, sizeof(mode_byte)) &&
+         uw_buffer_append(handshake, session->state.client_random, RANDOM_LEN);
+}
+
+static void fill_challenge_nonce_(const ClientSession* session,
+                                  uint8_t kind,
+                                  uint8_t nonce[CHALLENGE_NONCE_LEN]) {
+  nonce[0] = kind;
+  memcpy(nonce + 1, session->state.client_random, RANDOM_LEN);
+  memcpy(nonce + 1 + RANDOM_LEN, session->state.server_random, RANDOM_LEN);
+}
+
+/** Decodes the SAT, whose caveats then point into sat_buffer. */
+static bool decode_sat_(const ClientSession* session,
+                        uint8_t* sat_buffer,
+                        size_t sat_buffer_size,
+                        UwMacaroon* sat) {
+  if (!uw_macaroon_deserialize_(session->sat, session->sat_length, sat_buffer,
+                                sat_buffer_size, sat)) {
+    UW_LOG_ERROR("Could not decode SAT\n");
+    return false;
+  }
+  return true;
+}
+
+/** Writes SAT', the SAT extended with a challenge over both randoms. */
+static bool write_sat_prime_(const ClientSession* session,
+                             UwBuffer* message_out) {
+  uint8_t sat_buffer[MAX_DECODED_SAT_SIZE];
+  UwMacaroon sat;
+  if (!decode_sat_(session, sat_buffer, sizeof(sat_buffer), &sat)) {
+    return false;
+  }
+
+  uint8_t nonce[CHALLENGE_NONCE_LEN];
+  fill_challenge_nonce_(session, CHALLENGE_NONCE_SAT_PRIME, nonce);
+  UwMacaroonContext context;
+  uw_macaroon_context_create_(0, NULL, 0, nonce, sizeof(nonce), &context);
+
+  UwMacaroonCaveat challenge_caveat;
+  uint8_t challenge_caveat_buffer[16];
+  uint8_t sat_prime_buffer[MAX_DECODED_SAT_SIZE];
+  UwMacaroon sat_prime;
+  uint8_t encoded[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+  size_t encoded_length = 0;
+  if (!uw_macaroon_caveat_create_authentication_challenge_(
+          challenge_caveat_buffer, sizeof(challenge_caveat_buffer),
+          &challenge_caveat) ||
+      !uw_macaroon_extend_(&sat, &sat_prime, &context, &challenge_caveat,
+                           sat_prime_buffer, sizeof(sat_prime_buffer)) ||
+      !uw_macaroon_serialize_(&sat_prime, encoded, sizeof(encoded),
+                              &encoded_length)) {
+    UW_LOG_ERROR("Could not build SAT'\n");
+    return false;
+  }
+  return uw_buffer_append(message_out, encoded, encoded_length);
+}
+
+bool client_session_handle_confirm(ClientSession* session,
+                                   const UwBuffer* confirm,
+                                   UwBuffer* message_out) {
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(confirm, &bytes, &length);
+  if (length != RANDOM_LEN) {
+    UW_LOG_ERROR("Device confirm has no server random\n");
+    return false;
+  }
+  memcpy(session->state.server_random, bytes, RANDOM_LEN);
+  if (session->mode == UW_CRYPTO_MODE_RESUME_TICKET) {
+    return uw_buffer_append(message_out, session->ticket,
+                            sizeof(session->ticket));
+  }
+  return write_sat_prime_(session, message_out);
+}
+
+/**
+ * The device confirms a redeemed ticket with a control message, its first
+ * under the resumed key; the ticket stays good for later connections.
+ */
+static bool handle_resume_confirm_(ClientSession* session,
+                                   const UwBuffer* reply) {
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(reply, &bytes, &length);
+  uint8_t confirm_data[UW_MACAROON_MAC_LEN];
+  UwBuffer confirm;
+  uw_buffer_init(&confirm, confirm_data, sizeof(confirm_data));
+  if (!uw_buffer_append(&confirm, bytes, length)) {
+    UW_LOG_ERROR("Device reply to the ticket is too long\n");
+    return false;
+  }
+
+  if (!uw_channel_encryption_build_resumed_session_key_(
+          &session->state, session->ticket_secret)) {
+    return false;
+  }
+  session->state.phase = kUwChannelEncryptionPhaseInSession;
+  if (!uw_status_is_success(uw_channel_encryption_process_in_(
+          &session->state, NULL, &confirm, NULL)) ||
+      !session->state.resume_confirmed) {
+    UW_LOG_ERROR("Device did not confirm the resumed session\n");
+    session->state.phase = kUwChannelEncryptionPhasePassthrough;
+    return false;
+  }
+  session->has_ticket = true;
+  return true;
+}
+
+bool client_session_handle_auth_reply(ClientSession* session,
+                                      const UwBuffer* reply) {
+  if (session->mode == UW_CRYPTO_MODE_RESUME_TICKET) {
+    return handle_resume_confirm_(session, reply);
+  }
+
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(reply, &bytes, &length);
+  size_t expected_length = UW_MACAROON_MAC_LEN;
+  if (session->mode == UW_CRYPTO_MODE_TOKEN_SHA256_TICKET) {
+    expected_length += UW_DEVICE_CRYPTO_TICKET_LEN;
+  }
+  if (length < expected_length) {
+    UW_LOG_ERROR("Device reply to SAT' is too short\n");
+    return false;
+  }
+
+  // The device signs a challenge with the tag of the SAT, which only the holder
+  // of the root key can recompute from SAT'.
+  uint8_t sat_buffer[MAX_DECODED_SAT_SIZE];
+  UwMacaroon sat;
+  if (!decode_sat_(session, sat_buffer, sizeof(sat_buffer), &sat)) {
+    return false;
+  }
+  uint8_t nonce[CHALLENGE_NONCE_LEN];
+  fill_challenge_nonce_(session, CHALLENGE_NONCE_SIGNATURE, nonce);
+  UwMacaroonContext context;
+  uw_macaroon_context_create_(0, NULL, 0, nonce, sizeof(nonce), &context);
+  UwMacaroonCaveat challenge_caveat;
+  uint8_t challenge_caveat_buffer[16];
+  uint8_t expected[UW_MACAROON_MAC_LEN];
+  if (!uw_macaroon_caveat_create_authentication_challenge_(
+          challenge_caveat_buffer, sizeof(challenge_caveat_buffer),
+          &challenge_caveat) ||
+      !uw_macaroon_caveat_sign_(sat.mac_tag, sizeof(sat.mac_tag), &context,
+                                &challenge_caveat, expected,
+                                sizeof(expected))) {
+    return false;
+  }
+  if (!uw_crypto_utils_equal_(bytes, expected, sizeof(expected))) {
+    UW_LOG_ERROR("Device failed the SAT challenge\n");
+    return false;
+  }
+
+  if (!uw_channel_encryption_build_token_sha256_session_key_(&session->state,
+                                                             sat.mac_tag)) {
+    return false;
+  }
+  if (session->mode == UW_CRYPTO_MODE_TOKEN_SHA256_TICKET) {
+    // The ticket is opaque here; the client derives the secret it seals.
+    memcpy(session->ticket, bytes + UW_MACAROON_MAC_LEN,
+           sizeof(session->ticket));
+    uw_channel_encryption_build_resumption_secret_(
+        &session->state, sat.mac_tag, session->ticket_secret);
+    session->has_ticket = true;
+  }
+  session->state.phase = kUwChannelEncryptionPhaseInSession;
+  return true;
+}
+
+UwStatus client_session_seal(ClientSession* session,
+                             UwBuffer* message,
+                             UwBuffer* rekey_out) {
+  if (uw_channel_encryption_should_rekey_(&session->state)) {
+    UwStatus rekey_status =
+        uw_channel_encryption_start_rekey_(&session->state, rekey_out);
+    return uw_status_is_success(rekey_status) ? kUwStatusPending
+                                              : rekey_status;
+  }
+  return uw_channel_encryption_process_out_(&session->state, message);
+}
+
+UwStatus client_session_open(ClientSession* session, UwBuffer* message) {
+  bool rekey_pending = session->state.rekey_pending;
+  // The client end never needs the device keys.
+  UwStatus status =
+      uw_channel_encryption_process_in_(&session->state, NULL, message, NULL);
+  if (uw_status_is_success(status) && rekey_pending &&
+      !session->state.rekey_pending) {
+    session->rekey_count++;
+  }
+  return status;
+}
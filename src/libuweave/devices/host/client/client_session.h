@@ -0,0 +1,105 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_CLIENT_CLIENT_SESSION_H_
+#define LIBUWEAVE_DEVICES_HOST_CLIENT_CLIENT_SESSION_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/buffer.h"
+#include "src/channel_encryption.h"
+#include "src/device_crypto.h"
+
+/**
+ * Client end of the channel encryption, for use with a BleClient.
+ *
+ * The token handshake takes the connection request and one message exchange:
+ *   1. client_session_write_hello gives the crypto payload of the connection
+ *      request.
+ *   2. client_session_handle_confirm takes the device's confirm payload and
+ *      writes SAT', or the ticket when resuming, which is sent as the first
+ *      message.
+ *   3. client_session_handle_auth_reply checks the device's reply, after which
+ *      messages are sealed and opened under the session key.
+ * A full handshake in UW_CRYPTO_MODE_TOKEN_SHA256_TICKET also keeps the
+ * device's resumption ticket, so that later connections can use
+ * UW_CRYPTO_MODE_RESUME_TICKET, which skips the SAT' exchange's macaroon work
+ * on both ends.  The client offers rekeying with UW_CRYPTO_MODE_FLAG_REKEY and
+ * then rekeys the session itself; see client_session_seal.
+ */
+
+#define CLIENT_SESSION_MAX_SAT_LEN 128
+
+typedef struct {
+  UwChannelEncryptionState state;
+  // Crypto mode of the current connection.
+  uint8_t mode;
+  // Serialized server authentication token, as minted at pairing.
+  uint8_t sat[CLIENT_SESSION_MAX_SAT_LEN];
+  size_t sat_length;
+  // Whether connection requests offer rekeying.  Set by client_session_init;
+  // clear it to act as a client from before rekeying, which the device serves
+  // up to the hard message limit of a key.
+  bool offer_rekey;
+  // The last ticket the device issued, kept across connections.
+  bool has_ticket;
+  uint8_t ticket[UW_DEVICE_CRYPTO_TICKET_LEN];
+  uint8_t ticket_secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN];
+  // Counts the rekeys completed in this session.
+  uint32_t rekey_count;
+} ClientSession;
+
+/** Sets up a client that authenticates with the serialized sat. */
+bool client_session_init(ClientSession* session,
+                         const uint8_t* sat,
+                         size_t sat_length);
+
+/**
+ * Starts a new connection in mode, one of UW_CRYPTO_MODE_TOKEN_SHA256,
+ * UW_CRYPTO_MODE_TOKEN_SHA256_TICKET or, with a ticket from an earlier one,
+ * UW_CRYPTO_MODE_RESUME_TICKET.  Writes the crypto payload of the connection
+ * request to handshake.
+ */
+bool client_session_write_hello(ClientSession* session,
+                                uint8_t mode,
+                                UwBuffer* handshake);
+
+/**
+ * Takes the crypto payload of the device's connection confirm and writes the
+ * next handshake message to message_out.
+ */
+bool client_session_handle_confirm(ClientSession* session,
+                                   const UwBuffer* confirm,
+                                   UwBuffer* message_out);
+
+/**
+ * Takes the device's reply to the message from client_session_handle_confirm.
+ * Fails unless it proves that the device holds the SAT's root key, or when
+ * resuming, the ticket key.  A presented ticket is kept only once the device
+ * confirms it, so after a refusal or a lost connection the caller reconnects
+ * with a full handshake.
+ */
+bool client_session_handle_auth_reply(ClientSession* session,
+                                      const UwBuffer* reply);
+
+/**
+ * Encrypts message in place.  If the session is due a rekey, the message is
+ * left alone and a rekey request is written to rekey_out instead, and the
+ * function returns kUwStatusPending; send that, pass its reply to
+ * client_session_open, then seal the message again.
+ */
+UwStatus client_session_seal(ClientSession* session,
+                             UwBuffer* message,
+                             UwBuffer* rekey_out);
+
+/**
+ * Decrypts message in place.  A control message leaves it empty, having been
+ * handled here: the acknowledgement of a rekey, or the device asking for one,
+ * in which case the message it turned away must be sealed and sent again.
+ */
+UwStatus client_session_open(ClientSession* session, UwBuffer* message);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_CLIENT_CLIENT_SESSION_H_
@@ -0,0 +1,597 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Runs a uWeave device and BLE clients in one process, connected by the
+ * loopback provider, and times /info round trips over the full BLE transport,
+ * channel and privet request path.  With several clients, each round sends
+ * one request from every client at once.
+ *
+ *     loopback [--count=N] [--clients=N] [--mtu=BYTES] [--latency-us=US]
+ *              [--loss-ppm=PPM] [--tx-window=PACKETS] [--rx-window=PACKETS]
+ *              [--padding=BYTES]
+ *
+ * --padding adds a byte string of that size to each request, as params that
+ * /info ignores, to exercise multi-packet messages.  Also counts the device's
+ * busy passes: those in which it asked to be called again rather than waiting
+ * for a notification.
+ *
+ *     loopback --throughput [--count=N] [--padding=BYTES] [--latency-us=US]
+ *
+ * Sends padded requests at packet sizes of 20, 64, 185 and 244 bytes, the ATT
+ * payloads of 23, 67, 188 and 247-byte ATT MTUs, up to UW_BLE_PACKET_SIZE, and
+ * prints a CSV line for each.  Without --padding, each request nearly fills
+ * the device's request buffer.
+ *
+ *     loopback --burst=N [--count=N] [--padding=BYTES] [--latency-us=US] ...
+ *
+ * Has one client send N requests back to back, without waiting for replies,
+ * and reports requests per second.
+ *
+ *     loopback --resume [--count=N] [--latency-us=US] ...
+ *
+ * Connects one client N times with the full token handshake, which also hands
+ * out a resumption ticket, then N times by redeeming the ticket, and reports
+ * the mean time from the connection request to the reply to the first /info
+ * request of each.
+ *
+ * The Makefile builds with NDEBUG so that message logging does not dominate
+ * the times; a build with logging left on says so on stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cbor.h"
+#include "devices/host/client/ble_client.h"
+#include "devices/host/client/client_session.h"
+#include "devices/host/provider/ble_loopback.h"
+#include "src/crypto_defines.h"
+#include "src/device.h"
+#include "src/macaroon_helpers.h"
+#include "uweave/ble_transport.h"
+#include "uweave/device.h"
+
+// Gives up on a reply after this many polls of an idle link.
+#define MAX_IDLE_POLLS 1000000
+
+// Default request padding for --throughput, so that a request nearly fills
+// the device's request buffer.
+#define THROUGHPUT_PADDING (UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE - 32)
+
+// Privet RPC map keys, as parsed by src/privet_request.c.
+#define PRIVET_KEY_VERSION 0
+#define PRIVET_KEY_API_ID 1
+#define PRIVET_KEY_REQUEST_ID 2
+#define PRIVET_KEY_PARAMS 16
+#define PRIVET_VERSION 3
+#define PRIVET_API_ID_INFO 0
+
+static UwSettings settings_ = {
+    .firmware_version = "loopback",
+    .oem_name = "Weave",
+    .model_name = "Loopback",
+    .model_id = {'L', 'P', 'B'},
+    .device_class = {'A', 'A'},
+    .supported_pairing_types = kUwPairingTypeNone,
+    .supports_ble_40 = true,
+    .name = "loopback",
+};
+
+static uint64_t now_us_() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static bool parse_option_(const char* arg, const char* name, uint32_t* value) {
+  size_t name_length = strlen(name);
+  if (strncmp(arg, name, name_length) != 0) {
+    return false;
+  }
+  *value = (uint32_t)strtoul(arg + name_length, NULL, 10);
+  return true;
+}
+
+static size_t encode_info_request_(uint32_t request_id,
+                                   uint32_t padding,
+                                   uint8_t* data,
+                                   size_t data_size) {
+  static const uint8_t kPadding[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE] = {};
+  if (padding > sizeof(kPadding)) {
+    return 0;
+  }
+  CborEncoder encoder;
+  CborEncoder map;
+  cbor_encoder_init(&encoder, data, data_size, 0);
+  cbor_encoder_create_map(&encoder, &map, padding > 0 ? 4 : 3);
+  cbor_encode_int(&map, PRIVET_KEY_VERSION);
+  cbor_encode_int(&map, PRIVET_VERSION);
+  cbor_encode_int(&map, PRIVET_KEY_API_ID);
+  cbor_encode_int(&map, PRIVET_API_ID_INFO);
+  cbor_encode_int(&map, PRIVET_KEY_REQUEST_ID);
+  cbor_encode_uint(&map, request_id);
+  if (padding > 0) {
+    cbor_encode_int(&map, PRIVET_KEY_PARAMS);
+    cbor_encode_byte_string(&map, kPadding, padding);
+  }
+  if (cbor_encoder_close_container_checked(&encoder, &map) != CborNoError) {
+    return 0;
+  }
+  return encoder.ptr - data;
+}
+
+static BleClient clients_[BLE_LOOPBACK_MAX_CLIENTS];
+static uint64_t device_passes_ = 0;
+static uint64_t busy_passes_ = 0;
+
+/**
+ * Services the device and the clients until each client marked in waiting has
+ * reported an event, or the polls run out.  The events are stored in events.
+ */
+static void run_until_events_(UwDevice* device,
+                              size_t client_count,
+                              const bool waiting[],
+                              BleClientEvent events[],
+                              UwBuffer* received) {
+  for (size_t i = 0; i < client_count; i++) {
+    events[i] = waiting[i] ? kBleClientEventNone : kBleClientEventError;
+  }
+  for (int idle_polls = 0; idle_polls < MAX_IDLE_POLLS; idle_polls++) {
+    device_passes_++;
+    if (uw_device_handle_events(device) == kUwDeviceWorkStateBusy) {
+      busy_passes_++;
+    }
+    bool done = true;
+    for (size_t i = 0; i < client_count; i++) {
+      if (events[i] == kBleClientEventNone) {
+        events[i] = ble_client_poll(&clients_[i], received);
+        done &= (events[i] != kBleClientEventNone);
+      }
+    }
+    if (done) {
+      return;
+    }
+  }
+  for (size_t i = 0; i < client_count; i++) {
+    if (events[i] == kBleClientEventNone) {
+      events[i] = kBleClientEventError;
+    }
+  }
+}
+
+typedef struct {
+  uint64_t total_us;
+  uint64_t max_us;
+  size_t request_length;
+  size_t reply_length;
+} RoundStats_;
+
+static UwDevice* start_device_() {
+  UwDevice* device = malloc(uw_device_sizeof());
+  UwCommandList* command_list = malloc(uw_command_list_sizeof(1, 64));
+  UwCounterSet* counter_set = malloc(uw_counter_set_sizeof(0));
+  UwBleTransport* transport = malloc(uw_ble_transport_sizeof());
+  static UwDeviceHandlers handlers = {};
+  uw_command_list_init(command_list, 1, 64);
+  uw_counter_set_init(counter_set, NULL, 0);
+  uw_device_init(device, &settings_, &handlers, command_list, counter_set);
+  if (!uw_ble_transport_init(transport, device)) {
+    return NULL;
+  }
+  uw_device_start(device);
+  return device;
+}
+
+/**
+ * Connects the clients in passthrough mode and marks in active those the
+ * device accepted.  Clients beyond UW_BLE_MAX_CONNECTIONS are expected to be
+ * refused.  Returns the number accepted.
+ */
+static uint32_t connect_clients_(UwDevice* device,
+                                 size_t client_count,
+                                 bool active[]) {
+  const uint8_t handshake[] = {UW_CRYPTO_MODE_PASSTHROUGH};
+  BleClientEvent events[BLE_LOOPBACK_MAX_CLIENTS];
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+
+  for (size_t i = 0; i < client_count; i++) {
+    ble_client_init(&clients_[i], i);
+    active[i] = ble_client_connect(&clients_[i], handshake, sizeof(handshake));
+  }
+  run_until_events_(device, client_count, active, events, &received);
+  uint32_t connected_count = 0;
+  for (size_t i = 0; i < client_count; i++) {
+    active[i] = (events[i] == kBleClientEventConnected);
+    connected_count += active[i];
+  }
+  return connected_count;
+}
+
+/**
+ * Disconnects the clients and lets the device see it, so that the clients can
+ * connect again: the device closes any connection whose handle it sees a
+ * disconnection for.
+ */
+static void disconnect_clients_(UwDevice* device,
+                                size_t client_count,
+                                uint32_t latency_us) {
+  for (size_t i = 0; i < client_count; i++) {
+    ble_client_disconnect(&clients_[i]);
+  }
+  uint64_t ready_us = now_us_() + latency_us;
+  while (now_us_() < ready_us) {
+  }
+  uw_device_handle_events(device);
+}
+
+/** Sends count rounds of /info requests from the active clients. */
+static bool run_rounds_(UwDevice* device,
+                        size_t client_count,
+                        const bool active[],
+                        uint32_t count,
+                        uint32_t padding,
+                        RoundStats_* stats) {
+  BleClientEvent events[BLE_LOOPBACK_MAX_CLIENTS];
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+
+  *stats = (RoundStats_){};
+  for (uint32_t round = 0; round < count; round++) {
+    uint8_t request[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+    stats->request_length =
+        encode_info_request_(round, padding, request, sizeof(request));
+    if (stats->request_length == 0) {
+      fprintf(stderr, "Padding does not fit in a request\n");
+      return false;
+    }
+
+    uint64_t start_us = now_us_();
+    for (size_t i = 0; i < client_count; i++) {
+      if (active[i] &&
+          !ble_client_send(&clients_[i], request, stats->request_length)) {
+        fprintf(stderr, "Client %u could not send\n", (unsigned)i);
+        return false;
+      }
+    }
+    run_until_events_(device, client_count, active, events, &received);
+    for (size_t i = 0; i < client_count; i++) {
+      if (active[i] && events[i] != kBleClientEventMessage) {
+        fprintf(stderr, "Request %u from client %u failed\n",
+                (unsigned)round, (unsigned)i);
+        return false;
+      }
+    }
+    uint64_t elapsed_us = now_us_() - start_us;
+    stats->total_us += elapsed_us;
+    stats->max_us = elapsed_us > stats->max_us ? elapsed_us : stats->max_us;
+    stats->reply_length = uw_buffer_get_length(&received);
+  }
+  return true;
+}
+
+/**
+ * Has one client send burst requests back to back, each as soon as the last
+ * one is written out rather than once its reply is in, count times over.
+ */
+static bool run_bursts_(UwDevice* device,
+                        uint32_t count,
+                        uint32_t burst,
+                        uint32_t padding,
+                        RoundStats_* stats) {
+  uint8_t request[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+
+  *stats = (RoundStats_){};
+  stats->request_length =
+      encode_info_request_(0, padding, request, sizeof(request));
+  if (stats->request_length == 0) {
+    fprintf(stderr, "Padding does not fit in a request\n");
+    return false;
+  }
+  for (uint32_t round = 0; round < count; round++) {
+    uint32_t sent = 0;
+    uint32_t replies = 0;
+    uint64_t start_us = now_us_();
+    for (int idle_polls = 0; replies < burst; idle_polls++) {
+      if (idle_polls == MAX_IDLE_POLLS) {
+        fprintf(stderr, "Burst %u timed out\n", (unsigned)round);
+        return false;
+      }
+      if (sent < burst &&
+          ble_client_send(&clients_[0], request, stats->request_length)) {
+        sent++;
+      }
+      device_passes_++;
+      if (uw_device_handle_events(device) == kUwDeviceWorkStateBusy) {
+        busy_passes_++;
+      }
+      switch (ble_client_poll(&clients_[0], &received)) {
+        case kBleClientEventNone: {
+          break;
+        }
+        case kBleClientEventMessage: {
+          replies++;
+          idle_polls = 0;
+          break;
+        }
+        default: {
+          fprintf(stderr, "Burst %u failed after %u replies\n",
+                  (unsigned)round, (unsigned)replies);
+          return false;
+        }
+      }
+    }
+    uint64_t elapsed_us = now_us_() - start_us;
+    stats->total_us += elapsed_us;
+    stats->max_us = elapsed_us > stats->max_us ? elapsed_us : stats->max_us;
+    stats->reply_length = uw_buffer_get_length(&received);
+  }
+  return true;
+}
+
+/** Runs one client at each packet size in turn and prints a CSV table. */
+static bool run_throughput_(UwDevice* device,
+                            BleLoopbackConfig config,
+                            uint32_t count,
+                            uint32_t padding) {
+  // ATT MTUs of 23, 67, 188 and 247 bytes, less the 3-byte ATT header.
+  static const uint16_t kPacketSizes[] = {20, 64, 185, 244};
+
+  printf("packet_size,request_bytes,packets_per_round,us_per_round,"
+         "request_kbytes_per_second\n");
+  for (size_t i = 0; i < sizeof(kPacketSizes) / sizeof(kPacketSizes[0]);
+       i++) {
+    if (kPacketSizes[i] > UW_BLE_PACKET_SIZE) {
+      fprintf(stderr, "Skipping packet size %u, above UW_BLE_PACKET_SIZE\n",
+              (unsigned)kPacketSizes[i]);
+      continue;
+    }
+    config.mtu = kPacketSizes[i];
+    BleLoopbackStats before;
+    BleLoopbackStats after;
+    bool active[1] = {};
+    RoundStats_ stats;
+    if (!ble_loopback_configure(&config) ||
+        connect_clients_(device, 1, active) != 1) {
+      fprintf(stderr, "Connection failed\n");
+      return false;
+    }
+    ble_loopback_get_stats(&before);
+    if (!run_rounds_(device, 1, active, count, padding, &stats)) {
+      return false;
+    }
+    ble_loopback_get_stats(&after);
+    disconnect_clients_(device, 1, config.latency_us);
+
+    uint32_t packets = (after.packets_to_device - before.packets_to_device) +
+                       (after.packets_to_client - before.packets_to_client);
+    double us_per_round = (double)stats.total_us / count;
+    printf("%u,%u,%u,%.1f,%.0f\n", (unsigned)kPacketSizes[i],
+           (unsigned)stats.request_length, (unsigned)(packets / count),
+           us_per_round, stats.request_length * 1e6 / 1024 / us_per_round);
+  }
+  return true;
+}
+
+/** Services the device and client 0 until the client reports an event. */
+static BleClientEvent wait_for_event_(UwDevice* device, UwBuffer* received) {
+  const bool waiting[1] = {true};
+  BleClientEvent events[1];
+  run_until_events_(device, 1, waiting, events, received);
+  return events[0];
+}
+
+/** Sends message from client 0 and waits for the reply, which replaces it. */
+static bool exchange_(UwDevice* device, UwBuffer* message) {
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(message, &bytes, &length);
+  if (!ble_client_send(&clients_[0], bytes, length)) {
+    return false;
+  }
+  return wait_for_event_(device, message) == kBleClientEventMessage;
+}
+
+/**
+ * Connects client 0 in the token handshake mode given and has one /info request
+ * answered under the session key, timing it from the connection request to the
+ * reply.
+ */
+static bool run_secure_session_(UwDevice* device,
+                                ClientSession* session,
+                                uint8_t mode,
+                                uint32_t request_id,
+                                uint64_t* elapsed_us) {
+  uint8_t data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer message;
+  uw_buffer_init(&message, data, sizeof(data));
+  uint8_t next_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer next;
+  uw_buffer_init(&next, next_data, sizeof(next_data));
+
+  uint64_t start_us = now_us_();
+  const uint8_t* hello;
+  size_t hello_length;
+  ble_client_init(&clients_[0], 0);
+  if (!client_session_write_hello(session, mode, &message)) {
+    return false;
+  }
+  uw_buffer_get_const_bytes(&message, &hello, &hello_length);
+  if (!ble_client_connect(&clients_[0], hello, hello_length) ||
+      wait_for_event_(device, &message) != kBleClientEventConnected ||
+      !client_session_handle_confirm(session, &message, &next) ||
+      !exchange_(device, &next) ||
+      !client_session_handle_auth_reply(session, &next)) {
+    fprintf(stderr, "Handshake in mode %u failed\n", (unsigned)mode);
+    return false;
+  }
+
+  uint8_t* request;
+  size_t request_size;
+  uw_buffer_get_bytes_(&message, &request, &request_size);
+  size_t request_length =
+      encode_info_request_(request_id, 0, request, request_size);
+  uw_buffer_set_length_(&message, request_length);
+  if (request_length == 0 ||
+      !uw_status_is_success(client_session_seal(session, &message, &next)) ||
+      !exchange_(device, &message) ||
+      !uw_status_is_success(client_session_open(session, &message)) ||
+      uw_buffer_get_length(&message) == 0) {
+    fprintf(stderr, "Request %u failed\n", (unsigned)request_id);
+    return false;
+  }
+  *elapsed_us = now_us_() - start_us;
+  return true;
+}
+
+/**
+ * Times count full token handshakes that each end with a ticket, then count
+ * resumptions with the last ticket, each up to the first reply.
+ */
+static bool run_resume_(UwDevice* device,
+                        uint32_t latency_us,
+                        uint32_t count) {
+  static const uint8_t kNonce[UW_MACAROON_INIT_DELEGATION_NONCE_SIZE] = {1};
+  static const uint8_t kModes[] = {UW_CRYPTO_MODE_TOKEN_SHA256_TICKET,
+                                   UW_CRYPTO_MODE_RESUME_TICKET};
+  static ClientSession session;
+  uint8_t sat_buffer[80];
+  UwMacaroon sat_macaroon;
+  uint8_t sat[CLIENT_SESSION_MAX_SAT_LEN];
+  size_t sat_length = 0;
+  // The SAT that /pairing/confirm would hand out.
+  if (!uw_macaroon_mint_server_authentication_token_(
+          device->device_crypto.device_authentication_key,
+          sizeof(device->device_crypto.device_authentication_key), NULL, 0,
+          kNonce, sat_buffer, sizeof(sat_buffer), &sat_macaroon) ||
+      !uw_macaroon_serialize_(&sat_macaroon, sat, sizeof(sat), &sat_length) ||
+      !client_session_init(&session, sat, sat_length)) {
+    fprintf(stderr, "Could not mint a SAT\n");
+    return false;
+  }
+
+  uint64_t total_us[sizeof(kModes)] = {};
+  for (size_t i = 0; i < sizeof(kModes); i++) {
+    for (uint32_t round = 0; round < count; round++) {
+      uint64_t elapsed_us = 0;
+      if (!run_secure_session_(device, &session, kModes[i], round,
+                               &elapsed_us)) {
+        return false;
+      }
+      total_us[i] += elapsed_us;
+      disconnect_clients_(device, 1, latency_us);
+    }
+  }
+  int64_t full_us = (int64_t)(total_us[0] / count);
+  int64_t resumed_us = (int64_t)(total_us[1] / count);
+  printf("connect to first reply us: full handshake %d, resumed %d\n",
+         (int)full_us, (int)resumed_us);
+  printf("resumption saves: %d us, %d%%\n", (int)(full_us - resumed_us),
+         full_us > 0 ? (int)(100 * (full_us - resumed_us) / full_us) : 0);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  uint32_t count = 100;
+  uint32_t client_count = 1;
+  uint32_t padding = 0;
+  bool has_padding = false;
+  uint32_t burst = 0;
+  bool throughput = false;
+  bool resume = false;
+  BleLoopbackConfig config = {.mtu = UW_BLE_PACKET_SIZE, .seed = 1};
+  for (int i = 1; i < argc; i++) {
+    uint32_t mtu = 0;
+    if (parse_option_(argv[i], "--mtu=", &mtu)) {
+      config.mtu = (uint16_t)mtu;
+    } else if (strcmp(argv[i], "--throughput") == 0) {
+      throughput = true;
+    } else if (strcmp(argv[i], "--resume") == 0) {
+      resume = true;
+    } else if (parse_option_(argv[i], "--padding=", &padding)) {
+      has_padding = true;
+    } else if (!parse_option_(argv[i], "--count=", &count) &&
+               !parse_option_(argv[i], "--clients=", &client_count) &&
+               !parse_option_(argv[i], "--burst=", &burst) &&
+               !parse_option_(argv[i], "--latency-us=", &config.latency_us) &&
+               !parse_option_(argv[i], "--loss-ppm=", &config.loss_ppm) &&
+               !parse_option_(argv[i], "--tx-window=", &config.tx_window) &&
+               !parse_option_(argv[i], "--rx-window=", &config.rx_window)) {
+      fprintf(stderr, "Unknown option: %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (!ble_loopback_configure(&config) || client_count < 1 ||
+      client_count > BLE_LOOPBACK_MAX_CLIENTS || count < 1) {
+    fprintf(stderr, "Invalid link configuration\n");
+    return 1;
+  }
+#ifndef NDEBUG
+  fprintf(stderr, "Warning: built without NDEBUG, so message logging is "
+                  "included in the times\n");
+#endif
+
+  UwDevice* device = start_device_();
+  if (device == NULL) {
+    fprintf(stderr, "Could not start the BLE transport\n");
+    return 1;
+  }
+  if (throughput) {
+    if (!has_padding) {
+      padding = THROUGHPUT_PADDING;
+    }
+    return run_throughput_(device, config, count, padding) ? 0 : 1;
+  }
+  if (resume) {
+    return run_resume_(device, config.latency_us, count) ? 0 : 1;
+  }
+
+  bool active[BLE_LOOPBACK_MAX_CLIENTS] = {};
+  uint32_t connected_count = connect_clients_(device, client_count, active);
+  if (connected_count == 0) {
+    fprintf(stderr, "Connection failed\n");
+    return 1;
+  }
+  RoundStats_ stats;
+  if (burst > 0) {
+    if (!active[0] || !run_bursts_(device, count, burst, padding, &stats)) {
+      return 1;
+    }
+    printf("bursts: %u of %u requests, mean us %u, requests per second %u\n",
+           (unsigned)count, (unsigned)burst,
+           (unsigned)(stats.total_us / count),
+           (unsigned)(count * burst * 1000000ull /
+                      (stats.total_us > 0 ? stats.total_us : 1)));
+  } else if (!run_rounds_(device, client_count, active, count, padding,
+                          &stats)) {
+    return 1;
+  }
+  disconnect_clients_(device, client_count, config.latency_us);
+
+  BleLoopbackStats link_stats;
+  ble_loopback_get_stats(&link_stats);
+  printf("clients: %u connected, %u refused\n", (unsigned)connected_count,
+         (unsigned)(client_count - connected_count));
+  printf("rounds: %u, request bytes: %u, reply bytes: %u, mtu: %u\n",
+         (unsigned)count, (unsigned)stats.request_length,
+         (unsigned)stats.reply_length, (unsigned)config.mtu);
+  printf("round trip us: mean %u, max %u\n",
+         (unsigned)(stats.total_us / count), (unsigned)stats.max_us);
+  printf("packets: to device %u, to client %u, dropped %u\n",
+         (unsigned)link_stats.packets_to_device,
+         (unsigned)link_stats.packets_to_client,
+         (unsigned)link_stats.packets_dropped);
+  printf("device passes: %llu, busy %llu\n",
+         (unsigned long long)device_passes_,
+         (unsigned long long)busy_passes_);
+  return 0;
+}
@@ -0,0 +1,29 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_PROVIDER_AES128_TTABLE_H_
+#define LIBUWEAVE_DEVICES_HOST_PROVIDER_AES128_TTABLE_H_
+
+#include <stdint.h>
+
+/**
+ * Portable AES-128 encryption using 32-bit lookup tables.  Four 1KB tables are
+ * used unless UW_CRYPTO_AES_TTABLE_COMPACT is set, in which case a single
+ * table is rotated at lookup time.  Only encryption is provided, which is all
+ * CMAC, CTR and EAX need.
+ */
+
+#define AES128_TTABLE_ROUND_KEY_WORDS 44
+
+void aes128_ttable_expand_key(
+    const uint8_t* key,
+    uint32_t round_keys[AES128_TTABLE_ROUND_KEY_WORDS]);
+
+/** plaintext and ciphertext may point to the same block. */
+void aes128_ttable_encrypt(
+    const uint32_t round_keys[AES128_TTABLE_ROUND_KEY_WORDS],
+    const uint8_t* plaintext,
+    uint8_t* ciphertext);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_PROVIDER_AES128_TTABLE_H_
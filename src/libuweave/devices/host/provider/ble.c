@@ -0,0 +1,406 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "uweave/provider/ble.h"
+
+#include <string.h>
+#include <time.h>
+
+#include "devices/host/provider/ble_loopback.h"
+#include "uweave/config.h"
+
+// Smallest packet the Weave connection request accepts.
+#define MIN_MTU 20
+
+typedef struct {
+  UwBleEvent event;
+  uint64_t ready_us;  // Monotonic time at which the event can be read
+} QueuedEvent_;
+
+typedef struct {
+  QueuedEvent_ events[BLE_LOOPBACK_QUEUE_SIZE];
+  size_t head;
+  size_t count;
+} Queue_;
+
+typedef struct {
+  BleLoopbackConfig config;
+  uint32_t random_state;
+  bool advertising;
+  UwBleTransport* transport;
+  bool connected[BLE_LOOPBACK_MAX_CLIENTS];
+  // Connection, data and disconnection events from every client.
+  Queue_ to_device;
+  // Data events only, one queue per client.
+  Queue_ to_client[BLE_LOOPBACK_MAX_CLIENTS];
+  BleLoopbackStats stats;
+} Link_;
+
+static Link_ link_ = {
+    .config = {.mtu = UW_BLE_PACKET_SIZE, .seed = 1}, .random_state = 1,
+};
+
+// Connection handles are client numbers plus one, so that zero is never used.
+static UwBleOpaqueConnectionHandle handle_for_client_(size_t client) {
+  return (UwBleOpaqueConnectionHandle)(client + 1);
+}
+
+static bool client_for_handle_(UwBleOpaqueConnectionHandle connection_handle,
+                               size_t* client) {
+  if (connection_handle < 1 || connection_handle > BLE_LOOPBACK_MAX_CLIENTS) {
+    return false;
+  }
+  *client = (size_t)connection_handle - 1;
+  return true;
+}
+
+static bool is_connected_(size_t client) {
+  return client < BLE_LOOPBACK_MAX_CLIENTS && link_.connected[client];
+}
+
+static uint64_t now_us_() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+/** xorshift32; the state must not be zero. */
+static uint32_t next_random_() {
+  uint32_t x = link_.random_state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  link_.random_state = x;
+  return x;
+}
+
+static bool should_drop_() {
+  return link_.config.loss_ppm > 0 &&
+         next_random_() % 1000000 < link_.config.loss_ppm;
+}
+
+static void queue_clear_(Queue_* queue) {
+  queue->head = 0;
+  queue->count = 0;
+}
+
+/**
+ * Queues an event without packet data and returns it, so that the caller can
+ * fill in a packet in place, or NULL if the queue is full.
+ */
+static UwBleEvent* queue_push_(Queue_* queue,
+                               UwBleEventType event_type,
+                               UwBleOpaqueConnectionHandle connection_handle) {
+  if (queue->count == BLE_LOOPBACK_QUEUE_SIZE) {
+    return NULL;
+  }
+  QueuedEvent_* slot =
+      &queue->events[(queue->head + queue->count) % BLE_LOOPBACK_QUEUE_SIZE];
+  slot->event.event_type = event_type;
+  slot->event.connection_handle = connection_handle;
+  slot->event.packet.data_length = 0;
+  slot->ready_us = now_us_() + link_.config.latency_us;
+  queue->count++;
+  return &slot->event;
+}
+
+/** Returns the oldest event once its latency has passed, or NULL. */
+static const UwBleEvent* queue_peek_(const Queue_* queue) {
+  if (queue->count == 0) {
+    return NULL;
+  }
+  const QueuedEvent_* slot = &queue->events[queue->head];
+  if (link_.config.latency_us > 0 && now_us_() < slot->ready_us) {
+    return NULL;
+  }
+  return &slot->event;
+}
+
+static void queue_drop_head_(Queue_* queue) {
+  queue->head = (queue->head + 1) % BLE_LOOPBACK_QUEUE_SIZE;
+  queue->count--;
+}
+
+/** Drops the queued data events of one connection, keeping the rest. */
+static void queue_remove_data_(Queue_* queue,
+                               UwBleOpaqueConnectionHandle connection_handle) {
+  size_t kept = 0;
+  for (size_t i = 0; i < queue->count; i++) {
+    QueuedEvent_ slot = queue->events[(queue->head + i) %
+                                      BLE_LOOPBACK_QUEUE_SIZE];
+    if (slot.event.event_type == kUwBleEventTypeData &&
+        slot.event.connection_handle == connection_handle) {
+      continue;
+    }
+    queue->events[(queue->head + kept) % BLE_LOOPBACK_QUEUE_SIZE] = slot;
+    kept++;
+  }
+  queue->count = kept;
+}
+
+/**
+ * Queues a data packet of a header byte and a payload, unless the loss model
+ * drops it.  The payload is copied once, straight into the queue.
+ */
+static bool send_packet_(Queue_* queue,
+                         size_t client,
+                         uint8_t header,
+                         const uint8_t* payload,
+                         size_t payload_length,
+                         uint32_t* sent_count) {
+  if (!is_connected_(client) || payload_length >= link_.config.mtu ||
+      queue->count == BLE_LOOPBACK_QUEUE_SIZE) {
+    return false;
+  }
+  (*sent_count)++;
+  if (should_drop_()) {
+    link_.stats.packets_dropped++;
+    return true;
+  }
+  UwBleEvent* queued =
+      queue_push_(queue, kUwBleEventTypeData, handle_for_client_(client));
+  if (queued == NULL) {
+    return false;
+  }
+  UwBlePacket* packet = &queued->packet;
+  packet->data[0] = header;
+  memcpy(packet->data + 1, payload, payload_length);
+  packet->data_length = payload_length + 1;
+  return true;
+}
+
+static size_t tx_window_() {
+  return link_.config.tx_window == 0 ? BLE_LOOPBACK_QUEUE_SIZE
+                                     : link_.config.tx_window;
+}
+
+/** Counts the client's data packets that the device has yet to read. */
+static size_t count_unread_by_device_(size_t client) {
+  const Queue_* queue = &link_.to_device;
+  size_t count = 0;
+  for (size_t i = 0; i < queue->count; i++) {
+    const UwBleEvent* event =
+        &queue->events[(queue->head + i) % BLE_LOOPBACK_QUEUE_SIZE].event;
+    if (event->event_type == kUwBleEventTypeData &&
+        event->connection_handle == handle_for_client_(client)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+static void notify_device_() {
+  if (link_.transport != NULL) {
+    uw_ble_transport_notify_work(link_.transport);
+  }
+}
+
+bool ble_loopback_configure(const BleLoopbackConfig* config) {
+  if (config == NULL || config->mtu < MIN_MTU ||
+      config->mtu > UW_BLE_PACKET_SIZE || config->loss_ppm > 1000000 ||
+      config->tx_window > BLE_LOOPBACK_QUEUE_SIZE ||
+      config->rx_window > BLE_LOOPBACK_QUEUE_SIZE) {
+    return false;
+  }
+  link_.config = *config;
+  link_.random_state = config->seed != 0 ? config->seed : 1;
+  return true;
+}
+
+uint16_t ble_loopback_get_mtu() {
+  return link_.config.mtu;
+}
+
+bool ble_loopback_client_connect(size_t client) {
+  if (!link_.advertising || client >= BLE_LOOPBACK_MAX_CLIENTS ||
+      link_.connected[client]) {
+    return false;
+  }
+  queue_clear_(&link_.to_client[client]);
+  if (queue_push_(&link_.to_device, kUwBleEventTypeConnection,
+                  handle_for_client_(client)) == NULL) {
+    return false;
+  }
+  link_.connected[client] = true;
+  notify_device_();
+  return true;
+}
+
+void ble_loopback_client_disconnect(size_t client) {
+  if (!is_connected_(client)) {
+    return;
+  }
+  UwBleOpaqueConnectionHandle connection_handle = handle_for_client_(client);
+  link_.connected[client] = false;
+  queue_clear_(&link_.to_client[client]);
+  // Data still in flight is lost with the connection.
+  queue_remove_data_(&link_.to_device, connection_handle);
+  queue_push_(&link_.to_device, kUwBleEventTypeDisconnection,
+              connection_handle);
+  notify_device_();
+}
+
+bool ble_loopback_client_is_connected(size_t client) {
+  return is_connected_(client);
+}
+
+bool ble_loopback_client_can_write(size_t client) {
+  return is_connected_(client) &&
+         link_.to_device.count < BLE_LOOPBACK_QUEUE_SIZE &&
+         (link_.config.rx_window == 0 ||
+          count_unread_by_device_(client) < link_.config.rx_window);
+}
+
+bool ble_loopback_client_write(size_t client,
+                               const uint8_t* data,
+                               size_t length) {
+  if (length == 0 ||
+      !send_packet_(&link_.to_device, client, data[0], data + 1, length - 1,
+                    &link_.stats.packets_to_device)) {
+    return false;
+  }
+  notify_device_();
+  return true;
+}
+
+bool ble_loopback_client_read(size_t client,
+                              uint8_t* data,
+                              size_t data_size,
+                              size_t* length) {
+  if (client >= BLE_LOOPBACK_MAX_CLIENTS || data_size < link_.config.mtu) {
+    return false;
+  }
+  Queue_* queue = &link_.to_client[client];
+  bool window_was_full = queue->count >= tx_window_();
+  const UwBleEvent* event = queue_peek_(queue);
+  if (event == NULL) {
+    return false;
+  }
+  memcpy(data, event->packet.data, event->packet.data_length);
+  *length = event->packet.data_length;
+  queue_drop_head_(queue);
+  if (window_was_full && link_.transport != NULL) {
+    uw_ble_transport_notify_tx_complete(link_.transport);
+  }
+  return true;
+}
+
+void ble_loopback_get_stats(BleLoopbackStats* stats) {
+  *stats = link_.stats;
+}
+
+bool uwp_ble_init() {
+  UwBleTransport* transport = link_.transport;
+  BleLoopbackConfig config = link_.config;
+  link_ = (Link_){.config = config,
+                  .random_state = config.seed != 0 ? config.seed : 1,
+                  .transport = transport};
+  return true;
+}
+
+bool uwp_ble_set_advertising_data(const char* device_name,
+                                  const uint16_t manufacturer_id,
+                                  const uint8_t* manufacturer_data,
+                                  const uint8_t manufacturer_data_length) {
+  return true;
+}
+
+bool uwp_ble_advertising_start() {
+  link_.advertising = true;
+  return true;
+}
+
+bool uwp_ble_advertising_stop() {
+  link_.advertising = false;
+  return true;
+}
+
+bool uwp_ble_create_service(const UwBleService* service,
+                            UwBleTransport* transport) {
+  link_.transport = transport;
+  return true;
+}
+
+bool uwp_ble_peek_event(UwBleEventInfo* event) {
+  const UwBleEvent* next = queue_peek_(&link_.to_device);
+  if (next == NULL) {
+    return false;
+  }
+  *event = (UwBleEventInfo){.event_type = next->event_type,
+                            .connection_handle = next->connection_handle,
+                            .data_length = next->packet.data_length};
+  return true;
+}
+
+bool uwp_ble_read_event(uint8_t* header,
+                        uint8_t* payload,
+                        size_t payload_size) {
+  const UwBleEvent* event = queue_peek_(&link_.to_device);
+  if (event == NULL) {
+    return false;
+  }
+  if (header != NULL && event->event_type == kUwBleEventTypeData) {
+    const UwBlePacket* packet = &event->packet;
+    if (packet->data_length == 0 || packet->data_length - 1 > payload_size) {
+      return false;
+    }
+    *header = packet->data[0];
+    memcpy(payload, packet->data + 1, packet->data_length - 1);
+  }
+  queue_drop_head_(&link_.to_device);
+  return true;
+}
+
+bool uwp_ble_can_write_packet() {
+  // The device does not say which connection it will write to, so every
+  // connected client must have room.
+  bool any_connected = false;
+  for (size_t i = 0; i < BLE_LOOPBACK_MAX_CLIENTS; i++) {
+    if (!link_.connected[i]) {
+      continue;
+    }
+    if (link_.to_client[i].count >= tx_window_()) {
+      return false;
+    }
+    any_connected = true;
+  }
+  return any_connected;
+}
+
+bool uwp_ble_write_packet(UwBleOpaqueConnectionHandle connection_handle,
+                          uint8_t header,
+                          const uint8_t* payload,
+                          size_t payload_length) {
+  size_t client;
+  if (!client_for_handle_(connection_handle, &client)) {
+    return false;
+  }
+  return send_packet_(&link_.to_client[client], client, header, payload,
+                      payload_length, &link_.stats.packets_to_client);
+}
+
+uint16_t uwp_ble_get_max_packet_size(
+    UwBleOpaqueConnectionHandle connection_handle) {
+  size_t client;
+  if (!client_for_handle_(connection_handle, &client) ||
+      !link_.connected[client]) {
+    return MIN_MTU;
+  }
+  return link_.config.mtu;
+}
+
+void uwp_ble_disconnect(UwBleOpaqueConnectionHandle connection_handle) {
+  size_t client;
+  if (!client_for_handle_(connection_handle, &client) ||
+      !link_.connected[client]) {
+    return;
+  }
+  link_.connected[client] = false;
+  queue_clear_(&link_.to_client[client]);
+  queue_remove_data_(&link_.to_device, connection_handle);
+}
+
+bool uwp_ble_set_device_name(const char* device_name) {
+  return true;
+}
@@ -0,0 +1,118 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_PROVIDER_BLE_LOOPBACK_H_
+#define LIBUWEAVE_DEVICES_HOST_PROVIDER_BLE_LOOPBACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "uweave/config.h"
+#include "uweave/gatt.h"
+
+/**
+ * The host BLE provider is an in-process loopback link: the uwp_ble_*
+ * functions are the device end, and the ble_loopback_client_* functions below
+ * are the centrals that connect to it, normally driven by BleClient
+ * (devices/host/client/ble_client.h).  Each direction is a packet queue, so
+ * the device and the clients run in the same thread and are polled in turn.
+ *
+ * Clients are numbered from 0 to BLE_LOOPBACK_MAX_CLIENTS - 1.
+ */
+
+/**
+ * Centrals that can connect at once: one more than the device serves, so that
+ * refused connections can be exercised.
+ */
+#define BLE_LOOPBACK_MAX_CLIENTS (UW_BLE_MAX_CONNECTIONS + 1)
+
+/** Packets each direction of a connection can hold. */
+#define BLE_LOOPBACK_QUEUE_SIZE (2 * UW_BLE_EVENT_QUEUE_SIZE)
+
+typedef struct {
+  /**
+   * Largest packet either end may write, from 20 up to UW_BLE_PACKET_SIZE,
+   * and what uwp_ble_get_max_packet_size() reports for every connection.
+   * Larger writes fail.
+   */
+  uint16_t mtu;
+  /** Time from a write until the packet can be read at the other end. */
+  uint32_t latency_us;
+  /** Probability, in parts per million, that a data packet is dropped. */
+  uint32_t loss_ppm;
+  /** Seed for the loss decisions, so that a lossy run can be repeated. */
+  uint32_t seed;
+  /**
+   * Packets the device may have unread at one client before
+   * uwp_ble_can_write_packet() turns false, like the transmit buffers of a
+   * BLE controller.  0 for the full queue.  The link calls
+   * uw_ble_transport_notify_tx_complete as the client reads them.
+   */
+  uint32_t tx_window;
+  /**
+   * Packets a client may have unread at the device before
+   * ble_loopback_client_can_write() turns false, like the receive buffers of
+   * the device's BLE controller.  0 for the full queue.
+   */
+  uint32_t rx_window;
+} BleLoopbackConfig;
+
+typedef struct {
+  uint32_t packets_to_device;
+  uint32_t packets_to_client;
+  uint32_t packets_dropped;
+} BleLoopbackStats;
+
+/**
+ * Sets the link parameters.  The defaults are an MTU of UW_BLE_PACKET_SIZE, no
+ * latency, no loss and the full queue as transmit and receive windows.  Takes
+ * effect for packets written afterwards.
+ */
+bool ble_loopback_configure(const BleLoopbackConfig* config);
+
+/** Returns the largest packet the link carries. */
+uint16_t ble_loopback_get_mtu();
+
+/**
+ * Connects the client, queueing a connection event for the device.  Fails if
+ * the device is not advertising or the client is already connected.  The
+ * device may still refuse the connection by closing it.
+ */
+bool ble_loopback_client_connect(size_t client);
+
+/** Disconnects the client, queueing a disconnection event for the device. */
+void ble_loopback_client_disconnect(size_t client);
+
+/** Whether the client's connection is up; the device may close it. */
+bool ble_loopback_client_is_connected(size_t client);
+
+/**
+ * Whether the device's queue, and the client's receive window, have room for
+ * another packet from the client.
+ */
+bool ble_loopback_client_can_write(size_t client);
+
+/**
+ * Sends a packet to the device.  Returns false if the link is down, the
+ * packet exceeds the MTU or the queue is full.  A dropped packet still counts
+ * as sent.
+ */
+bool ble_loopback_client_write(size_t client,
+                               const uint8_t* data,
+                               size_t length);
+
+/**
+ * Receives the client's next packet from the device into data, which must
+ * hold an MTU, if one has arrived.  Returns false if there is none.
+ */
+bool ble_loopback_client_read(size_t client,
+                              uint8_t* data,
+                              size_t data_size,
+                              size_t* length);
+
+/** Copies the packet counts since start-up, summed over all clients. */
+void ble_loopback_get_stats(BleLoopbackStats* stats);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_PROVIDER_BLE_LOOPBACK_H_
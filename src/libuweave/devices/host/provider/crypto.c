@@ -0,0 +1,330 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "uweave/provider/crypto.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "devices/host/provider/crypto_x86.h"
+#include "devices/host/provider/sha256_portable.h"
+#include "uweave/config.h"
+
+#if UW_CRYPTO_AES_TTABLE
+#include "devices/host/provider/aes128_ttable.h"
+#else
+#include "tiny-aes128-c/aes.h"
+#endif
+
+bool uwp_crypto_init() {
+#if UW_CRYPTO_X86_ACCEL
+  // Probe the CPU up front rather than on the first block.
+  crypto_x86_has_aesni();
+  crypto_x86_has_shani();
+#endif
+  return true;
+}
+
+bool uwp_crypto_aes128_ecb_encrypt(const uint8_t* key,
+                                   const uint8_t* plaintext,
+                                   uint8_t* ciphertext) {
+  UwpCryptoAes128Key key_schedule;
+  return uwp_crypto_aes128_key_init(&key_schedule, key) &&
+         uwp_crypto_aes128_encrypt_block(&key_schedule, plaintext, ciphertext);
+}
+
+bool uwp_crypto_aes128_key_init(UwpCryptoAes128Key* key_schedule,
+                                const uint8_t* key) {
+  if (key_schedule == NULL || key == NULL) {
+    return false;
+  }
+#if UW_CRYPTO_X86_ACCEL
+  // The schedule layout depends on the backend; detection is fixed for the
+  // life of the process, so init and encrypt always agree.  (Only the test
+  // hook crypto_x86_disable_features changes it.)
+  if (crypto_x86_has_aesni()) {
+    crypto_x86_aes128_expand_key(key, key_schedule->round_keys);
+    return true;
+  }
+#endif
+#if UW_CRYPTO_AES_TTABLE
+  aes128_ttable_expand_key(key, key_schedule->round_keys);
+#else
+  AES128_ECB_expand_key(key, (uint8_t*)key_schedule->round_keys);
+#endif
+  return true;
+}
+
+bool uwp_crypto_aes128_encrypt_block(const UwpCryptoAes128Key* key_schedule,
+                                     const uint8_t* plaintext,
+                                     uint8_t* ciphertext) {
+  if (key_schedule == NULL || plaintext == NULL || ciphertext == NULL) {
+    return false;
+  }
+#if UW_CRYPTO_X86_ACCEL
+  if (crypto_x86_has_aesni()) {
+    crypto_x86_aes128_encrypt(key_schedule->round_keys, plaintext, ciphertext);
+    return true;
+  }
+#endif
+#if UW_CRYPTO_AES_TTABLE
+  aes128_ttable_encrypt(key_schedule->round_keys, plaintext, ciphertext);
+#else
+  AES128_ECB_encrypt_expanded(
+      plaintext, (const uint8_t*)key_schedule->round_keys, ciphertext);
+#endif
+  return true;
+}
+
+bool uwp_crypto_aes128_encrypt_blocks(const UwpCryptoAes128Key* key_schedule,
+                                      const uint8_t* plaintext,
+                                      uint8_t* ciphertext,
+                                      size_t num_blocks) {
+  if (key_schedule == NULL || plaintext == NULL || ciphertext == NULL) {
+    return false;
+  }
+#if UW_CRYPTO_X86_ACCEL
+  if (crypto_x86_has_aesni()) {
+    crypto_x86_aes128_encrypt_blocks(key_schedule->round_keys, plaintext,
+                                     ciphertext, num_blocks);
+    return true;
+  }
+#endif
+  // The table and byte-oriented backends gain nothing from interleaving.
+  for (size_t i = 0; i < num_blocks; ++i) {
+    size_t offset = i * UWP_CRYPTO_AES128_BLOCK_SIZE;
+    if (!uwp_crypto_aes128_encrypt_block(key_schedule, plaintext + offset,
+                                         ciphertext + offset)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Compresses whole blocks with the fastest code the CPU supports. */
+static void sha256_blocks_(uint32_t state[8],
+                           const uint8_t* data,
+                           size_t num_blocks) {
+#if UW_CRYPTO_X86_ACCEL
+  if (crypto_x86_has_shani()) {
+    crypto_x86_sha256_blocks(state, data, num_blocks);
+    return;
+  }
+#endif
+  sha256_portable_blocks(state, data, num_blocks);
+}
+
+#if UW_CRYPTO_X86_ACCEL
+#define SHA256_MAX_LANES CRYPTO_X86_SHA256_LANES
+#else
+#define SHA256_MAX_LANES 8
+#endif
+
+/** Compresses one block into each of num_lanes states. */
+static void sha256_lane_blocks_(uint32_t* const states[],
+                                const uint8_t* const blocks[],
+                                size_t num_lanes) {
+#if UW_CRYPTO_X86_ACCEL
+  // The SHA extensions beat SIMD lanes, and a lone lane is not worth padding.
+  if (!crypto_x86_has_shani() && crypto_x86_has_avx2() && num_lanes > 1) {
+    uint32_t spare_state[8];
+    uint32_t* lane_states[CRYPTO_X86_SHA256_LANES];
+    const uint8_t* lane_blocks[CRYPTO_X86_SHA256_LANES];
+    for (size_t i = 0; i < CRYPTO_X86_SHA256_LANES; ++i) {
+      lane_states[i] = (i < num_lanes) ? states[i] : spare_state;
+      lane_blocks[i] = (i < num_lanes) ? blocks[i] : blocks[0];
+    }
+    memcpy(spare_state, states[0], sizeof(spare_state));
+    crypto_x86_sha256_lanes(lane_states, lane_blocks);
+    return;
+  }
+#endif
+  for (size_t i = 0; i < num_lanes; ++i) {
+    sha256_blocks_(states[i], blocks[i], 1);
+  }
+}
+
+void uwp_crypto_sha256_init(UwpCryptoSha256State* state) {
+  static const uint32_t kInitialState[8] = {
+      0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+      0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  memset(state, 0, sizeof(*state));
+  memcpy(state->state, kInitialState, sizeof(state->state));
+}
+
+/**
+ * Only a partial block is ever copied into state->data; whole blocks are
+ * compressed straight from the caller's buffer.
+ */
+void uwp_crypto_sha256_update(UwpCryptoSha256State* state,
+                              const uint8_t* data,
+                              size_t data_len) {
+  state->bitlen += (uint64_t)data_len * 8;
+  if (state->datalen > 0) {
+    size_t fill = UWP_CRYPTO_SHA256_BLOCK_SIZE - state->datalen;
+    if (fill > data_len) {
+      fill = data_len;
+    }
+    memcpy(state->data + state->datalen, data, fill);
+    state->datalen += fill;
+    data += fill;
+    data_len -= fill;
+    if (state->datalen < UWP_CRYPTO_SHA256_BLOCK_SIZE) {
+      return;
+    }
+    sha256_blocks_(state->state, state->data, 1);
+    state->datalen = 0;
+  }
+
+  size_t num_blocks = data_len / UWP_CRYPTO_SHA256_BLOCK_SIZE;
+  if (num_blocks > 0) {
+    sha256_blocks_(state->state, data, num_blocks);
+    data += num_blocks * UWP_CRYPTO_SHA256_BLOCK_SIZE;
+    data_len -= num_blocks * UWP_CRYPTO_SHA256_BLOCK_SIZE;
+  }
+  memcpy(state->data, data, data_len);
+  state->datalen = data_len;
+}
+
+void uwp_crypto_sha256_final(UwpCryptoSha256State* state, uint8_t* digest) {
+  uint64_t bitlen = state->bitlen;
+  uint8_t padding[UWP_CRYPTO_SHA256_BLOCK_SIZE + 8] = {0x80};
+  size_t padding_len = (state->datalen < 56 ? 56 : 120) - state->datalen;
+  for (int i = 0; i < 8; ++i) {
+    padding[padding_len + i] = (uint8_t)(bitlen >> (56 - 8 * i));
+  }
+  uwp_crypto_sha256_update(state, padding, padding_len + 8);
+
+  for (int i = 0; i < 8; ++i) {
+    digest[4 * i] = (uint8_t)(state->state[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(state->state[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(state->state[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)state->state[i];
+  }
+  memset(state, 0, sizeof(*state));
+}
+
+/**
+ * Each pass takes at most one block from every lane: the lane's buffered
+ * block once it fills, or else the next whole block of its data.
+ */
+static void sha256_update_lane_group_(UwpCryptoSha256State* const states[],
+                                      const uint8_t* const data[],
+                                      const size_t data_len[],
+                                      size_t num_lanes) {
+  const uint8_t* next[SHA256_MAX_LANES];
+  size_t remaining[SHA256_MAX_LANES];
+  for (size_t i = 0; i < num_lanes; ++i) {
+    states[i]->bitlen += (uint64_t)data_len[i] * 8;
+    next[i] = data[i];
+    remaining[i] = data_len[i];
+  }
+
+  for (;;) {
+    uint32_t* block_states[SHA256_MAX_LANES];
+    const uint8_t* blocks[SHA256_MAX_LANES];
+    size_t num_blocks = 0;
+    for (size_t i = 0; i < num_lanes; ++i) {
+      UwpCryptoSha256State* state = states[i];
+      if (state->datalen == 0 && remaining[i] >= UWP_CRYPTO_SHA256_BLOCK_SIZE) {
+        blocks[num_blocks] = next[i];
+        block_states[num_blocks++] = state->state;
+        next[i] += UWP_CRYPTO_SHA256_BLOCK_SIZE;
+        remaining[i] -= UWP_CRYPTO_SHA256_BLOCK_SIZE;
+        continue;
+      }
+      if (remaining[i] == 0) {
+        continue;
+      }
+      size_t fill = UWP_CRYPTO_SHA256_BLOCK_SIZE - state->datalen;
+      if (fill > remaining[i]) {
+        fill = remaining[i];
+      }
+      memcpy(state->data + state->datalen, next[i], fill);
+      state->datalen += fill;
+      next[i] += fill;
+      remaining[i] -= fill;
+      if (state->datalen == UWP_CRYPTO_SHA256_BLOCK_SIZE) {
+        // Not touched again until the block has been compressed below.
+        blocks[num_blocks] = state->data;
+        block_states[num_blocks++] = state->state;
+        state->datalen = 0;
+      }
+    }
+    if (num_blocks == 0) {
+      return;
+    }
+    sha256_lane_blocks_(block_states, blocks, num_blocks);
+  }
+}
+
+void uwp_crypto_sha256_update_lanes(UwpCryptoSha256State* const states[],
+                                    const uint8_t* const data[],
+                                    const size_t data_len[],
+                                    size_t num_lanes) {
+  for (size_t first = 0; first < num_lanes; first += SHA256_MAX_LANES) {
+    size_t count = num_lanes - first;
+    if (count > SHA256_MAX_LANES) {
+      count = SHA256_MAX_LANES;
+    }
+    sha256_update_lane_group_(states + first, data + first, data_len + first,
+                              count);
+  }
+}
+
+void uwp_crypto_sha256_final_lanes(UwpCryptoSha256State* const states[],
+                                   uint8_t* const digests[],
+                                   size_t num_lanes) {
+  for (size_t first = 0; first < num_lanes; first += SHA256_MAX_LANES) {
+    size_t count = num_lanes - first;
+    if (count > SHA256_MAX_LANES) {
+      count = SHA256_MAX_LANES;
+    }
+
+    uint8_t padding[SHA256_MAX_LANES][UWP_CRYPTO_SHA256_BLOCK_SIZE + 8];
+    const uint8_t* padding_data[SHA256_MAX_LANES];
+    size_t padding_len[SHA256_MAX_LANES];
+    for (size_t i = 0; i < count; ++i) {
+      UwpCryptoSha256State* state = states[first + i];
+      uint64_t bitlen = state->bitlen;
+      size_t pad_len = (state->datalen < 56 ? 56 : 120) - state->datalen;
+      memset(padding[i], 0, sizeof(padding[i]));
+      padding[i][0] = 0x80;
+      for (int j = 0; j < 8; ++j) {
+        padding[i][pad_len + j] = (uint8_t)(bitlen >> (56 - 8 * j));
+      }
+      padding_data[i] = padding[i];
+      padding_len[i] = pad_len + 8;
+    }
+    sha256_update_lane_group_(states + first, padding_data, padding_len,
+                              count);
+
+    for (size_t i = 0; i < count; ++i) {
+      UwpCryptoSha256State* state = states[first + i];
+      uint8_t* digest = digests[first + i];
+      for (int j = 0; j < 8; ++j) {
+        digest[4 * j] = (uint8_t)(state->state[j] >> 24);
+        digest[4 * j + 1] = (uint8_t)(state->state[j] >> 16);
+        digest[4 * j + 2] = (uint8_t)(state->state[j] >> 8);
+        digest[4 * j + 3] = (uint8_t)state->state[j];
+      }
+      memset(state, 0, sizeof(*state));
+    }
+  }
+}
+
+void uwp_crypto_sha256_clone(const UwpCryptoSha256State* source,
+                             UwpCryptoSha256State* destination) {
+  memcpy(destination, source, sizeof(*destination));
+}
+
+bool uwp_crypto_getrandom(uint8_t* buffer, size_t length) {
+  FILE* urandom = fopen("/dev/urandom", "rb");
+  if (urandom == NULL) {
+    return false;
+  }
+  size_t read = fread(buffer, 1, length, urandom);
+  fclose(urandom);
+  return read == length;
+}
@@ -0,0 +1,323 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/provider/crypto_x86.h"
+
+#if UW_CRYPTO_X86_ACCEL
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+#define CPUID_1_ECX_SSSE3 (1 << 9)
+#define CPUID_1_ECX_SSE41 (1 << 19)
+#define CPUID_1_ECX_AES (1 << 25)
+#define CPUID_1_ECX_OSXSAVE (1 << 27)
+#define CPUID_1_ECX_AVX (1 << 28)
+#define CPUID_7_EBX_AVX2 (1 << 5)
+#define CPUID_7_EBX_SHA (1 << 29)
+#define XCR0_SSE_AVX_STATE 0x6
+
+typedef enum {
+  kCpuFeatureUnknown = 0,
+  kCpuFeatureMissing,
+  kCpuFeaturePresent,
+} CpuFeature_;
+
+static CpuFeature_ has_aesni_ = kCpuFeatureUnknown;
+static CpuFeature_ has_shani_ = kCpuFeatureUnknown;
+static CpuFeature_ has_avx2_ = kCpuFeatureUnknown;
+static unsigned int disabled_features_ = 0;
+
+/** Probes the CPU once.  Racing callers all store the same values. */
+static void detect_features_() {
+  unsigned int eax, ebx, ecx, edx;
+  unsigned int leaf1_ecx = 0;
+  unsigned int leaf7_ebx = 0;
+  if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    leaf1_ecx = ecx;
+  }
+  if (__get_cpuid_max(0, NULL) >= 7) {
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    leaf7_ebx = ebx;
+  }
+  has_aesni_ = (leaf1_ecx & CPUID_1_ECX_AES) ? kCpuFeaturePresent
+                                             : kCpuFeatureMissing;
+  has_shani_ = ((leaf7_ebx & CPUID_7_EBX_SHA) &&
+                (leaf1_ecx & CPUID_1_ECX_SSSE3) &&
+                (leaf1_ecx & CPUID_1_ECX_SSE41))
+                   ? kCpuFeaturePresent
+                   : kCpuFeatureMissing;
+
+  // AVX2 also needs the OS to save the YMM registers.
+  bool os_saves_ymm = false;
+  if ((leaf1_ecx & CPUID_1_ECX_OSXSAVE) && (leaf1_ecx & CPUID_1_ECX_AVX)) {
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    os_saves_ymm =
+        (xcr0_lo & XCR0_SSE_AVX_STATE) == XCR0_SSE_AVX_STATE;
+  }
+  has_avx2_ = (os_saves_ymm && (leaf7_ebx & CPUID_7_EBX_AVX2))
+                  ? kCpuFeaturePresent
+                  : kCpuFeatureMissing;
+}
+
+bool crypto_x86_has_aesni() {
+  if (has_aesni_ == kCpuFeatureUnknown) {
+    detect_features_();
+  }
+  return has_aesni_ == kCpuFeaturePresent &&
+         !(disabled_features_ & CRYPTO_X86_FEATURE_AESNI);
+}
+
+bool crypto_x86_has_shani() {
+  if (has_shani_ == kCpuFeatureUnknown) {
+    detect_features_();
+  }
+  return has_shani_ == kCpuFeaturePresent &&
+         !(disabled_features_ & CRYPTO_X86_FEATURE_SHANI);
+}
+
+bool crypto_x86_has_avx2() {
+  if (has_avx2_ == kCpuFeatureUnknown) {
+    detect_features_();
+  }
+  return has_avx2_ == kCpuFeaturePresent &&
+         !(disabled_features_ & CRYPTO_X86_FEATURE_AVX2);
+}
+
+void crypto_x86_disable_features(unsigned int features) {
+  disabled_features_ = features;
+}
+
+#define AESNI_TARGET_ __attribute__((target("aes,sse2")))
+#define SHANI_TARGET_ __attribute__((target("sha,ssse3,sse4.1")))
+#define AVX2_TARGET_ __attribute__((target("avx2")))
+
+AESNI_TARGET_ static __m128i aes128_expand_step_(__m128i key, __m128i assist) {
+  assist = _mm_shuffle_epi32(assist, 0xff);
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return _mm_xor_si128(key, assist);
+}
+
+// The round constant must be an immediate, hence the macro.
+#define AES128_EXPAND_(k_, rcon_) \
+  aes128_expand_step_((k_), _mm_aeskeygenassist_si128((k_), (rcon_)))
+
+AESNI_TARGET_ void crypto_x86_aes128_expand_key(const uint8_t* key,
+                                                uint32_t round_keys[44]) {
+  __m128i* rk = (__m128i*)round_keys;
+  __m128i k = _mm_loadu_si128((const __m128i*)key);
+  _mm_storeu_si128(rk + 0, k);
+  k = AES128_EXPAND_(k, 0x01);
+  _mm_storeu_si128(rk + 1, k);
+  k = AES128_EXPAND_(k, 0x02);
+  _mm_storeu_si128(rk + 2, k);
+  k = AES128_EXPAND_(k, 0x04);
+  _mm_storeu_si128(rk + 3, k);
+  k = AES128_EXPAND_(k, 0x08);
+  _mm_storeu_si128(rk + 4, k);
+  k = AES128_EXPAND_(k, 0x10);
+  _mm_storeu_si128(rk + 5, k);
+  k = AES128_EXPAND_(k, 0x20);
+  _mm_storeu_si128(rk + 6, k);
+  k = AES128_EXPAND_(k, 0x40);
+  _mm_storeu_si128(rk + 7, k);
+  k = AES128_EXPAND_(k, 0x80);
+  _mm_storeu_si128(rk + 8, k);
+  k = AES128_EXPAND_(k, 0x1b);
+  _mm_storeu_si128(rk + 9, k);
+  k = AES128_EXPAND_(k, 0x36);
+  _mm_storeu_si128(rk + 10, k);
+}
+
+AESNI_TARGET_ void crypto_x86_aes128_encrypt(const uint32_t round_keys[44],
+                                             const uint8_t* plaintext,
+                                             uint8_t* ciphertext) {
+  const __m128i* rk = (const __m128i*)round_keys;
+  __m128i block = _mm_loadu_si128((const __m128i*)plaintext);
+  block = _mm_xor_si128(block, _mm_loadu_si128(rk));
+  for (int round = 1; round < 10; ++round) {
+    block = _mm_aesenc_si128(block, _mm_loadu_si128(rk + round));
+  }
+  block = _mm_aesenclast_si128(block, _mm_loadu_si128(rk + 10));
+  _mm_storeu_si128((__m128i*)ciphertext, block);
+}
+
+AESNI_TARGET_ void crypto_x86_aes128_encrypt_blocks(
+    const uint32_t round_keys[44],
+    const uint8_t* plaintext,
+    uint8_t* ciphertext,
+    size_t num_blocks) {
+  const __m128i* rk = (const __m128i*)round_keys;
+  const __m128i* in = (const __m128i*)plaintext;
+  __m128i* out = (__m128i*)ciphertext;
+  for (; num_blocks >= 4; num_blocks -= 4, in += 4, out += 4) {
+    __m128i key = _mm_loadu_si128(rk);
+    __m128i b0 = _mm_xor_si128(_mm_loadu_si128(in + 0), key);
+    __m128i b1 = _mm_xor_si128(_mm_loadu_si128(in + 1), key);
+    __m128i b2 = _mm_xor_si128(_mm_loadu_si128(in + 2), key);
+    __m128i b3 = _mm_xor_si128(_mm_loadu_si128(in + 3), key);
+    for (int round = 1; round < 10; ++round) {
+      key = _mm_loadu_si128(rk + round);
+      b0 = _mm_aesenc_si128(b0, key);
+      b1 = _mm_aesenc_si128(b1, key);
+      b2 = _mm_aesenc_si128(b2, key);
+      b3 = _mm_aesenc_si128(b3, key);
+    }
+    key = _mm_loadu_si128(rk + 10);
+    _mm_storeu_si128(out + 0, _mm_aesenclast_si128(b0, key));
+    _mm_storeu_si128(out + 1, _mm_aesenclast_si128(b1, key));
+    _mm_storeu_si128(out + 2, _mm_aesenclast_si128(b2, key));
+    _mm_storeu_si128(out + 3, _mm_aesenclast_si128(b3, key));
+  }
+  for (; num_blocks > 0; --num_blocks, ++in, ++out) {
+    crypto_x86_aes128_encrypt(round_keys, (const uint8_t*)in, (uint8_t*)out);
+  }
+}
+
+static const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+SHANI_TARGET_ void crypto_x86_sha256_blocks(uint32_t state[8],
+                                            const uint8_t* data,
+                                            size_t num_blocks) {
+  // Byte swap each 32-bit word of the message.
+  const __m128i kByteSwap =
+      _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+  // The SHA instructions want the state as ABEF and CDGH.
+  __m128i tmp = _mm_loadu_si128((const __m128i*)&state[0]);
+  __m128i state1 = _mm_loadu_si128((const __m128i*)&state[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xB1);        // CDAB
+  state1 = _mm_shuffle_epi32(state1, 0x1B);  // EFGH
+  __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+  state1 = _mm_blend_epi16(state1, tmp, 0xF0);       // CDGH
+
+  while (num_blocks-- > 0) {
+    __m128i abef_save = state0;
+    __m128i cdgh_save = state1;
+    __m128i w[4];
+
+    // 16 groups of 4 rounds.  Groups 0-3 consume the message directly, later
+    // groups extend the schedule from the previous four.
+    for (int group = 0; group < 16; ++group) {
+      __m128i msg;
+      if (group < 4) {
+        msg = _mm_loadu_si128((const __m128i*)(data + 16 * group));
+        msg = _mm_shuffle_epi8(msg, kByteSwap);
+      } else {
+        msg = _mm_sha256msg1_epu32(w[group & 3], w[(group + 1) & 3]);
+        msg = _mm_add_epi32(
+            msg, _mm_alignr_epi8(w[(group + 3) & 3], w[(group + 2) & 3], 4));
+        msg = _mm_sha256msg2_epu32(msg, w[(group + 3) & 3]);
+      }
+      w[group & 3] = msg;
+
+      const __m128i* k = (const __m128i*)&kSha256K[4 * group];
+      msg = _mm_add_epi32(msg, _mm_loadu_si128(k));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+      msg = _mm_shuffle_epi32(msg, 0x0E);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    }
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+    data += 64;
+  }
+
+  // Back to ABCD and EFGH.
+  tmp = _mm_shuffle_epi32(state0, 0x1B);
+  state1 = _mm_shuffle_epi32(state1, 0xB1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128((__m128i*)&state[0], state0);
+  _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+// One 32-bit word from each of the CRYPTO_X86_SHA256_LANES hashes: a single
+// AVX2 register.
+typedef uint32_t Sha256Lanes_
+    __attribute__((vector_size(4 * CRYPTO_X86_SHA256_LANES)));
+
+#define LANES_ROTR_(x_, n_) (((x_) >> (n_)) | ((x_) << (32 - (n_))))
+#define LANES_SUM0_(x_) \
+  (LANES_ROTR_(x_, 2) ^ LANES_ROTR_(x_, 13) ^ LANES_ROTR_(x_, 22))
+#define LANES_SUM1_(x_) \
+  (LANES_ROTR_(x_, 6) ^ LANES_ROTR_(x_, 11) ^ LANES_ROTR_(x_, 25))
+#define LANES_SIGMA0_(x_) \
+  (LANES_ROTR_(x_, 7) ^ LANES_ROTR_(x_, 18) ^ ((x_) >> 3))
+#define LANES_SIGMA1_(x_) \
+  (LANES_ROTR_(x_, 17) ^ LANES_ROTR_(x_, 19) ^ ((x_) >> 10))
+
+// The lanes are compressed in lockstep with GCC vector arithmetic, so the
+// whole working state stays in registers.
+AVX2_TARGET_ void crypto_x86_sha256_lanes(
+    uint32_t* const states[CRYPTO_X86_SHA256_LANES],
+    const uint8_t* const blocks[CRYPTO_X86_SHA256_LANES]) {
+  Sha256Lanes_ w[16];
+  for (int i = 0; i < 16; ++i) {
+    for (int lane = 0; lane < CRYPTO_X86_SHA256_LANES; ++lane) {
+      const uint8_t* word = blocks[lane] + 4 * i;
+      w[i][lane] = (uint32_t)word[0] << 24 | (uint32_t)word[1] << 16 |
+                   (uint32_t)word[2] << 8 | (uint32_t)word[3];
+    }
+  }
+  Sha256Lanes_ v[8];
+  for (int i = 0; i < 8; ++i) {
+    for (int lane = 0; lane < CRYPTO_X86_SHA256_LANES; ++lane) {
+      v[i][lane] = states[lane][i];
+    }
+  }
+
+  Sha256Lanes_ a = v[0], b = v[1], c = v[2], d = v[3];
+  Sha256Lanes_ e = v[4], f = v[5], g = v[6], h = v[7];
+  // Fully unrolled so that the schedule indices are constants and the
+  // variable rotation costs nothing.
+#pragma GCC unroll 64
+  for (int i = 0; i < 64; ++i) {
+    if (i >= 16) {
+      w[i & 15] += LANES_SIGMA1_(w[(i - 2) & 15]) + w[(i - 7) & 15] +
+                   LANES_SIGMA0_(w[(i - 15) & 15]);
+    }
+    Sha256Lanes_ t1 =
+        h + LANES_SUM1_(e) + (g ^ (e & (f ^ g))) + kSha256K[i] + w[i & 15];
+    Sha256Lanes_ t2 = LANES_SUM0_(a) + ((a & b) | (c & (a | b)));
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+  v[0] += a;
+  v[1] += b;
+  v[2] += c;
+  v[3] += d;
+  v[4] += e;
+  v[5] += f;
+  v[6] += g;
+  v[7] += h;
+
+  for (int lane = 0; lane < CRYPTO_X86_SHA256_LANES; ++lane) {
+    for (int i = 0; i < 8; ++i) {
+      states[lane][i] = v[i][lane];
+    }
+  }
+}
+
+#endif  // UW_CRYPTO_X86_ACCEL
@@ -0,0 +1,86 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_PROVIDER_CRYPTO_X86_H_
+#define LIBUWEAVE_DEVICES_HOST_PROVIDER_CRYPTO_X86_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * AES-NI and SHA extension code paths for x86 hosts.  The instructions are
+ * enabled per function, so the rest of the build needs no special flags.
+ * Callers must check crypto_x86_has_aesni()/crypto_x86_has_shani() before
+ * using the matching functions.
+ */
+#ifndef UW_CRYPTO_X86_ACCEL
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define UW_CRYPTO_X86_ACCEL 1
+#else
+#define UW_CRYPTO_X86_ACCEL 0
+#endif
+#endif
+
+#if UW_CRYPTO_X86_ACCEL
+
+/** Returns true if the CPU supports AES-NI.  The result is cached. */
+bool crypto_x86_has_aesni();
+
+/** Returns true if the CPU supports the SHA-256 extensions.  Cached. */
+bool crypto_x86_has_shani();
+
+/** Returns true if the CPU and OS support AVX2.  Cached. */
+bool crypto_x86_has_avx2();
+
+#define CRYPTO_X86_FEATURE_AESNI (1 << 0)
+#define CRYPTO_X86_FEATURE_SHANI (1 << 1)
+#define CRYPTO_X86_FEATURE_AVX2 (1 << 2)
+
+/**
+ * For tests and benchmarks: the crypto_x86_has_* functions report the
+ * CRYPTO_X86_FEATURE_* bits in features as missing until the next call, so the
+ * portable paths can run on a CPU that has the instructions.  AES key schedules
+ * are laid out for one backend, so re-init any keys after changing AESNI.
+ */
+void crypto_x86_disable_features(unsigned int features);
+
+/** Expands key into 11 round keys in FIPS-197 byte order (176 bytes). */
+void crypto_x86_aes128_expand_key(const uint8_t* key, uint32_t round_keys[44]);
+
+/** plaintext and ciphertext may point to the same block. */
+void crypto_x86_aes128_encrypt(const uint32_t round_keys[44],
+                               const uint8_t* plaintext,
+                               uint8_t* ciphertext);
+
+/**
+ * Encrypts num_blocks independent blocks, four at a time so the AES unit's
+ * pipeline stays full.  plaintext and ciphertext may be the same buffer.
+ */
+void crypto_x86_aes128_encrypt_blocks(const uint32_t round_keys[44],
+                                      const uint8_t* plaintext,
+                                      uint8_t* ciphertext,
+                                      size_t num_blocks);
+
+/** Runs the SHA-256 compression function over num_blocks 64-byte blocks. */
+void crypto_x86_sha256_blocks(uint32_t state[8],
+                              const uint8_t* data,
+                              size_t num_blocks);
+
+/** Number of independent hashes crypto_x86_sha256_lanes compresses at once. */
+#define CRYPTO_X86_SHA256_LANES 8
+
+/**
+ * Compresses one 64-byte block into each of CRYPTO_X86_SHA256_LANES
+ * independent SHA-256 states, one per 32-bit lane of the AVX2 registers.
+ * Lanes may not share a state.  Needs crypto_x86_has_avx2().  (With only
+ * SSE2 there are too few registers for this to beat the scalar code.)
+ */
+void crypto_x86_sha256_lanes(
+    uint32_t* const states[CRYPTO_X86_SHA256_LANES],
+    const uint8_t* const blocks[CRYPTO_X86_SHA256_LANES]);
+
+#endif  // UW_CRYPTO_X86_ACCEL
+
+#endif  // LIBUWEAVE_DEVICES_HOST_PROVIDER_CRYPTO_X86_H_
@@ -0,0 +1,11 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "uweave/provider/log.h"
+
+#include <stdio.h>
+
+void uwp_log_vprintf(const char* format, va_list ap) {
+  vfprintf(stderr, format, ap);
+}
@@ -0,0 +1,94 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/provider/sha256_portable.h"
+
+#define GET_U32_(p_)                                       \
+  (((uint32_t)(p_)[0] << 24) | ((uint32_t)(p_)[1] << 16) | \
+   ((uint32_t)(p_)[2] << 8) | ((uint32_t)(p_)[3]))
+
+#define ROTR_(w_, n_) (((w_) >> (n_)) | ((w_) << (32 - (n_))))
+
+#define CH_(x_, y_, z_) ((z_) ^ ((x_) & ((y_) ^ (z_))))
+#define MAJ_(x_, y_, z_) (((x_) & (y_)) | ((z_) & ((x_) | (y_))))
+#define SUM0_(x_) (ROTR_(x_, 2) ^ ROTR_(x_, 13) ^ ROTR_(x_, 22))
+#define SUM1_(x_) (ROTR_(x_, 6) ^ ROTR_(x_, 11) ^ ROTR_(x_, 25))
+#define SIGMA0_(x_) (ROTR_(x_, 7) ^ ROTR_(x_, 18) ^ ((x_) >> 3))
+#define SIGMA1_(x_) (ROTR_(x_, 17) ^ ROTR_(x_, 19) ^ ((x_) >> 10))
+
+static const uint32_t kK[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+// Message word i for the first 16 rounds, loaded straight from the block.
+#define LOAD_W_(i_) (w[(i_)] = GET_U32_(data + 4 * (i_)))
+
+// Message word i for rounds 16..63, computed in place over word i - 16.
+#define SCHEDULE_W_(i_)                                               \
+  (w[(i_) & 15] += SIGMA1_(w[((i_) - 2) & 15]) + w[((i_) - 7) & 15] + \
+                   SIGMA0_(w[((i_) - 15) & 15]))
+
+// Rather than shuffling eight variables each round, the callers rotate the
+// argument order and only d and h are written.
+#define ROUND_(a_, b_, c_, d_, e_, f_, g_, h_, i_, w_)                   \
+  do {                                                                   \
+    uint32_t t1_ = (h_) + SUM1_(e_) + CH_(e_, f_, g_) + kK[(i_)] + (w_); \
+    (d_) += t1_;                                                         \
+    (h_) = t1_ + SUM0_(a_) + MAJ_(a_, b_, c_);                           \
+  } while (0)
+
+#define ROUNDS_8_(i_, W_)                                   \
+  do {                                                      \
+    ROUND_(a, b, c, d, e, f, g, h, (i_) + 0, W_((i_) + 0)); \
+    ROUND_(h, a, b, c, d, e, f, g, (i_) + 1, W_((i_) + 1)); \
+    ROUND_(g, h, a, b, c, d, e, f, (i_) + 2, W_((i_) + 2)); \
+    ROUND_(f, g, h, a, b, c, d, e, (i_) + 3, W_((i_) + 3)); \
+    ROUND_(e, f, g, h, a, b, c, d, (i_) + 4, W_((i_) + 4)); \
+    ROUND_(d, e, f, g, h, a, b, c, (i_) + 5, W_((i_) + 5)); \
+    ROUND_(c, d, e, f, g, h, a, b, (i_) + 6, W_((i_) + 6)); \
+    ROUND_(b, c, d, e, f, g, h, a, (i_) + 7, W_((i_) + 7)); \
+  } while (0)
+
+void sha256_portable_blocks(uint32_t state[8],
+                            const uint8_t* data,
+                            size_t num_blocks) {
+  uint32_t w[16];
+  for (; num_blocks > 0; --num_blocks, data += 64) {
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    uint32_t e = state[4];
+    uint32_t f = state[5];
+    uint32_t g = state[6];
+    uint32_t h = state[7];
+
+    ROUNDS_8_(0, LOAD_W_);
+    ROUNDS_8_(8, LOAD_W_);
+    ROUNDS_8_(16, SCHEDULE_W_);
+    ROUNDS_8_(24, SCHEDULE_W_);
+    ROUNDS_8_(32, SCHEDULE_W_);
+    ROUNDS_8_(40, SCHEDULE_W_);
+    ROUNDS_8_(48, SCHEDULE_W_);
+    ROUNDS_8_(56, SCHEDULE_W_);
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
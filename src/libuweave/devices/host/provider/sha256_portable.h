@@ -0,0 +1,22 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_PROVIDER_SHA256_PORTABLE_H_
+#define LIBUWEAVE_DEVICES_HOST_PROVIDER_SHA256_PORTABLE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Portable SHA-256 compression function.  Message words are loaded big-endian
+ * a word at a time and all 64 rounds are unrolled with a rolling 16-word
+ * schedule.  Buffering and padding are left to the caller.
+ */
+
+/** Runs the compression function over num_blocks 64-byte blocks. */
+void sha256_portable_blocks(uint32_t state[8],
+                            const uint8_t* data,
+                            size_t num_blocks);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_PROVIDER_SHA256_PORTABLE_H_
@@ -0,0 +1,70 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "uweave/provider/storage.h"
+
+#include <string.h>
+
+// In-memory storage: blobs last for the life of the process, which is what a
+// loopback run needs, and every run starts from a factory-reset device.
+#define MAX_FILES 8
+#define MAX_FILE_SIZE 2048
+
+typedef struct {
+  bool in_use;
+  UwStorageFileName name;
+  size_t length;
+  uint8_t data[MAX_FILE_SIZE];
+} File_;
+
+static File_ files_[MAX_FILES];
+
+static File_* find_file_(UwStorageFileName name) {
+  for (size_t i = 0; i < MAX_FILES; i++) {
+    if (files_[i].in_use && files_[i].name == name) {
+      return &files_[i];
+    }
+  }
+  return NULL;
+}
+
+bool uwp_storage_init() {
+  return true;
+}
+
+UwStatus uwp_storage_get(UwStorageFileName name,
+                         uint8_t buf[],
+                         size_t buf_len,
+                         size_t* result_len) {
+  File_* file = find_file_(name);
+  if (file == NULL) {
+    return kUwStatusStorageNotFound;
+  }
+  if (file->length > buf_len) {
+    return kUwStatusStorageBufferTooSmall;
+  }
+  memcpy(buf, file->data, file->length);
+  *result_len = file->length;
+  return kUwStatusSuccess;
+}
+
+UwStatus uwp_storage_put(UwStorageFileName name,
+                         uint8_t buf[],
+                         size_t buf_len) {
+  if (buf_len > MAX_FILE_SIZE) {
+    return kUwStatusStorageFileTooLarge;
+  }
+  File_* file = find_file_(name);
+  for (size_t i = 0; file == NULL && i < MAX_FILES; i++) {
+    if (!files_[i].in_use) {
+      file = &files_[i];
+    }
+  }
+  if (file == NULL) {
+    return kUwStatusStorageNoAvailableSpace;
+  }
+  *file = (File_){.in_use = true, .name = name, .length = buf_len};
+  memcpy(file->data, buf, buf_len);
+  return kUwStatusSuccess;
+}
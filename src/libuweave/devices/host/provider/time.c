@@ -0,0 +1,50 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "uweave/provider/time.h"
+
+#include "devices/host/provider/time_host.h"
+
+// Like a board without a battery-backed clock, the device starts out with no
+// time until a client sets it.
+static bool is_time_set_ = false;
+// Seconds added to the host clock, as set by uwp_time_set.
+static time_t offset_ = 0;
+// Seconds added to the monotonic clock by time_host_advance_ticks.
+static time_t ticks_offset_ = 0;
+
+static time_t monotonic_seconds_() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec;
+}
+
+bool uwp_time_init() {
+  return true;
+}
+
+void uwp_time_set(time_t unix_timestamp_seconds) {
+  offset_ = unix_timestamp_seconds - time(NULL);
+  is_time_set_ = true;
+}
+
+time_t uwp_time_get() {
+  return time(NULL) + offset_;
+}
+
+time_t uwp_time_get_ticks() {
+  return monotonic_seconds_() + ticks_offset_;
+}
+
+void time_host_advance_ticks(time_t seconds) {
+  ticks_offset_ += seconds;
+}
+
+uint32_t uwp_time_get_accuracy_ppm() {
+  return 50;
+}
+
+bool uwp_time_is_time_set() {
+  return is_time_set_;
+}
@@ -0,0 +1,16 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_PROVIDER_TIME_HOST_H_
+#define LIBUWEAVE_DEVICES_HOST_PROVIDER_TIME_HOST_H_
+
+#include <time.h>
+
+/**
+ * For tests: moves uwp_time_get_ticks, and so the device's uptime, forward by
+ * seconds, so that timeouts can be reached without waiting for them.
+ */
+void time_host_advance_ticks(time_t seconds);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_PROVIDER_TIME_HOST_H_
@@ -0,0 +1,90 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/** Tests Privet admission control through the loopback BLE transport. */
+
+#include "devices/host/test/test.h"
+#include "devices/host/test/test_loopback.h"
+#include "src/counters.h"
+#include "src/device.h"
+
+static UwCounterValue rejections_(UwDevice* device) {
+  return uw_counter_set_get_uw_counter_(
+      device->counter_set, kUwInternalCounterAdmissionRejectedPairingStart);
+}
+
+/** Sends a /pairing/start and waits for the reply, or the rejection. */
+static bool pairing_start_(UwDevice* device,
+                           BleClient* client,
+                           uint32_t request_id) {
+  return test_loopback_send_pairing_start(client, request_id) &&
+         test_loopback_run_until_event(device, client, NULL) ==
+             kBleClientEventMessage;
+}
+
+/**
+ * A client that loops on /pairing/start is rate limited once it has used its
+ * burst, while a client on another connection is still admitted.
+ */
+static void test_noisy_connection_does_not_starve_another_() {
+  UwDevice* device = test_loopback_start_device();
+  TEST_EXPECT(device != NULL);
+  TEST_EXPECT(test_loopback_connect(device, 0));
+  TEST_EXPECT(test_loopback_connect(device, 1));
+  BleClient* noisy = test_loopback_get_client(0);
+  BleClient* quiet = test_loopback_get_client(1);
+
+  // The test runs within a second, so no credit is refilled.
+  uint32_t request_id = 0;
+  for (int i = 0; i < UW_ADMISSION_PAIRING_START_BURST; i++) {
+    TEST_EXPECT(pairing_start_(device, noisy, request_id++));
+  }
+  TEST_EXPECT(rejections_(device) == 0);
+  TEST_EXPECT(pairing_start_(device, noisy, request_id++));
+  TEST_EXPECT(rejections_(device) == 1);
+
+  TEST_EXPECT(pairing_start_(device, quiet, request_id++));
+  TEST_EXPECT(rejections_(device) == 1);
+}
+
+/**
+ * Reconnecting starts a fresh set of buckets for the connection, but the
+ * device-wide limit still caps the calls of all connections together.
+ */
+static void test_reconnecting_client_hits_device_limit_() {
+  UwDevice* device = test_loopback_start_device();
+  TEST_EXPECT(device != NULL);
+  TEST_EXPECT(test_loopback_connect(device, 0));
+  TEST_EXPECT(test_loopback_connect(device, 1));
+  BleClient* client = test_loopback_get_client(0);
+  UwCounterValue rejections_before = rejections_(device);
+
+  // Each pass reconnects and uses the whole burst of the new connection.
+  uint32_t request_id = 0;
+  const int device_limit =
+      UW_ADMISSION_PAIRING_START_BURST * UW_ADMISSION_DEVICE_WIDE_SCALE;
+  int calls = 0;
+  for (int i = 0; i < device_limit; i++) {
+    test_loopback_disconnect(device, client);
+    TEST_EXPECT(test_loopback_connect(device, 0));
+    for (int j = 0; j < UW_ADMISSION_PAIRING_START_BURST; j++) {
+      TEST_EXPECT(pairing_start_(device, client, request_id++));
+      calls++;
+    }
+  }
+  TEST_EXPECT(calls - (int)(rejections_(device) - rejections_before) ==
+              device_limit);
+
+  // Another connection, which has its whole burst, is refused as well.
+  UwCounterValue rejections_after = rejections_(device);
+  TEST_EXPECT(pairing_start_(device, test_loopback_get_client(1),
+                             request_id++));
+  TEST_EXPECT(rejections_(device) == rejections_after + 1);
+}
+
+int main(int argc, char* argv[]) {
+  TEST_RUN(test_noisy_connection_does_not_starve_another_);
+  TEST_RUN(test_reconnecting_client_hits_device_limit_);
+  return TEST_EXIT_STATUS();
+}
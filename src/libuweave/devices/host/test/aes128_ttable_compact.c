@@ -0,0 +1,12 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/test/aes128_ttable_compact.h"
+
+#undef UW_CRYPTO_AES_TTABLE_COMPACT
+#define UW_CRYPTO_AES_TTABLE_COMPACT 1
+#define aes128_ttable_expand_key aes128_ttable_compact_expand_key
+#define aes128_ttable_encrypt aes128_ttable_compact_encrypt
+
+#include "devices/host/provider/aes128_ttable.c"
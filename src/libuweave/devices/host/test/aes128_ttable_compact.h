@@ -0,0 +1,27 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_TEST_AES128_TTABLE_COMPACT_H_
+#define LIBUWEAVE_DEVICES_HOST_TEST_AES128_TTABLE_COMPACT_H_
+
+#include <stdint.h>
+
+#include "devices/host/provider/aes128_ttable.h"
+
+/**
+ * devices/host/provider/aes128_ttable.c built a second time with
+ * UW_CRYPTO_AES_TTABLE_COMPACT, so that a test checks both table layouts
+ * whichever one the provider was built with.
+ */
+
+void aes128_ttable_compact_expand_key(
+    const uint8_t* key,
+    uint32_t round_keys[AES128_TTABLE_ROUND_KEY_WORDS]);
+
+void aes128_ttable_compact_encrypt(
+    const uint32_t round_keys[AES128_TTABLE_ROUND_KEY_WORDS],
+    const uint8_t* plaintext,
+    uint8_t* ciphertext);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_TEST_AES128_TTABLE_COMPACT_H_
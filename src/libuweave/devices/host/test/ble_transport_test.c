@@ -0,0 +1,317 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/** Tests the BLE transport end to end over the loopback provider. */
+
+#include "devices/host/client/ble_client.h"
+#include "devices/host/provider/ble_loopback.h"
+#include "devices/host/provider/time_host.h"
+#include "devices/host/test/test.h"
+#include "devices/host/test/test_loopback.h"
+#include "src/crypto_defines.h"
+#include "src/device.h"
+#include "src/service.h"
+#include "uweave/ble_transport.h"
+
+// Bounds the passes a device may stay busy for with no client traffic, e.g.
+// filling the SPAKE keypair pool.
+#define MAX_BUSY_PASSES 10000
+
+// Requests a client sends without waiting for the replies.
+#define BACK_TO_BACK_REQUESTS 8
+#define FIRST_REQUEST_ID 100
+
+// The smallest packets the link takes, so that every reply spans several.
+#define SMALL_MTU 20
+// Passes an /info reply takes at SMALL_MTU when each sends one packet.
+#define MAX_PASSES_PER_SMALL_REPLY 4
+
+static UwDevice* device_;
+
+/** Set to have interrupt_service_ call tx complete during the next pass. */
+static bool interrupt_next_pass_;
+
+/**
+ * Stands in for a tx-complete interrupt that fires after the transport has
+ * looked at its window in a pass, but before the pass ends.
+ */
+static bool interrupt_service_handler_(void* data) {
+  if (interrupt_next_pass_) {
+    interrupt_next_pass_ = false;
+    uw_ble_transport_notify_tx_complete((UwBleTransport*)data);
+  }
+  return false;
+}
+
+static UwDeviceWorkState run_until_idle_() {
+  UwDeviceWorkState state = kUwDeviceWorkStateBusy;
+  for (int i = 0; i < MAX_BUSY_PASSES && state == kUwDeviceWorkStateBusy;
+       i++) {
+    state = uw_device_handle_events(device_);
+  }
+  return state;
+}
+
+static const BleLoopbackConfig kDefaultLink = {.mtu = UW_BLE_PACKET_SIZE,
+                                               .seed = 1};
+
+/** Closes the connections a previous test left open. */
+static void disconnect_all_() {
+  for (size_t i = 0; i < BLE_LOOPBACK_MAX_CLIENTS; i++) {
+    if (ble_loopback_client_is_connected(i)) {
+      test_loopback_disconnect(device_, test_loopback_get_client(i));
+    }
+  }
+  run_until_idle_();
+}
+
+/** Connects the first count clients over a link with mtu and tx_window. */
+static void connect_clients_(size_t count, uint16_t mtu, uint32_t tx_window) {
+  disconnect_all_();
+  BleLoopbackConfig link = kDefaultLink;
+  link.mtu = mtu;
+  link.tx_window = tx_window;
+  TEST_EXPECT(ble_loopback_configure(&link));
+  for (size_t i = 0; i < count; i++) {
+    TEST_EXPECT(test_loopback_connect(device_, i));
+  }
+}
+
+/** Whether received is the reply to request_id. */
+static bool is_reply_to_(const UwBuffer* received, uint32_t request_id) {
+  uint32_t reply_id;
+  return test_loopback_get_reply_request_id(received, &reply_id) &&
+         reply_id == request_id;
+}
+
+/**
+ * A client sends its requests back to back, each as soon as the previous one
+ * is written out.  The device takes the next while a reply goes out, and the
+ * replies come back in order with matching ids.
+ */
+static void check_back_to_back_replies_in_order_(uint16_t mtu,
+                                                 uint32_t tx_window) {
+  connect_clients_(1, mtu, tx_window);
+  BleClient* client = test_loopback_get_client(0);
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+
+  uint32_t sent = 0;
+  uint32_t replied = 0;
+  uint32_t sent_before_first_reply = 0;
+  for (int pass = 0; pass < MAX_BUSY_PASSES && replied < BACK_TO_BACK_REQUESTS;
+       pass++) {
+    if (sent < BACK_TO_BACK_REQUESTS &&
+        test_loopback_send_request(client, TEST_PRIVET_API_ID_INFO,
+                                   FIRST_REQUEST_ID + sent)) {
+      sent++;
+    }
+    uw_device_handle_events(device_);
+    uw_buffer_reset(&received);
+    BleClientEvent event = ble_client_poll(client, &received);
+    if (event == kBleClientEventNone) {
+      continue;
+    }
+    TEST_EXPECT(event == kBleClientEventMessage);
+    if (replied == 0) {
+      sent_before_first_reply = sent;
+    }
+    TEST_EXPECT(is_reply_to_(&received, FIRST_REQUEST_ID + replied));
+    replied++;
+  }
+  TEST_EXPECT(replied == BACK_TO_BACK_REQUESTS);
+  TEST_EXPECT(sent_before_first_reply > 1);
+  TEST_EXPECT(ble_loopback_configure(&kDefaultLink));
+}
+
+static void test_back_to_back_replies_in_order_() {
+  check_back_to_back_replies_in_order_(UW_BLE_PACKET_SIZE, 0);
+  check_back_to_back_replies_in_order_(SMALL_MTU, 2);
+  check_back_to_back_replies_in_order_(SMALL_MTU, 1);
+}
+
+/**
+ * With every connection waiting on a reply of several packets and room for one
+ * packet at a time, the device sends for each in turn, so the replies finish
+ * together rather than one after another.
+ */
+static void test_connections_are_served_in_turn_() {
+  connect_clients_(UW_BLE_MAX_CONNECTIONS, SMALL_MTU, 1);
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    TEST_EXPECT(test_loopback_send_request(test_loopback_get_client(i),
+                                           TEST_PRIVET_API_ID_INFO,
+                                           FIRST_REQUEST_ID + i));
+  }
+
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+  int done_pass[UW_BLE_MAX_CONNECTIONS];
+  size_t done = 0;
+  int first_done = -1;
+  int last_done = -1;
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    done_pass[i] = -1;
+  }
+  for (int pass = 0; pass < MAX_BUSY_PASSES && done < UW_BLE_MAX_CONNECTIONS;
+       pass++) {
+    uw_device_handle_events(device_);
+    for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+      uw_buffer_reset(&received);
+      BleClientEvent event =
+          ble_client_poll(test_loopback_get_client(i), &received);
+      if (event == kBleClientEventNone) {
+        continue;
+      }
+      TEST_EXPECT(event == kBleClientEventMessage && done_pass[i] < 0);
+      TEST_EXPECT(is_reply_to_(&received, FIRST_REQUEST_ID + i));
+      done_pass[i] = pass;
+      first_done = done == 0 ? pass : first_done;
+      last_done = pass;
+      done++;
+    }
+  }
+  TEST_EXPECT(done == UW_BLE_MAX_CONNECTIONS);
+  // A reply takes first_done passes on its own; one after another, the last
+  // would take about UW_BLE_MAX_CONNECTIONS times that.
+  TEST_EXPECT(first_done > UW_BLE_MAX_CONNECTIONS);
+  TEST_EXPECT(last_done - first_done <= UW_BLE_MAX_CONNECTIONS);
+  TEST_EXPECT(ble_loopback_configure(&kDefaultLink));
+}
+
+/**
+ * Each connection times out on its own idle time: traffic on one does not
+ * keep another alive, and the one that timed out does not take the other
+ * down.
+ */
+static void test_idle_timeout_is_per_connection_() {
+  connect_clients_(2, UW_BLE_PACKET_SIZE, 0);
+  time_t timeout = uw_device_is_setup(device_)
+                       ? UW_IDLE_TIMEOUT_SECONDS
+                       : UW_UNCONFIGURED_IDLE_TIMEOUT_SECONDS;
+
+  time_host_advance_ticks(timeout);
+  BleClient* active = test_loopback_get_client(1);
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+  TEST_EXPECT(test_loopback_send_request(active, TEST_PRIVET_API_ID_INFO,
+                                         FIRST_REQUEST_ID));
+  TEST_EXPECT(test_loopback_run_until_event(device_, active, &received) ==
+              kBleClientEventMessage);
+  TEST_EXPECT(ble_loopback_client_is_connected(0));
+
+  time_host_advance_ticks(1);
+  uw_device_notify_work(device_);
+  run_until_idle_();
+  TEST_EXPECT(!ble_loopback_client_is_connected(0));
+  TEST_EXPECT(ble_loopback_client_is_connected(1));
+
+  uw_buffer_reset(&received);
+  TEST_EXPECT(test_loopback_send_request(active, TEST_PRIVET_API_ID_INFO,
+                                         FIRST_REQUEST_ID + 1));
+  TEST_EXPECT(test_loopback_run_until_event(device_, active, &received) ==
+              kBleClientEventMessage);
+  TEST_EXPECT(is_reply_to_(&received, FIRST_REQUEST_ID + 1));
+}
+
+/**
+ * Driven like firmware, which runs a pass only while the device is busy or
+ * after it was notified, a reply several times the transmit window still goes
+ * out: the device sleeps while the window is full, and each packet the client
+ * reads wakes it to send the next.
+ */
+static void test_tx_window_drains_on_notifications_() {
+  connect_clients_(1, SMALL_MTU, 1);
+  BleClient* client = test_loopback_get_client(0);
+  TEST_EXPECT(run_until_idle_() == kUwDeviceWorkStateIdle);
+  TEST_EXPECT(test_loopback_send_request(client, TEST_PRIVET_API_ID_INFO,
+                                         FIRST_REQUEST_ID));
+
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+  BleClientEvent event = kBleClientEventNone;
+  int passes = 0;
+  int sleeps = 0;
+  for (int i = 0; i < MAX_BUSY_PASSES && event == kBleClientEventNone; i++) {
+    if (device_->work_state == kUwDeviceWorkStateBusy) {
+      passes++;
+      sleeps += uw_device_handle_events(device_) == kUwDeviceWorkStateIdle;
+    }
+    event = ble_client_poll(client, &received);
+  }
+  TEST_EXPECT(event == kBleClientEventMessage);
+  TEST_EXPECT(is_reply_to_(&received, FIRST_REQUEST_ID));
+  // One pass per packet, and the device slept on the full window between.
+  TEST_EXPECT(sleeps > 0 && passes <= MAX_PASSES_PER_SMALL_REPLY);
+  TEST_EXPECT(ble_loopback_configure(&kDefaultLink));
+}
+
+/**
+ * With every connection slot taken, a client connects and disconnects at
+ * once, so that the device sees the connection it refuses and then the
+ * disconnection of the same, unknown, handle.  The packet queued behind them
+ * by a connected client must still be delivered.
+ */
+static void test_disconnect_of_refused_handle_keeps_next_packet_() {
+  UwDevice* device = device_;
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    TEST_EXPECT(test_loopback_connect(device, i));
+  }
+
+  const uint8_t handshake[] = {UW_CRYPTO_MODE_PASSTHROUGH};
+  BleClient* refused = test_loopback_get_client(UW_BLE_MAX_CONNECTIONS);
+  ble_client_init(refused, UW_BLE_MAX_CONNECTIONS);
+  TEST_EXPECT(ble_client_connect(refused, handshake, sizeof(handshake)));
+  ble_client_disconnect(refused);
+
+  // Writes the request behind the two events before the device reads any.
+  BleClient* client = test_loopback_get_client(0);
+  TEST_EXPECT(test_loopback_send_request(client, TEST_PRIVET_API_ID_INFO, 1));
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer received;
+  uw_buffer_init(&received, received_data, sizeof(received_data));
+  TEST_EXPECT(ble_client_poll(client, &received) == kBleClientEventNone);
+
+  TEST_EXPECT(test_loopback_run_until_event(device, client, &received) ==
+              kBleClientEventMessage);
+}
+
+/**
+ * A tx-complete notification that interrupts a pass which started busy finds
+ * the device busy and does not call the notify handler, so the pass must
+ * report itself busy rather than let the device sleep with the window to
+ * fill.  The pass after that is idle again.
+ */
+static void test_tx_complete_during_pass_is_not_lost_() {
+  static UwService interrupt_service;
+  uw_service_init_(&interrupt_service, NULL, interrupt_service_handler_, NULL,
+                   device_->first_service->service_data);
+  uw_device_register_service_(device_, &interrupt_service);
+  TEST_EXPECT(run_until_idle_() == kUwDeviceWorkStateIdle);
+
+  uw_device_notify_work(device_);
+  TEST_EXPECT(uw_device_handle_events(device_) == kUwDeviceWorkStateIdle);
+
+  uw_device_notify_work(device_);
+  interrupt_next_pass_ = true;
+  TEST_EXPECT(uw_device_handle_events(device_) == kUwDeviceWorkStateBusy);
+  TEST_EXPECT(uw_device_handle_events(device_) == kUwDeviceWorkStateIdle);
+}
+
+int main(int argc, char* argv[]) {
+  device_ = test_loopback_start_device();
+  if (device_ == NULL) {
+    return 1;
+  }
+  TEST_RUN(test_disconnect_of_refused_handle_keeps_next_packet_);
+  TEST_RUN(test_back_to_back_replies_in_order_);
+  TEST_RUN(test_connections_are_served_in_turn_);
+  TEST_RUN(test_idle_timeout_is_per_connection_);
+  TEST_RUN(test_tx_window_drains_on_notifications_);
+  TEST_RUN(test_tx_complete_during_pass_is_not_lost_);
+  return TEST_EXIT_STATUS();
+}
@@ -0,0 +1,200 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Tests encrypted sessions over the loopback link, built with a low
+ * UW_SESSION_REKEY_THRESHOLD (see the Makefile).
+ */
+
+#include <string.h>
+
+#include "devices/host/client/client_session.h"
+#include "devices/host/test/test.h"
+#include "devices/host/test/test_loopback.h"
+#include "src/crypto_defines.h"
+#include "src/device.h"
+#include "src/device_crypto.h"
+#include "uweave/ble_transport.h"
+
+static UwDevice* device_;
+
+/**
+ * The client rekeys once a counter reaches the threshold, and every request on
+ * either side of each rekey gets its reply under the key of the moment.
+ */
+static void test_client_rekeys_at_threshold_() {
+  static ClientSession session;
+  TEST_EXPECT(test_loopback_init_session(device_, &session));
+  TEST_EXPECT(test_loopback_connect_secure(
+      device_, 0, UW_CRYPTO_MODE_TOKEN_SHA256, &session));
+  BleClient* client = test_loopback_get_client(0);
+
+  uint8_t first_key[sizeof(session.state.session_key_bytes)];
+  memcpy(first_key, session.state.session_key_bytes, sizeof(first_key));
+
+  uint8_t reply_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer reply;
+  uw_buffer_init(&reply, reply_data, sizeof(reply_data));
+  for (uint32_t i = 0; i < 2 * UW_SESSION_REKEY_THRESHOLD + 1; i++) {
+    TEST_EXPECT(test_loopback_secure_request(
+        device_, client, &session, TEST_PRIVET_API_ID_INFO, i, &reply));
+  }
+  TEST_EXPECT(session.rekey_count == 2);
+  TEST_EXPECT(memcmp(first_key, session.state.session_key_bytes,
+                     sizeof(first_key)) != 0);
+  ble_client_disconnect(client);
+}
+
+/**
+ * A client that sends on past the threshold has its request turned away with
+ * a control message, and is served again after it rekeys.
+ */
+static void test_device_asks_client_to_rekey_() {
+  static ClientSession session;
+  TEST_EXPECT(test_loopback_init_session(device_, &session));
+  TEST_EXPECT(test_loopback_connect_secure(
+      device_, 1, UW_CRYPTO_MODE_TOKEN_SHA256, &session));
+  BleClient* client = test_loopback_get_client(1);
+
+  uint8_t message_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer message;
+  uw_buffer_init(&message, message_data, sizeof(message_data));
+  for (uint32_t i = 0; i < UW_SESSION_REKEY_THRESHOLD; i++) {
+    TEST_EXPECT(
+        test_loopback_encode_request(TEST_PRIVET_API_ID_INFO, i, &message));
+    TEST_EXPECT(test_loopback_send_sealed(device_, client, &session, &message));
+    TEST_EXPECT(uw_buffer_get_length(&message) > 0);
+  }
+  TEST_EXPECT(!session.state.rekey_requested);
+
+  TEST_EXPECT(test_loopback_encode_request(TEST_PRIVET_API_ID_INFO, 0,
+                                           &message));
+  TEST_EXPECT(test_loopback_send_sealed(device_, client, &session, &message));
+  TEST_EXPECT(uw_buffer_get_length(&message) == 0);
+  TEST_EXPECT(session.state.rekey_requested);
+
+  TEST_EXPECT(test_loopback_secure_request(
+      device_, client, &session, TEST_PRIVET_API_ID_INFO, 1, &message));
+  TEST_EXPECT(session.rekey_count == 1);
+  TEST_EXPECT(!session.state.rekey_requested);
+  ble_client_disconnect(client);
+}
+
+/**
+ * A full handshake that asks for a ticket leaves the client able to resume
+ * with it, under a new key, as often as it reconnects.
+ */
+static void test_ticket_resumes_session_() {
+  static ClientSession session;
+  TEST_EXPECT(test_loopback_init_session(device_, &session));
+  TEST_EXPECT(test_loopback_connect_secure(
+      device_, 2, UW_CRYPTO_MODE_TOKEN_SHA256_TICKET, &session));
+  TEST_EXPECT(session.has_ticket);
+  BleClient* client = test_loopback_get_client(2);
+
+  uint8_t reply_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer reply;
+  uw_buffer_init(&reply, reply_data, sizeof(reply_data));
+  TEST_EXPECT(test_loopback_secure_request(
+      device_, client, &session, TEST_PRIVET_API_ID_INFO, 0, &reply));
+  uint8_t full_key[sizeof(session.state.session_key_bytes)];
+  memcpy(full_key, session.state.session_key_bytes, sizeof(full_key));
+  test_loopback_disconnect(device_, client);
+
+  for (uint32_t i = 1; i <= 2; i++) {
+    TEST_EXPECT(test_loopback_connect_secure(
+        device_, 2, UW_CRYPTO_MODE_RESUME_TICKET, &session));
+    TEST_EXPECT(session.has_ticket);
+    TEST_EXPECT(memcmp(full_key, session.state.session_key_bytes,
+                       sizeof(full_key)) != 0);
+    TEST_EXPECT(test_loopback_secure_request(
+        device_, client, &session, TEST_PRIVET_API_ID_INFO, i, &reply));
+    test_loopback_disconnect(device_, client);
+  }
+}
+
+/**
+ * Pairing, open to any client, leaves the ticket good.  A new root key on the
+ * device revokes it, and the client then drops it, falling back on a full
+ * handshake.
+ */
+static void test_new_root_key_refuses_ticket_() {
+  static ClientSession session;
+  TEST_EXPECT(test_loopback_init_session(device_, &session));
+  TEST_EXPECT(test_loopback_connect_secure(
+      device_, 3, UW_CRYPTO_MODE_TOKEN_SHA256_TICKET, &session));
+  BleClient* client = test_loopback_get_client(3);
+  test_loopback_disconnect(device_, client);
+
+  UwDeviceCrypto* device_crypto = &device_->device_crypto;
+  uint8_t pairing_key[sizeof(device_crypto->ephemeral_pairing_key)] = {};
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_remember_pairing_key_(
+      device_crypto, pairing_key, sizeof(pairing_key), 0)));
+  TEST_EXPECT(test_loopback_connect_secure(
+      device_, 3, UW_CRYPTO_MODE_RESUME_TICKET, &session));
+  test_loopback_disconnect(device_, client);
+
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_generate_pending_client_authz_key_(device_crypto,
+                                                          NULL)));
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_commit_pending_client_authz_key_(device_crypto)));
+  TEST_EXPECT(!test_loopback_connect_secure(
+      device_, 3, UW_CRYPTO_MODE_RESUME_TICKET, &session));
+  TEST_EXPECT(!session.has_ticket);
+  test_loopback_disconnect(device_, client);
+
+  TEST_EXPECT(test_loopback_connect_secure(
+      device_, 3, UW_CRYPTO_MODE_TOKEN_SHA256, &session));
+  uint8_t reply_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer reply;
+  uw_buffer_init(&reply, reply_data, sizeof(reply_data));
+  TEST_EXPECT(test_loopback_secure_request(
+      device_, client, &session, TEST_PRIVET_API_ID_INFO, 0, &reply));
+  test_loopback_disconnect(device_, client);
+}
+
+/**
+ * A client that does not offer rekeying, as before it existed, is served past
+ * the threshold without ever being asked to rekey.
+ */
+static void test_client_without_rekey_is_served_past_threshold_() {
+  static ClientSession session;
+  TEST_EXPECT(test_loopback_init_session(device_, &session));
+  session.offer_rekey = false;
+  TEST_EXPECT(test_loopback_connect_secure(
+      device_, 0, UW_CRYPTO_MODE_TOKEN_SHA256, &session));
+  BleClient* client = test_loopback_get_client(0);
+
+  uint8_t reply_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer reply;
+  uw_buffer_init(&reply, reply_data, sizeof(reply_data));
+  for (uint32_t i = 0; i < 2 * UW_SESSION_REKEY_THRESHOLD + 1; i++) {
+    TEST_EXPECT(test_loopback_secure_request(
+        device_, client, &session, TEST_PRIVET_API_ID_INFO, i, &reply));
+  }
+  TEST_EXPECT(session.rekey_count == 0);
+  TEST_EXPECT(!session.state.rekey_requested);
+  TEST_EXPECT(session.state.our_counter == 2 * UW_SESSION_REKEY_THRESHOLD + 1);
+
+  uint8_t rekey_data[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+  UwBuffer rekey;
+  uw_buffer_init(&rekey, rekey_data, sizeof(rekey_data));
+  TEST_EXPECT(!uw_status_is_success(
+      uw_channel_encryption_start_rekey_(&session.state, &rekey)));
+  test_loopback_disconnect(device_, client);
+}
+
+int main(int argc, char* argv[]) {
+  device_ = test_loopback_start_device();
+  if (device_ == NULL) {
+    return 1;
+  }
+  TEST_RUN(test_client_rekeys_at_threshold_);
+  TEST_RUN(test_device_asks_client_to_rekey_);
+  TEST_RUN(test_ticket_resumes_session_);
+  TEST_RUN(test_new_root_key_refuses_ticket_);
+  TEST_RUN(test_client_without_rekey_is_served_past_threshold_);
+  return TEST_EXIT_STATUS();
+}
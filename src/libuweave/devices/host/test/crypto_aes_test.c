@@ -0,0 +1,388 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Tests the AES-128 of the host crypto provider, and the EAX mode on top of
+ * it, against published vectors and the original tiny-aes code.
+ */
+
+#include <pthread.h>
+#include <string.h>
+
+#include "devices/host/provider/aes128_ttable.h"
+#include "devices/host/provider/crypto_x86.h"
+#include "devices/host/test/aes128_ttable_compact.h"
+#include "devices/host/test/test.h"
+#include "src/buffer.h"
+#include "src/crypto_eax.h"
+#include "tiny-aes128-c/aes.h"
+#include "uweave/provider/crypto.h"
+
+#define BLOCK_SIZE UWP_CRYPTO_AES128_BLOCK_SIZE
+
+typedef struct {
+  uint8_t key[BLOCK_SIZE];
+  uint8_t plaintext[BLOCK_SIZE];
+  uint8_t ciphertext[BLOCK_SIZE];
+} AesVector_;
+
+/** FIPS-197 appendices B and C.1. */
+static const AesVector_ kFips197Vectors[] = {
+    {{0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88,
+      0x09, 0xcf, 0x4f, 0x3c},
+     {0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2,
+      0xe0, 0x37, 0x07, 0x34},
+     {0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97,
+      0x19, 0x6a, 0x0b, 0x32}},
+    {{0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+      0x0c, 0x0d, 0x0e, 0x0f},
+     {0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb,
+      0xcc, 0xdd, 0xee, 0xff},
+     {0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80,
+      0x70, 0xb4, 0xc5, 0x5a}},
+};
+
+#define NUM_FIPS197_VECTORS \
+  (sizeof(kFips197Vectors) / sizeof(kFips197Vectors[0]))
+
+/** The last round key that FIPS-197 A.1 expands from the appendix B key. */
+static const uint8_t kFips197LastRoundKey[BLOCK_SIZE] = {
+    0xd0, 0x14, 0xf9, 0xa8, 0xc9, 0xee, 0x25, 0x89,
+    0xe1, 0x3f, 0x0c, 0xc8, 0xb6, 0x63, 0x0c, 0xa6};
+
+/** Fills data with a repeatable pattern that differs with seed. */
+static void fill_pattern_(uint8_t* data, size_t length, uint32_t seed) {
+  uint32_t x = seed * 2654435761u + 1;
+  for (size_t i = 0; i < length; i++) {
+    x = x * 1664525u + 1013904223u;
+    data[i] = (uint8_t)(x >> 24);
+  }
+}
+
+/**
+ * The key schedule API, the one-shot ECB call and the multi-block call all
+ * give the FIPS-197 ciphertexts.
+ */
+static void test_fips197_known_answers_() {
+  for (size_t i = 0; i < NUM_FIPS197_VECTORS; i++) {
+    const AesVector_* vector = &kFips197Vectors[i];
+    uint8_t out[3 * BLOCK_SIZE];
+    UwpCryptoAes128Key key;
+    TEST_EXPECT(uwp_crypto_aes128_key_init(&key, vector->key));
+    TEST_EXPECT(uwp_crypto_aes128_encrypt_block(&key, vector->plaintext, out));
+    TEST_EXPECT(memcmp(out, vector->ciphertext, BLOCK_SIZE) == 0);
+
+    TEST_EXPECT(uwp_crypto_aes128_ecb_encrypt(vector->key, vector->plaintext,
+                                              out));
+    TEST_EXPECT(memcmp(out, vector->ciphertext, BLOCK_SIZE) == 0);
+
+    // In place, as CTR mode uses it.
+    for (size_t j = 0; j < 3; j++) {
+      memcpy(out + j * BLOCK_SIZE, vector->plaintext, BLOCK_SIZE);
+    }
+    TEST_EXPECT(uwp_crypto_aes128_encrypt_blocks(&key, out, out, 3));
+    for (size_t j = 0; j < 3; j++) {
+      TEST_EXPECT(memcmp(out + j * BLOCK_SIZE, vector->ciphertext,
+                         BLOCK_SIZE) == 0);
+    }
+  }
+
+  uint8_t round_keys[AES128_ROUND_KEY_SIZE];
+  AES128_ECB_expand_key(kFips197Vectors[0].key, round_keys);
+  TEST_EXPECT(memcmp(round_keys + AES128_ROUND_KEY_SIZE - BLOCK_SIZE,
+                     kFips197LastRoundKey, BLOCK_SIZE) == 0);
+}
+
+/**
+ * A schedule expanded once encrypts every block as the original tiny-aes
+ * call does, which expands the key again for each one.  Covers both the
+ * provider, whatever backend it picked, and tiny-aes's own expanded path.
+ */
+static void test_schedule_matches_per_block_expansion_() {
+  for (uint32_t seed = 0; seed < 64; seed++) {
+    uint8_t raw_key[BLOCK_SIZE];
+    uint8_t blocks[8 * BLOCK_SIZE];
+    uint8_t expected[sizeof(blocks)];
+    uint8_t out[sizeof(blocks)];
+    fill_pattern_(raw_key, sizeof(raw_key), seed);
+    fill_pattern_(blocks, sizeof(blocks), seed + 1000);
+    for (size_t j = 0; j < sizeof(blocks); j += BLOCK_SIZE) {
+      AES128_ECB_encrypt(blocks + j, raw_key, expected + j);
+    }
+
+    UwpCryptoAes128Key key;
+    TEST_EXPECT(uwp_crypto_aes128_key_init(&key, raw_key));
+    for (size_t j = 0; j < sizeof(blocks); j += BLOCK_SIZE) {
+      TEST_EXPECT(uwp_crypto_aes128_encrypt_block(&key, blocks + j, out + j));
+    }
+    TEST_EXPECT(memcmp(out, expected, sizeof(out)) == 0);
+    TEST_EXPECT(uwp_crypto_aes128_encrypt_blocks(&key, blocks, out, 8));
+    TEST_EXPECT(memcmp(out, expected, sizeof(out)) == 0);
+
+    uint8_t round_keys[AES128_ROUND_KEY_SIZE];
+    AES128_ECB_expand_key(raw_key, round_keys);
+    for (size_t j = 0; j < sizeof(blocks); j += BLOCK_SIZE) {
+      AES128_ECB_encrypt_expanded(blocks + j, round_keys, out + j);
+    }
+    TEST_EXPECT(memcmp(out, expected, sizeof(out)) == 0);
+  }
+}
+
+typedef void (*TtableExpandKey_)(const uint8_t*, uint32_t*);
+typedef void (*TtableEncrypt_)(const uint32_t*, const uint8_t*, uint8_t*);
+
+/**
+ * Checks one T-table layout against FIPS-197 and tiny-aes.  Its round keys are
+ * the FIPS-197 schedule in big-endian words.
+ */
+static void check_ttable_(TtableExpandKey_ expand_key, TtableEncrypt_ encrypt) {
+  uint32_t round_keys[AES128_TTABLE_ROUND_KEY_WORDS];
+  uint8_t out[BLOCK_SIZE];
+  for (size_t i = 0; i < NUM_FIPS197_VECTORS; i++) {
+    expand_key(kFips197Vectors[i].key, round_keys);
+    encrypt(round_keys, kFips197Vectors[i].plaintext, out);
+    TEST_EXPECT(memcmp(out, kFips197Vectors[i].ciphertext, BLOCK_SIZE) == 0);
+  }
+
+  for (uint32_t seed = 0; seed < 64; seed++) {
+    uint8_t raw_key[BLOCK_SIZE];
+    uint8_t block[BLOCK_SIZE];
+    uint8_t expected[BLOCK_SIZE];
+    uint8_t tiny_round_keys[AES128_ROUND_KEY_SIZE];
+    fill_pattern_(raw_key, sizeof(raw_key), seed);
+    fill_pattern_(block, sizeof(block), seed + 2000);
+    AES128_ECB_expand_key(raw_key, tiny_round_keys);
+    AES128_ECB_encrypt(block, raw_key, expected);
+
+    expand_key(raw_key, round_keys);
+    for (size_t w = 0; w < AES128_TTABLE_ROUND_KEY_WORDS; w++) {
+      const uint8_t* bytes = tiny_round_keys + 4 * w;
+      TEST_EXPECT(round_keys[w] ==
+                  ((uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 |
+                   (uint32_t)bytes[2] << 8 | bytes[3]));
+    }
+    // In place, as the provider allows.
+    memcpy(out, block, sizeof(out));
+    encrypt(round_keys, out, out);
+    TEST_EXPECT(memcmp(out, expected, sizeof(out)) == 0);
+  }
+}
+
+/**
+ * Both T-table layouts, the four-table one and the compact one-table one,
+ * encrypt as FIPS-197 and tiny-aes do, whichever the provider uses.
+ */
+static void test_ttable_matches_tiny_aes_() {
+  check_ttable_(aes128_ttable_expand_key, aes128_ttable_encrypt);
+  check_ttable_(aes128_ttable_compact_expand_key,
+                aes128_ttable_compact_encrypt);
+}
+
+#if UW_CRYPTO_X86_ACCEL
+/**
+ * The AES-NI path expands the FIPS-197 schedule byte for byte as tiny-aes
+ * does, and encrypts as it does one block at a time and in the four-way
+ * interleaved runs, with any remainder.
+ */
+static void test_aesni_matches_tiny_aes_() {
+  if (!crypto_x86_has_aesni()) {
+    fprintf(stderr, "No AES-NI on this CPU, skipped\n");
+    return;
+  }
+  uint32_t round_keys[AES128_TTABLE_ROUND_KEY_WORDS];
+  uint8_t out[9 * BLOCK_SIZE];
+  for (size_t i = 0; i < NUM_FIPS197_VECTORS; i++) {
+    crypto_x86_aes128_expand_key(kFips197Vectors[i].key, round_keys);
+    crypto_x86_aes128_encrypt(round_keys, kFips197Vectors[i].plaintext, out);
+    TEST_EXPECT(memcmp(out, kFips197Vectors[i].ciphertext, BLOCK_SIZE) == 0);
+  }
+
+  for (uint32_t seed = 0; seed < 64; seed++) {
+    uint8_t raw_key[BLOCK_SIZE];
+    uint8_t blocks[sizeof(out)];
+    uint8_t expected[sizeof(out)];
+    uint8_t tiny_round_keys[AES128_ROUND_KEY_SIZE];
+    fill_pattern_(raw_key, sizeof(raw_key), seed);
+    fill_pattern_(blocks, sizeof(blocks), seed + 3000);
+    AES128_ECB_expand_key(raw_key, tiny_round_keys);
+    for (size_t j = 0; j < sizeof(blocks); j += BLOCK_SIZE) {
+      AES128_ECB_encrypt(blocks + j, raw_key, expected + j);
+    }
+
+    crypto_x86_aes128_expand_key(raw_key, round_keys);
+    TEST_EXPECT(memcmp(round_keys, tiny_round_keys, sizeof(round_keys)) == 0);
+    crypto_x86_aes128_encrypt(round_keys, blocks, out);
+    TEST_EXPECT(memcmp(out, expected, BLOCK_SIZE) == 0);
+    size_t num_blocks = 1 + seed % 9;
+    memcpy(out, blocks, sizeof(out));
+    crypto_x86_aes128_encrypt_blocks(round_keys, out, out, num_blocks);
+    TEST_EXPECT(memcmp(out, expected, num_blocks * BLOCK_SIZE) == 0);
+    TEST_EXPECT(memcmp(out + num_blocks * BLOCK_SIZE,
+                       blocks + num_blocks * BLOCK_SIZE,
+                       sizeof(out) - num_blocks * BLOCK_SIZE) == 0);
+  }
+}
+#endif
+
+/**
+ * EAX over a shared key schedule gives the first two vectors of the EAX paper
+ * (Bellare, Rogaway and Wagner), and opens what it seals.
+ */
+static void test_eax_known_answers_() {
+  static const struct {
+    uint8_t key[BLOCK_SIZE];
+    uint8_t nonce[BLOCK_SIZE];
+    uint8_t header[8];
+    uint8_t message[2];
+    size_t message_length;
+    uint8_t ciphertext[2 + BLOCK_SIZE];
+  } kVectors[] = {
+      {{0x23, 0x39, 0x52, 0xde, 0xe4, 0xd5, 0xed, 0x5f, 0x9b, 0x9c, 0x6d,
+        0x6f, 0xf8, 0x0f, 0xf4, 0x78},
+       {0x62, 0xec, 0x67, 0xf9, 0xc3, 0xa4, 0xa4, 0x07, 0xfc, 0xb2, 0xa8,
+        0xc4, 0x90, 0x31, 0xa8, 0xb3},
+       {0x6b, 0xfb, 0x91, 0x4f, 0xd0, 0x7e, 0xae, 0x6b},
+       {},
+       0,
+       {0xe0, 0x37, 0x83, 0x0e, 0x83, 0x89, 0xf2, 0x7b, 0x02, 0x5a, 0x2d,
+        0x65, 0x27, 0xe7, 0x9d, 0x01}},
+      {{0x91, 0x94, 0x5d, 0x3f, 0x4d, 0xcb, 0xee, 0x0b, 0xf4, 0x5e, 0xf5,
+        0x22, 0x55, 0xf0, 0x95, 0xa4},
+       {0xbe, 0xca, 0xf0, 0x43, 0xb0, 0xa2, 0x3d, 0x84, 0x31, 0x94, 0xba,
+        0x97, 0x2c, 0x66, 0xde, 0xbd},
+       {0xfa, 0x3b, 0xfd, 0x48, 0x06, 0xeb, 0x53, 0xfa},
+       {0xf7, 0xfb},
+       2,
+       {0x19, 0xdd, 0x5c, 0x4c, 0x93, 0x31, 0x04, 0x9d, 0x0b, 0xda, 0xb0,
+        0x27, 0x74, 0x08, 0xf6, 0x79, 0x67, 0xe5}},
+  };
+
+  for (size_t i = 0; i < sizeof(kVectors) / sizeof(kVectors[0]); i++) {
+    size_t sealed_length = kVectors[i].message_length + BLOCK_SIZE;
+    UwpCryptoAes128Key key;
+    TEST_EXPECT(uwp_crypto_aes128_key_init(&key, kVectors[i].key));
+    uint8_t data[sizeof(kVectors[i].ciphertext)];
+    UwBuffer buffer;
+    uw_buffer_init(&buffer, data, sizeof(data));
+    TEST_EXPECT(uw_buffer_append(&buffer, kVectors[i].message,
+                                 kVectors[i].message_length));
+    TEST_EXPECT(uw_eax_encrypt_(&key, BLOCK_SIZE, kVectors[i].nonce,
+                                BLOCK_SIZE, kVectors[i].header,
+                                sizeof(kVectors[i].header), &buffer, &buffer));
+    TEST_EXPECT(uw_buffer_get_length(&buffer) == sealed_length);
+    TEST_EXPECT(memcmp(data, kVectors[i].ciphertext, sealed_length) == 0);
+
+    TEST_EXPECT(uw_eax_decrypt_(&key, BLOCK_SIZE, kVectors[i].nonce,
+                                BLOCK_SIZE, kVectors[i].header,
+                                sizeof(kVectors[i].header), &buffer, &buffer));
+    TEST_EXPECT(uw_buffer_get_length(&buffer) == kVectors[i].message_length);
+    TEST_EXPECT(memcmp(data, kVectors[i].message,
+                       kVectors[i].message_length) == 0);
+  }
+}
+
+#define STRESS_THREADS 8
+#define STRESS_ROUNDS 200
+#define STRESS_MESSAGE_SIZE 100
+#define STRESS_SEALED_SIZE (STRESS_MESSAGE_SIZE + BLOCK_SIZE)
+
+typedef struct {
+  uint32_t seed;
+  // The message sealed by each round, worked out before the threads start.
+  uint8_t expected[STRESS_ROUNDS][STRESS_SEALED_SIZE];
+  uint8_t expected_block[STRESS_ROUNDS][BLOCK_SIZE];
+  int mismatches;
+} StressThread_;
+
+/** Seals and opens round's message for a thread, and encrypts one block. */
+static bool run_stress_round_(uint32_t seed,
+                              uint32_t round,
+                              uint8_t sealed[STRESS_SEALED_SIZE],
+                              uint8_t block[BLOCK_SIZE]) {
+  uint8_t raw_key[BLOCK_SIZE];
+  uint8_t nonce[BLOCK_SIZE];
+  uint8_t message[STRESS_MESSAGE_SIZE];
+  fill_pattern_(raw_key, sizeof(raw_key), seed);
+  fill_pattern_(nonce, sizeof(nonce), seed + round);
+  fill_pattern_(message, sizeof(message), seed * STRESS_ROUNDS + round);
+
+  UwpCryptoAes128Key key;
+  UwBuffer buffer;
+  uw_buffer_init(&buffer, sealed, STRESS_SEALED_SIZE);
+  if (!uwp_crypto_aes128_key_init(&key, raw_key) ||
+      !uw_buffer_append(&buffer, message, sizeof(message)) ||
+      !uw_eax_encrypt_(&key, BLOCK_SIZE, nonce, sizeof(nonce), NULL, 0,
+                       &buffer, &buffer)) {
+    return false;
+  }
+
+  uint8_t opened_data[STRESS_SEALED_SIZE];
+  UwBuffer opened;
+  uw_buffer_init(&opened, opened_data, sizeof(opened_data));
+  if (!uw_buffer_append(&opened, sealed, STRESS_SEALED_SIZE) ||
+      !uw_eax_decrypt_(&key, BLOCK_SIZE, nonce, sizeof(nonce), NULL, 0,
+                       &opened, &opened) ||
+      memcmp(opened_data, message, sizeof(message)) != 0) {
+    return false;
+  }
+
+  // The one-shot tiny-aes call, whose shared state this used to clobber.
+  AES128_ECB_encrypt(message, raw_key, block);
+  return true;
+}
+
+static void* stress_thread_(void* arg) {
+  StressThread_* thread = arg;
+  for (int pass = 0; pass < 4; pass++) {
+    for (uint32_t round = 0; round < STRESS_ROUNDS; round++) {
+      uint8_t sealed[STRESS_SEALED_SIZE];
+      uint8_t block[BLOCK_SIZE];
+      if (!run_stress_round_(thread->seed, round, sealed, block) ||
+          memcmp(sealed, thread->expected[round], sizeof(sealed)) != 0 ||
+          memcmp(block, thread->expected_block[round], sizeof(block)) != 0) {
+        thread->mismatches++;
+      }
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Threads that each seal, open and encrypt under their own keys at the same
+ * time get exactly the results of running alone.
+ */
+static void test_concurrent_eax_matches_serial_() {
+  static StressThread_ threads[STRESS_THREADS];
+  for (uint32_t i = 0; i < STRESS_THREADS; i++) {
+    threads[i] = (StressThread_){.seed = 7919 * (i + 1)};
+    for (uint32_t round = 0; round < STRESS_ROUNDS; round++) {
+      TEST_EXPECT(run_stress_round_(threads[i].seed, round,
+                                    threads[i].expected[round],
+                                    threads[i].expected_block[round]));
+    }
+  }
+
+  pthread_t ids[STRESS_THREADS];
+  for (size_t i = 0; i < STRESS_THREADS; i++) {
+    TEST_EXPECT(pthread_create(&ids[i], NULL, stress_thread_, &threads[i]) ==
+                0);
+  }
+  for (size_t i = 0; i < STRESS_THREADS; i++) {
+    TEST_EXPECT(pthread_join(ids[i], NULL) == 0);
+    TEST_EXPECT(threads[i].mismatches == 0);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  uwp_crypto_init();
+  TEST_RUN(test_fips197_known_answers_);
+  TEST_RUN(test_schedule_matches_per_block_expansion_);
+  TEST_RUN(test_ttable_matches_tiny_aes_);
+#if UW_CRYPTO_X86_ACCEL
+  TEST_RUN(test_aesni_matches_tiny_aes_);
+#endif
+  TEST_RUN(test_eax_known_answers_);
+  TEST_RUN(test_concurrent_eax_matches_serial_);
+  return TEST_EXIT_STATUS();
+}
@@ -0,0 +1,297 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Tests that the batched HMAC and macaroon functions agree with their one at a
+ * time counterparts, through the provider's SHA-256 lanes with every x86
+ * backend the CPU has and through the serial fallback for other providers.
+ */
+
+#include <string.h>
+
+#include "devices/host/provider/crypto_x86.h"
+#include "devices/host/test/crypto_hmac_serial.h"
+#include "devices/host/test/test.h"
+#include "src/crypto_hmac.h"
+#include "src/macaroon.h"
+#include "src/macaroon_caveat.h"
+#include "src/macaroon_context.h"
+
+// More than one pass of the batch functions, with a partial last pass.
+#define NUM_JOBS 19
+#define MAX_MESSAGES 3
+#define MAX_MESSAGE_LEN 200
+#define MAX_CAVEATS 5
+#define CAVEAT_BUFFER_SIZE 32
+#define CURRENT_TIME 1000
+
+typedef bool (*HmacBatch_)(const UwCryptoHmacJob jobs[], size_t num_jobs);
+typedef bool (*HmacKeyInitBatch_)(UwCryptoHmacKey hmac_keys[],
+                                  const uint8_t* const keys[],
+                                  size_t key_len,
+                                  size_t num_keys);
+
+/** Fills data with a repeatable pattern that differs with seed. */
+static void fill_pattern_(uint8_t* data, size_t length, uint32_t seed) {
+  uint32_t x = seed * 2654435761u + 1;
+  for (size_t i = 0; i < length; i++) {
+    x = x * 1664525u + 1013904223u;
+    data[i] = (uint8_t)(x >> 24);
+  }
+}
+
+/**
+ * Jobs with keys of 1 to 100 bytes, zero to MAX_MESSAGES messages of up to
+ * MAX_MESSAGE_LEN bytes (some empty) and every truncation length.
+ */
+typedef struct {
+  UwCryptoHmacKey keys[NUM_JOBS];
+  uint8_t data[NUM_JOBS][MAX_MESSAGES][MAX_MESSAGE_LEN];
+  UwCryptoHmacMsg messages[NUM_JOBS][MAX_MESSAGES];
+  uint8_t digests[NUM_JOBS][UWP_CRYPTO_SHA256_DIGEST_LEN];
+  UwCryptoHmacJob jobs[NUM_JOBS];
+} HmacJobs_;
+
+static bool init_hmac_jobs_(HmacJobs_* hmac_jobs) {
+  memset(hmac_jobs, 0, sizeof(*hmac_jobs));
+  for (size_t i = 0; i < NUM_JOBS; i++) {
+    uint8_t key[100];
+    size_t key_len = 1 + (i * 37) % sizeof(key);
+    fill_pattern_(key, key_len, i);
+    if (!uw_crypto_hmac_key_init_(&hmac_jobs->keys[i], key, key_len)) {
+      return false;
+    }
+
+    size_t num_messages = i % (MAX_MESSAGES + 1);
+    for (size_t m = 0; m < num_messages; m++) {
+      size_t length = (i * 53 + m * 71) % MAX_MESSAGE_LEN;
+      fill_pattern_(hmac_jobs->data[i][m], length, 100 * i + m);
+      hmac_jobs->messages[i][m] =
+          (UwCryptoHmacMsg){.bytes = hmac_jobs->data[i][m],
+                            .num_bytes = length};
+    }
+    hmac_jobs->jobs[i] = (UwCryptoHmacJob){
+        .key = &hmac_jobs->keys[i],
+        .messages = hmac_jobs->messages[i],
+        .num_messages = num_messages,
+        .truncated_digest = hmac_jobs->digests[i],
+        .truncated_digest_len = 1 + i % UWP_CRYPTO_SHA256_DIGEST_LEN};
+  }
+  return true;
+}
+
+static void check_hmac_batch_(HmacBatch_ batch) {
+  static HmacJobs_ hmac_jobs;
+  TEST_EXPECT(init_hmac_jobs_(&hmac_jobs));
+
+  // Every count, so that each pass size and partial pass is covered.
+  for (size_t num_jobs = 0; num_jobs <= NUM_JOBS; num_jobs++) {
+    memset(hmac_jobs.digests, 0, sizeof(hmac_jobs.digests));
+    TEST_EXPECT(batch(hmac_jobs.jobs, num_jobs));
+    for (size_t i = 0; i < num_jobs; i++) {
+      const UwCryptoHmacJob* job = &hmac_jobs.jobs[i];
+      uint8_t expected[UWP_CRYPTO_SHA256_DIGEST_LEN] = {0};
+      TEST_EXPECT(uw_crypto_hmac_with_key_(job->key, job->messages,
+                                           job->num_messages, expected,
+                                           job->truncated_digest_len));
+      TEST_EXPECT(memcmp(hmac_jobs.digests[i], expected, sizeof(expected)) ==
+                  0);
+    }
+  }
+
+  // One invalid job fails the whole batch before any digest is written.
+  memset(hmac_jobs.digests, 0, sizeof(hmac_jobs.digests));
+  hmac_jobs.jobs[NUM_JOBS - 1].truncated_digest_len =
+      UWP_CRYPTO_SHA256_DIGEST_LEN + 1;
+  TEST_EXPECT(!batch(hmac_jobs.jobs, NUM_JOBS));
+  static const uint8_t kZeros[UWP_CRYPTO_SHA256_DIGEST_LEN] = {0};
+  for (size_t i = 0; i < NUM_JOBS; i++) {
+    TEST_EXPECT(memcmp(hmac_jobs.digests[i], kZeros, sizeof(kZeros)) == 0);
+  }
+}
+
+static void check_hmac_key_init_batch_(HmacKeyInitBatch_ key_init_batch) {
+  static const size_t kKeyLengths[] = {1, UW_MACAROON_MAC_LEN,
+                                       UWP_CRYPTO_SHA256_BLOCK_SIZE};
+  static const uint8_t kMessage[] = "message";
+  const UwCryptoHmacMsg message = {.bytes = kMessage,
+                                   .num_bytes = sizeof(kMessage)};
+
+  for (size_t k = 0; k < sizeof(kKeyLengths) / sizeof(kKeyLengths[0]); k++) {
+    uint8_t keys[NUM_JOBS][UWP_CRYPTO_SHA256_BLOCK_SIZE];
+    const uint8_t* key_ptrs[NUM_JOBS];
+    for (size_t i = 0; i < NUM_JOBS; i++) {
+      fill_pattern_(keys[i], kKeyLengths[k], 1000 * k + i);
+      key_ptrs[i] = keys[i];
+    }
+
+    UwCryptoHmacKey hmac_keys[NUM_JOBS];
+    TEST_EXPECT(key_init_batch(hmac_keys, key_ptrs, kKeyLengths[k], NUM_JOBS));
+    for (size_t i = 0; i < NUM_JOBS; i++) {
+      uint8_t digest[UWP_CRYPTO_SHA256_DIGEST_LEN];
+      uint8_t expected[UWP_CRYPTO_SHA256_DIGEST_LEN];
+      TEST_EXPECT(uw_crypto_hmac_with_key_(&hmac_keys[i], &message, 1, digest,
+                                           sizeof(digest)));
+      TEST_EXPECT(uw_crypto_hmac_(keys[i], kKeyLengths[k], &message, 1,
+                                  expected, sizeof(expected)));
+      TEST_EXPECT(memcmp(digest, expected, sizeof(expected)) == 0);
+    }
+  }
+}
+
+static void test_hmac_batch_matches_scalar_() {
+  check_hmac_batch_(uw_crypto_hmac_batch_with_key_);
+  check_hmac_key_init_batch_(uw_crypto_hmac_key_init_batch_);
+}
+
+static void test_serial_hmac_batch_matches_scalar_() {
+  check_hmac_batch_(crypto_hmac_serial_batch_with_key);
+  check_hmac_key_init_batch_(crypto_hmac_serial_key_init_batch);
+}
+
+/**
+ * Macaroons of one to MAX_CAVEATS caveats.  Some have a forged tag, one is
+ * checked against the wrong key and one has expired, so that each way of
+ * failing shows up between valid lanes.
+ */
+typedef struct {
+  UwCryptoHmacKey root_key;
+  UwCryptoHmacKey wrong_key;
+  uint8_t caveat_buffers[NUM_JOBS][MAX_CAVEATS][CAVEAT_BUFFER_SIZE];
+  UwMacaroonCaveat caveats[NUM_JOBS][MAX_CAVEATS];
+  const UwMacaroonCaveat* caveat_ptrs[NUM_JOBS][MAX_CAVEATS];
+  UwMacaroon macaroons[NUM_JOBS];
+  UwMacaroonValidationResult results[NUM_JOBS];
+  UwMacaroonValidationJob jobs[NUM_JOBS];
+} MacaroonJobs_;
+
+static bool add_caveat_(MacaroonJobs_* macaroon_jobs,
+                        size_t i,
+                        size_t c,
+                        bool expired) {
+  uint8_t* buffer = macaroon_jobs->caveat_buffers[i][c];
+  UwMacaroonCaveat* caveat = &macaroon_jobs->caveats[i][c];
+  macaroon_jobs->caveat_ptrs[i][c] = caveat;
+  if (c == 0) {
+    static const UwMacaroonCaveatScopeType kScopes[] = {
+        kUwMacaroonCaveatScopeTypeOwner, kUwMacaroonCaveatScopeTypeManager,
+        kUwMacaroonCaveatScopeTypeUser, kUwMacaroonCaveatScopeTypeViewer};
+    return uw_macaroon_caveat_create_scope_(
+        kScopes[i % (sizeof(kScopes) / sizeof(kScopes[0]))], buffer,
+        CAVEAT_BUFFER_SIZE, caveat);
+  }
+  if (c == 1) {
+    uint32_t expiration = expired ? CURRENT_TIME - 1 : CURRENT_TIME + 100 * i;
+    return uw_macaroon_caveat_create_expiration_absolute_(
+        expiration, buffer, CAVEAT_BUFFER_SIZE, caveat);
+  }
+  uint8_t nonce[8];
+  fill_pattern_(nonce, sizeof(nonce), 10 * i + c);
+  return uw_macaroon_caveat_create_nonce_(nonce, sizeof(nonce), buffer,
+                                          CAVEAT_BUFFER_SIZE, caveat);
+}
+
+static bool init_macaroon_jobs_(MacaroonJobs_* macaroon_jobs,
+                                const UwMacaroonContext* context) {
+  static const uint8_t kRootKey[] = "root key";
+  static const uint8_t kWrongKey[] = "wrong key";
+  memset(macaroon_jobs, 0, sizeof(*macaroon_jobs));
+  if (!uw_crypto_hmac_key_init_(&macaroon_jobs->root_key, kRootKey,
+                                sizeof(kRootKey)) ||
+      !uw_crypto_hmac_key_init_(&macaroon_jobs->wrong_key, kWrongKey,
+                                sizeof(kWrongKey))) {
+    return false;
+  }
+
+  for (size_t i = 0; i < NUM_JOBS; i++) {
+    size_t num_caveats = 1 + (i * 3) % MAX_CAVEATS;
+    for (size_t c = 0; c < num_caveats; c++) {
+      if (!add_caveat_(macaroon_jobs, i, c, i == 11)) {
+        return false;
+      }
+    }
+    UwMacaroon* macaroon = &macaroon_jobs->macaroons[i];
+    if (!uw_macaroon_create_from_hmac_key_(
+            macaroon, &macaroon_jobs->root_key, context,
+            macaroon_jobs->caveat_ptrs[i], num_caveats)) {
+      return false;
+    }
+    if (i % 4 == 1) {
+      macaroon->mac_tag[i % UW_MACAROON_MAC_LEN] ^= 0x01;
+    }
+
+    macaroon_jobs->jobs[i] = (UwMacaroonValidationJob){
+        .macaroon = macaroon,
+        .root_key =
+            (i == 6) ? &macaroon_jobs->wrong_key : &macaroon_jobs->root_key,
+        .context = context,
+        .result = &macaroon_jobs->results[i]};
+  }
+  return true;
+}
+
+static void test_macaroon_batch_matches_scalar_() {
+  UwMacaroonContext context;
+  TEST_EXPECT(uw_macaroon_context_create_with_timestamp_(CURRENT_TIME,
+                                                         &context));
+  static MacaroonJobs_ macaroon_jobs;
+  bool initialized = init_macaroon_jobs_(&macaroon_jobs, &context);
+  TEST_EXPECT(initialized);
+  if (!initialized) {
+    return;
+  }
+
+  size_t num_valid = 0;
+  uw_macaroon_validate_batch_(macaroon_jobs.jobs, NUM_JOBS);
+  for (size_t i = 0; i < NUM_JOBS; i++) {
+    const UwMacaroonValidationJob* job = &macaroon_jobs.jobs[i];
+    UwMacaroonValidationResult expected;
+    bool is_valid = uw_macaroon_validate_with_hmac_key_(
+        job->macaroon, job->root_key, job->context, &expected);
+    TEST_EXPECT(job->is_valid == is_valid);
+    TEST_EXPECT(job->result->granted_scope == expected.granted_scope);
+    TEST_EXPECT(job->result->expiration_time == expected.expiration_time);
+    if (is_valid) {
+      num_valid++;
+    }
+  }
+  // Both outcomes are represented.
+  TEST_EXPECT(num_valid > 0 && num_valid < NUM_JOBS);
+  TEST_EXPECT(!macaroon_jobs.jobs[1].is_valid);
+  TEST_EXPECT(!macaroon_jobs.jobs[6].is_valid);
+  TEST_EXPECT(!macaroon_jobs.jobs[11].is_valid);
+  TEST_EXPECT(macaroon_jobs.jobs[NUM_JOBS - 1].is_valid);
+}
+
+static void run_tests_() {
+  TEST_RUN(test_hmac_batch_matches_scalar_);
+  TEST_RUN(test_serial_hmac_batch_matches_scalar_);
+  TEST_RUN(test_macaroon_batch_matches_scalar_);
+}
+
+int main() {
+  if (!uwp_crypto_init()) {
+    return 1;
+  }
+  run_tests_();
+
+#if UW_CRYPTO_X86_ACCEL
+  // Without the SHA extensions the lanes go through the AVX2 kernel, and
+  // without both through the portable compression function.
+  if (crypto_x86_has_shani() && crypto_x86_has_avx2()) {
+    fprintf(stderr, "Without SHA-NI:\n");
+    crypto_x86_disable_features(CRYPTO_X86_FEATURE_SHANI);
+    run_tests_();
+  }
+  if (crypto_x86_has_shani() || crypto_x86_has_avx2()) {
+    fprintf(stderr, "Without SHA-NI or AVX2:\n");
+    crypto_x86_disable_features(CRYPTO_X86_FEATURE_SHANI |
+                                CRYPTO_X86_FEATURE_AVX2);
+    run_tests_();
+  }
+  crypto_x86_disable_features(0);
+#endif
+
+  return TEST_EXIT_STATUS();
+}
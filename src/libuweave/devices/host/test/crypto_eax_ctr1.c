@@ -0,0 +1,16 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/test/crypto_eax_ctr1.h"
+
+// Renames the public functions so that they link next to the library's.
+#undef UW_CRYPTO_CTR_BATCH_BLOCKS
+#define UW_CRYPTO_CTR_BATCH_BLOCKS 1
+#define uw_eax_encrypt_ crypto_eax_ctr1_encrypt
+#define uw_eax_decrypt_ crypto_eax_ctr1_decrypt
+#define uw_eax_prefix_init_ crypto_eax_ctr1_prefix_init
+#define uw_eax_encrypt_with_prefix_ crypto_eax_ctr1_encrypt_with_prefix
+#define uw_eax_decrypt_with_prefix_ crypto_eax_ctr1_decrypt_with_prefix
+
+#include "src/crypto_eax.c"
@@ -0,0 +1,36 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_TEST_CRYPTO_EAX_CTR1_H_
+#define LIBUWEAVE_DEVICES_HOST_TEST_CRYPTO_EAX_CTR1_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/crypto_eax.h"
+
+/**
+ * The EAX functions of src/crypto_eax.c built with UW_CRYPTO_CTR_BATCH_BLOCKS
+ * 1, so that each counter block is encrypted by its own provider call.
+ */
+bool crypto_eax_ctr1_encrypt(const UwpCryptoAes128Key* key,
+                             size_t tag_length,
+                             const uint8_t* nonce,
+                             size_t nonce_length,
+                             const uint8_t* ad,
+                             size_t ad_length,
+                             UwBuffer* input,
+                             UwBuffer* output);
+
+bool crypto_eax_ctr1_decrypt(const UwpCryptoAes128Key* key,
+                             size_t tag_length,
+                             const uint8_t* nonce,
+                             size_t nonce_length,
+                             const uint8_t* ad,
+                             size_t ad_length,
+                             UwBuffer* input,
+                             UwBuffer* output);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_TEST_CRYPTO_EAX_CTR1_H_
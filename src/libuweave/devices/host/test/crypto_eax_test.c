@@ -0,0 +1,217 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Tests the shortcuts of src/crypto_eax.c against the plain computation: the
+ * cached nonce prefix of the session messages, and the batching of CTR blocks
+ * (UW_CRYPTO_CTR_BATCH_BLOCKS).
+ */
+
+#include <string.h>
+
+#include "devices/host/test/crypto_eax_ctr1.h"
+#include "devices/host/test/test.h"
+#include "src/buffer.h"
+#include "src/crypto_eax.h"
+#include "uweave/config.h"
+#include "uweave/provider/crypto.h"
+
+#define BLOCK_SIZE UWP_CRYPTO_AES128_BLOCK_SIZE
+#define MAX_MESSAGE_SIZE 300
+#define MAX_NONCE_SIZE 40
+
+/** Prefix and suffix lengths of the session nonces, and block boundaries. */
+static const struct {
+  size_t prefix_length;
+  size_t suffix_length;
+} kNonceSplits[] = {
+    {16, 4}, {0, 4}, {12, 4}, {15, 1}, {16, 16}, {17, 3}, {32, 8},
+};
+
+/** Message counters in the last bytes of the suffix, as the sessions write. */
+static const uint32_t kCounters[] = {
+    0, 1, 0xff, 0x100, 0xffff, 0xffffff, 0x1000000, 0xffffffff,
+};
+
+/** Message lengths around one and several CTR batches, of 1 and 4 blocks. */
+static const size_t kLengths[] = {
+    0, 1, 15, 16, 17, 31, 48, 63, 64, 65, 80, 127, 128, 129, 200, 255, 300,
+};
+
+static void fill_pattern_(uint8_t* data, size_t length, uint32_t seed) {
+  uint32_t x = seed * 2654435761u + 1;
+  for (size_t i = 0; i < length; i++) {
+    x = x * 1664525u + 1013904223u;
+    data[i] = (uint8_t)(x >> 24);
+  }
+}
+
+/** Writes counter big-endian into the last bytes of the suffix. */
+static void put_counter_(uint8_t* suffix, size_t length, uint32_t counter) {
+  for (size_t i = 0; i < length && i < sizeof(counter); i++) {
+    suffix[length - 1 - i] = (uint8_t)(counter >> (8 * i));
+  }
+}
+
+/**
+ * Sealing with a cached nonce prefix gives what uw_eax_encrypt_ gives for the
+ * whole nonce, and each side opens what the other sealed, over nonce splits,
+ * message counters, associated data and message lengths.
+ */
+static void test_prefix_matches_plain_() {
+  uint8_t raw_key[BLOCK_SIZE];
+  fill_pattern_(raw_key, sizeof(raw_key), 1);
+  UwpCryptoAes128Key key;
+  TEST_EXPECT(uwp_crypto_aes128_key_init(&key, raw_key));
+
+  for (size_t s = 0; s < sizeof(kNonceSplits) / sizeof(kNonceSplits[0]);
+       s++) {
+    size_t prefix_length = kNonceSplits[s].prefix_length;
+    size_t suffix_length = kNonceSplits[s].suffix_length;
+    size_t nonce_length = prefix_length + suffix_length;
+    uint8_t nonce[MAX_NONCE_SIZE];
+    fill_pattern_(nonce, sizeof(nonce), 100 + s);
+    uint8_t ad[20];
+    size_t ad_length = s % 2 == 0 ? 0 : sizeof(ad);
+    fill_pattern_(ad, sizeof(ad), 200 + s);
+
+    UwEaxPrefixState prefix;
+    TEST_EXPECT(uw_eax_prefix_init_(&prefix, &key, nonce, prefix_length,
+                                    ad_length > 0 ? ad : NULL, ad_length));
+
+    for (size_t c = 0; c < sizeof(kCounters) / sizeof(kCounters[0]); c++) {
+      put_counter_(nonce + prefix_length, suffix_length, kCounters[c]);
+      for (size_t l = 0; l < sizeof(kLengths) / sizeof(kLengths[0]); l++) {
+        size_t length = kLengths[l];
+        size_t tag_length = l % 2 == 0 ? 12 : BLOCK_SIZE;
+        uint8_t message[MAX_MESSAGE_SIZE];
+        fill_pattern_(message, length, 1000 * s + 10 * c + l);
+
+        uint8_t plain_data[MAX_MESSAGE_SIZE + BLOCK_SIZE];
+        uint8_t prefix_data[MAX_MESSAGE_SIZE + BLOCK_SIZE];
+        UwBuffer plain, with_prefix;
+        uw_buffer_init(&plain, plain_data, sizeof(plain_data));
+        uw_buffer_init(&with_prefix, prefix_data, sizeof(prefix_data));
+        TEST_EXPECT(uw_buffer_append(&plain, message, length));
+        TEST_EXPECT(uw_buffer_append(&with_prefix, message, length));
+
+        TEST_EXPECT(uw_eax_encrypt_(&key, tag_length, nonce, nonce_length,
+                                    ad_length > 0 ? ad : NULL, ad_length,
+                                    &plain, &plain));
+        TEST_EXPECT(uw_eax_encrypt_with_prefix_(
+            &prefix, &key, tag_length, nonce + prefix_length, suffix_length,
+            &with_prefix, &with_prefix));
+        TEST_EXPECT(uw_buffer_get_length(&plain) == length + tag_length);
+        TEST_EXPECT(uw_buffer_get_length(&with_prefix) ==
+                    length + tag_length);
+        TEST_EXPECT(memcmp(plain_data, prefix_data, length + tag_length) == 0);
+
+        TEST_EXPECT(uw_eax_decrypt_with_prefix_(
+            &prefix, &key, tag_length, nonce + prefix_length, suffix_length,
+            &plain, &plain));
+        TEST_EXPECT(uw_eax_decrypt_(&key, tag_length, nonce, nonce_length,
+                                    ad_length > 0 ? ad : NULL, ad_length,
+                                    &with_prefix, &with_prefix));
+        TEST_EXPECT(uw_buffer_get_length(&plain) == length);
+        TEST_EXPECT(memcmp(plain_data, message, length) == 0);
+        TEST_EXPECT(memcmp(prefix_data, message, length) == 0);
+      }
+    }
+  }
+}
+
+/**
+ * A message sealed under one counter does not open under the next, nor with
+ * a flipped bit, through the cached prefix.
+ */
+static void test_prefix_rejects_wrong_counter_() {
+  uint8_t raw_key[BLOCK_SIZE];
+  fill_pattern_(raw_key, sizeof(raw_key), 2);
+  UwpCryptoAes128Key key;
+  TEST_EXPECT(uwp_crypto_aes128_key_init(&key, raw_key));
+  uint8_t nonce[20];
+  fill_pattern_(nonce, sizeof(nonce), 3);
+  UwEaxPrefixState prefix;
+  TEST_EXPECT(uw_eax_prefix_init_(&prefix, &key, nonce, 16, NULL, 0));
+
+  uint8_t message[100];
+  fill_pattern_(message, sizeof(message), 4);
+  uint8_t sealed[sizeof(message) + 12];
+  uint8_t data[sizeof(sealed)];
+  UwBuffer buffer;
+  uw_buffer_init(&buffer, sealed, sizeof(sealed));
+  TEST_EXPECT(uw_buffer_append(&buffer, message, sizeof(message)));
+  put_counter_(nonce + 16, 4, 7);
+  TEST_EXPECT(uw_eax_encrypt_with_prefix_(&prefix, &key, 12, nonce + 16, 4,
+                                          &buffer, &buffer));
+
+  put_counter_(nonce + 16, 4, 8);
+  memcpy(data, sealed, sizeof(data));
+  uw_buffer_init(&buffer, data, sizeof(data));
+  uw_buffer_set_length_(&buffer, sizeof(data));
+  TEST_EXPECT(!uw_eax_decrypt_with_prefix_(&prefix, &key, 12, nonce + 16, 4,
+                                           &buffer, &buffer));
+
+  put_counter_(nonce + 16, 4, 7);
+  memcpy(data, sealed, sizeof(data));
+  data[50] ^= 0x01;
+  uw_buffer_init(&buffer, data, sizeof(data));
+  uw_buffer_set_length_(&buffer, sizeof(data));
+  TEST_EXPECT(!uw_eax_decrypt_with_prefix_(&prefix, &key, 12, nonce + 16, 4,
+                                           &buffer, &buffer));
+
+  data[50] ^= 0x01;
+  uw_buffer_init(&buffer, data, sizeof(data));
+  uw_buffer_set_length_(&buffer, sizeof(data));
+  TEST_EXPECT(uw_eax_decrypt_with_prefix_(&prefix, &key, 12, nonce + 16, 4,
+                                          &buffer, &buffer));
+  TEST_EXPECT(memcmp(data, message, sizeof(message)) == 0);
+}
+
+/**
+ * The library's CTR batches of UW_CRYPTO_CTR_BATCH_BLOCKS give the same
+ * ciphertext as one block per provider call, at every length up to several
+ * batches, and each build opens what the other sealed.
+ */
+static void test_ctr_batches_match_single_blocks_() {
+  uint8_t raw_key[BLOCK_SIZE];
+  uint8_t nonce[BLOCK_SIZE];
+  fill_pattern_(raw_key, sizeof(raw_key), 5);
+  UwpCryptoAes128Key key;
+  TEST_EXPECT(uwp_crypto_aes128_key_init(&key, raw_key));
+
+  for (size_t length = 0; length <= MAX_MESSAGE_SIZE; length++) {
+    fill_pattern_(nonce, sizeof(nonce), 6 + length);
+    uint8_t message[MAX_MESSAGE_SIZE];
+    fill_pattern_(message, length, 7 + length);
+
+    uint8_t batched_data[MAX_MESSAGE_SIZE + BLOCK_SIZE];
+    uint8_t single_data[MAX_MESSAGE_SIZE + BLOCK_SIZE];
+    UwBuffer batched, single;
+    uw_buffer_init(&batched, batched_data, sizeof(batched_data));
+    uw_buffer_init(&single, single_data, sizeof(single_data));
+    TEST_EXPECT(uw_buffer_append(&batched, message, length));
+    TEST_EXPECT(uw_buffer_append(&single, message, length));
+
+    TEST_EXPECT(uw_eax_encrypt_(&key, BLOCK_SIZE, nonce, sizeof(nonce), NULL,
+                                0, &batched, &batched));
+    TEST_EXPECT(crypto_eax_ctr1_encrypt(&key, BLOCK_SIZE, nonce, sizeof(nonce),
+                                        NULL, 0, &single, &single));
+    TEST_EXPECT(memcmp(batched_data, single_data, length + BLOCK_SIZE) == 0);
+
+    TEST_EXPECT(crypto_eax_ctr1_decrypt(&key, BLOCK_SIZE, nonce, sizeof(nonce),
+                                        NULL, 0, &batched, &batched));
+    TEST_EXPECT(uw_eax_decrypt_(&key, BLOCK_SIZE, nonce, sizeof(nonce), NULL,
+                                0, &single, &single));
+    TEST_EXPECT(memcmp(batched_data, message, length) == 0);
+    TEST_EXPECT(memcmp(single_data, message, length) == 0);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  TEST_RUN(test_prefix_matches_plain_);
+  TEST_RUN(test_prefix_rejects_wrong_counter_);
+  TEST_RUN(test_ctr_batches_match_single_blocks_);
+  return TEST_EXIT_STATUS();
+}
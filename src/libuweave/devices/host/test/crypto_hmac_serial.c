@@ -0,0 +1,16 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/test/crypto_hmac_serial.h"
+
+// Renames the public functions so that they link next to the library's.
+#undef UW_CRYPTO_PROVIDER_SHA256_LANES
+#define UW_CRYPTO_PROVIDER_SHA256_LANES 0
+#define uw_crypto_hmac_key_init_ crypto_hmac_serial_key_init
+#define uw_crypto_hmac_with_key_ crypto_hmac_serial_with_key
+#define uw_crypto_hmac_batch_with_key_ crypto_hmac_serial_batch_with_key
+#define uw_crypto_hmac_key_init_batch_ crypto_hmac_serial_key_init_batch
+#define uw_crypto_hmac_ crypto_hmac_serial
+
+#include "src/crypto_hmac.c"
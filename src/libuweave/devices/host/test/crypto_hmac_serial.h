@@ -0,0 +1,27 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_TEST_CRYPTO_HMAC_SERIAL_H_
+#define LIBUWEAVE_DEVICES_HOST_TEST_CRYPTO_HMAC_SERIAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/crypto_hmac.h"
+
+/**
+ * The batched HMAC functions of src/crypto_hmac.c built with
+ * UW_CRYPTO_PROVIDER_SHA256_LANES 0, so that their lanes are hashed one after
+ * another as on providers without the lanes API.
+ */
+bool crypto_hmac_serial_batch_with_key(const UwCryptoHmacJob jobs[],
+                                       size_t num_jobs);
+
+bool crypto_hmac_serial_key_init_batch(UwCryptoHmacKey hmac_keys[],
+                                       const uint8_t* const keys[],
+                                       size_t key_len,
+                                       size_t num_keys);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_TEST_CRYPTO_HMAC_SERIAL_H_
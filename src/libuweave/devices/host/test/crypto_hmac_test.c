@@ -0,0 +1,227 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Tests the HMAC-SHA256 of src/crypto_hmac.c, which starts each HMAC from the
+ * key's precomputed pad midstates, against RFC 4231 and the textbook
+ * construction over the provider's SHA-256.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "devices/host/test/test.h"
+#include "src/crypto_hmac.h"
+#include "uweave/provider/crypto.h"
+
+#define MAX_KEY_LEN 140
+#define MAX_DATA_LEN 160
+
+/**
+ * A test case of RFC 4231.  A NULL key or data stands for length bytes of the
+ * fill value, as the RFC writes them.
+ */
+typedef struct {
+  const char* key;
+  uint8_t key_fill;
+  size_t key_len;
+  const char* data;
+  uint8_t data_fill;
+  size_t data_len;
+  const char* mac_hex;
+} HmacVector_;
+
+/** RFC 4231 section 4, HMAC-SHA-256. */
+static const HmacVector_ kRfc4231Vectors[] = {
+    {NULL, 0x0b, 20, "Hi There", 0, 8,
+     "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+    // A key shorter than the digest.
+    {"Jefe", 0, 4, "what do ya want for nothing?", 0, 28,
+     "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+    {NULL, 0xaa, 20, NULL, 0xdd, 50,
+     "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe"},
+    {"\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+     "\x11\x12\x13\x14\x15\x16\x17\x18\x19",
+     0, 25, NULL, 0xcd, 50,
+     "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b"},
+    // Truncated to 128 bits.
+    {NULL, 0x0c, 20, "Test With Truncation", 0, 20,
+     "a3b6167473100ee06e0c796c2955552b"},
+    // Keys longer than the 64-byte block are hashed first.
+    {NULL, 0xaa, 131, "Test Using Larger Than Block-Size Key - Hash Key First",
+     0, 54, "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"},
+    {NULL, 0xaa, 131,
+     "This is a test using a larger than block-size key and a larger than "
+     "block-size data. The key needs to be hashed before being used by the "
+     "HMAC algorithm.",
+     0, 152,
+     "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2"},
+};
+
+/** Copies bytes, or length copies of fill if bytes is NULL. */
+static void expand_(uint8_t* out,
+                    const char* bytes,
+                    uint8_t fill,
+                    size_t length) {
+  if (bytes != NULL) {
+    memcpy(out, bytes, length);
+  } else {
+    memset(out, fill, length);
+  }
+}
+
+/** Decodes a hex string into out, returning the number of bytes. */
+static size_t from_hex_(const char* hex, uint8_t* out) {
+  size_t length = 0;
+  for (; hex[0] != '\0' && hex[1] != '\0'; hex += 2) {
+    unsigned int byte;
+    sscanf(hex, "%2x", &byte);
+    out[length++] = (uint8_t)byte;
+  }
+  return length;
+}
+
+static void fill_pattern_(uint8_t* data, size_t length, uint32_t seed) {
+  uint32_t x = seed * 2654435761u + 1;
+  for (size_t i = 0; i < length; i++) {
+    x = x * 1664525u + 1013904223u;
+    data[i] = (uint8_t)(x >> 24);
+  }
+}
+
+/**
+ * HMAC as RFC 2104 writes it, H((K ^ opad) || H((K ^ ipad) || data)), over
+ * the provider's SHA-256 and without midstates.
+ */
+static void reference_hmac_(const uint8_t* key,
+                            size_t key_len,
+                            const uint8_t* data,
+                            size_t data_len,
+                            uint8_t mac[UWP_CRYPTO_SHA256_DIGEST_LEN]) {
+  uint8_t block_key[UWP_CRYPTO_SHA256_BLOCK_SIZE] = {0};
+  UwpCryptoSha256State state;
+  if (key_len > sizeof(block_key)) {
+    uwp_crypto_sha256_init(&state);
+    uwp_crypto_sha256_update(&state, key, key_len);
+    uwp_crypto_sha256_final(&state, block_key);
+  } else {
+    memcpy(block_key, key, key_len);
+  }
+
+  uint8_t pad[UWP_CRYPTO_SHA256_BLOCK_SIZE];
+  uint8_t inner[UWP_CRYPTO_SHA256_DIGEST_LEN];
+  for (size_t i = 0; i < sizeof(pad); i++) {
+    pad[i] = block_key[i] ^ 0x36;
+  }
+  uwp_crypto_sha256_init(&state);
+  uwp_crypto_sha256_update(&state, pad, sizeof(pad));
+  uwp_crypto_sha256_update(&state, data, data_len);
+  uwp_crypto_sha256_final(&state, inner);
+
+  for (size_t i = 0; i < sizeof(pad); i++) {
+    pad[i] = block_key[i] ^ 0x5c;
+  }
+  uwp_crypto_sha256_init(&state);
+  uwp_crypto_sha256_update(&state, pad, sizeof(pad));
+  uwp_crypto_sha256_update(&state, inner, sizeof(inner));
+  uwp_crypto_sha256_final(&state, mac);
+}
+
+/**
+ * The one-shot call and a prepared key both give the RFC 4231 MACs, keys
+ * longer than the 64-byte block included, with the data whole or split.
+ */
+static void test_rfc4231_vectors_() {
+  for (size_t i = 0; i < sizeof(kRfc4231Vectors) / sizeof(kRfc4231Vectors[0]);
+       i++) {
+    const HmacVector_* vector = &kRfc4231Vectors[i];
+    uint8_t key[MAX_KEY_LEN];
+    uint8_t data[MAX_DATA_LEN];
+    uint8_t expected[UWP_CRYPTO_SHA256_DIGEST_LEN];
+    expand_(key, vector->key, vector->key_fill, vector->key_len);
+    expand_(data, vector->data, vector->data_fill, vector->data_len);
+    size_t mac_len = from_hex_(vector->mac_hex, expected);
+
+    uint8_t mac[UWP_CRYPTO_SHA256_DIGEST_LEN];
+    UwCryptoHmacMsg whole = {.bytes = data, .num_bytes = vector->data_len};
+    memset(mac, 0, sizeof(mac));
+    TEST_EXPECT(
+        uw_crypto_hmac_(key, vector->key_len, &whole, 1, mac, mac_len));
+    TEST_EXPECT(memcmp(mac, expected, mac_len) == 0);
+
+    UwCryptoHmacKey hmac_key;
+    TEST_EXPECT(uw_crypto_hmac_key_init_(&hmac_key, key, vector->key_len));
+    size_t half = vector->data_len / 2;
+    UwCryptoHmacMsg split[] = {
+        {.bytes = data, .num_bytes = half},
+        {.bytes = NULL, .num_bytes = 0},
+        {.bytes = data + half, .num_bytes = vector->data_len - half},
+    };
+    // Twice, since a prepared key is reused.
+    for (int pass = 0; pass < 2; pass++) {
+      memset(mac, 0, sizeof(mac));
+      TEST_EXPECT(uw_crypto_hmac_with_key_(&hmac_key, split,
+                                           sizeof(split) / sizeof(split[0]),
+                                           mac, mac_len));
+      TEST_EXPECT(memcmp(mac, expected, mac_len) == 0);
+    }
+  }
+}
+
+/**
+ * Prepared keys of every length up to past two blocks give the textbook HMAC
+ * and the same MAC as uw_crypto_hmac_, for data lengths around the block size
+ * and every truncation.
+ */
+static void test_prepared_key_matches_one_shot_() {
+  static const size_t kDataLengths[] = {0, 1, 55, 56, 63, 64, 65, 119, 120,
+                                        128, 150};
+  for (size_t key_len = 1; key_len <= MAX_KEY_LEN; key_len++) {
+    uint8_t key[MAX_KEY_LEN];
+    fill_pattern_(key, key_len, key_len);
+    UwCryptoHmacKey hmac_key;
+    TEST_EXPECT(uw_crypto_hmac_key_init_(&hmac_key, key, key_len));
+
+    for (size_t d = 0; d < sizeof(kDataLengths) / sizeof(kDataLengths[0]);
+         d++) {
+      size_t data_len = kDataLengths[d];
+      uint8_t data[MAX_DATA_LEN];
+      fill_pattern_(data, data_len, 1000 + 16 * key_len + d);
+      UwCryptoHmacMsg message = {.bytes = data, .num_bytes = data_len};
+
+      uint8_t expected[UWP_CRYPTO_SHA256_DIGEST_LEN];
+      uint8_t one_shot[UWP_CRYPTO_SHA256_DIGEST_LEN];
+      uint8_t prepared[UWP_CRYPTO_SHA256_DIGEST_LEN];
+      reference_hmac_(key, key_len, data, data_len, expected);
+      size_t mac_len = 1 + (key_len + d) % UWP_CRYPTO_SHA256_DIGEST_LEN;
+      TEST_EXPECT(
+          uw_crypto_hmac_(key, key_len, &message, 1, one_shot, mac_len));
+      TEST_EXPECT(uw_crypto_hmac_with_key_(&hmac_key, &message, 1, prepared,
+                                           mac_len));
+      TEST_EXPECT(memcmp(one_shot, expected, mac_len) == 0);
+      TEST_EXPECT(memcmp(prepared, expected, mac_len) == 0);
+    }
+  }
+}
+
+/** Empty keys and out-of-range truncations are refused. */
+static void test_invalid_arguments_() {
+  uint8_t key[16] = {1};
+  uint8_t mac[UWP_CRYPTO_SHA256_DIGEST_LEN];
+  UwCryptoHmacMsg message = {.bytes = key, .num_bytes = sizeof(key)};
+  UwCryptoHmacKey hmac_key;
+  TEST_EXPECT(!uw_crypto_hmac_key_init_(&hmac_key, key, 0));
+  TEST_EXPECT(!uw_crypto_hmac_(key, 0, &message, 1, mac, sizeof(mac)));
+  TEST_EXPECT(uw_crypto_hmac_key_init_(&hmac_key, key, sizeof(key)));
+  TEST_EXPECT(!uw_crypto_hmac_with_key_(&hmac_key, &message, 1, mac, 0));
+  TEST_EXPECT(!uw_crypto_hmac_with_key_(&hmac_key, &message, 1, mac,
+                                        sizeof(mac) + 1));
+}
+
+int main(int argc, char* argv[]) {
+  TEST_RUN(test_rfc4231_vectors_);
+  TEST_RUN(test_prepared_key_matches_one_shot_);
+  TEST_RUN(test_invalid_arguments_);
+  return TEST_EXIT_STATUS();
+}
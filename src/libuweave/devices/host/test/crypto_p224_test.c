@@ -0,0 +1,220 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/** Tests the P-224 point multiplications of third_party/omaha-crypto. */
+
+#include <string.h>
+
+#include "devices/host/test/p224_limb32.h"
+#include "devices/host/test/test.h"
+#include "omaha-crypto/p224.h"
+
+#define SCALAR_SIZE 28
+#define POINT_SIZE 56
+
+/** The P-224 generator from FIPS 186-4 D.1.2.2, as p224_point_to_bin writes. */
+static const uint8_t kGeneratorBin[POINT_SIZE] = {
+    0xb7, 0x0e, 0x0c, 0xbd, 0x6b, 0xb4, 0xbf, 0x7f, 0x32, 0x13, 0x90, 0xb9,
+    0x4a, 0x03, 0xc1, 0xd3, 0x56, 0xc2, 0x11, 0x22, 0x34, 0x32, 0x80, 0xd6,
+    0x11, 0x5c, 0x1d, 0x21, 0xbd, 0x37, 0x63, 0x88, 0xb5, 0xf7, 0x23, 0xfb,
+    0x4c, 0x22, 0xdf, 0xe6, 0xcd, 0x43, 0x75, 0xa0, 0x5a, 0x07, 0x47, 0x64,
+    0x44, 0xd5, 0x81, 0x99, 0x85, 0x00, 0x7e, 0x34};
+
+typedef struct {
+  uint8_t scalar[SCALAR_SIZE];
+  uint8_t point[POINT_SIZE];
+} P224Vector_;
+
+/**
+ * Multiples of the generator, worked out in affine coordinates from the
+ * FIPS 186-4 curve parameters independently of this code.
+ */
+static const P224Vector_ kVectors[] = {
+    // 2G
+    {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x02},
+     {0x70, 0x6a, 0x46, 0xdc, 0x76, 0xdc, 0xb7, 0x67, 0x98, 0xe6, 0x0e, 0x6d,
+      0x89, 0x47, 0x47, 0x88, 0xd1, 0x6d, 0xc1, 0x80, 0x32, 0xd2, 0x68, 0xfd,
+      0x1a, 0x70, 0x4f, 0xa6, 0x1c, 0x2b, 0x76, 0xa7, 0xbc, 0x25, 0xe7, 0x70,
+      0x2a, 0x70, 0x4f, 0xa9, 0x86, 0x89, 0x28, 0x49, 0xfc, 0xa6, 0x29, 0x48,
+      0x7a, 0xcf, 0x37, 0x09, 0xd2, 0xe4, 0xe8, 0xbb}},
+    // 3G
+    {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+      0x00, 0x00, 0x00, 0x03},
+     {0xdf, 0x1b, 0x1d, 0x66, 0xa5, 0x51, 0xd0, 0xd3, 0x1e, 0xff, 0x82, 0x25,
+      0x58, 0xb9, 0xd2, 0xcc, 0x75, 0xc2, 0x18, 0x02, 0x79, 0xfe, 0x0d, 0x08,
+      0xfd, 0x89, 0x6d, 0x04, 0xa3, 0xf7, 0xf0, 0x3c, 0xad, 0xd0, 0xbe, 0x44,
+      0x4c, 0x0a, 0xa5, 0x68, 0x30, 0x13, 0x0d, 0xdf, 0x77, 0xd3, 0x17, 0x34,
+      0x4e, 0x1a, 0xf3, 0x59, 0x19, 0x81, 0xa9, 0x25}},
+    // (n - 1)G, which is -G
+    {{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xff, 0x16, 0xa2, 0xe0, 0xb8, 0xf0, 0x3e, 0x13, 0xdd, 0x29, 0x45,
+      0x5c, 0x5c, 0x2a, 0x3c},
+     {0xb7, 0x0e, 0x0c, 0xbd, 0x6b, 0xb4, 0xbf, 0x7f, 0x32, 0x13, 0x90, 0xb9,
+      0x4a, 0x03, 0xc1, 0xd3, 0x56, 0xc2, 0x11, 0x22, 0x34, 0x32, 0x80, 0xd6,
+      0x11, 0x5c, 0x1d, 0x21, 0x42, 0xc8, 0x9c, 0x77, 0x4a, 0x08, 0xdc, 0x04,
+      0xb3, 0xdd, 0x20, 0x19, 0x32, 0xbc, 0x8a, 0x5e, 0xa5, 0xf8, 0xb8, 0x9b,
+      0xbb, 0x2a, 0x7e, 0x66, 0x7a, 0xff, 0x81, 0xcd}},
+    // (2^224 - 1)G, with every comb bit set
+    {{0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+      0xff, 0xff, 0xff, 0xff},
+     {0x1a, 0xed, 0x85, 0xad, 0x65, 0xdc, 0x68, 0xe4, 0x65, 0x01, 0xeb, 0xaa,
+      0xbd, 0x04, 0xd5, 0x16, 0x01, 0x0e, 0x7a, 0x38, 0x9b, 0xfa, 0xd5, 0xc1,
+      0xc1, 0x86, 0xc4, 0x9f, 0xd2, 0x69, 0x2f, 0x36, 0xd5, 0x9c, 0xc7, 0x91,
+      0xfa, 0xcb, 0xde, 0x8f, 0xbb, 0x59, 0xf7, 0x44, 0x33, 0x26, 0x2b, 0xff,
+      0x47, 0x90, 0x0b, 0xed, 0x9b, 0x30, 0x14, 0xf8}},
+};
+
+#define NUM_VECTORS (sizeof(kVectors) / sizeof(kVectors[0]))
+
+/** Fills data with a repeatable pattern that differs with seed. */
+static void fill_pattern_(uint8_t* data, size_t length, uint32_t seed) {
+  uint32_t x = seed * 2654435761u + 1;
+  for (size_t i = 0; i < length; i++) {
+    x = x * 1664525u + 1013904223u;
+    data[i] = (uint8_t)(x >> 24);
+  }
+}
+
+/** The comb multiplication of the generator, stepped max_rows at a time. */
+static void comb_mul_(const uint8_t scalar[SCALAR_SIZE],
+                      int max_rows,
+                      uint8_t out[POINT_SIZE]) {
+  p224_scalar_mult_state state;
+  p224_point point;
+  p224_base_point_mult_begin(&state, scalar);
+  while (!p224_scalar_mult_step(&state, max_rows)) {
+  }
+  p224_scalar_mult_finish(&state, &point);
+  p224_point_to_bin(&point, out);
+}
+
+/** The generic windowed multiplication of the generator. */
+static void ladder_mul_(const uint8_t scalar[SCALAR_SIZE],
+                        uint8_t out[POINT_SIZE]) {
+  p224_point generator;
+  p224_point point;
+  TEST_EXPECT(p224_point_from_bin(kGeneratorBin, POINT_SIZE, &generator));
+  p224_point_mul(&generator, scalar, &point);
+  p224_point_to_bin(&point, out);
+}
+
+/**
+ * The comb gives the known multiples, at once or stepped over any number of
+ * passes, and so does the generic multiplication.
+ */
+static void test_comb_known_answers_() {
+  for (size_t i = 0; i < NUM_VECTORS; i++) {
+    uint8_t out[POINT_SIZE];
+    p224_point point;
+    p224_base_point_mul(kVectors[i].scalar, &point);
+    p224_point_to_bin(&point, out);
+    TEST_EXPECT(memcmp(out, kVectors[i].point, POINT_SIZE) == 0);
+    for (int max_rows = 1; max_rows <= SCALAR_SIZE; max_rows++) {
+      comb_mul_(kVectors[i].scalar, max_rows, out);
+      TEST_EXPECT(memcmp(out, kVectors[i].point, POINT_SIZE) == 0);
+    }
+    ladder_mul_(kVectors[i].scalar, out);
+    TEST_EXPECT(memcmp(out, kVectors[i].point, POINT_SIZE) == 0);
+  }
+}
+
+/**
+ * The comb and the generic multiplication agree on the zero scalar, which
+ * gives the point at infinity, on one, and on pseudo-random scalars.
+ */
+static void test_comb_matches_ladder_() {
+  uint8_t scalar[SCALAR_SIZE] = {};
+  uint8_t comb[POINT_SIZE];
+  uint8_t ladder[POINT_SIZE];
+  static const uint8_t kInfinity[POINT_SIZE] = {};
+  comb_mul_(scalar, SCALAR_SIZE, comb);
+  ladder_mul_(scalar, ladder);
+  TEST_EXPECT(memcmp(comb, kInfinity, POINT_SIZE) == 0);
+  TEST_EXPECT(memcmp(ladder, kInfinity, POINT_SIZE) == 0);
+
+  scalar[SCALAR_SIZE - 1] = 1;
+  comb_mul_(scalar, SCALAR_SIZE, comb);
+  TEST_EXPECT(memcmp(comb, kGeneratorBin, POINT_SIZE) == 0);
+
+  for (uint32_t seed = 0; seed < 200; seed++) {
+    fill_pattern_(scalar, sizeof(scalar), seed);
+    comb_mul_(scalar, 1 + seed % SCALAR_SIZE, comb);
+    ladder_mul_(scalar, ladder);
+    TEST_EXPECT(memcmp(comb, ladder, POINT_SIZE) == 0);
+  }
+}
+
+#if P224_LIMB64
+/** Checks one point operation of the 56-bit limbs against the 28-bit ones. */
+#define EXPECT_SAME_POINT_(limb64, limb32) \
+  TEST_EXPECT(memcmp((limb64), (limb32), POINT_SIZE) == 0)
+
+/**
+ * The 56-bit limbs, as built into the library, agree with the original 28-bit
+ * limbs on the known multiples, whose coordinates include -G's p - y, and on
+ * multiplications, additions and negations of pseudo-random points.  Both
+ * reject the same point off the curve.
+ */
+static void test_limb64_matches_limb32_() {
+  uint8_t limb64[POINT_SIZE];
+  uint8_t limb32[POINT_SIZE];
+  p224_point point;
+  for (size_t i = 0; i < NUM_VECTORS; i++) {
+    p224_limb32_base_point_mul_bin(kVectors[i].scalar, limb32);
+    EXPECT_SAME_POINT_(kVectors[i].point, limb32);
+    TEST_EXPECT(
+        p224_limb32_point_mul_bin(kGeneratorBin, kVectors[i].scalar, limb32));
+    EXPECT_SAME_POINT_(kVectors[i].point, limb32);
+  }
+
+  for (uint32_t seed = 0; seed < 100; seed++) {
+    uint8_t scalar[SCALAR_SIZE];
+    uint8_t a[POINT_SIZE];
+    uint8_t b[POINT_SIZE];
+    fill_pattern_(scalar, sizeof(scalar), seed);
+    p224_base_point_mul(scalar, &point);
+    p224_point_to_bin(&point, a);
+    p224_limb32_base_point_mul_bin(scalar, limb32);
+    EXPECT_SAME_POINT_(a, limb32);
+
+    // b = scalar' * a, through the windowed multiplication of each.
+    p224_point point_a, point_b, sum;
+    fill_pattern_(scalar, sizeof(scalar), seed + 500);
+    TEST_EXPECT(p224_point_from_bin(a, POINT_SIZE, &point_a));
+    p224_point_mul(&point_a, scalar, &point_b);
+    p224_point_to_bin(&point_b, b);
+    TEST_EXPECT(p224_limb32_point_mul_bin(a, scalar, limb32));
+    EXPECT_SAME_POINT_(b, limb32);
+
+    p224_point_add(&point_a, &point_b, &sum);
+    p224_point_to_bin(&sum, limb64);
+    TEST_EXPECT(p224_limb32_point_add_bin(a, b, limb32));
+    EXPECT_SAME_POINT_(limb64, limb32);
+
+    p224_point_negate(&point_a, &point);
+    p224_point_to_bin(&point, limb64);
+    TEST_EXPECT(p224_limb32_point_negate_bin(a, limb32));
+    EXPECT_SAME_POINT_(limb64, limb32);
+  }
+
+  uint8_t off_curve[POINT_SIZE];
+  memcpy(off_curve, kGeneratorBin, sizeof(off_curve));
+  off_curve[POINT_SIZE - 1] ^= 1;
+  TEST_EXPECT(!p224_point_from_bin(off_curve, POINT_SIZE, &point));
+  TEST_EXPECT(!p224_limb32_point_negate_bin(off_curve, limb32));
+}
+#endif
+
+int main(int argc, char* argv[]) {
+  TEST_RUN(test_comb_known_answers_);
+  TEST_RUN(test_comb_matches_ladder_);
+#if P224_LIMB64
+  TEST_RUN(test_limb64_matches_limb32_);
+#endif
+  return TEST_EXIT_STATUS();
+}
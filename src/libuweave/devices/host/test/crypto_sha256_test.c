@@ -0,0 +1,205 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Tests the SHA-256 of the host crypto provider and each of its compression
+ * functions against FIPS 180-4 and the original omaha code.
+ */
+
+#include <string.h>
+
+#include "devices/host/provider/crypto_x86.h"
+#include "devices/host/provider/sha256_portable.h"
+#include "devices/host/test/test.h"
+#include "omaha-crypto/sha256.h"
+#include "uweave/provider/crypto.h"
+
+#define SHA256_BLOCK_SIZE 64
+#define MILLION_A_LENGTH 1000000
+
+typedef void (*Sha256Blocks_)(uint32_t state[8],
+                              const uint8_t* data,
+                              size_t num_blocks);
+
+/** Fills data with a repeatable pattern that differs with seed. */
+static void fill_pattern_(uint8_t* data, size_t length, uint32_t seed) {
+  uint32_t x = seed * 2654435761u + 1;
+  for (size_t i = 0; i < length; i++) {
+    x = x * 1664525u + 1013904223u;
+    data[i] = (uint8_t)(x >> 24);
+  }
+}
+
+/**
+ * Hashes data with the compression function given, padding as FIPS 180-4
+ * section 5.1.1 does.  Full blocks go straight from data, several at a time.
+ */
+static void hash_with_(Sha256Blocks_ blocks,
+                       const uint8_t* data,
+                       size_t length,
+                       uint8_t digest[SHA256_DIGEST_SIZE]) {
+  uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  size_t full_blocks = length / SHA256_BLOCK_SIZE;
+  if (full_blocks > 0) {
+    blocks(state, data, full_blocks);
+  }
+
+  uint8_t tail[2 * SHA256_BLOCK_SIZE] = {};
+  size_t tail_length = length % SHA256_BLOCK_SIZE;
+  memcpy(tail, data + full_blocks * SHA256_BLOCK_SIZE, tail_length);
+  tail[tail_length] = 0x80;
+  size_t tail_blocks = tail_length + 9 > SHA256_BLOCK_SIZE ? 2 : 1;
+  uint64_t bit_length = (uint64_t)length * 8;
+  for (int i = 0; i < 8; i++) {
+    tail[tail_blocks * SHA256_BLOCK_SIZE - 1 - i] =
+        (uint8_t)(bit_length >> (8 * i));
+  }
+  blocks(state, tail, tail_blocks);
+
+  for (int i = 0; i < 8; i++) {
+    digest[4 * i] = (uint8_t)(state[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)state[i];
+  }
+}
+
+/** Hashes data through the provider, in pieces of at most chunk bytes. */
+static void hash_with_provider_(const uint8_t* data,
+                                size_t length,
+                                size_t chunk,
+                                uint8_t digest[SHA256_DIGEST_SIZE]) {
+  UwpCryptoSha256State state;
+  uwp_crypto_sha256_init(&state);
+  for (size_t offset = 0; offset < length; offset += chunk) {
+    size_t piece = length - offset < chunk ? length - offset : chunk;
+    uwp_crypto_sha256_update(&state, data + offset, piece);
+  }
+  uwp_crypto_sha256_final(&state, digest);
+}
+
+typedef struct {
+  const char* message;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+} Sha256Vector_;
+
+/**
+ * The one-, two- and multi-block examples of FIPS 180-4 (from the NIST
+ * examples document), and the empty message.
+ */
+static const Sha256Vector_ kFips180Vectors[] = {
+    {"",
+     {0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4,
+      0xc8, 0x99, 0x6f, 0xb9, 0x24, 0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b,
+      0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55}},
+    {"abc",
+     {0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40,
+      0xde, 0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17,
+      0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad}},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+     {0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26,
+      0x93, 0x0c, 0x3e, 0x60, 0x39, 0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff,
+      0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1}},
+    {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+     "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+     {0xcf, 0x5b, 0x16, 0xa7, 0x78, 0xaf, 0x83, 0x80, 0x03, 0x6c, 0xe5,
+      0x9e, 0x7b, 0x04, 0x92, 0x37, 0x0b, 0x24, 0x9b, 0x11, 0xe8, 0xf0,
+      0x7a, 0x51, 0xaf, 0xac, 0x45, 0x03, 0x7a, 0xfe, 0xe9, 0xd1}},
+};
+
+/** The digest of one million repetitions of 'a'. */
+static const uint8_t kMillionADigest[SHA256_DIGEST_SIZE] = {
+    0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7,
+    0xe2, 0x84, 0xd7, 0x3e, 0x67, 0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97,
+    0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0};
+
+/**
+ * Checks that each way of hashing data gives digest: the portable and, where
+ * the CPU has them, the SHA extension compression functions, and the provider
+ * fed whole or in pieces that straddle the block boundaries.
+ */
+static void check_digest_(const uint8_t* data,
+                          size_t length,
+                          const uint8_t digest[SHA256_DIGEST_SIZE]) {
+  static const size_t kChunks[] = {1, 3, 63, 64, 65, 1000};
+  uint8_t out[SHA256_DIGEST_SIZE];
+  hash_with_(sha256_portable_blocks, data, length, out);
+  TEST_EXPECT(memcmp(out, digest, sizeof(out)) == 0);
+#if UW_CRYPTO_X86_ACCEL
+  if (crypto_x86_has_shani()) {
+    hash_with_(crypto_x86_sha256_blocks, data, length, out);
+    TEST_EXPECT(memcmp(out, digest, sizeof(out)) == 0);
+  }
+#endif
+  hash_with_provider_(data, length, length > 0 ? length : 1, out);
+  TEST_EXPECT(memcmp(out, digest, sizeof(out)) == 0);
+  for (size_t i = 0; i < sizeof(kChunks) / sizeof(kChunks[0]); i++) {
+    hash_with_provider_(data, length, kChunks[i], out);
+    TEST_EXPECT(memcmp(out, digest, sizeof(out)) == 0);
+  }
+}
+
+/** Every path gives the FIPS 180-4 digests. */
+static void test_fips180_known_answers_() {
+  for (size_t i = 0; i < sizeof(kFips180Vectors) / sizeof(kFips180Vectors[0]);
+       i++) {
+    const char* message = kFips180Vectors[i].message;
+    check_digest_((const uint8_t*)message, strlen(message),
+                  kFips180Vectors[i].digest);
+  }
+
+  static uint8_t million_a[MILLION_A_LENGTH];
+  memset(million_a, 'a', sizeof(million_a));
+  check_digest_(million_a, sizeof(million_a), kMillionADigest);
+}
+
+/**
+ * The provider agrees with the omaha SHA-256 it replaced on messages of every
+ * length up to a few blocks.
+ */
+static void test_matches_omaha_sha256_() {
+  uint8_t data[5 * SHA256_BLOCK_SIZE];
+  for (size_t length = 0; length <= sizeof(data); length++) {
+    fill_pattern_(data, length, (uint32_t)length + 5000);
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    SHA256_hash(data, (unsigned int)length, expected);
+    check_digest_(data, length, expected);
+  }
+}
+
+#if UW_CRYPTO_X86_ACCEL
+/**
+ * The SHA extension path agrees with the portable code on messages of every
+ * length around the padding boundaries and over several blocks, and so does
+ * the provider, which picks it when the CPU has it.
+ */
+static void test_shani_matches_portable_() {
+  if (!crypto_x86_has_shani()) {
+    fprintf(stderr, "No SHA extensions on this CPU, skipped\n");
+    return;
+  }
+  uint8_t data[5 * SHA256_BLOCK_SIZE];
+  for (size_t length = 0; length <= sizeof(data); length++) {
+    fill_pattern_(data, length, (uint32_t)length);
+    uint8_t expected[SHA256_DIGEST_SIZE];
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    hash_with_(sha256_portable_blocks, data, length, expected);
+    hash_with_(crypto_x86_sha256_blocks, data, length, digest);
+    TEST_EXPECT(memcmp(digest, expected, sizeof(digest)) == 0);
+    hash_with_provider_(data, length, 1 + length % 70, digest);
+    TEST_EXPECT(memcmp(digest, expected, sizeof(digest)) == 0);
+  }
+}
+#endif
+
+int main(int argc, char* argv[]) {
+  uwp_crypto_init();
+  TEST_RUN(test_fips180_known_answers_);
+  TEST_RUN(test_matches_omaha_sha256_);
+#if UW_CRYPTO_X86_ACCEL
+  TEST_RUN(test_shani_matches_portable_);
+#endif
+  return TEST_EXIT_STATUS();
+}
@@ -0,0 +1,110 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/** Tests the resumable exchange of src/crypto_spake.c. */
+
+#include <string.h>
+
+#include "devices/host/test/test.h"
+#include "src/buffer.h"
+#include "src/crypto_spake.h"
+#include "uweave/config.h"
+
+static const uint8_t kCode[] = {'1', '2', '3', '4'};
+
+static int passes_(int windows) {
+  return (windows + UW_SPAKE_STEP_NIBBLES - 1) / UW_SPAKE_STEP_NIBBLES;
+}
+
+/** Steps the pending computation to the end, counting the busy passes. */
+static int step_to_done_(UwSpakeState* state) {
+  int passes = 1;
+  UwSpakeStepResult result;
+  while ((result = uw_spake_step_(state, UW_SPAKE_STEP_NIBBLES)) ==
+         kUwSpakeStepBusy) {
+    passes++;
+  }
+  TEST_EXPECT(result == kUwSpakeStepDone);
+  return passes;
+}
+
+/**
+ * Without a precomputed keypair or masks, the commitment takes the comb rows
+ * of the base-point multiplication and then the windows of the mask, a bounded
+ * number per pass, and matches the one computed at once.
+ */
+static void test_commitment_without_keypair_is_stepped_() {
+  UwSpakeState stepped;
+  TEST_EXPECT(uw_spake_init_(&stepped, true, kCode, sizeof(kCode)));
+  UwSpakeState at_once = stepped;
+  p224_scalar_mult_state mult;
+  uw_spake_use_mult_state_(&stepped, &mult);
+
+  TEST_EXPECT(uw_spake_commitment_begin_(&stepped));
+  TEST_EXPECT(stepped.pending == kUwSpakePendingCommitmentBase);
+  TEST_EXPECT(step_to_done_(&stepped) ==
+              passes_(UW_SPAKE_P224_SCALAR_SIZE) +
+                  passes_(UW_SPAKE_P224_POINT_SIZE));
+
+  uint8_t stepped_data[UW_SPAKE_P224_POINT_SIZE];
+  uint8_t at_once_data[UW_SPAKE_P224_POINT_SIZE];
+  UwBuffer stepped_commitment, at_once_commitment;
+  uw_buffer_init(&stepped_commitment, stepped_data, sizeof(stepped_data));
+  uw_buffer_init(&at_once_commitment, at_once_data, sizeof(at_once_data));
+  TEST_EXPECT(uw_spake_get_commitment_(&stepped, &stepped_commitment));
+  TEST_EXPECT(uw_spake_compute_commitment_(&at_once, &at_once_commitment));
+  TEST_EXPECT(memcmp(stepped_data, at_once_data, sizeof(stepped_data)) == 0);
+}
+
+/**
+ * Masks recorded by a stepped exchange are the ones uw_spake_compute_masks_
+ * returns, and serve a later exchange.
+ */
+static void test_recorded_masks_match_computed_() {
+  UwSpakeState server, client;
+  UwSpakeMasks recorded, computed;
+  memset(&recorded, 0, sizeof(recorded));
+  TEST_EXPECT(uw_spake_init_(&server, true, kCode, sizeof(kCode)));
+  TEST_EXPECT(uw_spake_init_(&client, false, kCode, sizeof(kCode)));
+  uw_spake_record_masks_(&server, &recorded);
+  p224_scalar_mult_state mult;
+  uw_spake_use_mult_state_(&server, &mult);
+
+  uint8_t server_data[UW_SPAKE_P224_POINT_SIZE];
+  uint8_t client_data[UW_SPAKE_P224_POINT_SIZE];
+  UwBuffer server_commitment, client_commitment;
+  uw_buffer_init(&server_commitment, server_data, sizeof(server_data));
+  uw_buffer_init(&client_commitment, client_data, sizeof(client_data));
+  TEST_EXPECT(uw_spake_commitment_begin_(&server));
+  step_to_done_(&server);
+  TEST_EXPECT(uw_spake_get_commitment_(&server, &server_commitment));
+  TEST_EXPECT(uw_spake_compute_commitment_(&client, &client_commitment));
+  TEST_EXPECT(uw_spake_finalize_begin_(&server, &client_commitment));
+  step_to_done_(&server);
+
+  TEST_EXPECT(uw_spake_compute_masks_(&server, &computed));
+  TEST_EXPECT(memcmp(&recorded, &computed, sizeof(recorded)) == 0);
+
+  // A second exchange with the recorded masks agrees with the client.
+  uint8_t server_key[UW_SPAKE_P224_POINT_SIZE];
+  uint8_t client_key[UW_SPAKE_P224_POINT_SIZE];
+  TEST_EXPECT(uw_spake_init_(&server, true, kCode, sizeof(kCode)));
+  TEST_EXPECT(uw_spake_init_(&client, false, kCode, sizeof(kCode)));
+  uw_spake_use_masks_(&server, &recorded);
+  uw_buffer_reset(&server_commitment);
+  uw_buffer_reset(&client_commitment);
+  TEST_EXPECT(uw_spake_compute_commitment_(&server, &server_commitment));
+  TEST_EXPECT(uw_spake_compute_commitment_(&client, &client_commitment));
+  TEST_EXPECT(uw_spake_finalize_(&server, &client_commitment, server_key,
+                                 sizeof(server_key)));
+  TEST_EXPECT(uw_spake_finalize_(&client, &server_commitment, client_key,
+                                 sizeof(client_key)));
+  TEST_EXPECT(memcmp(server_key, client_key, sizeof(server_key)) == 0);
+}
+
+int main(int argc, char* argv[]) {
+  TEST_RUN(test_commitment_without_keypair_is_stepped_);
+  TEST_RUN(test_recorded_masks_match_computed_);
+  return TEST_EXIT_STATUS();
+}
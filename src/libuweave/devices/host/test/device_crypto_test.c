@@ -0,0 +1,250 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/** Tests the persisted state of src/device_crypto.c on the host providers. */
+
+#include <string.h>
+
+#include "devices/host/test/test.h"
+#include "src/buffer.h"
+#include "src/device_crypto.h"
+#include "uweave/provider/storage.h"
+
+static const uint8_t kCode[] = {'1', '2', '3', '4', '5', '6'};
+
+/** The P-224 generator from FIPS 186-4 D.1.2.2, as p224_point_to_bin writes. */
+static const uint8_t kGeneratorBin[UW_SPAKE_P224_POINT_SIZE] = {
+    0xb7, 0x0e, 0x0c, 0xbd, 0x6b, 0xb4, 0xbf, 0x7f, 0x32, 0x13, 0x90, 0xb9,
+    0x4a, 0x03, 0xc1, 0xd3, 0x56, 0xc2, 0x11, 0x22, 0x34, 0x32, 0x80, 0xd6,
+    0x11, 0x5c, 0x1d, 0x21, 0xbd, 0x37, 0x63, 0x88, 0xb5, 0xf7, 0x23, 0xfb,
+    0x4c, 0x22, 0xdf, 0xe6, 0xcd, 0x43, 0x75, 0xa0, 0x5a, 0x07, 0x47, 0x64,
+    0x44, 0xd5, 0x81, 0x99, 0x85, 0x00, 0x7e, 0x34};
+
+/** Whether needle appears anywhere in the stored file. */
+static bool file_contains_(UwStorageFileName name,
+                           const uint8_t* needle,
+                           size_t needle_length) {
+  uint8_t data[UW_DEVICE_CRYPTO_SPAKE_MASKS_BUFFER_LEN];
+  size_t length = 0;
+  if (!uw_status_is_success(
+          uwp_storage_get(name, data, sizeof(data), &length))) {
+    return false;
+  }
+  for (size_t i = 0; i + needle_length <= length; i++) {
+    if (memcmp(data + i, needle, needle_length) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static size_t file_length_(UwStorageFileName name) {
+  uint8_t data[UW_DEVICE_CRYPTO_SPAKE_MASKS_BUFFER_LEN];
+  size_t length = 0;
+  if (!uw_status_is_success(
+          uwp_storage_get(name, data, sizeof(data), &length))) {
+    return 0;
+  }
+  return length;
+}
+
+/**
+ * Runs a whole exchange between server and client, both already initialized
+ * with kCode, and checks that they agree on the key.
+ */
+static void exchange_(UwSpakeState* server, UwSpakeState* client) {
+  uint8_t server_commitment_data[UW_SPAKE_P224_POINT_SIZE];
+  uint8_t client_commitment_data[UW_SPAKE_P224_POINT_SIZE];
+  UwBuffer server_commitment, client_commitment;
+  uw_buffer_init(&server_commitment, server_commitment_data,
+                 sizeof(server_commitment_data));
+  uw_buffer_init(&client_commitment, client_commitment_data,
+                 sizeof(client_commitment_data));
+  TEST_EXPECT(uw_spake_compute_commitment_(server, &server_commitment));
+  TEST_EXPECT(uw_spake_compute_commitment_(client, &client_commitment));
+
+  uint8_t server_key[UW_SPAKE_P224_POINT_SIZE];
+  uint8_t client_key[UW_SPAKE_P224_POINT_SIZE];
+  TEST_EXPECT(uw_spake_finalize_(server, &client_commitment, server_key,
+                                 sizeof(server_key)));
+  TEST_EXPECT(uw_spake_finalize_(client, &server_commitment, client_key,
+                                 sizeof(client_key)));
+  TEST_EXPECT(memcmp(server_key, client_key, sizeof(server_key)) == 0);
+}
+
+/**
+ * A cache miss leaves the masks to the exchange, which records them.  The
+ * cache is persisted under a tag of the code, never the hashed code itself,
+ * survives a restart, serves a later exchange, and is erased by a reset.
+ */
+static void test_spake_masks_file_holds_no_code_() {
+  static UwDeviceCrypto device_crypto;
+  UwSpakeState server, client;
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_init_(&device_crypto)));
+  TEST_EXPECT(uw_spake_init_(&server, true, kCode, sizeof(kCode)));
+  TEST_EXPECT(uw_spake_init_(&client, false, kCode, sizeof(kCode)));
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_use_cached_spake_masks_(&device_crypto, &server)));
+  TEST_EXPECT(server.masks == NULL);
+  exchange_(&server, &client);
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_save_spake_masks_(&device_crypto, &server)));
+  TEST_EXPECT(device_crypto.has_spake_masks);
+
+  UwSpakeMasks expected;
+  TEST_EXPECT(uw_spake_compute_masks_(&server, &expected));
+  TEST_EXPECT(memcmp(&device_crypto.spake_masks, &expected,
+                     sizeof(expected)) == 0);
+  TEST_EXPECT(file_length_(kUwStorageFileNameSpakeMasks) > 0);
+  TEST_EXPECT(!file_contains_(kUwStorageFileNameSpakeMasks, server.pw,
+                              sizeof(server.pw)));
+
+  // A restart loads the cache, which still matches the code.
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_init_(&device_crypto)));
+  TEST_EXPECT(device_crypto.has_spake_masks);
+  TEST_EXPECT(memcmp(&device_crypto.spake_masks, &expected,
+                     sizeof(expected)) == 0);
+  TEST_EXPECT(uw_spake_init_(&server, true, kCode, sizeof(kCode)));
+  TEST_EXPECT(uw_spake_init_(&client, false, kCode, sizeof(kCode)));
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_use_cached_spake_masks_(&device_crypto, &server)));
+  TEST_EXPECT(server.masks == &device_crypto.spake_masks);
+  exchange_(&server, &client);
+
+  uw_device_crypto_reset_(&device_crypto);
+  TEST_EXPECT(file_length_(kUwStorageFileNameSpakeMasks) == 0);
+  TEST_EXPECT(!device_crypto.has_spake_masks);
+}
+
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+/**
+ * Each refill call advances one keypair by UW_SPAKE_STEP_NIBBLES comb rows,
+ * and the pooled keypairs are valid.
+ */
+static void test_refill_spake_pool_is_stepped_() {
+  static UwDeviceCrypto device_crypto;
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_init_(&device_crypto)));
+
+  const int calls_per_keypair =
+      (UW_SPAKE_P224_SCALAR_SIZE + UW_SPAKE_STEP_NIBBLES - 1) /
+      UW_SPAKE_STEP_NIBBLES;
+  int calls = 0;
+  while (uw_device_crypto_refill_spake_pool_(&device_crypto)) {
+    calls++;
+    TEST_EXPECT(device_crypto.spake_pool_count ==
+                (size_t)(calls / calls_per_keypair));
+  }
+  calls++;
+  TEST_EXPECT(calls == calls_per_keypair * UW_SPAKE_KEYPAIR_POOL_SIZE);
+  TEST_EXPECT(device_crypto.spake_pool_count == UW_SPAKE_KEYPAIR_POOL_SIZE);
+
+  // The comb rows agree with the generic multiplication.
+  p224_point generator;
+  TEST_EXPECT(p224_point_from_bin(kGeneratorBin, sizeof(kGeneratorBin),
+                                  &generator));
+  UwSpakeKeypair keypair;
+  while (uw_device_crypto_take_spake_keypair_(&device_crypto, &keypair)) {
+    p224_point X;
+    uint8_t expected[UW_SPAKE_P224_POINT_SIZE];
+    p224_point_mul(&generator, keypair.x, &X);
+    p224_point_to_bin(&X, expected);
+    TEST_EXPECT(memcmp(keypair.X, expected, sizeof(expected)) == 0);
+  }
+}
+#endif
+
+/**
+ * Pairing exchanges take turns with the device's multiplication state: a
+ * second one waits while the first has a multiplication pending, and the pool
+ * neither refills meanwhile nor keeps the keypair it had in progress.
+ */
+static void test_spake_mult_is_shared_() {
+  static UwDeviceCrypto device_crypto;
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_init_(&device_crypto)));
+  UwSpakeState first, second;
+  TEST_EXPECT(uw_spake_init_(&first, true, kCode, sizeof(kCode)));
+  TEST_EXPECT(uw_spake_init_(&second, true, kCode, sizeof(kCode)));
+
+  // Without a lent state, the exchange cannot begin.
+  TEST_EXPECT(!uw_spake_commitment_begin_(&first));
+
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  TEST_EXPECT(uw_device_crypto_refill_spake_pool_(&device_crypto));
+  TEST_EXPECT(device_crypto.spake_pool_filling);
+#endif
+  TEST_EXPECT(uw_device_crypto_lend_spake_mult_(&device_crypto, &first));
+  TEST_EXPECT(uw_spake_commitment_begin_(&first));
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  TEST_EXPECT(!device_crypto.spake_pool_filling);
+  TEST_EXPECT(!uw_device_crypto_refill_spake_pool_(&device_crypto));
+  TEST_EXPECT(device_crypto.spake_pool_count == 0);
+#endif
+  TEST_EXPECT(!uw_device_crypto_lend_spake_mult_(&device_crypto, &second));
+  // The borrower itself may begin its next multiplication.
+  TEST_EXPECT(uw_device_crypto_lend_spake_mult_(&device_crypto, &first));
+
+  while (uw_spake_step_(&first, UW_SPAKE_STEP_NIBBLES) == kUwSpakeStepBusy) {
+  }
+  TEST_EXPECT(uw_device_crypto_lend_spake_mult_(&device_crypto, &second));
+  TEST_EXPECT(uw_spake_commitment_begin_(&second));
+
+  // An exchange abandoned mid-multiplication gives the state back.
+  TEST_EXPECT(uw_spake_init_(&second, true, kCode, sizeof(kCode)));
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  TEST_EXPECT(uw_device_crypto_refill_spake_pool_(&device_crypto));
+#endif
+  TEST_EXPECT(uw_device_crypto_lend_spake_mult_(&device_crypto, &first));
+}
+
+/**
+ * A ticket is redeemed for the secret it seals until a root key changes or the
+ * device is reset, which each revoke it.  Pairing, which any client may start,
+ * does not.
+ */
+static void test_new_root_key_revokes_tickets_() {
+  static UwDeviceCrypto device_crypto;
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_init_(&device_crypto)));
+
+  const uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN] = {1, 2, 3, 4};
+  uint8_t redeemed[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN];
+  uint8_t ticket[UW_DEVICE_CRYPTO_TICKET_LEN];
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_issue_ticket_(&device_crypto, secret, ticket)));
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_redeem_ticket_(
+      &device_crypto, ticket, sizeof(ticket), redeemed)));
+  TEST_EXPECT(memcmp(secret, redeemed, sizeof(secret)) == 0);
+
+  uint8_t pairing_key[sizeof(device_crypto.ephemeral_pairing_key)] = {5};
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_remember_pairing_key_(
+      &device_crypto, pairing_key, sizeof(pairing_key), 0)));
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_redeem_ticket_(
+      &device_crypto, ticket, sizeof(ticket), redeemed)));
+
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_generate_pending_client_authz_key_(&device_crypto,
+                                                          NULL)));
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_redeem_ticket_(
+      &device_crypto, ticket, sizeof(ticket), redeemed)));
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_commit_pending_client_authz_key_(&device_crypto)));
+  TEST_EXPECT(!uw_status_is_success(uw_device_crypto_redeem_ticket_(
+      &device_crypto, ticket, sizeof(ticket), redeemed)));
+
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_issue_ticket_(&device_crypto, secret, ticket)));
+  uw_device_crypto_reset_(&device_crypto);
+  TEST_EXPECT(!uw_status_is_success(uw_device_crypto_redeem_ticket_(
+      &device_crypto, ticket, sizeof(ticket), redeemed)));
+}
+
+int main(int argc, char* argv[]) {
+  uwp_storage_init();
+  TEST_RUN(test_spake_masks_file_holds_no_code_);
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  TEST_RUN(test_refill_spake_pool_is_stepped_);
+#endif
+  TEST_RUN(test_spake_mult_is_shared_);
+  TEST_RUN(test_new_root_key_revokes_tickets_);
+  return TEST_EXIT_STATUS();
+}
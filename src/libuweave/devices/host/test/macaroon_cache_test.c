@@ -0,0 +1,302 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+/**
+ * Tests the cache of verified macaroon prefixes: what it stores, what it
+ * evicts, and when the device flushes it.
+ */
+
+#include <string.h>
+
+#include "devices/host/test/test.h"
+#include "src/device_crypto.h"
+#include "src/macaroon.h"
+#include "src/macaroon_cache.h"
+#include "src/macaroon_caveat.h"
+#include "src/macaroon_context.h"
+#include "uweave/provider/storage.h"
+
+#define MAX_CAVEATS 4
+#define CAVEAT_BUFFER_SIZE 32
+#define CURRENT_TIME 1000
+
+typedef enum {
+  kCaveatScope_,
+  kCaveatNonce_,
+  kCaveatBleSessionId_,
+  kCaveatAuthChallenge_,
+} CaveatKind_;
+
+/** A macaroon and the storage its caveats point into. */
+typedef struct {
+  uint8_t buffers[MAX_CAVEATS][CAVEAT_BUFFER_SIZE];
+  UwMacaroonCaveat caveats[MAX_CAVEATS];
+  const UwMacaroonCaveat* caveat_ptrs[MAX_CAVEATS];
+  UwMacaroon macaroon;
+} TestMacaroon_;
+
+static const uint8_t kSessionId[] = {1, 2, 3, 4, 5, 6, 7, 8};
+static const uint8_t kOtherSessionId[] = {8, 7, 6, 5, 4, 3, 2, 1};
+static const uint8_t kChallenge[] = "challenge";
+
+static bool create_caveat_(CaveatKind_ kind,
+                           uint8_t nonce,
+                           uint8_t* buffer,
+                           UwMacaroonCaveat* caveat) {
+  switch (kind) {
+    case kCaveatScope_:
+      return uw_macaroon_caveat_create_scope_(kUwMacaroonCaveatScopeTypeOwner,
+                                              buffer, CAVEAT_BUFFER_SIZE,
+                                              caveat);
+    case kCaveatNonce_:
+      return uw_macaroon_caveat_create_nonce_(&nonce, 1, buffer,
+                                              CAVEAT_BUFFER_SIZE, caveat);
+    case kCaveatBleSessionId_:
+      return uw_macaroon_caveat_create_ble_session_id_(
+          buffer, CAVEAT_BUFFER_SIZE, caveat);
+    case kCaveatAuthChallenge_:
+      return uw_macaroon_caveat_create_authentication_challenge_(
+          buffer, CAVEAT_BUFFER_SIZE, caveat);
+  }
+  return false;
+}
+
+/** Signs the caveats of kinds under root_key, in context. */
+static bool create_macaroon_(TestMacaroon_* test_macaroon,
+                             const UwCryptoHmacKey* root_key,
+                             const UwMacaroonContext* context,
+                             const CaveatKind_ kinds[],
+                             size_t num_caveats) {
+  for (size_t i = 0; i < num_caveats; i++) {
+    if (!create_caveat_(kinds[i], (uint8_t)i, test_macaroon->buffers[i],
+                        &test_macaroon->caveats[i])) {
+      return false;
+    }
+    test_macaroon->caveat_ptrs[i] = &test_macaroon->caveats[i];
+  }
+  return uw_macaroon_create_from_hmac_key_(&test_macaroon->macaroon, root_key,
+                                           context, test_macaroon->caveat_ptrs,
+                                           num_caveats);
+}
+
+static bool validate_(const TestMacaroon_* test_macaroon,
+                      const UwCryptoHmacKey* root_key,
+                      UwMacaroonCache* cache,
+                      const UwMacaroonContext* context) {
+  UwMacaroonValidationResult result;
+  return uw_macaroon_validate_with_cache_(&test_macaroon->macaroon, root_key,
+                                          cache, context, &result);
+}
+
+static size_t cache_entries_(const UwMacaroonCache* cache) {
+  size_t count = 0;
+  for (size_t i = 0; i < UW_MACAROON_CACHE_SIZE; i++) {
+    if (cache->entries[i].valid) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/** Whether the cache holds the first prefix_len caveats of the macaroon. */
+static bool is_prefix_cached_(UwMacaroonCache* cache,
+                              const UwCryptoHmacKey* root_key,
+                              const TestMacaroon_* test_macaroon,
+                              size_t prefix_len) {
+  UwpCryptoSha256State id_state;
+  uint8_t id[UW_MACAROON_CACHE_ID_LEN];
+  uw_macaroon_cache_id_init_(&id_state, root_key);
+  for (size_t i = 0; i < prefix_len; i++) {
+    uw_macaroon_cache_id_add_caveat_(&id_state,
+                                     test_macaroon->macaroon.caveats[i], id);
+  }
+  uint8_t mac_tag[UW_MACAROON_CACHE_TAG_LEN];
+  return uw_macaroon_cache_lookup_(cache, id, mac_tag);
+}
+
+static void init_keys_(UwCryptoHmacKey* root_key, UwCryptoHmacKey* other_key) {
+  static const uint8_t kRootKey[] = "root key";
+  static const uint8_t kOtherKey[] = "other key";
+  TEST_EXPECT(uw_crypto_hmac_key_init_(root_key, kRootKey, sizeof(kRootKey)));
+  TEST_EXPECT(
+      uw_crypto_hmac_key_init_(other_key, kOtherKey, sizeof(kOtherKey)));
+}
+
+/**
+ * A macaroon whose tag does not verify, whether by a forged tag or the wrong
+ * key, stores nothing, and a cached prefix does not let a forged extension of
+ * it through.
+ */
+static void test_forged_tag_is_not_cached_() {
+  UwCryptoHmacKey root_key, other_key;
+  init_keys_(&root_key, &other_key);
+  UwMacaroonContext context;
+  TEST_EXPECT(
+      uw_macaroon_context_create_with_timestamp_(CURRENT_TIME, &context));
+  UwMacaroonCache cache = {};
+
+  static const CaveatKind_ kKinds[] = {kCaveatScope_, kCaveatNonce_,
+                                       kCaveatNonce_};
+  TestMacaroon_ forged;
+  TEST_EXPECT(create_macaroon_(&forged, &root_key, &context, kKinds, 3));
+  forged.macaroon.mac_tag[0] ^= 0x01;
+  TEST_EXPECT(!validate_(&forged, &root_key, &cache, &context));
+  TEST_EXPECT(cache_entries_(&cache) == 0);
+
+  TestMacaroon_ wrong_key;
+  TEST_EXPECT(create_macaroon_(&wrong_key, &other_key, &context, kKinds, 3));
+  TEST_EXPECT(!validate_(&wrong_key, &root_key, &cache, &context));
+  TEST_EXPECT(cache_entries_(&cache) == 0);
+
+  TestMacaroon_ prefix;
+  TEST_EXPECT(create_macaroon_(&prefix, &root_key, &context, kKinds, 2));
+  TEST_EXPECT(validate_(&prefix, &root_key, &cache, &context));
+  TEST_EXPECT(cache_entries_(&cache) == 1);
+  TEST_EXPECT(is_prefix_cached_(&cache, &root_key, &prefix, 2));
+
+  // Resumes from the cached prefix, but the last caveat still has to match.
+  TEST_EXPECT(!validate_(&forged, &root_key, &cache, &context));
+  TEST_EXPECT(cache_entries_(&cache) == 1);
+  TEST_EXPECT(!is_prefix_cached_(&cache, &root_key, &forged, 3));
+  forged.macaroon.mac_tag[0] ^= 0x01;
+  TEST_EXPECT(validate_(&forged, &root_key, &cache, &context));
+  TEST_EXPECT(is_prefix_cached_(&cache, &root_key, &forged, 3));
+}
+
+/**
+ * Caveats whose MAC covers the BLE session ID or the auth challenge, and any
+ * after them, are never cached, so a token bound to one session cannot be
+ * replayed on another through the cache.
+ */
+static void test_session_bound_caveats_are_not_cached_() {
+  UwCryptoHmacKey root_key, other_key;
+  init_keys_(&root_key, &other_key);
+  UwMacaroonContext context, other_context;
+  TEST_EXPECT(uw_macaroon_context_create_(CURRENT_TIME, kSessionId,
+                                          sizeof(kSessionId), kChallenge,
+                                          sizeof(kChallenge), &context));
+  TEST_EXPECT(uw_macaroon_context_create_(CURRENT_TIME, kOtherSessionId,
+                                          sizeof(kOtherSessionId), kChallenge,
+                                          sizeof(kChallenge), &other_context));
+  UwMacaroonCache cache = {};
+
+  static const CaveatKind_ kSessionKinds[] = {
+      kCaveatScope_, kCaveatNonce_, kCaveatBleSessionId_, kCaveatNonce_};
+  TestMacaroon_ session_bound;
+  TEST_EXPECT(create_macaroon_(&session_bound, &root_key, &context,
+                               kSessionKinds, 4));
+  TEST_EXPECT(validate_(&session_bound, &root_key, &cache, &context));
+  TEST_EXPECT(cache_entries_(&cache) == 1);
+  TEST_EXPECT(is_prefix_cached_(&cache, &root_key, &session_bound, 2));
+  TEST_EXPECT(!is_prefix_cached_(&cache, &root_key, &session_bound, 3));
+  TEST_EXPECT(!is_prefix_cached_(&cache, &root_key, &session_bound, 4));
+
+  // With the prefix cached, the session caveat is still checked.
+  TEST_EXPECT(!validate_(&session_bound, &root_key, &cache, &other_context));
+  TEST_EXPECT(validate_(&session_bound, &root_key, &cache, &context));
+
+  static const CaveatKind_ kChallengeKinds[] = {kCaveatAuthChallenge_,
+                                                kCaveatScope_, kCaveatNonce_};
+  TestMacaroon_ challenge_bound;
+  TEST_EXPECT(create_macaroon_(&challenge_bound, &root_key, &context,
+                               kChallengeKinds, 3));
+  uw_macaroon_cache_clear_(&cache);
+  TEST_EXPECT(validate_(&challenge_bound, &root_key, &cache, &context));
+  TEST_EXPECT(cache_entries_(&cache) == 0);
+}
+
+/** Once full, the cache evicts the entry looked up or stored longest ago. */
+static void test_cache_evicts_least_recently_used_() {
+  UwMacaroonCache cache = {};
+  uint8_t ids[UW_MACAROON_CACHE_SIZE + 1][UW_MACAROON_CACHE_ID_LEN];
+  uint8_t tag[UW_MACAROON_CACHE_TAG_LEN] = {0};
+  uint8_t found_tag[UW_MACAROON_CACHE_TAG_LEN];
+  for (size_t i = 0; i <= UW_MACAROON_CACHE_SIZE; i++) {
+    memset(ids[i], (int)i + 1, UW_MACAROON_CACHE_ID_LEN);
+  }
+
+  for (size_t i = 0; i < UW_MACAROON_CACHE_SIZE; i++) {
+    tag[0] = (uint8_t)i;
+    uw_macaroon_cache_insert_(&cache, ids[i], tag);
+  }
+  TEST_EXPECT(cache_entries_(&cache) == UW_MACAROON_CACHE_SIZE);
+
+  // Using the oldest entry makes the second one the least recently used.
+  TEST_EXPECT(uw_macaroon_cache_lookup_(&cache, ids[0], found_tag));
+  TEST_EXPECT(found_tag[0] == 0);
+  tag[0] = UW_MACAROON_CACHE_SIZE;
+  uw_macaroon_cache_insert_(&cache, ids[UW_MACAROON_CACHE_SIZE], tag);
+  TEST_EXPECT(cache_entries_(&cache) == UW_MACAROON_CACHE_SIZE);
+  TEST_EXPECT(!uw_macaroon_cache_lookup_(&cache, ids[1], found_tag));
+  for (size_t i = 0; i <= UW_MACAROON_CACHE_SIZE; i++) {
+    if (i != 1) {
+      TEST_EXPECT(uw_macaroon_cache_lookup_(&cache, ids[i], found_tag));
+      TEST_EXPECT(found_tag[0] == i);
+    }
+  }
+
+  // Storing an id again replaces its tag rather than taking another entry.
+  tag[0] = 0xff;
+  uw_macaroon_cache_insert_(&cache, ids[0], tag);
+  TEST_EXPECT(cache_entries_(&cache) == UW_MACAROON_CACHE_SIZE);
+  TEST_EXPECT(uw_macaroon_cache_lookup_(&cache, ids[0], found_tag));
+  TEST_EXPECT(found_tag[0] == 0xff);
+}
+
+/** Fills the device's cache with a prefix under its client authz key. */
+static bool populate_device_cache_(UwDeviceCrypto* device_crypto) {
+  UwMacaroonContext context;
+  static const CaveatKind_ kKinds[] = {kCaveatScope_, kCaveatNonce_};
+  TestMacaroon_ token;
+  return uw_macaroon_context_create_with_timestamp_(CURRENT_TIME, &context) &&
+         create_macaroon_(&token,
+                          &device_crypto->client_authorization_hmac_key,
+                          &context, kKinds, 2) &&
+         validate_(&token, &device_crypto->client_authorization_hmac_key,
+                   &device_crypto->macaroon_cache, &context) &&
+         cache_entries_(&device_crypto->macaroon_cache) > 0;
+}
+
+/**
+ * The device flushes the cache along with a new client authz key and on a
+ * factory reset, but not for a new pairing key, which any nearby client can
+ * have set.
+ */
+static void test_device_flushes_cache_on_key_change_() {
+  static UwDeviceCrypto device_crypto;
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_init_(&device_crypto)));
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_generate_pending_client_authz_key_(&device_crypto,
+                                                          NULL)));
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_commit_pending_client_authz_key_(&device_crypto)));
+  TEST_EXPECT(cache_entries_(&device_crypto.macaroon_cache) == 0);
+
+  TEST_EXPECT(populate_device_cache_(&device_crypto));
+  uint8_t pairing_key[sizeof(device_crypto.ephemeral_pairing_key)] = {5};
+  TEST_EXPECT(uw_status_is_success(uw_device_crypto_remember_pairing_key_(
+      &device_crypto, pairing_key, sizeof(pairing_key), 0)));
+  TEST_EXPECT(cache_entries_(&device_crypto.macaroon_cache) > 0);
+
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_generate_pending_client_authz_key_(&device_crypto,
+                                                          NULL)));
+  TEST_EXPECT(cache_entries_(&device_crypto.macaroon_cache) > 0);
+  TEST_EXPECT(uw_status_is_success(
+      uw_device_crypto_commit_pending_client_authz_key_(&device_crypto)));
+  TEST_EXPECT(cache_entries_(&device_crypto.macaroon_cache) == 0);
+
+  TEST_EXPECT(populate_device_cache_(&device_crypto));
+  uw_device_crypto_reset_(&device_crypto);
+  TEST_EXPECT(cache_entries_(&device_crypto.macaroon_cache) == 0);
+}
+
+int main(int argc, char* argv[]) {
+  uwp_storage_init();
+  TEST_RUN(test_forged_tag_is_not_cached_);
+  TEST_RUN(test_session_bound_caveats_are_not_cached_);
+  TEST_RUN(test_cache_evicts_least_recently_used_);
+  TEST_RUN(test_device_flushes_cache_on_key_change_);
+  return TEST_EXIT_STATUS();
+}
@@ -0,0 +1,63 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/test/p224_limb32.h"
+
+// Renames the public functions so that they link next to the library's.
+#undef P224_LIMB64
+#define P224_LIMB64 0
+#define p224_point_from_bin p224_limb32_point_from_bin
+#define p224_point_to_bin p224_limb32_point_to_bin
+#define p224_base_point_mul p224_limb32_base_point_mul
+#define p224_point_mul p224_limb32_point_mul
+#define p224_scalar_mult_begin p224_limb32_scalar_mult_begin
+#define p224_scalar_mult_step p224_limb32_scalar_mult_step
+#define p224_scalar_mult_finish p224_limb32_scalar_mult_finish
+#define p224_base_point_mult_begin p224_limb32_base_point_mult_begin
+#define p224_point_add p224_limb32_point_add
+#define p224_point_negate p224_limb32_point_negate
+
+#include "omaha-crypto/p224_ec.c"
+
+int p224_limb32_point_mul_bin(const uint8_t in[56],
+                              const uint8_t scalar[28],
+                              uint8_t out[56]) {
+  p224_point point, product;
+  if (!p224_point_from_bin(in, 56, &point)) {
+    return 0;
+  }
+  p224_point_mul(&point, scalar, &product);
+  p224_point_to_bin(&product, out);
+  return 1;
+}
+
+void p224_limb32_base_point_mul_bin(const uint8_t scalar[28],
+                                    uint8_t out[56]) {
+  p224_point point;
+  p224_base_point_mul(scalar, &point);
+  p224_point_to_bin(&point, out);
+}
+
+int p224_limb32_point_add_bin(const uint8_t a[56],
+                              const uint8_t b[56],
+                              uint8_t out[56]) {
+  p224_point point_a, point_b, sum;
+  if (!p224_point_from_bin(a, 56, &point_a) ||
+      !p224_point_from_bin(b, 56, &point_b)) {
+    return 0;
+  }
+  p224_point_add(&point_a, &point_b, &sum);
+  p224_point_to_bin(&sum, out);
+  return 1;
+}
+
+int p224_limb32_point_negate_bin(const uint8_t in[56], uint8_t out[56]) {
+  p224_point point, negated;
+  if (!p224_point_from_bin(in, 56, &point)) {
+    return 0;
+  }
+  p224_point_negate(&point, &negated);
+  p224_point_to_bin(&negated, out);
+  return 1;
+}
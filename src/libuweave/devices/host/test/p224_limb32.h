@@ -0,0 +1,30 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_TEST_P224_LIMB32_H_
+#define LIBUWEAVE_DEVICES_HOST_TEST_P224_LIMB32_H_
+
+#include <stdint.h>
+
+/**
+ * third_party/omaha-crypto/p224_ec.c built a second time with its 28-bit
+ * limbs, so that a test on a 64-bit host can check the 56-bit limbs against
+ * them.  Points are in the 56-byte form of p224_point_to_bin; the functions
+ * that take one return 0 if it is not on the curve.
+ */
+
+int p224_limb32_point_mul_bin(const uint8_t in[56],
+                              const uint8_t scalar[28],
+                              uint8_t out[56]);
+
+void p224_limb32_base_point_mul_bin(const uint8_t scalar[28],
+                                    uint8_t out[56]);
+
+int p224_limb32_point_add_bin(const uint8_t a[56],
+                              const uint8_t b[56],
+                              uint8_t out[56]);
+
+int p224_limb32_point_negate_bin(const uint8_t in[56], uint8_t out[56]);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_TEST_P224_LIMB32_H_
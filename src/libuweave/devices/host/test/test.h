@@ -0,0 +1,39 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_TEST_TEST_H_
+#define LIBUWEAVE_DEVICES_HOST_TEST_TEST_H_
+
+#include <stdio.h>
+
+/**
+ * Minimal checks for the host test programs.  Each *_test.c file is a program
+ * whose main runs its cases with TEST_RUN and returns TEST_EXIT_STATUS().  A
+ * failed TEST_EXPECT prints its location and fails the program but lets the
+ * case go on, so that one run reports every broken expectation.
+ */
+
+static int test_failure_count_ = 0;
+
+#define TEST_EXPECT(condition)                                           \
+  do {                                                                   \
+    if (!(condition)) {                                                  \
+      fprintf(stderr, "%s:%d: expected %s\n", __FILE__, __LINE__,        \
+              #condition);                                               \
+      test_failure_count_++;                                             \
+    }                                                                    \
+  } while (0)
+
+#define TEST_RUN(test_function)                                          \
+  do {                                                                   \
+    int failures_before = test_failure_count_;                           \
+    test_function();                                                     \
+    fprintf(stderr, "%s %s\n",                                           \
+            test_failure_count_ == failures_before ? "PASS" : "FAIL",    \
+            #test_function);                                             \
+  } while (0)
+
+#define TEST_EXIT_STATUS() (test_failure_count_ == 0 ? 0 : 1)
+
+#endif  // LIBUWEAVE_DEVICES_HOST_TEST_TEST_H_
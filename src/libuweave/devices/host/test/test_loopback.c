@@ -0,0 +1,305 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "devices/host/test/test_loopback.h"
+
+#include <stdlib.h>
+
+#include "cbor.h"
+#include "devices/host/provider/ble_loopback.h"
+#include "src/crypto_defines.h"
+#include "src/device.h"
+#include "src/macaroon_helpers.h"
+#include "uweave/ble_transport.h"
+
+// Gives up on a reply after this many polls of an idle link.
+#define MAX_POLLS 10000
+
+// Privet RPC map keys, as parsed by src/privet_request.c.
+#define PRIVET_KEY_VERSION 0
+#define PRIVET_KEY_API_ID 1
+#define PRIVET_KEY_REQUEST_ID 2
+#define PRIVET_KEY_PARAMS 16
+#define PRIVET_VERSION 3
+
+// /pairing/start params, as parsed by src/pairing_request.c.
+#define PAIRING_START_KEY_PAIRING 0
+#define PAIRING_START_KEY_CRYPTO 1
+#define PAIRING_START_VALUE_EMBEDDED 1
+#define PAIRING_START_VALUE_SPAKE_P224 0
+
+static UwSettings settings_ = {
+    .firmware_version = "test",
+    .oem_name = "Weave",
+    .model_name = "Test",
+    .model_id = {'T', 'S', 'T'},
+    .device_class = {'A', 'A'},
+    .supported_pairing_types = kUwPairingTypeEmbeddedCode,
+    .embedded_code = {.source = kUwEmbeddedCodeSourceSettings,
+                      .u.embedded_code_str = TEST_LOOPBACK_EMBEDDED_CODE},
+    .supports_ble_40 = true,
+    .name = "test",
+};
+
+static BleClient clients_[BLE_LOOPBACK_MAX_CLIENTS];
+
+UwDevice* test_loopback_start_device() {
+  UwDevice* device = malloc(uw_device_sizeof());
+  UwCommandList* command_list = malloc(uw_command_list_sizeof(1, 64));
+  UwCounterSet* counter_set = malloc(uw_counter_set_sizeof(0));
+  UwBleTransport* transport = malloc(uw_ble_transport_sizeof());
+  static UwDeviceHandlers handlers = {};
+  uw_command_list_init(command_list, 1, 64);
+  uw_counter_set_init(counter_set, NULL, 0);
+  uw_device_init(device, &settings_, &handlers, command_list, counter_set);
+  if (!uw_ble_transport_init(transport, device)) {
+    return NULL;
+  }
+  uw_device_start(device);
+  return device;
+}
+
+BleClient* test_loopback_get_client(size_t link_client) {
+  return &clients_[link_client];
+}
+
+BleClientEvent test_loopback_run_until_event(UwDevice* device,
+                                             BleClient* client,
+                                             UwBuffer* received) {
+  uint8_t received_data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer scratch;
+  if (received == NULL) {
+    uw_buffer_init(&scratch, received_data, sizeof(received_data));
+    received = &scratch;
+  }
+  for (int polls = 0; polls < MAX_POLLS; polls++) {
+    uw_device_handle_events(device);
+    BleClientEvent event = ble_client_poll(client, received);
+    if (event != kBleClientEventNone) {
+      return event;
+    }
+  }
+  return kBleClientEventNone;
+}
+
+bool test_loopback_connect(UwDevice* device, size_t link_client) {
+  const uint8_t handshake[] = {UW_CRYPTO_MODE_PASSTHROUGH};
+  BleClient* client = &clients_[link_client];
+  ble_client_init(client, link_client);
+  return ble_client_connect(client, handshake, sizeof(handshake)) &&
+         test_loopback_run_until_event(device, client, NULL) ==
+             kBleClientEventConnected;
+}
+
+void test_loopback_disconnect(UwDevice* device, BleClient* client) {
+  ble_client_disconnect(client);
+  uw_device_handle_events(device);
+}
+
+/** Encodes a Privet request for api_id into request. */
+static bool encode_request_(uint32_t api_id,
+                            uint32_t request_id,
+                            bool pairing_start_params,
+                            UwBuffer* request) {
+  uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_bytes_(request, &bytes, &length);
+  CborEncoder encoder;
+  CborEncoder map;
+  cbor_encoder_init(&encoder, bytes, uw_buffer_get_size(request), 0);
+  cbor_encoder_create_map(&encoder, &map, pairing_start_params ? 4 : 3);
+  cbor_encode_int(&map, PRIVET_KEY_VERSION);
+  cbor_encode_int(&map, PRIVET_VERSION);
+  cbor_encode_int(&map, PRIVET_KEY_API_ID);
+  cbor_encode_uint(&map, api_id);
+  cbor_encode_int(&map, PRIVET_KEY_REQUEST_ID);
+  cbor_encode_uint(&map, request_id);
+  if (pairing_start_params) {
+    CborEncoder params;
+    cbor_encode_int(&map, PRIVET_KEY_PARAMS);
+    cbor_encoder_create_map(&map, &params, 2);
+    cbor_encode_int(&params, PAIRING_START_KEY_PAIRING);
+    cbor_encode_int(&params, PAIRING_START_VALUE_EMBEDDED);
+    cbor_encode_int(&params, PAIRING_START_KEY_CRYPTO);
+    cbor_encode_int(&params, PAIRING_START_VALUE_SPAKE_P224);
+    cbor_encoder_close_container(&map, &params);
+  }
+  if (cbor_encoder_close_container_checked(&encoder, &map) != CborNoError) {
+    return false;
+  }
+  uw_buffer_set_length_(request, encoder.ptr - bytes);
+  return true;
+}
+
+static bool send_request_(BleClient* client,
+                          uint32_t api_id,
+                          uint32_t request_id,
+                          bool pairing_start_params) {
+  uint8_t request_data[64];
+  UwBuffer request;
+  uw_buffer_init(&request, request_data, sizeof(request_data));
+  return encode_request_(api_id, request_id, pairing_start_params,
+                         &request) &&
+         ble_client_send(client, request_data, uw_buffer_get_length(&request));
+}
+
+bool test_loopback_encode_request(uint32_t api_id,
+                                  uint32_t request_id,
+                                  UwBuffer* request) {
+  uw_buffer_reset(request);
+  return encode_request_(api_id, request_id, false, request);
+}
+
+bool test_loopback_send_request(BleClient* client,
+                                uint32_t api_id,
+                                uint32_t request_id) {
+  return send_request_(client, api_id, request_id, false);
+}
+
+bool test_loopback_get_reply_request_id(const UwBuffer* reply,
+                                        uint32_t* request_id) {
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(reply, &bytes, &length);
+  CborParser parser;
+  CborValue map;
+  CborValue value;
+  if (cbor_parser_init(bytes, length, 0, &parser, &map) != CborNoError ||
+      !cbor_value_is_map(&map) ||
+      cbor_value_enter_container(&map, &value) != CborNoError) {
+    return false;
+  }
+  while (!cbor_value_at_end(&value)) {
+    int key;
+    if (!cbor_value_is_integer(&value) ||
+        cbor_value_get_int(&value, &key) != CborNoError ||
+        cbor_value_advance_fixed(&value) != CborNoError) {
+      return false;
+    }
+    if (key == PRIVET_KEY_REQUEST_ID) {
+      int64_t id;
+      if (!cbor_value_is_integer(&value) ||
+          cbor_value_get_int64(&value, &id) != CborNoError) {
+        return false;
+      }
+      *request_id = (uint32_t)id;
+      return true;
+    }
+    if (cbor_value_advance(&value) != CborNoError) {
+      return false;
+    }
+  }
+  return false;
+}
+
+bool test_loopback_send_pairing_start(BleClient* client, uint32_t request_id) {
+  return send_request_(client, TEST_PRIVET_API_ID_PAIRING_START, request_id,
+                       true);
+}
+
+bool test_loopback_mint_sat(UwDevice* device,
+                            uint8_t* sat,
+                            size_t* sat_length) {
+  static const uint8_t kNonce[UW_MACAROON_INIT_DELEGATION_NONCE_SIZE] = {1};
+  uint8_t sat_buffer[80];
+  UwMacaroon sat_macaroon;
+  return uw_macaroon_mint_server_authentication_token_(
+             device->device_crypto.device_authentication_key,
+             sizeof(device->device_crypto.device_authentication_key), NULL, 0,
+             kNonce, sat_buffer, sizeof(sat_buffer), &sat_macaroon) &&
+         uw_macaroon_serialize_(&sat_macaroon, sat, CLIENT_SESSION_MAX_SAT_LEN,
+                                sat_length);
+}
+
+/** Sends message and waits for the reply, which replaces it. */
+static bool exchange_(UwDevice* device, BleClient* client, UwBuffer* message) {
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(message, &bytes, &length);
+  if (!ble_client_send(client, bytes, length)) {
+    return false;
+  }
+  uw_buffer_reset(message);
+  return test_loopback_run_until_event(device, client, message) ==
+         kBleClientEventMessage;
+}
+
+bool test_loopback_init_session(UwDevice* device, ClientSession* session) {
+  uint8_t sat[CLIENT_SESSION_MAX_SAT_LEN];
+  size_t sat_length;
+  return test_loopback_mint_sat(device, sat, &sat_length) &&
+         client_session_init(session, sat, sat_length);
+}
+
+bool test_loopback_connect_secure(UwDevice* device,
+                                  size_t link_client,
+                                  uint8_t mode,
+                                  ClientSession* session) {
+  uint8_t data[UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE];
+  UwBuffer message;
+  uw_buffer_init(&message, data, sizeof(data));
+  BleClient* client = &clients_[link_client];
+  ble_client_init(client, link_client);
+  if (!client_session_write_hello(session, mode, &message)) {
+    return false;
+  }
+
+  const uint8_t* hello;
+  size_t hello_length;
+  uw_buffer_get_const_bytes(&message, &hello, &hello_length);
+  if (!ble_client_connect(client, hello, hello_length)) {
+    return false;
+  }
+  uw_buffer_reset(&message);
+  if (test_loopback_run_until_event(device, client, &message) !=
+      kBleClientEventConnected) {
+    return false;
+  }
+
+  uint8_t next_data[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+  UwBuffer next;
+  uw_buffer_init(&next, next_data, sizeof(next_data));
+  return client_session_handle_confirm(session, &message, &next) &&
+         exchange_(device, client, &next) &&
+         client_session_handle_auth_reply(session, &next);
+}
+
+bool test_loopback_send_sealed(UwDevice* device,
+                               BleClient* client,
+                               ClientSession* session,
+                               UwBuffer* message) {
+  return uw_status_is_success(
+             uw_channel_encryption_process_out_(&session->state, message)) &&
+         exchange_(device, client, message) &&
+         uw_status_is_success(client_session_open(session, message));
+}
+
+bool test_loopback_secure_request(UwDevice* device,
+                                  BleClient* client,
+                                  ClientSession* session,
+                                  uint32_t api_id,
+                                  uint32_t request_id,
+                                  UwBuffer* reply) {
+  uint8_t rekey_data[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+  UwBuffer rekey;
+  uw_buffer_init(&rekey, rekey_data, sizeof(rekey_data));
+  // A rekey adds an exchange, and a rekey the device asks for a second one.
+  for (int attempt = 0; attempt < 3; attempt++) {
+    if (!test_loopback_encode_request(api_id, request_id, reply)) {
+      return false;
+    }
+    UwStatus seal_status = client_session_seal(session, reply, &rekey);
+    UwBuffer* message = (seal_status == kUwStatusPending) ? &rekey : reply;
+    if ((seal_status != kUwStatusPending &&
+         !uw_status_is_success(seal_status)) ||
+        !exchange_(device, client, message) ||
+        !uw_status_is_success(client_session_open(session, message))) {
+      return false;
+    }
+    if (message == reply && uw_buffer_get_length(reply) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,114 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_DEVICES_HOST_TEST_TEST_LOOPBACK_H_
+#define LIBUWEAVE_DEVICES_HOST_TEST_TEST_LOOPBACK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "devices/host/client/ble_client.h"
+#include "devices/host/client/client_session.h"
+#include "uweave/device.h"
+
+/**
+ * A device on the BLE loopback link and BleClients to talk to it, as in
+ * devices/host/loopback, for tests that go through the whole transport,
+ * channel and privet request path.  The provider state is global, so a test
+ * program starts one device.
+ */
+
+// Privet API ids, as parsed by src/privet_request.c.
+#define TEST_PRIVET_API_ID_INFO 0
+#define TEST_PRIVET_API_ID_PAIRING_START 2
+
+#define TEST_LOOPBACK_EMBEDDED_CODE "1234"
+
+/**
+ * Starts a device with the BLE transport, which supports embedded code
+ * pairing with TEST_LOOPBACK_EMBEDDED_CODE.
+ */
+UwDevice* test_loopback_start_device();
+
+/** The client for link_client of the loopback link. */
+BleClient* test_loopback_get_client(size_t link_client);
+
+/**
+ * Services the device and the client until the client reports an event, which
+ * is returned, or a bounded number of polls pass, which returns
+ * kBleClientEventNone.  received, if not NULL, gets the message.
+ */
+BleClientEvent test_loopback_run_until_event(UwDevice* device,
+                                             BleClient* client,
+                                             UwBuffer* received);
+
+/** Connects link_client in passthrough mode; true once the device confirms. */
+bool test_loopback_connect(UwDevice* device, size_t link_client);
+
+/**
+ * Disconnects client and lets the device handle it, so that the link client
+ * can connect again.
+ */
+void test_loopback_disconnect(UwDevice* device, BleClient* client);
+
+/** Writes a Privet request for api_id with no params to request. */
+bool test_loopback_encode_request(uint32_t api_id,
+                                  uint32_t request_id,
+                                  UwBuffer* request);
+
+/** Queues a Privet request for api_id with no params on the client. */
+bool test_loopback_send_request(BleClient* client,
+                                uint32_t api_id,
+                                uint32_t request_id);
+
+/** Reads the request id a Privet reply echoes; false if it has none. */
+bool test_loopback_get_reply_request_id(const UwBuffer* reply,
+                                        uint32_t* request_id);
+
+/** Queues a /pairing/start for the embedded code with SPAKE P-224. */
+bool test_loopback_send_pairing_start(BleClient* client, uint32_t request_id);
+
+/**
+ * Mints and serializes a SAT under the device's authentication key, as
+ * /pairing/confirm hands out, into sat of CLIENT_SESSION_MAX_SAT_LEN bytes.
+ */
+bool test_loopback_mint_sat(UwDevice* device,
+                            uint8_t* sat,
+                            size_t* sat_length);
+
+/** Sets up session with a fresh SAT from test_loopback_mint_sat. */
+bool test_loopback_init_session(UwDevice* device, ClientSession* session);
+
+/**
+ * Connects link_client in the token handshake mode given, as
+ * client_session_write_hello takes it; true once the session is encrypted.
+ */
+bool test_loopback_connect_secure(UwDevice* device,
+                                  size_t link_client,
+                                  uint8_t mode,
+                                  ClientSession* session);
+
+/**
+ * Seals message as is, without the rekey check of client_session_seal, sends
+ * it and opens the reply into message.
+ */
+bool test_loopback_send_sealed(UwDevice* device,
+                               BleClient* client,
+                               ClientSession* session,
+                               UwBuffer* message);
+
+/**
+ * Sends a Privet request for api_id with no params over the encrypted session
+ * and opens the reply into reply, rekeying first if the session is due or the
+ * device asks for it.
+ */
+bool test_loopback_secure_request(UwDevice* device,
+                                  BleClient* client,
+                                  ClientSession* session,
+                                  uint32_t api_id,
+                                  uint32_t request_id,
+                                  UwBuffer* reply);
+
+#endif  // LIBUWEAVE_DEVICES_HOST_TEST_TEST_LOOPBACK_H_
@@ -33,8 +33,17 @@ void uw_ble_transport_notify_work(UwBleTransport* ble_transport);
 
 /**
  * Notifies the transport that activity has occurred that should be considered
- * non-idle.
+ * non-idle.  The transport times out each connection on its own packets; this
+ * restarts the idle timer of every connection, for activity it cannot see.
  */
 void uw_ble_transport_notify_activity(UwBleTransport* ble_transport);
 
+/**
+ * Notifies the transport that sent packets have left the provider's transmit
+ * window, so uwp_ble_can_write_packet() may be true again.  Safe to call from
+ * interrupt handlers, even while uw_device_handle_events runs, as
+ * uw_device_notify_work is; see UW_BLE_PROVIDER_NOTIFIES_TX_COMPLETE.
+ */
+void uw_ble_transport_notify_tx_complete(UwBleTransport* ble_transport);
+
 #endif  // LIBUWEAVE_INCLUDE_UWEAVE_BLE_TRANSPORT_H_
@@ -51,7 +51,25 @@
 #define UW_BLE_TRANSPORT_REPLY_BUFFER_SIZE 512
 #endif
 
-/** The size of a single BLE packet. */
+/**
+ * Whether each BLE connection gets a second request buffer.  A request's
+ * buffer is freed as soon as its reply is ready, so the next request can
+ * arrive while the reply is sent either way.  The second buffer also takes
+ * the request after that, or the next one while a handler is pending, at a
+ * cost of UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE bytes of RAM per connection.
+ */
+#ifndef UW_BLE_TRANSPORT_DOUBLE_BUFFER_REQUESTS
+#define UW_BLE_TRANSPORT_DOUBLE_BUFFER_REQUESTS 0
+#endif
+
+/**
+ * The largest BLE packet, i.e. characteristic write or indication, the
+ * transport will use.  Each connection uses the smaller of this, the size
+ * reported by uwp_ble_get_max_packet_size() (the negotiated ATT MTU less its
+ * 3-byte header) and the size the client asks for.  Raising it to 244 lets
+ * phones that negotiate a 247-byte ATT MTU get one header byte per 243 payload
+ * bytes instead of per 19, at the cost of larger UwBleEvent buffers.
+ */
 #ifndef UW_BLE_PACKET_SIZE
 #define UW_BLE_PACKET_SIZE 20
 #endif
@@ -69,6 +87,26 @@
 #define UW_BLE_EVENT_QUEUE_SIZE 32
 #endif
 
+/**
+ * Number of BLE clients the transport serves at once.  Each connection has its
+ * own session and request and reply buffers, so every slot costs about
+ * UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE * 2 bytes of RAM.  Further connections
+ * are refused.
+ */
+#ifndef UW_BLE_MAX_CONNECTIONS
+#define UW_BLE_MAX_CONNECTIONS 1
+#endif
+
+/**
+ * Set to 1 if the BLE provider calls uw_ble_transport_notify_tx_complete when
+ * uwp_ble_can_write_packet() turns true again.  The transport then reports
+ * itself idle while the transmit window is full, so that the device can sleep.
+ * Otherwise it keeps polling the window.
+ */
+#ifndef UW_BLE_PROVIDER_NOTIFIES_TX_COMPLETE
+#define UW_BLE_PROVIDER_NOTIFIES_TX_COMPLETE 0
+#endif
+
 /** Used by the provider to specify the advertising interval. */
 #ifndef UW_BLE_ADVERTISING_INTERVAL_MS
 #define UW_BLE_ADVERTISING_INTERVAL_MS 500
@@ -94,6 +132,112 @@
 #define UW_STORAGE_ALIGNMENT 16
 #endif
 
+/**
+ * Used by the provider to select its software AES-128.  Zero uses the
+ * byte-oriented tiny-aes code.  One uses 32-bit T-tables, which is several
+ * times faster on 32-bit cores at the cost of 4KB of read-only tables.
+ */
+#ifndef UW_CRYPTO_AES_TTABLE
+#define UW_CRYPTO_AES_TTABLE 0
+#endif
+
+/**
+ * With UW_CRYPTO_AES_TTABLE, keep a single 1KB table and rotate each lookup
+ * instead of storing four tables.  Saves 3KB of flash for a small slowdown.
+ */
+#ifndef UW_CRYPTO_AES_TTABLE_COMPACT
+#define UW_CRYPTO_AES_TTABLE_COMPACT 0
+#endif
+
+/**
+ * Number of AES-CTR keystream blocks EAX requests from the provider per call.
+ * Each block costs 16 bytes of stack.
+ */
+#ifndef UW_CRYPTO_CTR_BATCH_BLOCKS
+#define UW_CRYPTO_CTR_BATCH_BLOCKS 4
+#endif
+
+/**
+ * Set to 1 if the provider implements uwp_crypto_sha256_update_lanes and
+ * uwp_crypto_sha256_final_lanes, e.g. with SIMD.  Otherwise the batched HMAC
+ * functions hash their lanes one after another.
+ */
+#ifndef UW_CRYPTO_PROVIDER_SHA256_LANES
+#define UW_CRYPTO_PROVIDER_SHA256_LANES 0
+#endif
+
+/**
+ * Number of ephemeral SPAKE keypairs (x, x * G) precomputed while the device
+ * is idle, so /pairing/start can skip the base-point multiplication.  Each
+ * entry costs 84 bytes of RAM, plus one keypair for the entry in progress; the
+ * pool computes it in the multiplication state (about 1.6 KB) the device keeps
+ * for pairing anyway, and yields it to pairing.  Zero disables the pool.
+ */
+#ifndef UW_SPAKE_KEYPAIR_POOL_SIZE
+#define UW_SPAKE_KEYPAIR_POOL_SIZE 2
+#endif
+
+/**
+ * Number of 4-bit scalar windows of P-224 multiplication a pairing request or
+ * the keypair pool computes per event loop pass before returning
+ * kUwDeviceWorkStateBusy; a full multiplication is 56, and a base-point one is
+ * 28 cheaper comb rows.  Smaller values keep the loop more responsive at the
+ * cost of more passes.
+ */
+#ifndef UW_SPAKE_STEP_NIBBLES
+#define UW_SPAKE_STEP_NIBBLES 8
+#endif
+
+/**
+ * Number of verified macaroon caveat prefixes remembered per device so that a
+ * token presented again only has its new caveats signed.  Each entry is 40
+ * bytes; 0 disables the cache.
+ */
+#ifndef UW_MACAROON_CACHE_SIZE
+#define UW_MACAROON_CACHE_SIZE 4
+#endif
+
+/**
+ * Admission control for the Privet APIs that run expensive crypto.  Each API
+ * admits BURST calls back to back, then PER_MINUTE calls per minute; calls over
+ * the limit are rejected with kUwStatusRateLimited before any crypto runs.  A
+ * rate of 0 disables the limit for that API.
+ *
+ * The limits apply to each BLE connection separately, so that one client
+ * cannot use up the calls of another.  All connections together are also held
+ * to UW_ADMISSION_DEVICE_WIDE_SCALE times each burst and rate.  That bounds
+ * the crypto work of clients that reconnect to get fresh limits, or that open
+ * every connection, though such a client can then lock others out of the API
+ * until the device-wide calls refill.  0 drops the device-wide limit.
+ */
+#ifndef UW_ADMISSION_DEVICE_WIDE_SCALE
+#define UW_ADMISSION_DEVICE_WIDE_SCALE 2
+#endif
+
+#ifndef UW_ADMISSION_PAIRING_START_PER_MINUTE
+#define UW_ADMISSION_PAIRING_START_PER_MINUTE 6
+#endif
+
+#ifndef UW_ADMISSION_PAIRING_START_BURST
+#define UW_ADMISSION_PAIRING_START_BURST 3
+#endif
+
+#ifndef UW_ADMISSION_PAIRING_CONFIRM_PER_MINUTE
+#define UW_ADMISSION_PAIRING_CONFIRM_PER_MINUTE 6
+#endif
+
+#ifndef UW_ADMISSION_PAIRING_CONFIRM_BURST
+#define UW_ADMISSION_PAIRING_CONFIRM_BURST 3
+#endif
+
+#ifndef UW_ADMISSION_AUTH_PER_MINUTE
+#define UW_ADMISSION_AUTH_PER_MINUTE 60
+#endif
+
+#ifndef UW_ADMISSION_AUTH_BURST
+#define UW_ADMISSION_AUTH_BURST 10
+#endif
+
 #ifndef UW_ENABLE_MULTIPAIRING_DEFAULT
 #define UW_ENABLE_MULTIPAIRING_DEFAULT 0
 #endif
@@ -106,4 +250,25 @@
 #define UW_UNCONFIGURED_IDLE_TIMEOUT_SECONDS 120
 #endif
 
+/**
+ * Message count in either direction after which a client rekeys its session
+ * (see uw_channel_encryption_start_rekey_), and past which the device turns
+ * requests away until it does.  Both only apply to clients that offer
+ * rekeying (UW_CRYPTO_MODE_FLAG_REKEY); others are served up to the hard limit
+ * of 2^24 - 1 messages per key, as before rekeying.  Well below that limit,
+ * so that a busy session never reaches it.
+ */
+#ifndef UW_SESSION_REKEY_THRESHOLD
+#define UW_SESSION_REKEY_THRESHOLD (1UL << 23)
+#endif
+
+/**
+ * How long a session resumption ticket stays redeemable after the full
+ * handshake that issued it, measured in device uptime.  0 disables the ticket
+ * crypto modes.
+ */
+#ifndef UW_SESSION_TICKET_LIFETIME_SECONDS
+#define UW_SESSION_TICKET_LIFETIME_SECONDS (60 * 60)
+#endif
+
 #endif  // LIBUWEAVE_INCLUDE_UWEAVE_CONFIG_H_
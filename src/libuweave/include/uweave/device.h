@@ -123,7 +123,10 @@ UwDeviceWorkState uw_device_handle_events(UwDevice* device);
  * managing the device's power mode. This call can be used from interrupt
  * handlers or provider code to signal the host application through the
  * UwDeviceNotifyWorkHandler in the UwDeviceHandlers struct specified in
- * uw_device_init.
+ * uw_device_init.  A call that interrupts uw_device_handle_events is not
+ * lost: if it skips the handler, that pass returns kUwDeviceWorkStateBusy.
+ * This holds on a single core; callers on other threads need their own
+ * locking.
  */
 void uw_device_notify_work(UwDevice* device);
 
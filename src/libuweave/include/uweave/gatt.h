@@ -52,7 +52,20 @@ typedef enum {
  */
 typedef uint16_t UwBleOpaqueConnectionHandle;
 
-/** Data for 1 MTU sized packet. */
+/**
+ * A pending provider event, less the packet bytes, which the transport reads
+ * separately into place (see uwp_ble_read_event).
+ */
+typedef struct {
+  UwBleEventType event_type;
+  UwBleOpaqueConnectionHandle connection_handle;
+  uint16_t data_length;  // Packet length, for data events
+} UwBleEventInfo;
+
+/**
+ * Data for 1 MTU sized packet.  The transport does not use these types itself;
+ * they are for providers that queue events.
+ */
 typedef struct {
   uint16_t data_length;
   uint8_t data[UW_BLE_PACKET_SIZE];
@@ -43,21 +43,59 @@ bool uwp_ble_create_service(const UwBleService* service,
                             UwBleTransport* transport);
 
 /**
- * If an event is pending, copies the data into the event pointer and returns
- * true.  Otherwise returns false.
+ * If an event is pending, describes it in event and returns true, without
+ * consuming it.  Otherwise returns false.  The transport may leave an event
+ * pending, e.g. a packet for a connection still busy with its last message,
+ * and peek at it again later.
  *
  * Each event includes an opaque connection_handle.  Over the lifetime of the
  * session, the uWeave library expects to read a sequence of a
  * kUwBleEventTypeConnected, kUwBleEventTypeData, kUwBleEventTypeDisconnected
  * events with the same connection_handle.
  */
-bool uwp_ble_read_event(UwBleEvent* packet);
+bool uwp_ble_peek_event(UwBleEventInfo* event);
 
-/** Returns true if you can write a BLE packet. */
+/**
+ * Consumes the event uwp_ble_peek_event() returned.  For a data event, copies
+ * the first byte of the packet, the Weave packet header, to header and the
+ * rest to payload, which holds payload_size bytes: the transport points it
+ * into its reassembly buffer, so that each packet is copied once.  Returns
+ * false, consuming nothing, if the rest does not fit.
+ *
+ * With a NULL header, the packet is discarded; other events have no bytes to
+ * copy.
+ */
+bool uwp_ble_read_event(uint8_t* header,
+                        uint8_t* payload,
+                        size_t payload_size);
+
+/**
+ * Returns true if you can write a BLE packet, i.e. the transmit window has
+ * room for another.  The transport writes packets back to back until this
+ * returns false.  If UW_BLE_PROVIDER_NOTIFIES_TX_COMPLETE is set, the provider
+ * must call uw_ble_transport_notify_tx_complete once it returns true again.
+ */
 bool uwp_ble_can_write_packet();
 
-/** Writes a data packet. */
-bool uwp_ble_write_packet(UwBleEvent* packet);
+/**
+ * Writes a data packet made of the one-byte header followed by payload_length
+ * bytes of payload.  The payload points into the transport's reply buffer, so
+ * the provider copies it straight to its transmit buffer or the radio.
+ */
+bool uwp_ble_write_packet(UwBleOpaqueConnectionHandle connection_handle,
+                          uint8_t header,
+                          const uint8_t* payload,
+                          size_t payload_length);
+
+/**
+ * Returns the largest packet that can be written to or received from the
+ * connection: the ATT MTU negotiated with the client less the 3-byte ATT
+ * header, or 20 if no MTU exchange has taken place.  The transport asks before
+ * each connection request, so an MTU exchange that completes after the link
+ * comes up is still used.
+ */
+uint16_t uwp_ble_get_max_packet_size(
+    UwBleOpaqueConnectionHandle connection_handle);
 
 /** Disconnects the session associated with the connection_handle. */
 void uwp_ble_disconnect(UwBleOpaqueConnectionHandle connection_handle);
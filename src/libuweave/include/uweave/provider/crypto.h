@@ -9,9 +9,12 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "uweave/config.h"
+
 #define UWP_CRYPTO_AES128_BLOCK_SIZE 16
 #define UWP_CRYPTO_SHA256_BLOCK_SIZE 64
 #define UWP_CRYPTO_SHA256_DIGEST_LEN 32
+#define UWP_CRYPTO_AES128_ROUND_KEY_WORDS 44
 
 /**
  * Initializes any global state for the crypto library at startup.  No other uw
@@ -30,6 +33,44 @@ bool uwp_crypto_aes128_ecb_encrypt(const uint8_t* key,
                                    const uint8_t* plaintext,
                                    uint8_t* ciphertext);
 
+/**
+ * An expanded AES-128 key schedule.  The layout of round_keys is defined by
+ * the provider and must only be filled in by uwp_crypto_aes128_key_init.
+ */
+typedef struct {
+  uint32_t round_keys[UWP_CRYPTO_AES128_ROUND_KEY_WORDS];
+} UwpCryptoAes128Key;
+
+/**
+ * Expands a 128-bit key into key_schedule so that it can be reused for any
+ * number of calls to uwp_crypto_aes128_encrypt_block.
+ */
+bool uwp_crypto_aes128_key_init(UwpCryptoAes128Key* key_schedule,
+                                const uint8_t* key);
+
+/**
+ * Encrypts a single 16-byte block with a key schedule previously set up by
+ * uwp_crypto_aes128_key_init.  Like uwp_crypto_aes128_ecb_encrypt, the
+ * plaintext and ciphertext pointers may point to the same block.
+ *
+ * All cipher state must live in the key schedule and the caller's buffers, so
+ * that several sessions (or an interrupt handler) can encrypt concurrently.
+ */
+bool uwp_crypto_aes128_encrypt_block(const UwpCryptoAes128Key* key_schedule,
+                                     const uint8_t* plaintext,
+                                     uint8_t* ciphertext);
+
+/**
+ * Encrypts num_blocks consecutive 16-byte blocks independently (ECB) with
+ * key_schedule.  Used to generate several CTR keystream blocks per call, so
+ * providers with pipelined or parallel AES should process the blocks
+ * together.  plaintext and ciphertext may be the same buffer.
+ */
+bool uwp_crypto_aes128_encrypt_blocks(const UwpCryptoAes128Key* key_schedule,
+                                      const uint8_t* plaintext,
+                                      uint8_t* ciphertext,
+                                      size_t num_blocks);
+
 typedef struct {
   uint8_t data[64];
   uint8_t datalen;
@@ -47,6 +88,31 @@ void uwp_crypto_sha256_update(UwpCryptoSha256State* state,
                               size_t data_len);
 void uwp_crypto_sha256_final(UwpCryptoSha256State* state, uint8_t* digest);
 
+/**
+ * Copies an in-progress hash so that both copies can be updated and finalized
+ * independently.  Used to resume from a saved midstate, e.g. the HMAC pads.
+ */
+void uwp_crypto_sha256_clone(const UwpCryptoSha256State* source,
+                             UwpCryptoSha256State* destination);
+
+#if UW_CRYPTO_PROVIDER_SHA256_LANES
+/**
+ * Feeds data[i] (data_len[i] bytes) into states[i] for each of num_lanes
+ * independent hashes, with the same result as uwp_crypto_sha256_update on each
+ * lane.  Providers with SIMD should compress the lanes side by side, which
+ * multiplies throughput on many short messages such as batched HMACs.
+ */
+void uwp_crypto_sha256_update_lanes(UwpCryptoSha256State* const states[],
+                                    const uint8_t* const data[],
+                                    const size_t data_len[],
+                                    size_t num_lanes);
+
+/** Finalizes num_lanes hashes as uwp_crypto_sha256_final does. */
+void uwp_crypto_sha256_final_lanes(UwpCryptoSha256State* const states[],
+                                   uint8_t* const digests[],
+                                   size_t num_lanes);
+#endif  // UW_CRYPTO_PROVIDER_SHA256_LANES
+
 /**
  * Sources random data suitable for cryptographic purposes. The provider
  * will write length bytes of random data into the buffer given and return true.
@@ -27,7 +27,10 @@ typedef enum {
   kUwStorageFileNameSettings = 0,
   kUwStorageFileNameKeys = 1,
   kUwStorageFileNameCounters = 2,
-  // File ids 3-99 are reserved for future uWeave use.  Application developers
+  // Cached SPAKE mask points for the embedded pairing code.  Losing it only
+  // costs a recomputation.
+  kUwStorageFileNameSpakeMasks = 3,
+  // File ids 4-99 are reserved for future uWeave use.  Application developers
   // that would like to share the same name-space can use ids starting at
   // VendorStart.
   kUwStorageFileNameVendorStart = 100,
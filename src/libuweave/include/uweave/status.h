@@ -21,7 +21,11 @@ typedef enum {
   kUwStatusTooLong = 3,
   kUwStatusInvalidArgument = 4,
   kUwStatusCommandNotFound = 5,
-  // 6-9 Reserved for future generic use.
+  // The operation is not finished; the caller should retry it later.
+  kUwStatusPending = 6,
+  // The call is over its rate limit; the caller should retry it later.
+  kUwStatusRateLimited = 7,
+  // 8-9 Reserved for future generic use.
 
   // Device Crypto/Auth errors.
   kUwStatusDeviceCryptoNoKeys = 10,
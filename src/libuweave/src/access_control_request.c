@@ -138,10 +138,9 @@ UwStatus uw_access_control_request_confirm_(UwDevice* device,
     // If we confirmed the token and committed it, but the client lost the
     // response, re-check the current token to see if it worked.  If not,
     // re-pairing is required.
-    if (!uw_macaroon_validate_(&client_access_token,
-                               device_crypto->client_authorization_key,
-                               sizeof(device_crypto->client_authorization_key),
-                               &macaroon_context, &validation_result)) {
+    if (!uw_macaroon_validate_with_hmac_key_(
+            &client_access_token, &device_crypto->client_authorization_hmac_key,
+            &macaroon_context, &validation_result)) {
       return UW_STATUS_AND_LOG_WARN(
           kUwStatusVerificationFailed,
           "Failed to verify committed client authz token\n");
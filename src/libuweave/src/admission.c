@@ -0,0 +1,105 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/admission.h"
+
+#include "src/log.h"
+#include "uweave/config.h"
+
+// Units of credit per call; see UwAdmissionBucket.
+#define CREDIT_PER_CALL 60
+
+typedef struct {
+  UwPrivetRequestApiId api_id;
+  uint32_t calls_per_minute;  // 0 for no limit
+  uint32_t burst;             // Calls admitted back to back
+  UwInternalCounter rejection_counter;
+} AdmissionPolicy_;
+
+static const AdmissionPolicy_ kPolicies[UW_ADMISSION_BUCKET_COUNT] = {
+    {kUwPrivetRequestApiIdPairingStart, UW_ADMISSION_PAIRING_START_PER_MINUTE,
+     UW_ADMISSION_PAIRING_START_BURST,
+     kUwInternalCounterAdmissionRejectedPairingStart},
+    {kUwPrivetRequestApiIdPairingConfirm,
+     UW_ADMISSION_PAIRING_CONFIRM_PER_MINUTE,
+     UW_ADMISSION_PAIRING_CONFIRM_BURST,
+     kUwInternalCounterAdmissionRejectedPairingConfirm},
+    {kUwPrivetRequestApiIdAuth, UW_ADMISSION_AUTH_PER_MINUTE,
+     UW_ADMISSION_AUTH_BURST, kUwInternalCounterAdmissionRejectedAuth},
+};
+
+static int find_policy_(UwPrivetRequestApiId api_id) {
+  for (int i = 0; i < UW_ADMISSION_BUCKET_COUNT; i++) {
+    if (kPolicies[i].api_id == api_id) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static uint32_t capacity_(const AdmissionPolicy_* policy, uint32_t scale) {
+  return policy->burst * CREDIT_PER_CALL * scale;
+}
+
+void uw_admission_init_(UwAdmission* admission, uint32_t scale, time_t uptime) {
+  admission->scale = scale;
+  for (int i = 0; i < UW_ADMISSION_BUCKET_COUNT; i++) {
+    admission->buckets[i] = (UwAdmissionBucket){
+        .credit = capacity_(&kPolicies[i], scale), .last_refill = uptime};
+  }
+}
+
+/** Refills the bucket for the whole seconds since the last call. */
+static void refill_(UwAdmissionBucket* bucket,
+                    const AdmissionPolicy_* policy,
+                    uint32_t scale,
+                    time_t uptime) {
+  if (uptime > bucket->last_refill) {
+    uint64_t elapsed = (uint64_t)(uptime - bucket->last_refill);
+    uint64_t credit =
+        bucket->credit + elapsed * policy->calls_per_minute * scale;
+    uint32_t capacity = capacity_(policy, scale);
+    bucket->credit = credit < capacity ? (uint32_t)credit : capacity;
+  }
+  bucket->last_refill = uptime;
+}
+
+UwStatus uw_admission_acquire_(UwAdmission* connection_admission,
+                               UwAdmission* device_admission,
+                               UwPrivetRequestApiId api_id,
+                               time_t uptime) {
+  int index = find_policy_(api_id);
+  if (index < 0 || kPolicies[index].calls_per_minute == 0) {
+    return kUwStatusSuccess;
+  }
+  const AdmissionPolicy_* policy = &kPolicies[index];
+  UwAdmission* admissions[2];
+  size_t admission_count = 0;
+  if (connection_admission != NULL) {
+    admissions[admission_count++] = connection_admission;
+  }
+  if (device_admission != NULL) {
+    admissions[admission_count++] = device_admission;
+  }
+
+  for (size_t i = 0; i < admission_count; i++) {
+    UwAdmissionBucket* bucket = &admissions[i]->buckets[index];
+    refill_(bucket, policy, admissions[i]->scale, uptime);
+    if (bucket->credit < CREDIT_PER_CALL) {
+      return UW_STATUS_AND_LOG_WARN(kUwStatusRateLimited,
+                                    "Rate limited api %d\n", api_id);
+    }
+  }
+  for (size_t i = 0; i < admission_count; i++) {
+    admissions[i]->buckets[index].credit -= CREDIT_PER_CALL;
+  }
+  return kUwStatusSuccess;
+}
+
+UwInternalCounter uw_admission_get_rejection_counter_(
+    UwPrivetRequestApiId api_id) {
+  int index = find_policy_(api_id);
+  return index < 0 ? kUwInternalCounterLast
+                   : kPolicies[index].rejection_counter;
+}
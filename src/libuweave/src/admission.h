@@ -0,0 +1,60 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_SRC_ADMISSION_H_
+#define LIBUWEAVE_SRC_ADMISSION_H_
+
+#include <stdint.h>
+#include <time.h>
+
+#include "src/counters.h"
+#include "src/privet_request.h"
+#include "uweave/status.h"
+
+/** Number of rate limited APIs: /pairing/start, /pairing/confirm and /auth. */
+#define UW_ADMISSION_BUCKET_COUNT 3
+
+/**
+ * A token bucket.  credit is kept in sixtieths of a call, so that a rate given
+ * in calls per minute refills a whole number of units every second.
+ */
+typedef struct {
+  uint32_t credit;
+  time_t last_refill;  // Uptime in seconds
+} UwAdmissionBucket;
+
+/**
+ * Admission control for the Privet APIs that run expensive crypto (P-224
+ * multiplications, macaroon HMAC chains), so that a client looping on them
+ * cannot starve other requests.  Rates are set per API in uweave/config.h.
+ *
+ * Each connection has its own set of buckets, so a noisy client only uses up
+ * its own calls.  A device-wide set with larger buckets, charged on top, caps
+ * the calls of all connections together; see UW_ADMISSION_DEVICE_WIDE_SCALE.
+ */
+typedef struct UwAdmission_ {
+  UwAdmissionBucket buckets[UW_ADMISSION_BUCKET_COUNT];
+  uint32_t scale;  // Multiplies the burst and rate of every API
+} UwAdmission;
+
+/** Starts every bucket full, with scale times the configured limits. */
+void uw_admission_init_(UwAdmission* admission, uint32_t scale, time_t uptime);
+
+/**
+ * Takes one call from the bucket of api_id in the connection's set and, if
+ * device_admission is not NULL, in the device-wide set.  Returns
+ * kUwStatusSuccess, or kUwStatusRateLimited, taking nothing, if either bucket
+ * is empty.  APIs without a limit, and a NULL connection_admission with a NULL
+ * device_admission, are always admitted.
+ */
+UwStatus uw_admission_acquire_(UwAdmission* connection_admission,
+                               UwAdmission* device_admission,
+                               UwPrivetRequestApiId api_id,
+                               time_t uptime);
+
+/** The counter incremented when a call to api_id is rejected. */
+UwInternalCounter uw_admission_get_rejection_counter_(
+    UwPrivetRequestApiId api_id);
+
+#endif  // LIBUWEAVE_SRC_ADMISSION_H_
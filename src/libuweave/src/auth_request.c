@@ -17,8 +17,8 @@
 
 static UwStatus validate_macaroon_(
     const UwValue* auth_code,
-    const uint8_t* key,
-    size_t key_len,
+    const UwCryptoHmacKey* key,
+    UwMacaroonCache* cache,
     const uint8_t* ble_session_id,
     size_t ble_session_id_len,
     UwMacaroonValidationResult* validation_result) {
@@ -40,8 +40,8 @@ static UwStatus validate_macaroon_(
                                   "Macaroon context creation failed\n");
   }
 
-  if (!uw_macaroon_validate_(&macaroon, key, key_len, &macaroon_context,
-                             validation_result)) {
+  if (!uw_macaroon_validate_with_cache_(&macaroon, key, cache,
+                                        &macaroon_context, validation_result)) {
     // TODO(jmccullough): Promote to more specific error.
     return UW_STATUS_AND_LOG_WARN(kUwStatusVerificationFailed,
                                   "Macaroon validation failed\n");
@@ -119,10 +119,9 @@ UwStatus uw_auth_request_handler_(UwDevice* device,
       }
       UwMacaroonValidationResult validation_result = {};
       UwStatus validation_status = validate_macaroon_(
-          &auth_code, device->device_crypto.ephemeral_pairing_key,
-          sizeof(device->device_crypto.ephemeral_pairing_key),
-          NULL /* ble_session_id */, 0 /* ble_session_id_len */,
-          &validation_result);
+          &auth_code, &device->device_crypto.ephemeral_pairing_hmac_key,
+          &device->device_crypto.macaroon_cache, NULL /* ble_session_id */,
+          0 /* ble_session_id_len */, &validation_result);
       if (!uw_status_is_success(validation_status)) {
         return UW_STATUS_AND_LOG_WARN(validation_status,
                                       "Failed to auth with pairing token\n");
@@ -138,8 +137,8 @@ UwStatus uw_auth_request_handler_(UwDevice* device,
       uw_device_increment_uw_counter_(device, kUwInternalCounterAuthToken);
       UwMacaroonValidationResult validation_result = {};
       UwStatus validation_status = validate_macaroon_(
-          &auth_code, device->device_crypto.client_authorization_key,
-          sizeof(device->device_crypto.client_authorization_key),
+          &auth_code, &device->device_crypto.client_authorization_hmac_key,
+          &device->device_crypto.macaroon_cache,
           uw_channel_encryption_session_id_(&(session->crypto_state)),
           UW_BLE_SESSION_ID_LEN, &validation_result);
       if (!uw_status_is_success(validation_status)) {
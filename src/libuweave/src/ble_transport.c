@@ -6,6 +6,7 @@
 
 #include <string.h>
 
+#include "src/admission.h"
 #include "src/ble_advertising.h"
 #include "src/counters.h"
 #include "src/device_channel.h"
@@ -23,18 +24,23 @@
 #include "uweave/provider/ble.h"
 #include "uweave/status.h"
 
-static const uint16_t kUwCharacteristicSize = 20;
+static const uint16_t kUwCharacteristicSize = UW_BLE_PACKET_SIZE;
+
+// Packet size every BLE link supports, from the default ATT MTU of 23.
+static const size_t kUwMinPacketSize = 20;
 
 typedef enum {
   kUwBleTransportStateDisconnected = 0,
   kUwBleTransportStateConnected,
 } UwBleTransportState;
 
-struct UwBleTransport_ {
-  UwService service;
-  UwDevice* device;
+/** One slot of the connection pool, with its own session and channel. */
+typedef struct {
+  UwBleTransport* transport;
 
   UwSession session;
+  // Rate limits of the client on this connection, reset when it connects.
+  UwAdmission admission;
 
   UwBleTransportState connection_state;
   UwBleOpaqueConnectionHandle opaque_connection_handle;
@@ -47,6 +53,20 @@ struct UwBleTransport_ {
   uint8_t write_data[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
   UwBuffer read_buffer;
   UwBuffer write_buffer;
+#if UW_BLE_TRANSPORT_DOUBLE_BUFFER_REQUESTS
+  // Takes the next request while read_data holds one.
+  uint8_t next_read_data[UW_BLE_TRANSPORT_REQUEST_BUFFER_SIZE];
+  UwBuffer next_read_buffer;
+#endif
+} UwBleConnection;
+
+struct UwBleTransport_ {
+  UwService service;
+  UwDevice* device;
+
+  UwBleConnection connections[UW_BLE_MAX_CONNECTIONS];
+  // The connection serviced first on the next pass, rotated for fairness.
+  size_t next_connection;
 };
 
 static bool handshake_exchange_handler_(void* data,
@@ -62,31 +82,49 @@ static bool service_event_handler_();
 static bool create_service_(UwBleTransport* transport);
 static bool start_advertising_();
 
-bool uw_ble_transport_init(UwBleTransport* transport, UwDevice* device) {
-  assert(transport != NULL && device != NULL);
-
-  memset(transport, 0, sizeof(UwBleTransport));
-  transport->device = device;
+static void connection_init_(UwBleConnection* connection,
+                             UwBleTransport* transport) {
+  connection->transport = transport;
 
   // Inbound packets will be assembled into a message in this buffer.
-  uw_buffer_init(&transport->read_buffer, transport->read_data,
-                 sizeof(transport->read_data));
+  uw_buffer_init(&connection->read_buffer, connection->read_data,
+                 sizeof(connection->read_data));
 
   // Outbound packets will come from the message stored in this buffer.
-  uw_buffer_init(&transport->write_buffer, transport->write_data,
-                 sizeof(transport->write_data));
+  uw_buffer_init(&connection->write_buffer, connection->write_data,
+                 sizeof(connection->write_data));
 
-  uw_session_init_(&transport->session, device);
+  uw_session_init_(&connection->session, transport->device);
+  connection->session.admission = &connection->admission;
 
   // The connection request can negotiate message size smaller than
   // UW_BLE_PACKET_SIZE, but never larger.
   uw_device_channel_init_(
-      &transport->device_channel,
+      &connection->device_channel,
       (UwDeviceChannelHandshakeConfig){.handler = handshake_exchange_handler_,
-                                       .data = (void*)transport},
+                                       .data = (void*)connection},
       (UwDeviceChannelConnectionResetConfig){
-          .handler = connection_reset_handler_, .data = (void*)transport},
-      &transport->read_buffer, &transport->write_buffer, UW_BLE_PACKET_SIZE);
+          .handler = connection_reset_handler_, .data = (void*)connection},
+      &connection->read_buffer, &connection->write_buffer, UW_BLE_PACKET_SIZE);
+
+#if UW_BLE_TRANSPORT_DOUBLE_BUFFER_REQUESTS
+  uw_buffer_init(&connection->next_read_buffer, connection->next_read_data,
+                 sizeof(connection->next_read_data));
+  uw_channel_set_next_message_in_buffer_(
+      uw_device_channel_get_channel_(&connection->device_channel),
+      &connection->next_read_buffer);
+#endif
+}
+
+bool uw_ble_transport_init(UwBleTransport* transport, UwDevice* device) {
+  assert(transport != NULL && device != NULL);
+
+  memset(transport, 0, sizeof(UwBleTransport));
+  transport->device = device;
+
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    connection_init_(&transport->connections[i], transport);
+  }
 
   uw_service_init_(&transport->service, service_start_handler_,
                    service_event_handler_, service_stop_handler_, transport);
@@ -106,29 +144,32 @@ void uw_ble_transport_notify_work(UwBleTransport* ble_transport) {
 }
 
 void uw_ble_transport_notify_activity(UwBleTransport* ble_transport) {
-  ble_transport->last_activity_time = uw_time_get_uptime_seconds_();
+  time_t now = uw_time_get_uptime_seconds_();
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    ble_transport->connections[i].last_activity_time = now;
+  }
 }
 
-size_t uw_ble_transport_sizeof() {
-  return sizeof(UwBleTransport);
+void uw_ble_transport_notify_tx_complete(UwBleTransport* ble_transport) {
+  // The next pass fills the window again.
+  uw_ble_transport_notify_work(ble_transport);
 }
 
-UwSession* uw_ble_transport_get_session_(UwBleTransport* ble_transport) {
-  return &ble_transport->session;
+size_t uw_ble_transport_sizeof() {
+  return sizeof(UwBleTransport);
 }
 
 static bool handshake_exchange_handler_(void* data,
                                         UwBuffer* request,
                                         UwBuffer* reply) {
-  UwBleTransport* ble_transport = (UwBleTransport*)data;
-  return uw_session_handshake_exchange_(&ble_transport->session, request,
-                                        reply);
+  UwBleConnection* connection = (UwBleConnection*)data;
+  return uw_session_handshake_exchange_(&connection->session, request, reply);
 }
 
 static bool connection_reset_handler_(void* data) {
-  UwBleTransport* ble_transport = (UwBleTransport*)data;
+  UwBleConnection* connection = (UwBleConnection*)data;
   // Clear the data in the session.
-  uw_session_start_valid_(uw_ble_transport_get_session_(ble_transport));
+  uw_session_start_valid_(&connection->session);
   return true;
 }
 
@@ -144,34 +185,88 @@ static bool service_stop_handler_(UwBleTransport* transport) {
   return true;
 }
 
-static void connect_(UwBleTransport* transport,
+/**
+ * Limits the channel to the packet size of the link, until the connection
+ * request settles it for the session.
+ */
+static void update_max_packet_size_(UwBleConnection* connection) {
+  size_t packet_size =
+      uwp_ble_get_max_packet_size(connection->opaque_connection_handle);
+  if (packet_size < kUwMinPacketSize) {
+    packet_size = kUwMinPacketSize;
+  } else if (packet_size > UW_BLE_PACKET_SIZE) {
+    packet_size = UW_BLE_PACKET_SIZE;
+  }
+  uw_channel_set_max_packet_size_(
+      uw_device_channel_get_channel_(&connection->device_channel),
+      packet_size);
+}
+
+static void connect_(UwBleConnection* connection,
                      UwBleOpaqueConnectionHandle connection_handle) {
-  uw_session_start_valid_(&transport->session);
-  transport->opaque_connection_handle = connection_handle;
-  transport->connection_state = kUwBleTransportStateConnected;
-  uw_trace_ble_event(transport->device, kUwTraceBleEventConnect, 0);
-  uw_device_increment_uw_counter_(transport->device,
-                                  kUwInternalCounterBleConnect);
+  UwDevice* device = connection->transport->device;
+  uw_session_start_valid_(&connection->session);
+  uw_admission_init_(&connection->admission, /* scale */ 1,
+                     uw_time_get_uptime_seconds_());
+  connection->opaque_connection_handle = connection_handle;
+  connection->connection_state = kUwBleTransportStateConnected;
+  connection->last_activity_time = uw_time_get_uptime_seconds_();
+  uw_trace_ble_event(device, kUwTraceBleEventConnect, 0);
+  uw_device_increment_uw_counter_(device, kUwInternalCounterBleConnect);
 }
 
-static void disconnect_(UwBleTransport* transport) {
+static void disconnect_(UwBleConnection* connection) {
+  UwDevice* device = connection->transport->device;
   bool is_connected =
-      (transport->connection_state == kUwBleTransportStateConnected);
+      (connection->connection_state == kUwBleTransportStateConnected);
 
   if (is_connected) {
-    uwp_ble_disconnect(transport->opaque_connection_handle);
+    uwp_ble_disconnect(connection->opaque_connection_handle);
   }
 
-  uw_trace_ble_event(transport->device, kUwTraceBleEventDisconnect,
-                     is_connected);
-  uw_device_increment_uw_counter_(transport->device,
-                                  kUwInternalCounterBleDisconnect);
+  uw_trace_ble_event(device, kUwTraceBleEventDisconnect, is_connected);
+  uw_device_increment_uw_counter_(device, kUwInternalCounterBleDisconnect);
 
-  uw_device_channel_reset_(&transport->device_channel);
+  uw_device_channel_reset_(&connection->device_channel);
   // uw_session_invalidate must follow uw_device_channel reset because
   // device_channel_reset starts a valid session.
-  uw_session_invalidate_(&transport->session);
-  transport->connection_state = kUwBleTransportStateDisconnected;
+  uw_session_invalidate_(&connection->session);
+  connection->connection_state = kUwBleTransportStateDisconnected;
+}
+
+/** Turns away a connection when every slot of the pool is in use. */
+static void refuse_connection_(UwBleTransport* transport,
+                               UwBleOpaqueConnectionHandle connection_handle) {
+  UW_LOG_WARN("Refusing connection %d, all %d slots in use\n",
+              connection_handle, UW_BLE_MAX_CONNECTIONS);
+  uwp_ble_disconnect(connection_handle);
+  uw_trace_ble_event(transport->device, kUwTraceBleEventConnectRefused, 0);
+  uw_device_increment_uw_counter_(transport->device,
+                                  kUwInternalCounterBleConnectRefused);
+}
+
+/** Returns the live connection with the given handle, or NULL. */
+static UwBleConnection* find_connection_(
+    UwBleTransport* transport,
+    UwBleOpaqueConnectionHandle connection_handle) {
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    UwBleConnection* connection = &transport->connections[i];
+    if (connection->connection_state == kUwBleTransportStateConnected &&
+        connection->opaque_connection_handle == connection_handle) {
+      return connection;
+    }
+  }
+  return NULL;
+}
+
+static UwBleConnection* find_free_connection_(UwBleTransport* transport) {
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    UwBleConnection* connection = &transport->connections[i];
+    if (connection->connection_state == kUwBleTransportStateDisconnected) {
+      return connection;
+    }
+  }
+  return NULL;
 }
 
 typedef enum {
@@ -192,23 +287,23 @@ typedef enum {
  * Returns kHandlerStateError on error if the value should be reset.
  */
 static HandlerState try_to_send_packet_(UwChannel* channel,
-                                        UwBleTransport* transport) {
+                                        UwBleConnection* connection) {
   if (!uwp_ble_can_write_packet()) {
     return kHandlerStateWait;
   }
 
-  UwBleEvent event = {};
-  UwBuffer packet_buffer;
-  uw_buffer_init(&packet_buffer, event.packet.data, sizeof(event.packet.data));
-  if (!uw_channel_get_next_packet_out_(channel, &packet_buffer)) {
+  uint8_t packet_header = 0;
+  const uint8_t* data_bytes = NULL;
+  size_t data_length = 0;
+  if (!uw_channel_take_next_packet_out_(channel, &packet_header, &data_bytes,
+                                        &data_length)) {
     UW_LOG_WARN("Failed to get next packet\n");
     return kHandlerStateError;
   }
 
-  // Send next packet.
-  event.packet.data_length = uw_buffer_get_length(&packet_buffer);
-  event.connection_handle = transport->opaque_connection_handle;
-  if (!uwp_ble_write_packet(&event)) {
+  // Send next packet, straight from the reply buffer.
+  if (!uwp_ble_write_packet(connection->opaque_connection_handle,
+                            packet_header, data_bytes, data_length)) {
     UW_LOG_WARN("Failed to write packet\n");
     return kHandlerStateError;
   }
@@ -218,24 +313,23 @@ static HandlerState try_to_send_packet_(UwChannel* channel,
                                             : kHandlerStateComplete;
 }
 
-static void handle_message_exchange_(UwBleTransport* ble_transport) {
-  UwChannel* channel =
-      uw_device_channel_get_channel_(&ble_transport->device_channel);
-  UwMessageIn* message_in = uw_channel_get_message_in_(channel);
-  UwBuffer* buffer_in = uw_message_in_get_buffer_(message_in);
+/**
+ * Queues the reply of a finished exchange, or disconnects on failure.  Leaves
+ * message_out untouched while the handler is still pending.
+ */
+static void finish_message_exchange_(UwBleConnection* connection,
+                                     UwStatus status,
+                                     UwMessageOut* message_out) {
+  if (status == kUwStatusPending) {
+    return;
+  }
 
-  UwMessageOut* message_out = uw_channel_get_message_out_(channel);
   UwBuffer* buffer_out = uw_message_out_get_buffer_(message_out);
 
-  uw_message_out_start_(message_out, kUwMessageTypeData);
-
-  UwStatus status = uw_session_message_exchange_(&ble_transport->session,
-                                                 buffer_in, buffer_out);
-
   if (!uw_status_is_success(status)) {
     UW_LOG_ERROR("Error exchanging message: %d. Disconnecting.\n",
                  status);
-    disconnect_(ble_transport);
+    disconnect_(connection);
     return;
   }
 
@@ -249,169 +343,269 @@ static void handle_message_exchange_(UwBleTransport* ble_transport) {
   uw_message_out_ready_(message_out);
 }
 
+static void handle_message_exchange_(UwBleConnection* connection) {
+  UwChannel* channel =
+      uw_device_channel_get_channel_(&connection->device_channel);
+  UwMessageIn* message_in = uw_channel_get_message_in_(channel);
+  UwBuffer* buffer_in = uw_message_in_get_buffer_(message_in);
+
+  UwMessageOut* message_out = uw_channel_get_message_out_(channel);
+  UwBuffer* buffer_out = uw_message_out_get_buffer_(message_out);
+
+  uw_message_out_start_(message_out, kUwMessageTypeData);
+
+  UwStatus status = uw_session_message_exchange_(&connection->session,
+                                                 buffer_in, buffer_out);
+  finish_message_exchange_(connection, status, message_out);
+}
+
 /**
- * Attempts to read an event from the provider.
+ * Handles the complete requests in message_in, oldest first, while the reply
+ * buffer is free.  A request is released as soon as its reply is ready, so
+ * that the next one can be reassembled while the reply is sent; replies still
+ * go out in order, one at a time.
  *
- * Returns kHandlerStateInProgress if a packet was read.
- * Returns kHandlerStateWait if we should sleep until a new packet notification.
- * Returns kHandlerStateComplete if all processing for this operation has
- * completed and the channel can be reset.
- * Returns kHandlerStateDisconnect if a disconnect event was observed.
- * Returns kHandlerStateError on error if the connection should be reset.
+ * Returns false on error if the connection should be reset.
  */
-static HandlerState try_to_read_event_(UwDeviceChannel* device_channel,
-                                       UwBleTransport* transport) {
+static bool start_exchanges_(UwBleConnection* connection) {
+  UwDeviceChannel* device_channel = &connection->device_channel;
   UwChannel* channel = uw_device_channel_get_channel_(device_channel);
-  UwBleEvent event = {};
-  // Read events until we are connected and have data to pass on.
-  while (true) {
-    if (!uwp_ble_read_event(&event)) {
-      return kHandlerStateWait;
-    }
-    if (transport->connection_state == kUwBleTransportStateDisconnected) {
-      if (event.event_type != kUwBleEventTypeConnection) {
-        // Skip packets until a connection starts.
-        UW_LOG_WARN("Dropping packet while in disconnected state\n");
-        uw_trace_ble_event(transport->device, kUwTraceBleEventDisconnectDrop,
-                           0);
-        continue;
+
+  while (!connection->session.exchange_pending &&
+         uw_channel_get_in_state_(channel) == kUwMessageStateComplete) {
+    // The channel handles control messages as they complete, so only data
+    // messages are left to exchange.
+    if (uw_message_in_get_type_(uw_channel_get_message_in_(channel)) ==
+        kUwMessageTypeData) {
+      if (uw_channel_get_out_state_(channel) != kUwMessageStateEmpty) {
+        // Wait for the previous reply to go out.
+        return true;
       }
-      connect_(transport, event.connection_handle);
-    } else if (transport->connection_state == kUwBleTransportStateConnected) {
-      if (event.event_type == kUwBleEventTypeData) {
-        if (event.connection_handle != transport->opaque_connection_handle) {
-          UW_LOG_WARN("Dropping packet with mismatched handle [%d != %d]\n",
-                      event.connection_handle,
-                      transport->opaque_connection_handle);
-          continue;
-        }
-        // Continue to the handler.
-        break;
-      } else if (event.event_type == kUwBleEventTypeDisconnection) {
-        return kHandlerStateDisconnect;
-      } else {
-        return kHandlerStateError;
+      handle_message_exchange_(connection);
+      if (connection->connection_state != kUwBleTransportStateConnected ||
+          connection->session.exchange_pending) {
+        return true;
       }
     }
+    if (!uw_device_channel_release_request_(device_channel)) {
+      return false;
+    }
   }
+  return true;
+}
 
-  if (uw_channel_get_in_state_(channel) == kUwMessageStateEmpty) {
-    transport->opaque_connection_handle = event.connection_handle;
-  } else if (transport->opaque_connection_handle != event.connection_handle) {
-    UW_LOG_WARN("Unexpected session handle %d\n", event.connection_handle);
-    return kHandlerStateWait;
+/**
+ * Gives a pending handler (e.g. a pairing request computing its SPAKE result)
+ * another slice of work.  Once it finishes, the reply is sent like any other.
+ */
+static void resume_message_exchange_(UwBleConnection* connection) {
+  UwDeviceChannel* device_channel = &connection->device_channel;
+  UwChannel* channel = uw_device_channel_get_channel_(device_channel);
+  UwMessageIn* message_in = uw_channel_get_message_in_(channel);
+  UwBuffer* buffer_in = uw_message_in_get_buffer_(message_in);
+
+  UwMessageOut* message_out = uw_channel_get_message_out_(channel);
+  UwBuffer* buffer_out = uw_message_out_get_buffer_(message_out);
+
+  UwStatus status = uw_session_resume_exchange_(&connection->session,
+                                                buffer_in, buffer_out);
+  finish_message_exchange_(connection, status, message_out);
+
+  if (connection->connection_state == kUwBleTransportStateConnected &&
+      !connection->session.exchange_pending &&
+      (!uw_device_channel_release_request_(device_channel) ||
+       !start_exchanges_(connection))) {
+    disconnect_(connection);
   }
+}
 
-  UwBuffer packet_buffer;
-  uw_buffer_init(&packet_buffer, event.packet.data, sizeof(event.packet.data));
-  uw_buffer_set_length_(&packet_buffer, event.packet.data_length);
+/**
+ * Reads a data packet from the provider into the connection's inbound message,
+ * in place, and handles the message if that completes it.
+ *
+ * Returns false on error if the connection should be reset.
+ */
+static bool receive_packet_(UwBleConnection* connection,
+                            const UwBleEventInfo* event) {
+  UwChannel* channel =
+      uw_device_channel_get_channel_(&connection->device_channel);
+
+  uint8_t packet_header = 0;
+  uint8_t* cursor =
+      uw_channel_get_packet_in_cursor_(channel, event->data_length);
+  if (cursor == NULL) {
+    UW_LOG_WARN("No room for a packet of %d bytes\n", event->data_length);
+    uwp_ble_read_event(NULL, NULL, 0);
+    return false;
+  }
+  if (!uwp_ble_read_event(&packet_header, cursor, event->data_length - 1) ||
+      !uw_channel_commit_packet_in_(channel, packet_header,
+                                    event->data_length - 1)) {
+    return false;
+  }
 
-  if (!uw_channel_append_packet_in_(channel, &packet_buffer)) {
-    return kHandlerStateError;
+  return start_exchanges_(connection);
+}
+
+/**
+ * Consumes the pending provider event and routes it to the connection it
+ * belongs to.
+ *
+ * Returns false, leaving the event pending, if it is a data packet for a
+ * connection whose request buffers are all holding complete requests.  The
+ * provider has a single event queue, so reading stops until that connection
+ * can take the packet.
+ */
+static bool dispatch_event_(UwBleTransport* transport,
+                            const UwBleEventInfo* event) {
+  UwBleConnection* connection =
+      find_connection_(transport, event->connection_handle);
+
+  if (event->event_type != kUwBleEventTypeData) {
+    uwp_ble_read_event(NULL, NULL, 0);
   }
 
-  UwMessageState in_state = uw_channel_get_in_state_(channel);
-  if (in_state == kUwMessageStateError) {
-    return kHandlerStateError;
+  if (event->event_type == kUwBleEventTypeConnection) {
+    if (connection != NULL) {
+      UW_LOG_WARN("Connection event for live handle %d\n",
+                  event->connection_handle);
+      disconnect_(connection);
+      return true;
+    }
+    connection = find_free_connection_(transport);
+    if (connection == NULL) {
+      refuse_connection_(transport, event->connection_handle);
+      return true;
+    }
+    connect_(connection, event->connection_handle);
+    return true;
   }
 
-  if (in_state == kUwMessageStateBusy) {
-    return kHandlerStateInProgress;
+  if (connection == NULL) {
+    if (event->event_type == kUwBleEventTypeData) {
+      // Skip packets until a connection starts.
+      uwp_ble_read_event(NULL, NULL, 0);
+    }
+    UW_LOG_WARN("Dropping packet for unconnected handle %d\n",
+                event->connection_handle);
+    uw_trace_ble_event(transport->device, kUwTraceBleEventDisconnectDrop, 0);
+    return true;
   }
 
-  if (in_state == kUwMessageStateComplete &&
-      uw_message_in_get_type_(&channel->message_in) == kUwMessageTypeData) {
-    handle_message_exchange_(transport);
+  if (event->event_type != kUwBleEventTypeData) {
+    if (event->event_type != kUwBleEventTypeDisconnection) {
+      UW_LOG_WARN("Unexpected event type %d\n", event->event_type);
+    }
+    disconnect_(connection);
+    return true;
   }
 
-  UwMessageState out_state = uw_channel_get_out_state_(channel);
-  if (out_state == kUwMessageStateBusy) {
-    // There's a pending reply.
-    return kHandlerStateInProgress;
+  UwDeviceChannel* device_channel = &connection->device_channel;
+  if (!uw_channel_can_append_packet_in_(
+          uw_device_channel_get_channel_(device_channel))) {
+    return false;
   }
 
-  return kHandlerStateComplete;
+  connection->last_activity_time = uw_time_get_uptime_seconds_();
+  if (!uw_device_channel_is_connected(device_channel)) {
+    // This packet carries the connection request.
+    update_max_packet_size_(connection);
+  }
+  if (!receive_packet_(connection, event) &&
+      connection->connection_state == kUwBleTransportStateConnected) {
+    UW_LOG_WARN("Disconnecting\n");
+    disconnect_(connection);
+  }
+  return true;
 }
 
-static time_t idle_time_(UwBleTransport* ble_transport) {
-  return uw_time_get_uptime_seconds_() - ble_transport->last_activity_time;
+/**
+ * Reads and routes a bounded number of provider events, about one per
+ * connection, so that replies keep going out while packets arrive.
+ *
+ * Returns true if an event was handled and more may be waiting.
+ */
+static bool read_events_(UwBleTransport* transport) {
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    UwBleEventInfo event = {};
+    if (!uwp_ble_peek_event(&event) || !dispatch_event_(transport, &event)) {
+      return i > 0;
+    }
+  }
+  return true;
 }
 
-static bool service_event_handler_(UwBleTransport* transport) {
-  UwDeviceChannel* device_channel = &transport->device_channel;
-  UwChannel* channel = uw_device_channel_get_channel_(device_channel);
+static time_t idle_time_(UwBleConnection* connection) {
+  return uw_time_get_uptime_seconds_() - connection->last_activity_time;
+}
 
-  UwMessageState out_state = uw_channel_get_out_state_(channel);
-  UwMessageState in_state = uw_channel_get_in_state_(channel);
+/**
+ * Advances one connection by a step: its idle timeout, a slice of a pending
+ * handler, or as much of its reply as the transmit window takes.
+ *
+ * Returns true if the connection has more work to do right away.
+ */
+static bool service_connection_(UwBleConnection* connection) {
+  if (connection->connection_state != kUwBleTransportStateConnected) {
+    return false;
+  }
 
-  if (transport->connection_state == kUwBleTransportStateConnected) {
-    time_t timeout = uw_device_is_setup(transport->device)
-                         ? UW_IDLE_TIMEOUT_SECONDS
-                         : UW_UNCONFIGURED_IDLE_TIMEOUT_SECONDS;
-    if (idle_time_(transport) > timeout) {
-      UW_LOG_WARN("Disconnecting after idle timeout\n");
-      disconnect_(transport);
-      return false;
-    }
+  UwDeviceChannel* device_channel = &connection->device_channel;
+  UwChannel* channel = uw_device_channel_get_channel_(device_channel);
+
+  time_t timeout = uw_device_is_setup(connection->transport->device)
+                       ? UW_IDLE_TIMEOUT_SECONDS
+                       : UW_UNCONFIGURED_IDLE_TIMEOUT_SECONDS;
+  if (idle_time_(connection) > timeout) {
+    UW_LOG_WARN("Disconnecting handle %d after idle timeout\n",
+                connection->opaque_connection_handle);
+    disconnect_(connection);
+    return false;
   }
 
-  if (in_state != kUwMessageStateComplete) {
-    // If the reply is not in progress, the read channel is either empty or
-    // reading.
-    switch (try_to_read_event_(device_channel, transport)) {
-      case kHandlerStateComplete: {
-        // If the read completes the command, then we clear the channel for the
-        // next command.
-        uw_device_channel_complete_exchange_(device_channel);
-        break;
-      }
-      case kHandlerStateInProgress: {
-        break;
-      }
-      case kHandlerStateWait: {
-        // Wait for new packets if we aren't complete.
-        return false;
-      }
-      case kHandlerStateDisconnect:
-      // Fallthrough intended.
-      case kHandlerStateError: {
-        UW_LOG_WARN("Disconnecting\n");
-        disconnect_(transport);
-        break;
-      }
-    }
-    in_state = uw_channel_get_in_state_(channel);
-    out_state = uw_channel_get_out_state_(channel);
+  if (connection->session.exchange_pending) {
+    resume_message_exchange_(connection);
+    return true;
   }
 
-  // If either channel is in an error state, or there is no reply available,
-  // reset the channel and check for more work.
-  if (in_state == kUwMessageStateError || out_state == kUwMessageStateError ||
-      (in_state == kUwMessageStateComplete &&
-       out_state == kUwMessageStateEmpty)) {
+  UwMessageState out_state = uw_channel_get_out_state_(channel);
+  UwMessageState in_state = uw_channel_get_in_state_(channel);
+
+  // If either channel is in an error state, reset the channel and check for
+  // more work.
+  if (in_state == kUwMessageStateError || out_state == kUwMessageStateError) {
     uw_device_channel_reset_(device_channel);
     // Check for immediately available work.
     return true;
   }
 
-  if (in_state == kUwMessageStateComplete && out_state == kUwMessageStateBusy) {
-    switch (try_to_send_packet_(channel, transport)) {
+  if (out_state == kUwMessageStateBusy) {
+    // Send back to back while the window is open, so a multi-packet reply
+    // can go out within one connection event.
+    HandlerState send_state;
+    do {
+      send_state = try_to_send_packet_(channel, connection);
+    } while (send_state == kHandlerStateInProgress);
+
+    switch (send_state) {
       case kHandlerStateComplete: {
-        uw_device_channel_complete_exchange_(device_channel);
-        break;
-      }
-      case kHandlerStateInProgress: {
+        // A request that came in meanwhile can have the reply buffer now.
+        uw_device_channel_complete_reply_(device_channel);
+        if (!start_exchanges_(connection)) {
+          disconnect_(connection);
+        }
         break;
       }
       case kHandlerStateWait: {
-        // TODO(jmccullough): Do we get notify signal on packet-sent?  Could
-        // sleep in between.
-        break;
+        // With tx-complete notifications, sleep until the window reopens.
+        return !UW_BLE_PROVIDER_NOTIFIES_TX_COMPLETE;
       }
+      case kHandlerStateInProgress:
+      // Fall through intended.
       case kHandlerStateDisconnect:
       // Fall through intended.
       case kHandlerStateError: {
-        disconnect_(transport);
+        disconnect_(connection);
         break;
       }
     }
@@ -419,8 +613,23 @@ static bool service_event_handler_(UwBleTransport* transport) {
     return true;
   }
 
-  // More work to do.
-  return true;
+  // Waiting for packets from the client.
+  return false;
+}
+
+static bool service_event_handler_(UwBleTransport* transport) {
+  bool work_remaining = read_events_(transport);
+
+  // Each connection gets one step per pass.  The first pick of the provider's
+  // write slots rotates, so a long reply cannot starve the others.
+  for (size_t i = 0; i < UW_BLE_MAX_CONNECTIONS; i++) {
+    size_t index = (transport->next_connection + i) % UW_BLE_MAX_CONNECTIONS;
+    work_remaining |= service_connection_(&transport->connections[index]);
+  }
+  transport->next_connection =
+      (transport->next_connection + 1) % UW_BLE_MAX_CONNECTIONS;
+
+  return work_remaining;
 }
 
 static bool create_service_(UwBleTransport* transport) {
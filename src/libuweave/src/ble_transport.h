@@ -6,8 +6,5 @@
 #define LIBUWEAVE_SRC_BLE_TRANSPORT_H_
 
 #include "uweave/ble_transport.h"
-#include "src/session.h"
-
-UwSession* uw_ble_transport_get_session_(UwBleTransport* ble_transport);
 
 #endif  // LIBUWEAVE_SRC_BLE_TRANSPORT_H_
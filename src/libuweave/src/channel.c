@@ -24,11 +24,52 @@ void uw_channel_init_(UwChannel* channel,
   uw_message_out_init_(&channel->message_out, message_out_buffer);
 }
 
+void uw_channel_set_next_message_in_buffer_(UwChannel* channel,
+                                            UwBuffer* next_message_in_buffer) {
+  uw_message_in_init_(&channel->next_message_in, next_message_in_buffer);
+}
+
+static bool has_next_message_in_(UwChannel* channel) {
+  return uw_message_in_get_buffer_(&channel->next_message_in) != NULL;
+}
+
+/** Returns the message that inbound packets are appended to. */
+static UwMessageIn* filling_message_in_(UwChannel* channel) {
+  if (uw_message_in_get_state_(&channel->message_in) ==
+          kUwMessageStateComplete &&
+      has_next_message_in_(channel)) {
+    return &channel->next_message_in;
+  }
+  return &channel->message_in;
+}
+
 void uw_channel_reset_messages_(UwChannel* channel) {
   uw_message_in_reset_(&channel->message_in);
+  if (has_next_message_in_(channel)) {
+    uw_message_in_reset_(&channel->next_message_in);
+  }
   uw_message_out_reset_(&channel->message_out);
 }
 
+bool uw_channel_release_message_in_(UwChannel* channel) {
+  uw_message_in_reset_(&channel->message_in);
+  if (!has_next_message_in_(channel)) {
+    return true;
+  }
+
+  // Swap the buffers, so the next message becomes message_in without a copy.
+  UwMessageIn released = channel->message_in;
+  channel->message_in = channel->next_message_in;
+  channel->next_message_in = released;
+
+  if (uw_message_in_get_state_(&channel->message_in) ==
+          kUwMessageStateComplete &&
+      channel->message_config.handler != NULL) {
+    return channel->message_config.handler(channel->message_config.data);
+  }
+  return true;
+}
+
 void uw_channel_reset_(UwChannel* channel) {
   channel->packet_in_counter = 0;
   channel->packet_out_counter = 0;
@@ -41,7 +82,7 @@ size_t uw_channel_get_max_packet_size_(UwChannel* channel) {
 }
 
 void uw_channel_set_max_packet_size_(UwChannel* channel,
-                                     uint8_t max_packet_size) {
+                                     size_t max_packet_size) {
   channel->max_packet_size = max_packet_size;
 }
 
@@ -61,18 +102,23 @@ UwMessageState uw_channel_get_out_state_(UwChannel* channel) {
   return uw_message_out_get_state_(&channel->message_out);
 }
 
-bool uw_channel_append_packet_in_(UwChannel* channel, UwBuffer* packet_buffer) {
-  const uint8_t* packet_bytes = NULL;
-  size_t packet_length = 0;
-  uw_buffer_get_const_bytes(packet_buffer, &packet_bytes, &packet_length);
-
-  // Pluck out the header.
-  uint8_t packet_header = packet_bytes[0];
+bool uw_channel_can_append_packet_in_(UwChannel* channel) {
+  return uw_message_in_get_state_(filling_message_in_(channel)) !=
+         kUwMessageStateComplete;
+}
 
-  // The rest is data.
-  packet_bytes++;
-  packet_length--;
+uint8_t* uw_channel_get_packet_in_cursor_(UwChannel* channel,
+                                          size_t packet_length) {
+  if (packet_length == 0) {
+    return NULL;
+  }
+  return uw_message_in_get_append_cursor_(filling_message_in_(channel),
+                                          packet_length - 1);
+}
 
+bool uw_channel_commit_packet_in_(UwChannel* channel,
+                                  uint8_t packet_header,
+                                  size_t data_length) {
   // Confirm the packet_counter.
   uint8_t packet_counter = uw_packet_header_get_counter_(packet_header);
   if (packet_counter != channel->packet_in_counter) {
@@ -84,13 +130,16 @@ bool uw_channel_append_packet_in_(UwChannel* channel, UwBuffer* packet_buffer) {
   channel->packet_in_counter = (channel->packet_in_counter + 1) % 8;
 
   // Append the packet and check the new state.
-  UwMessageState message_state = uw_message_in_append_packet_(
-      &channel->message_in, packet_header, packet_bytes, packet_length);
+  UwMessageIn* message_in = filling_message_in_(channel);
+  UwMessageState message_state =
+      uw_message_in_commit_packet_(message_in, packet_header, data_length);
   if (message_state == kUwMessageStateError) {
     return false;
   }
 
-  if (message_state == kUwMessageStateComplete) {
+  // A next message is handled once it becomes message_in.
+  if (message_state == kUwMessageStateComplete &&
+      message_in == &channel->message_in) {
     if (channel->message_config.handler != NULL) {
       return channel->message_config.handler(channel->message_config.data);
     }
@@ -99,6 +148,23 @@ bool uw_channel_append_packet_in_(UwChannel* channel, UwBuffer* packet_buffer) {
   return true;
 }
 
+bool uw_channel_append_packet_in_(UwChannel* channel, UwBuffer* packet_buffer) {
+  const uint8_t* packet_bytes = NULL;
+  size_t packet_length = 0;
+  uw_buffer_get_const_bytes(packet_buffer, &packet_bytes, &packet_length);
+
+  uint8_t* cursor = uw_channel_get_packet_in_cursor_(channel, packet_length);
+  if (cursor == NULL) {
+    UW_LOG_ERROR("No room for a packet of %d bytes.\n", (int)packet_length);
+    return false;
+  }
+
+  // The header is the first byte, the rest is data.
+  memcpy(cursor, packet_bytes + 1, packet_length - 1);
+  return uw_channel_commit_packet_in_(channel, packet_bytes[0],
+                                      packet_length - 1);
+}
+
 bool uw_channel_get_next_packet_out_(UwChannel* channel,
                                      UwBuffer* packet_buffer) {
   UwMessageState message_state = uw_message_out_get_next_packet_(
@@ -107,3 +173,14 @@ bool uw_channel_get_next_packet_out_(UwChannel* channel,
   channel->packet_out_counter = (channel->packet_out_counter + 1) % 8;
   return message_state != kUwMessageStateError;
 }
+
+bool uw_channel_take_next_packet_out_(UwChannel* channel,
+                                      uint8_t* packet_header,
+                                      const uint8_t** data_bytes,
+                                      size_t* data_length) {
+  UwMessageState message_state = uw_message_out_take_next_packet_(
+      &channel->message_out, channel->max_packet_size,
+      channel->packet_out_counter, packet_header, data_bytes, data_length);
+  channel->packet_out_counter = (channel->packet_out_counter + 1) % 8;
+  return message_state != kUwMessageStateError;
+}
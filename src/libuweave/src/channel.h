@@ -27,13 +27,19 @@ typedef struct {
  *
  * Provides flexible event handling via the UwChannelMessageHandler callback,
  * which is invoked when an incoming message is complete.
+ *
+ * Given a second inbound buffer, the channel reassembles the next message
+ * while message_in holds a complete one that is still being handled.
  */
 typedef struct {
   UwChannelMessageConfig message_config;
   size_t max_packet_size;
 
   uint8_t packet_in_counter;
+  // The oldest incoming message, which the handler sees.
   UwMessageIn message_in;
+  // The message after it, if there is a buffer for it.
+  UwMessageIn next_message_in;
 
   uint8_t packet_out_counter;
   UwMessageOut message_out;
@@ -51,12 +57,26 @@ void uw_channel_init_(UwChannel* channel,
                       UwBuffer* message_out_buffer,
                       size_t max_packet_size);
 
+/**
+ * Adds a buffer in which the next incoming message is reassembled while
+ * message_in is complete.
+ */
+void uw_channel_set_next_message_in_buffer_(UwChannel* channel,
+                                            UwBuffer* next_message_in_buffer);
+
 /**
  * Resets the buffer state for an individual command but preserves the packet
  * counter.  For use between commands in the same connection.
  */
 void uw_channel_reset_messages_(UwChannel* channel);
 
+/**
+ * Resets message_in once its message has been handled, making the next
+ * message, if there is one, the new message_in.  If that message is complete,
+ * the message handler is invoked for it and its result returned.
+ */
+bool uw_channel_release_message_in_(UwChannel* channel);
+
 /**
  * Resets the channel state without affecting the current max_packet_size. For
  * use between connections.
@@ -68,7 +88,7 @@ size_t uw_channel_get_max_packet_size_(UwChannel* channel);
 
 /** Sets the maximum size of a packet. */
 void uw_channel_set_max_packet_size_(UwChannel* channel,
-                                     uint8_t max_packet_size);
+                                     size_t max_packet_size);
 
 /** Returns the UwMessageIn object for this channel. */
 UwMessageIn* uw_channel_get_message_in_(UwChannel* channel);
@@ -79,6 +99,12 @@ UwMessageOut* uw_channel_get_message_out_(UwChannel* channel);
 /** Returns the state of the inbound message. */
 UwMessageState uw_channel_get_in_state_(UwChannel* channel);
 
+/**
+ * Returns true if an inbound packet can be appended now: false once message_in
+ * and the next message, if it has a buffer, are both complete.
+ */
+bool uw_channel_can_append_packet_in_(UwChannel* channel);
+
 /** Returns the state of the outbound message. */
 UwMessageState uw_channel_get_out_state_(UwChannel* channel);
 
@@ -91,6 +117,24 @@ UwMessageState uw_channel_get_out_state_(UwChannel* channel);
  */
 bool uw_channel_append_packet_in_(UwChannel* channel, UwBuffer* packet_buffer);
 
+/**
+ * Returns where the data of an inbound packet of packet_length bytes, less
+ * its one-byte header, goes in the message_in buffer, or NULL if it does not
+ * fit.  Lets the transport receive packets in place: the header goes
+ * elsewhere, the data at the cursor, then uw_channel_commit_packet_in_() takes
+ * the place of uw_channel_append_packet_in_().
+ */
+uint8_t* uw_channel_get_packet_in_cursor_(UwChannel* channel,
+                                          size_t packet_length);
+
+/**
+ * Appends a packet whose data was written at the packet in cursor.  Returns
+ * false on error, like uw_channel_append_packet_in_().
+ */
+bool uw_channel_commit_packet_in_(UwChannel* channel,
+                                  uint8_t packet_header,
+                                  size_t data_length);
+
 /**
  * Writes the next chunk of the current outbound message to the given packet
  * buffer.
@@ -102,4 +146,14 @@ bool uw_channel_append_packet_in_(UwChannel* channel, UwBuffer* packet_buffer);
 bool uw_channel_get_next_packet_out_(UwChannel* channel,
                                      UwBuffer* packet_buffer);
 
+/**
+ * Like uw_channel_get_next_packet_out_(), but returns the packet header and
+ * the span of the message_out buffer that makes up the rest of the packet,
+ * rather than copying them, so the transport can write them out directly.
+ */
+bool uw_channel_take_next_packet_out_(UwChannel* channel,
+                                      uint8_t* packet_header,
+                                      const uint8_t** data_bytes,
+                                      size_t* data_length);
+
 #endif  // LIBUWEAVE_SRC_CHANNEL_H_
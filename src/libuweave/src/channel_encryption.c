@@ -14,14 +14,25 @@
 #include "src/macaroon_caveat.h"
 #include "src/macaroon_context.h"
 #include "src/macaroon_caveat_internal.h"
+#include "uweave/config.h"
 #include "uweave/provider/crypto.h"
 
 #define SESSION_TAG_LENGTH 12
 #define SESSION_NONCE_LENGTH 20
+#define SESSION_NONCE_SUFFIX_LENGTH 4  // sender (1), counter (3)
 #define SESSION_CLIENT_SENDER 0x01
 #define SESSION_SERVER_SENDER 0x03
 
 #define TOKEN_SHA256_KEY_DATA_LEN 41
+#define RESUME_KEY_DATA_LEN (25 + UW_DEVICE_CRYPTO_TICKET_SECRET_LEN)
+
+// In-session control messages: the CBOR break code, then the type.
+#define CONTROL_MARKER 0xff
+#define CONTROL_MESSAGE_LEN 2
+#define CONTROL_REKEY_REQUEST 0x01  // Client: switch to the next key
+#define CONTROL_REKEY_ACK 0x02      // Device: switching after this message
+#define CONTROL_REKEY_DUE 0x03      // Device: request turned away, rekey first
+#define CONTROL_RESUMED 0x04        // Device: first message of a resumption
 
 #define MAX_FIRST_RESPONSE_SIZE 15
 #define MAX_DECODED_SAT_SIZE 256
@@ -51,6 +62,15 @@ static const uint8_t kHkdfContextSessionKey[11] = {
     0x6e, 0x20, 0x6b, 0x65, 0x79  // ascii "session key"
 };
 
+static const uint8_t kHkdfContextRekey[5] = {
+    0x72, 0x65, 0x6b, 0x65, 0x79  // ascii "rekey"
+};
+
+static const uint8_t kHkdfContextResumption[10] = {
+    0x72, 0x65, 0x73, 0x75, 0x6d,
+    0x70, 0x74, 0x69, 0x6f, 0x6e  // ascii "resumption"
+};
+
 bool uw_channel_encryption_init_(UwChannelEncryptionState* state,
                                  UwBuffer* message_in,
                                  UwBuffer* message_out) {
@@ -63,7 +83,9 @@ bool uw_channel_encryption_init_(UwChannelEncryptionState* state,
     return false;
   }
 
-  switch (buf_in[0]) {
+  uint8_t mode = buf_in[0] & ~UW_CRYPTO_MODE_FLAG_REKEY;
+  state->can_rekey = (mode != buf_in[0]);
+  switch (mode) {
     case UW_CRYPTO_MODE_PASSTHROUGH:
       state->phase = kUwChannelEncryptionPhasePassthrough;
       // TODO(arnarb): set encrypted=false in session ctxt
@@ -74,11 +96,22 @@ bool uw_channel_encryption_init_(UwChannelEncryptionState* state,
       return false;
 
     case UW_CRYPTO_MODE_TOKEN_SHA256:
+    case UW_CRYPTO_MODE_TOKEN_SHA256_TICKET:
+    case UW_CRYPTO_MODE_RESUME_TICKET:
+      if (mode != UW_CRYPTO_MODE_TOKEN_SHA256 &&
+          UW_SESSION_TICKET_LIFETIME_SECONDS == 0) {
+        UW_LOG_ERROR("Client asked for disabled ticket mode: %d\n", buf_in[0]);
+        return false;
+      }
       if (buf_in_length != 13) {
         UW_LOG_ERROR("Client asked for token auth with wrong random\n");
         return false;
       }
-      state->phase = kUwChannelEncryptionPhaseSATReceived;
+      // The second message carries a ticket instead of SAT' when resuming.
+      state->phase = (mode == UW_CRYPTO_MODE_RESUME_TICKET)
+                         ? kUwChannelEncryptionPhaseTicketReceived
+                         : kUwChannelEncryptionPhaseSATReceived;
+      state->issue_ticket = (mode == UW_CRYPTO_MODE_TOKEN_SHA256_TICKET);
       memcpy(state->client_random, buf_in + 1, 12);
       uwp_crypto_getrandom(state->server_random, 12);
       uw_buffer_append(message_out, state->server_random, 12);
@@ -90,31 +123,192 @@ bool uw_channel_encryption_init_(UwChannelEncryptionState* state,
   }
 }
 
-void uw_channel_encryption_build_token_sha256_session_key_(
-    UwChannelEncryptionState* state,
-    const uint8_t mac_tag[UW_MACAROON_MAC_LEN]) {
-  uint8_t key_material[TOKEN_SHA256_KEY_DATA_LEN];
-  key_material[0] = 0x02;
-  memcpy(key_material + 1, state->client_random, 12);
-  memcpy(key_material + 13, state->server_random, 12);
-  memcpy(key_material + 25, mac_tag, UW_MACAROON_MAC_LEN);
-
+/**
+ * Expands the session key and nonce base from HKDF output over key_material,
+ * which starts with a mode byte and the two randoms.
+ */
+static bool build_session_key_(UwChannelEncryptionState* state,
+                               const uint8_t* key_material,
+                               size_t key_material_len) {
   uint8_t hkdf_output[32];
-  uw_crypto_hkdf_(key_material, sizeof(key_material), kHkdfContextSessionKey,
+  uw_crypto_hkdf_(key_material, key_material_len, kHkdfContextSessionKey,
                   sizeof(kHkdfContextSessionKey), kModeSaltTokenSha256,
                   hkdf_output);
-  memcpy(state->session_key, hkdf_output, 16);
+  if (!uwp_crypto_aes128_key_init(&state->session_key, hkdf_output)) {
+    UW_LOG_ERROR("Could not expand session key\n");
+    return false;
+  }
+  memcpy(state->session_key_bytes, hkdf_output, 16);
   memcpy(state->nonce_base, hkdf_output + 16, 16);
+  if (!uw_eax_prefix_init_(&state->session_eax, &state->session_key,
+                           state->nonce_base, UW_BLE_SESSION_ID_LEN, NULL, 0)) {
+    UW_LOG_ERROR("Could not set up session EAX state\n");
+    return false;
+  }
   state->our_counter = 0;
   state->their_counter = 0;
+  state->rekey_pending = false;
+  state->rekey_requested = false;
+  state->resume_confirmed = false;
 #ifdef VERBOSE_ENCRYPTION
   // Only for debugging. Never check in code with this enabled.
-  dump("mac_tag", mac_tag, UW_MACAROON_MAC_LEN);
-  dump("session key", state->session_key, 16);
+  dump("session key", hkdf_output, 16);
   dump("session id", state->nonce_base, 16);
   dump("client random", state->client_random, 12);
   dump("server random", state->server_random, 12);
 #endif
+  return true;
+}
+
+static void fill_key_material_(const UwChannelEncryptionState* state,
+                               uint8_t mode,
+                               const uint8_t* secret,
+                               size_t secret_len,
+                               uint8_t* key_material) {
+  key_material[0] = mode;
+  memcpy(key_material + 1, state->client_random, 12);
+  memcpy(key_material + 13, state->server_random, 12);
+  memcpy(key_material + 25, secret, secret_len);
+}
+
+bool uw_channel_encryption_build_token_sha256_session_key_(
+    UwChannelEncryptionState* state,
+    const uint8_t mac_tag[UW_MACAROON_MAC_LEN]) {
+  uint8_t key_material[TOKEN_SHA256_KEY_DATA_LEN];
+  fill_key_material_(state, 0x02, mac_tag, UW_MACAROON_MAC_LEN, key_material);
+#ifdef VERBOSE_ENCRYPTION
+  // Only for debugging. Never check in code with this enabled.
+  dump("mac_tag", mac_tag, UW_MACAROON_MAC_LEN);
+#endif
+  return build_session_key_(state, key_material, sizeof(key_material));
+}
+
+void uw_channel_encryption_build_resumption_secret_(
+    const UwChannelEncryptionState* state,
+    const uint8_t mac_tag[UW_MACAROON_MAC_LEN],
+    uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN]) {
+  uint8_t key_material[TOKEN_SHA256_KEY_DATA_LEN];
+  fill_key_material_(state, 0x02, mac_tag, UW_MACAROON_MAC_LEN, key_material);
+
+  uint8_t hkdf_output[32];
+  uw_crypto_hkdf_(key_material, sizeof(key_material), kHkdfContextResumption,
+                  sizeof(kHkdfContextResumption), kModeSaltTokenSha256,
+                  hkdf_output);
+  memcpy(secret, hkdf_output, UW_DEVICE_CRYPTO_TICKET_SECRET_LEN);
+}
+
+bool uw_channel_encryption_build_resumed_session_key_(
+    UwChannelEncryptionState* state,
+    const uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN]) {
+  uint8_t key_material[RESUME_KEY_DATA_LEN];
+  fill_key_material_(state, 0x03, secret, UW_DEVICE_CRYPTO_TICKET_SECRET_LEN,
+                     key_material);
+  return build_session_key_(state, key_material, sizeof(key_material));
+}
+
+/**
+ * Replaces the session key with one derived from it, keeping the session id,
+ * and restarts both counters.
+ */
+static bool rekey_(UwChannelEncryptionState* state) {
+  uint8_t key_material[1 + sizeof(state->session_key_bytes)];
+  key_material[0] = 0x04;
+  memcpy(key_material + 1, state->session_key_bytes,
+         sizeof(state->session_key_bytes));
+
+  uint8_t hkdf_output[32];
+  uw_crypto_hkdf_(key_material, sizeof(key_material), kHkdfContextRekey,
+                  sizeof(kHkdfContextRekey), kModeSaltTokenSha256, hkdf_output);
+  memset(key_material, 0, sizeof(key_material));
+  bool key_ok =
+      uwp_crypto_aes128_key_init(&state->session_key, hkdf_output) &&
+      uw_eax_prefix_init_(&state->session_eax, &state->session_key,
+                          state->nonce_base, UW_BLE_SESSION_ID_LEN, NULL, 0);
+  memcpy(state->session_key_bytes, hkdf_output,
+         sizeof(state->session_key_bytes));
+  memset(hkdf_output, 0, sizeof(hkdf_output));
+  if (!key_ok) {
+    UW_LOG_ERROR("Could not rekey session\n");
+    return false;
+  }
+
+  state->our_counter = 0;
+  state->their_counter = 0;
+  state->rekey_pending = false;
+  state->rekey_requested = false;
+  UW_LOG_INFO("Session rekeyed\n");
+  return true;
+}
+
+static bool is_control_message_(const UwBuffer* message) {
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(message, &bytes, &length);
+  return length == CONTROL_MESSAGE_LEN && bytes[0] == CONTROL_MARKER;
+}
+
+/** Replaces message_out with an encrypted control message of type. */
+static UwStatus write_control_message_(UwChannelEncryptionState* state,
+                                       uint8_t type,
+                                       UwBuffer* message_out) {
+  const uint8_t control[CONTROL_MESSAGE_LEN] = {CONTROL_MARKER, type};
+  uw_buffer_reset(message_out);
+  if (!uw_buffer_append(message_out, control, sizeof(control))) {
+    return kUwStatusTooLong;
+  }
+  return uw_channel_encryption_process_out_(state, message_out);
+}
+
+/**
+ * Handles a decrypted control message, which leaves message_in empty.  The
+ * device takes only rekey requests, which it acknowledges under the old key
+ * before switching.  The client takes the acknowledgement of its rekey
+ * request, a request to rekey, and the confirm of a resumed session, which
+ * only comes as the device's first message.
+ */
+static UwStatus handle_control_message_(UwChannelEncryptionState* state,
+                                        UwBuffer* message_in,
+                                        UwBuffer* message_out) {
+  const uint8_t* bytes;
+  size_t length;
+  uw_buffer_get_const_bytes(message_in, &bytes, &length);
+  uint8_t type = bytes[1];
+  uw_buffer_reset(message_in);
+
+  if (state->encryption_role == kUwChannelEncryptionRoleDevice) {
+    if (type == CONTROL_REKEY_REQUEST && state->can_rekey) {
+      UwStatus ack_status =
+          write_control_message_(state, CONTROL_REKEY_ACK, message_out);
+      if (!uw_status_is_success(ack_status)) {
+        return ack_status;
+      }
+      return rekey_(state) ? kUwStatusSuccess
+                           : kUwStatusCryptoEncryptionFailed;
+    }
+  } else {
+    switch (type) {
+      case CONTROL_REKEY_ACK:
+        if (state->rekey_pending) {
+          return rekey_(state) ? kUwStatusSuccess
+                               : kUwStatusCryptoIncomingMessageInvalid;
+        }
+        break;
+      case CONTROL_REKEY_DUE:
+        if (state->can_rekey) {
+          state->rekey_requested = true;
+          return kUwStatusSuccess;
+        }
+        break;
+      case CONTROL_RESUMED:
+        if (state->their_counter == 1) {
+          state->resume_confirmed = true;
+          return kUwStatusSuccess;
+        }
+        break;
+    }
+  }
+  return UW_STATUS_AND_LOG_WARN(kUwStatusCryptoIncomingMessageInvalid,
+                                "Unexpected control message %d\n", type);
 }
 
 static UwStatus handshake_sat_helper(UwChannelEncryptionState* state,
@@ -122,6 +316,11 @@ static UwStatus handshake_sat_helper(UwChannelEncryptionState* state,
                                      UwBuffer* message_in,
                                      UwBuffer* message_out);
 
+static UwStatus resume_ticket_helper(UwChannelEncryptionState* state,
+                                     UwDeviceCrypto* device_crypto,
+                                     UwBuffer* message_in,
+                                     UwBuffer* message_out);
+
 UwStatus uw_channel_encryption_process_in_(UwChannelEncryptionState* state,
                                            UwDeviceCrypto* device_crypto,
                                            UwBuffer* message_in,
@@ -138,7 +337,16 @@ UwStatus uw_channel_encryption_process_in_(UwChannelEncryptionState* state,
       return handshake_sat_helper(state, device_crypto, message_in,
                                   message_out);
 
-    case kUwChannelEncryptionPhaseInSession:
+    case kUwChannelEncryptionPhaseTicketReceived:
+      return resume_ticket_helper(state, device_crypto, message_in,
+                                  message_out);
+
+    case kUwChannelEncryptionPhaseInSession: {
+      // A client that sends on past the threshold is asked to rekey, if it
+      // can; others are served up to the hard limit.
+      bool rekey_due =
+          state->encryption_role == kUwChannelEncryptionRoleDevice &&
+          uw_channel_encryption_should_rekey_(state);
       uw_buffer_get_const_bytes(message_in, &buf_in, &buf_in_length);
       // Decrypt in-place
       if (0 == (++(state->their_counter) & 0x00ffffff)) {
@@ -152,13 +360,24 @@ UwStatus uw_channel_encryption_process_in_(UwChannelEncryptionState* state,
       state->nonce_base[17] = (state->their_counter >> 16) & 0xff;
       state->nonce_base[18] = (state->their_counter >> 8) & 0xff;
       state->nonce_base[19] = state->their_counter & 0xff;
-      if (!uw_eax_decrypt_(state->session_key, SESSION_TAG_LENGTH,
-                           state->nonce_base, SESSION_NONCE_LENGTH, NULL, 0,
-                           message_in, message_in)) {
+      if (!uw_eax_decrypt_with_prefix_(
+              &state->session_eax, &state->session_key, SESSION_TAG_LENGTH,
+              state->nonce_base + UW_BLE_SESSION_ID_LEN,
+              SESSION_NONCE_SUFFIX_LENGTH, message_in, message_in)) {
         UW_LOG_ERROR("Could not decrypt session message.\n");
         return kUwStatusCryptoIncomingMessageInvalid;
       }
+      if (is_control_message_(message_in)) {
+        return handle_control_message_(state, message_in, message_out);
+      }
+      if (rekey_due) {
+        // The request is dropped; the reply is signalling, so the caller
+        // sends it without dispatching anything.
+        UW_LOG_WARN("Session is due a rekey, turning request away\n");
+        return write_control_message_(state, CONTROL_REKEY_DUE, message_out);
+      }
       return kUwStatusSuccess;
+    }
   }
 
   // Keep this point unreachable.
@@ -173,6 +392,7 @@ UwStatus uw_channel_encryption_process_out_(UwChannelEncryptionState* state,
       return kUwStatusSuccess;
 
     case kUwChannelEncryptionPhaseSATReceived:
+    case kUwChannelEncryptionPhaseTicketReceived:
       // This should not happen
       UW_LOG_ERROR(
           "Application tried to sent message but still in handshake.\n");
@@ -197,6 +417,8 @@ UwStatus uw_channel_encryption_process_out_(UwChannelEncryptionState* state,
       // Allowing more than 2^24-1 messages per key requires increasing the tag
       // size accordingly.
       // REUSING A COUNTER WITH THE SAME SESSION KEY IS NEVER SAFE.
+      // Long sessions rekey well before this, which restarts the counters
+      // under a new key (see uw_channel_encryption_start_rekey_).
       if (0 == (++state->our_counter & 0x00ffffff)) {
         UW_LOG_ERROR("Maximum messages per session reached.\n");
         return kUwStatusCryptoEncryptionFailed;
@@ -208,9 +430,10 @@ UwStatus uw_channel_encryption_process_out_(UwChannelEncryptionState* state,
       state->nonce_base[17] = (state->our_counter >> 16) & 0xff;
       state->nonce_base[18] = (state->our_counter >> 8) & 0xff;
       state->nonce_base[19] = state->our_counter & 0xff;
-      if (!uw_eax_encrypt_(state->session_key, SESSION_TAG_LENGTH,
-                           state->nonce_base, SESSION_NONCE_LENGTH, NULL, 0,
-                           message_out, message_out)) {
+      if (!uw_eax_encrypt_with_prefix_(
+              &state->session_eax, &state->session_key, SESSION_TAG_LENGTH,
+              state->nonce_base + UW_BLE_SESSION_ID_LEN,
+              SESSION_NONCE_SUFFIX_LENGTH, message_out, message_out)) {
         UW_LOG_ERROR("Could not encrypt session message.\n");
         return kUwStatusCryptoEncryptionFailed;
       }
@@ -221,6 +444,32 @@ UwStatus uw_channel_encryption_process_out_(UwChannelEncryptionState* state,
   return kUwStatusNotFound;
 }
 
+bool uw_channel_encryption_should_rekey_(
+    const UwChannelEncryptionState* state) {
+  return state->phase == kUwChannelEncryptionPhaseInSession &&
+         state->can_rekey &&
+         (state->rekey_requested ||
+          state->our_counter >= UW_SESSION_REKEY_THRESHOLD ||
+          state->their_counter >= UW_SESSION_REKEY_THRESHOLD);
+}
+
+UwStatus uw_channel_encryption_start_rekey_(UwChannelEncryptionState* state,
+                                            UwBuffer* message_out) {
+  if (state->phase != kUwChannelEncryptionPhaseInSession ||
+      state->encryption_role != kUwChannelEncryptionRoleClient ||
+      !state->can_rekey) {
+    return UW_STATUS_AND_LOG_WARN(
+        kUwStatusInvalidArgument,
+        "Only a client in a session that can rekey can start one\n");
+  }
+  UwStatus status =
+      write_control_message_(state, CONTROL_REKEY_REQUEST, message_out);
+  if (uw_status_is_success(status)) {
+    state->rekey_pending = true;
+  }
+  return status;
+}
+
 // This helper processes an incoming SAT handshake message,
 // and is kept separate since it requires a large amount of stack.
 static UwStatus handshake_sat_helper(UwChannelEncryptionState* state,
@@ -253,18 +502,17 @@ static UwStatus handshake_sat_helper(UwChannelEncryptionState* state,
                               &sat_context);
 
   UwMacaroonValidationResult sat_validation_result;
-  if (!uw_macaroon_validate_(&sat, device_crypto->device_authentication_key,
-                             sizeof(device_crypto->device_authentication_key),
-                             &sat_context, &sat_validation_result)) {
+  if (!uw_macaroon_validate_with_hmac_key_(
+          &sat, &device_crypto->device_authentication_hmac_key, &sat_context,
+          &sat_validation_result)) {
     UW_LOG_ERROR("Incoming SAT' is invalid.\n");
     return kUwStatusVerificationFailed;
   }
 
   // (re)compute the tag of SAT (SAT' minus the last caveat)
   UwMacaroon sat2;
-  if (!uw_macaroon_create_from_root_key_(
-          &sat2, device_crypto->device_authentication_key,
-          sizeof(device_crypto->device_authentication_key), &sat_context,
+  if (!uw_macaroon_create_from_hmac_key_(
+          &sat2, &device_crypto->device_authentication_hmac_key, &sat_context,
           sat.caveats, sat.num_caveats - 1)) {
     UW_LOG_ERROR("Could not recreate SAT\n");
     return kUwStatusCryptoIncomingMessageInvalid;
@@ -290,8 +538,64 @@ static UwStatus handshake_sat_helper(UwChannelEncryptionState* state,
   uw_buffer_append(message_out, sat_signature, sizeof(sat_signature));
 
   // sat2.mac_tag == original sat.mac_tag (sat.mac_tag above is sat').
-  uw_channel_encryption_build_token_sha256_session_key_(state, sat2.mac_tag);
+  if (!uw_channel_encryption_build_token_sha256_session_key_(state,
+                                                             sat2.mac_tag)) {
+    return kUwStatusCryptoIncomingMessageInvalid;
+  }
+
+  if (state->issue_ticket) {
+    // The client derives the same secret; the ticket lets the device recover
+    // it later without keeping any per-client state.
+    uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN];
+    uint8_t ticket[UW_DEVICE_CRYPTO_TICKET_LEN];
+    uw_channel_encryption_build_resumption_secret_(state, sat2.mac_tag,
+                                                   secret);
+    UwStatus ticket_status =
+        uw_device_crypto_issue_ticket_(device_crypto, secret, ticket);
+    memset(secret, 0, sizeof(secret));
+    if (!uw_status_is_success(ticket_status)) {
+      return ticket_status;
+    }
+    if (!uw_buffer_append(message_out, ticket, sizeof(ticket))) {
+      UW_LOG_ERROR("No room for resumption ticket\n");
+      return kUwStatusTooLong;
+    }
+  }
+
   state->phase = kUwChannelEncryptionPhaseInSession;
   UW_LOG_INFO("Starting session\n");
   return kUwStatusSuccess;
 }
+
+// Redeems a ticket in place of SAT'.  The device proves it holds the new key by
+// replying with the first session message, a resumed control message.
+static UwStatus resume_ticket_helper(UwChannelEncryptionState* state,
+                                     UwDeviceCrypto* device_crypto,
+                                     UwBuffer* message_in,
+                                     UwBuffer* message_out) {
+  const uint8_t* buf_in;
+  size_t buf_in_length;
+  uw_buffer_get_const_bytes(message_in, &buf_in, &buf_in_length);
+
+  uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN];
+  UwStatus redeem_status = uw_device_crypto_redeem_ticket_(
+      device_crypto, buf_in, buf_in_length, secret);
+  if (!uw_status_is_success(redeem_status)) {
+    return redeem_status;
+  }
+
+  bool key_ok = uw_channel_encryption_build_resumed_session_key_(state, secret);
+  memset(secret, 0, sizeof(secret));
+  if (!key_ok) {
+    return kUwStatusCryptoIncomingMessageInvalid;
+  }
+
+  state->phase = kUwChannelEncryptionPhaseInSession;
+  UwStatus confirm_status =
+      write_control_message_(state, CONTROL_RESUMED, message_out);
+  if (!uw_status_is_success(confirm_status)) {
+    return confirm_status;
+  }
+  UW_LOG_INFO("Resuming session\n");
+  return kUwStatusSuccess;
+}
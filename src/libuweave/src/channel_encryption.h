@@ -8,8 +8,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "src/crypto_eax.h"
 #include "src/device_crypto.h"
 #include "uweave/buffer.h"
+#include "uweave/provider/crypto.h"
 #include "uweave/status.h"
 
 #define UW_BLE_SESSION_ID_LEN 16
@@ -22,6 +24,9 @@ typedef enum {
   // Symmetric handshake
   kUwChannelEncryptionPhaseSATReceived,
 
+  // Resumption from a ticket issued by an earlier symmetric handshake
+  kUwChannelEncryptionPhaseTicketReceived,
+
   // Running session (i.e. handshake done)
   kUwChannelEncryptionPhaseInSession,
 } UwChannelEncryptionPhase;
@@ -38,13 +43,30 @@ typedef struct {
   // Common state for handshakes
   uint8_t client_random[12];
   uint8_t server_random[12];
-
-  // Session state
-  uint8_t session_key[16];
+  // Whether the client asked for a resumption ticket with the SAT handshake.
+  bool issue_ticket;
+  // Whether both ends handle rekey control messages, as the client offered
+  // with UW_CRYPTO_MODE_FLAG_REKEY.  Without it the session runs to the hard
+  // message limit.
+  bool can_rekey;
+
+  // Session state. The session key is kept expanded for the whole session,
+  // and in raw form to derive the next key from when rekeying.
+  UwpCryptoAes128Key session_key;
+  uint8_t session_key_bytes[16];
   // session id (16), sender (1), counter (3)
   uint8_t nonce_base[UW_BLE_SESSION_ID_LEN + 4];
+  // EAX work shared by every message of the session: the session id part of
+  // the nonce and the (empty) associated data never change.
+  UwEaxPrefixState session_eax;
   uint32_t our_counter;
   uint32_t their_counter;
+  // Client only: a rekey request was sent and its acknowledgement is awaited.
+  bool rekey_pending;
+  // Client only: the device turned a message away to ask for a rekey.
+  bool rekey_requested;
+  // Client only: the device's first message confirmed a resumed session.
+  bool resume_confirmed;
 } UwChannelEncryptionState;
 
 static inline const uint8_t* uw_channel_encryption_session_id_(
@@ -56,10 +78,31 @@ bool uw_channel_encryption_init_(UwChannelEncryptionState* state,
                                  UwBuffer* message_in,
                                  UwBuffer* message_out);
 
-void uw_channel_encryption_build_token_sha256_session_key_(
+/**
+ * Derives the session key and nonce base from the SAT tag and expands the
+ * session key schedule once for use by every message in the session.
+ */
+bool uw_channel_encryption_build_token_sha256_session_key_(
     UwChannelEncryptionState* state,
     const uint8_t mac_tag[UW_MACAROON_MAC_LEN]);
 
+/**
+ * Derives the secret a ticket issued after the SAT handshake carries.  Both
+ * ends compute it from the SAT tag and the handshake randoms.
+ */
+void uw_channel_encryption_build_resumption_secret_(
+    const UwChannelEncryptionState* state,
+    const uint8_t mac_tag[UW_MACAROON_MAC_LEN],
+    uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN]);
+
+/**
+ * Derives the session key for a resumed session from the ticket secret and the
+ * fresh randoms, with a single HKDF.
+ */
+bool uw_channel_encryption_build_resumed_session_key_(
+    UwChannelEncryptionState* state,
+    const uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN]);
+
 /**
  * Processes an incoming message. This may either:
  * 1. Modify message_in in place.
@@ -71,6 +114,9 @@ void uw_channel_encryption_build_token_sha256_session_key_(
  *    to the client with the contents of message_out.
  * A caller should check if the length of message_out changed as a result
  * of calling this method. If not, case 1 applies, otherwise case 2.
+ * In session, control messages (rekeying, the confirm of a resumed session)
+ * are handled here and leave message_in empty.  They start with 0xFF, the CBOR
+ * break code, which no Privet message can start with.
  */
 UwStatus uw_channel_encryption_process_in_(UwChannelEncryptionState* state,
                                            UwDeviceCrypto* device_crypto,
@@ -80,6 +126,28 @@ UwStatus uw_channel_encryption_process_in_(UwChannelEncryptionState* state,
 UwStatus uw_channel_encryption_process_out_(UwChannelEncryptionState* state,
                                             UwBuffer* message_out);
 
+/**
+ * Whether a session that can rekey has either message counter at
+ * UW_SESSION_REKEY_THRESHOLD, or the device asked the client to rekey.  A
+ * client checks this before each message it sends and rekeys first if it is
+ * set.  A device turns away any further request with a rekey-due control
+ * message, which sets it at the client; the client then rekeys and sends the
+ * request again.
+ */
+bool uw_channel_encryption_should_rekey_(
+    const UwChannelEncryptionState* state);
+
+/**
+ * Client side: writes a rekey request control message to message_out.  The
+ * device acknowledges it with another control message, after which both ends
+ * derive the next session key from the current one and reset their counters.
+ * The session id is kept so tokens bound to it stay valid.  Only start one
+ * with no reply outstanding, since replies sent before the acknowledgement
+ * are still under the old key.  Fails unless the session can rekey.
+ */
+UwStatus uw_channel_encryption_start_rekey_(UwChannelEncryptionState* state,
+                                            UwBuffer* message_out);
+
 static inline bool uw_channel_encryption_is_encrypted_(
     UwChannelEncryptionState* state) {
   return state->phase == kUwChannelEncryptionPhaseInSession;
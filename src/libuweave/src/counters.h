@@ -34,6 +34,12 @@ typedef enum {
   kUwInternalCounterSessionEncryptionFailure = 9,
   kUwInternalCounterPrivetDispatch = 10,
   kUwInternalCounterFactoryReset = 11,
+  kUwInternalCounterSpakePoolHit = 12,
+  kUwInternalCounterSpakePoolMiss = 13,
+  kUwInternalCounterAdmissionRejectedPairingStart = 14,
+  kUwInternalCounterAdmissionRejectedPairingConfirm = 15,
+  kUwInternalCounterAdmissionRejectedAuth = 16,
+  kUwInternalCounterBleConnectRefused = 17,
   kUwInternalCounterLast
 } UwInternalCounter;
 
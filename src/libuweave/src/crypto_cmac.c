@@ -47,13 +47,13 @@ static void doubling_(uint8_t* out, const uint8_t* in) {
 #endif
 }
 
-bool uw_cmac_init_(UwCmacState* state, const uint8_t* key) {
+bool uw_cmac_init_(UwCmacState* state, const UwpCryptoAes128Key* key) {
   UW_ASSERT(state != NULL && key != NULL, "Null state or key");
   state->key = key;
   memset(state->block, 0, UWP_CRYPTO_AES128_BLOCK_SIZE);
 
   // Temporarily use k2 to store k0 (not needed after init)
-  if (!uwp_crypto_aes128_ecb_encrypt(key, state->block, state->k2)) {
+  if (!uwp_crypto_aes128_encrypt_block(key, state->block, state->k2)) {
     return false;
   }
   doubling_(state->k1, state->k2);  // k1 <- doubling of k0
@@ -91,8 +91,8 @@ bool uw_cmac_update_(UwCmacState* state, const uint8_t* data, size_t length) {
     for (size_t i = 0; i < UWP_CRYPTO_AES128_BLOCK_SIZE; ++i) {
       state->block[i] ^= state->partial_block[i];
     }
-    if (!uwp_crypto_aes128_ecb_encrypt(state->key, state->block,
-                                       state->block)) {
+    if (!uwp_crypto_aes128_encrypt_block(state->key, state->block,
+                                         state->block)) {
       UW_LOG_ERROR("CMAC encrypt failed\n");
       return false;
     }
@@ -111,6 +111,19 @@ bool uw_cmac_update_(UwCmacState* state, const uint8_t* data, size_t length) {
   return true;
 }
 
+bool uw_cmac_flush_(UwCmacState* state) {
+  UW_ASSERT(state != NULL, "Null state");
+  if (state->partial_size < UWP_CRYPTO_AES128_BLOCK_SIZE) {
+    return true;
+  }
+  for (size_t i = 0; i < UWP_CRYPTO_AES128_BLOCK_SIZE; ++i) {
+    state->block[i] ^= state->partial_block[i];
+  }
+  state->partial_size = 0;
+  return uwp_crypto_aes128_encrypt_block(state->key, state->block,
+                                         state->block);
+}
+
 bool uw_cmac_final_(UwCmacState* state, uint8_t* mac) {
   UW_ASSERT(state != NULL, "Null state");
   uint8_t* mask;
@@ -125,5 +138,5 @@ bool uw_cmac_final_(UwCmacState* state, uint8_t* mac) {
   for (size_t i = 0; i < UWP_CRYPTO_AES128_BLOCK_SIZE; ++i) {
     state->block[i] ^= mask[i] ^ state->partial_block[i];
   }
-  return uwp_crypto_aes128_ecb_encrypt(state->key, state->block, mac);
+  return uwp_crypto_aes128_encrypt_block(state->key, state->block, mac);
 }
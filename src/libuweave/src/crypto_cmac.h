@@ -11,7 +11,7 @@
 #include "uweave/provider/crypto.h"
 
 typedef struct {
-  const uint8_t* key;
+  const UwpCryptoAes128Key* key;
   uint8_t block[UWP_CRYPTO_AES128_BLOCK_SIZE];
   uint8_t k1[UWP_CRYPTO_AES128_BLOCK_SIZE];
   uint8_t k2[UWP_CRYPTO_AES128_BLOCK_SIZE];
@@ -19,10 +19,18 @@ typedef struct {
   uint8_t partial_size;
 } UwCmacState;
 
-bool uw_cmac_init_(UwCmacState* state, const uint8_t* key);
+bool uw_cmac_init_(UwCmacState* state, const UwpCryptoAes128Key* key);
 bool uw_cmac_reset_(UwCmacState* state);
 bool uw_cmac_clone_(UwCmacState* dst, const UwCmacState* src);
 bool uw_cmac_update_(UwCmacState* state, const uint8_t* data, size_t length);
+
+/**
+ * Runs the cipher over a buffered complete block.  uw_cmac_update_ holds the
+ * last full block back in case it is the final one; callers that know more
+ * data will follow can use this to do that work ahead of time.  The state
+ * must not be finalized until at least one more byte has been added.
+ */
+bool uw_cmac_flush_(UwCmacState* state);
 bool uw_cmac_final_(UwCmacState* state, uint8_t* mac);
 
 #endif  // LIBUWEAVE_SRC_CRYPTO_CMAC_H_
@@ -8,6 +8,18 @@
 #define UW_CRYPTO_MODE_PASSTHROUGH 0x00
 #define UW_CRYPTO_MODE_ED25519_HKDF_SHA256 0x01
 #define UW_CRYPTO_MODE_TOKEN_SHA256 0x02
+// Same handshake as UW_CRYPTO_MODE_TOKEN_SHA256, with a resumption ticket
+// appended to the reply to SAT'.
+#define UW_CRYPTO_MODE_TOKEN_SHA256_TICKET 0x03
+// Presents a ticket in place of SAT' to derive a new session key without
+// re-validating the SAT.
+#define UW_CRYPTO_MODE_RESUME_TICKET 0x04
 #define UW_CRYPTO_MODE_INVALID 0xFF
 
+// Set on top of a token mode in the connection request by a client that
+// handles the in-session rekey control messages.  Devices from before
+// rekeying refuse the combined value, so such a client can connect again
+// without it; a device only asks clients that set it to rekey.
+#define UW_CRYPTO_MODE_FLAG_REKEY 0x80
+
 #endif  // LIBUWEAVE_SRC_CRYPTO_DEFINES_H_
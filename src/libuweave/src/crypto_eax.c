@@ -10,6 +10,7 @@
 #include "src/crypto_utils.h"
 #include "src/log.h"
 #include "src/uw_assert.h"
+#include "uweave/config.h"
 #include "uweave/provider/crypto.h"
 
 #define CHECK_ERROR_(x) \
@@ -31,15 +32,29 @@ static void increment_msb_(uint8_t* buf, size_t length) {
   }
 }
 
+/** XORs a word at a time; the buffers may alias and need not be aligned. */
 static void xor_buffers_(uint8_t* dst,
                          const uint8_t* a,
                          const uint8_t* b,
                          size_t length) {
+  for (; length >= sizeof(uint32_t); length -= sizeof(uint32_t)) {
+    uint32_t word_a, word_b;
+    memcpy(&word_a, a, sizeof(word_a));
+    memcpy(&word_b, b, sizeof(word_b));
+    word_a ^= word_b;
+    memcpy(dst, &word_a, sizeof(word_a));
+    dst += sizeof(uint32_t);
+    a += sizeof(uint32_t);
+    b += sizeof(uint32_t);
+  }
   while (length--) {
     *dst++ = *a++ ^ *b++;
   }
 }
 
+#define CTR_RUN_SIZE_ \
+  (UW_CRYPTO_CTR_BATCH_BLOCKS * UWP_CRYPTO_AES128_BLOCK_SIZE)
+
 /** Common state used in both encrypt and decrypt. */
 typedef struct {
   UwCmacState cmac_state;
@@ -47,7 +62,7 @@ typedef struct {
   uint8_t ad_nonce_mac[UWP_CRYPTO_AES128_BLOCK_SIZE];
 } EaxState_;
 
-static bool eax_init_(const uint8_t* key,
+static bool eax_init_(const UwpCryptoAes128Key* key,
                       size_t tag_length,
                       const uint8_t* nonce,
                       size_t nonce_length,
@@ -89,21 +104,84 @@ static bool eax_init_(const uint8_t* key,
   return true;
 }
 
-bool uw_eax_encrypt_(const uint8_t* key,
-                     size_t tag_length,
-                     const uint8_t* nonce,
-                     size_t nonce_length,
-                     const uint8_t* ad,
-                     size_t ad_length,
-                     UwBuffer* input,
-                     UwBuffer* output) {
-  if (input == NULL || output == NULL) {
+/**
+ * Applies the next length bytes (at most CTR_RUN_SIZE_) of CTR keystream from
+ * in to out, generating all of the counter blocks in one provider call.
+ */
+static bool ctr_xor_run_(EaxState_* state,
+                         const UwpCryptoAes128Key* key,
+                         const uint8_t* in,
+                         uint8_t* out,
+                         size_t length) {
+  uint32_t keystream_words[CTR_RUN_SIZE_ / sizeof(uint32_t)];
+  uint8_t* keystream = (uint8_t*)keystream_words;
+  size_t num_blocks = (length + UWP_CRYPTO_AES128_BLOCK_SIZE - 1) /
+                      UWP_CRYPTO_AES128_BLOCK_SIZE;
+  for (size_t i = 0; i < num_blocks; ++i) {
+    memcpy(keystream + i * UWP_CRYPTO_AES128_BLOCK_SIZE, state->ctr,
+           UWP_CRYPTO_AES128_BLOCK_SIZE);
+    increment_msb_(state->ctr, UWP_CRYPTO_AES128_BLOCK_SIZE);
+  }
+  CHECK_ERROR_(
+      uwp_crypto_aes128_encrypt_blocks(key, keystream, keystream, num_blocks));
+  xor_buffers_(out, in, keystream, length);
+  return true;
+}
+
+/**
+ * Sets up the per-message state from a cached nonce prefix.  Only the nonce
+ * suffix is run through CMAC; the AD MAC and ciphertext MAC prefix are reused.
+ */
+static bool eax_init_with_prefix_(const UwEaxPrefixState* prefix,
+                                  const UwpCryptoAes128Key* key,
+                                  size_t tag_length,
+                                  const uint8_t* nonce_suffix,
+                                  size_t nonce_suffix_length,
+                                  EaxState_* state) {
+  if (prefix == NULL || key == NULL || nonce_suffix == NULL ||
+      nonce_suffix_length == 0) {
     return false;
   }
-  EaxState_ state;
+  if (0 == tag_length || tag_length > UWP_CRYPTO_AES128_BLOCK_SIZE) {
+    return false;
+  }
+
+  CHECK_ERROR_(uw_cmac_clone_(&state->cmac_state, &prefix->nonce_cmac));
+  state->cmac_state.key = key;
   CHECK_ERROR_(
-      eax_init_(key, tag_length, nonce, nonce_length, ad, ad_length, &state));
+      uw_cmac_update_(&state->cmac_state, nonce_suffix, nonce_suffix_length));
+  CHECK_ERROR_(uw_cmac_final_(&state->cmac_state, state->ctr));
+
+  xor_buffers_(state->ad_nonce_mac, prefix->ad_mac, state->ctr,
+               UWP_CRYPTO_AES128_BLOCK_SIZE);
+
+  CHECK_ERROR_(uw_cmac_clone_(&state->cmac_state, &prefix->ciphertext_cmac));
+  state->cmac_state.key = key;
+  return true;
+}
 
+/**
+ * Finishes the ciphertext MAC. The cached ciphertext CMAC has its tweak block
+ * already processed, so it cannot represent an empty ciphertext; that MAC is
+ * cached separately.
+ */
+static bool eax_ciphertext_mac_(EaxState_* state,
+                                const UwEaxPrefixState* prefix,
+                                size_t ciphertext_length,
+                                uint8_t* mac) {
+  if (prefix != NULL && ciphertext_length == 0) {
+    memcpy(mac, prefix->empty_ciphertext_mac, UWP_CRYPTO_AES128_BLOCK_SIZE);
+    return true;
+  }
+  return uw_cmac_final_(&state->cmac_state, mac);
+}
+
+static bool eax_encrypt_with_state_(EaxState_* state,
+                                    const UwEaxPrefixState* prefix,
+                                    const UwpCryptoAes128Key* key,
+                                    size_t tag_length,
+                                    UwBuffer* input,
+                                    UwBuffer* output) {
   const uint8_t* in_p;
   size_t in_length;
   uw_buffer_get_const_bytes(input, &in_p, &in_length);
@@ -126,26 +204,21 @@ bool uw_eax_encrypt_(const uint8_t* key,
     return false;
   }
 
-  uint8_t key_block[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  size_t ciphertext_length = in_length;
   while (in_length > 0) {
-    // Get new key block
-    CHECK_ERROR_(uwp_crypto_aes128_ecb_encrypt(key, state.ctr, key_block));
-    increment_msb_(state.ctr, UWP_CRYPTO_AES128_BLOCK_SIZE);
-
-    size_t chunk_size = in_length > UWP_CRYPTO_AES128_BLOCK_SIZE
-                            ? UWP_CRYPTO_AES128_BLOCK_SIZE
-                            : in_length;
-    xor_buffers_(out_p, in_p, key_block, chunk_size);
-    CHECK_ERROR_(uw_cmac_update_(&state.cmac_state, out_p, chunk_size));
+    size_t chunk_size = in_length > CTR_RUN_SIZE_ ? CTR_RUN_SIZE_ : in_length;
+    CHECK_ERROR_(ctr_xor_run_(state, key, in_p, out_p, chunk_size));
+    CHECK_ERROR_(uw_cmac_update_(&state->cmac_state, out_p, chunk_size));
 
     in_length -= chunk_size;
     in_p += chunk_size;
     out_p += chunk_size;
   }
 
-  // Done with the key_block, lets use it to do mac calculation
-  CHECK_ERROR_(uw_cmac_final_(&state.cmac_state, key_block));
-  xor_buffers_(key_block, key_block, state.ad_nonce_mac,
+  uint8_t key_block[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  CHECK_ERROR_(
+      eax_ciphertext_mac_(state, prefix, ciphertext_length, key_block));
+  xor_buffers_(key_block, key_block, state->ad_nonce_mac,
                UWP_CRYPTO_AES128_BLOCK_SIZE);
   memcpy(out_p, key_block, tag_length);
 
@@ -153,21 +226,12 @@ bool uw_eax_encrypt_(const uint8_t* key,
   return true;
 }
 
-bool uw_eax_decrypt_(const uint8_t* key,
-                     size_t tag_length,
-                     const uint8_t* nonce,
-                     size_t nonce_length,
-                     const uint8_t* ad,
-                     size_t ad_length,
-                     UwBuffer* input,
-                     UwBuffer* output) {
-  if (input == NULL || output == NULL) {
-    return false;
-  }
-  EaxState_ state;
-  CHECK_ERROR_(
-      eax_init_(key, tag_length, nonce, nonce_length, ad, ad_length, &state));
-
+static bool eax_decrypt_with_state_(EaxState_* state,
+                                    const UwEaxPrefixState* prefix,
+                                    const UwpCryptoAes128Key* key,
+                                    size_t tag_length,
+                                    UwBuffer* input,
+                                    UwBuffer* output) {
   const uint8_t* in_p;
   size_t in_length;
   uw_buffer_get_const_bytes(input, &in_p, &in_length);
@@ -193,9 +257,9 @@ bool uw_eax_decrypt_(const uint8_t* key,
     return false;
   }
   in_length -= tag_length;
-  CHECK_ERROR_(uw_cmac_update_(&state.cmac_state, in_p, in_length));
-  CHECK_ERROR_(uw_cmac_final_(&state.cmac_state, key_block));
-  xor_buffers_(key_block, key_block, state.ad_nonce_mac,
+  CHECK_ERROR_(uw_cmac_update_(&state->cmac_state, in_p, in_length));
+  CHECK_ERROR_(eax_ciphertext_mac_(state, prefix, in_length, key_block));
+  xor_buffers_(key_block, key_block, state->ad_nonce_mac,
                UWP_CRYPTO_AES128_BLOCK_SIZE);
   if (!uw_crypto_utils_equal_(key_block, in_p + in_length, tag_length)) {
     UW_LOG_ERROR("Signature check failed\n");
@@ -203,14 +267,8 @@ bool uw_eax_decrypt_(const uint8_t* key,
   }
 
   while (in_length > 0) {
-    // Get new key block
-    CHECK_ERROR_(uwp_crypto_aes128_ecb_encrypt(key, state.ctr, key_block));
-    increment_msb_(state.ctr, UWP_CRYPTO_AES128_BLOCK_SIZE);
-
-    size_t chunk_size = in_length > UWP_CRYPTO_AES128_BLOCK_SIZE
-                            ? UWP_CRYPTO_AES128_BLOCK_SIZE
-                            : in_length;
-    xor_buffers_(out_p, in_p, key_block, chunk_size);
+    size_t chunk_size = in_length > CTR_RUN_SIZE_ ? CTR_RUN_SIZE_ : in_length;
+    CHECK_ERROR_(ctr_xor_run_(state, key, in_p, out_p, chunk_size));
 
     in_length -= chunk_size;
     in_p += chunk_size;
@@ -220,3 +278,118 @@ bool uw_eax_decrypt_(const uint8_t* key,
   uw_buffer_set_length_(output, out_length);
   return true;
 }
+
+bool uw_eax_encrypt_(const UwpCryptoAes128Key* key,
+                     size_t tag_length,
+                     const uint8_t* nonce,
+                     size_t nonce_length,
+                     const uint8_t* ad,
+                     size_t ad_length,
+                     UwBuffer* input,
+                     UwBuffer* output) {
+  if (input == NULL || output == NULL) {
+    return false;
+  }
+  EaxState_ state;
+  CHECK_ERROR_(
+      eax_init_(key, tag_length, nonce, nonce_length, ad, ad_length, &state));
+  return eax_encrypt_with_state_(&state, NULL, key, tag_length, input, output);
+}
+
+bool uw_eax_decrypt_(const UwpCryptoAes128Key* key,
+                     size_t tag_length,
+                     const uint8_t* nonce,
+                     size_t nonce_length,
+                     const uint8_t* ad,
+                     size_t ad_length,
+                     UwBuffer* input,
+                     UwBuffer* output) {
+  if (input == NULL || output == NULL) {
+    return false;
+  }
+  EaxState_ state;
+  CHECK_ERROR_(
+      eax_init_(key, tag_length, nonce, nonce_length, ad, ad_length, &state));
+  return eax_decrypt_with_state_(&state, NULL, key, tag_length, input, output);
+}
+
+bool uw_eax_prefix_init_(UwEaxPrefixState* prefix,
+                         const UwpCryptoAes128Key* key,
+                         const uint8_t* nonce_prefix,
+                         size_t nonce_prefix_length,
+                         const uint8_t* ad,
+                         size_t ad_length) {
+  if (prefix == NULL || key == NULL ||
+      (nonce_prefix == NULL && nonce_prefix_length > 0)) {
+    return false;
+  }
+
+  // A freshly keyed CMAC state, copied for each of the three tweaks.
+  UwCmacState* fresh_state = &prefix->ciphertext_cmac;
+  CHECK_ERROR_(uw_cmac_init_(fresh_state, key));
+
+  uint8_t tweak[UWP_CRYPTO_AES128_BLOCK_SIZE] = {0};  // "tweak" for IV's CMAC
+  CHECK_ERROR_(uw_cmac_clone_(&prefix->nonce_cmac, fresh_state));
+  CHECK_ERROR_(uw_cmac_update_(&prefix->nonce_cmac, tweak,
+                               UWP_CRYPTO_AES128_BLOCK_SIZE));
+  if (nonce_prefix_length > 0) {
+    CHECK_ERROR_(uw_cmac_update_(&prefix->nonce_cmac, nonce_prefix,
+                                 nonce_prefix_length));
+  }
+  // Every message appends a non-empty suffix, so a complete trailing block of
+  // the prefix can be encrypted now rather than once per message.
+  CHECK_ERROR_(uw_cmac_flush_(&prefix->nonce_cmac));
+
+  UwCmacState scratch_state;
+  tweak[UWP_CRYPTO_AES128_BLOCK_SIZE - 1] = 0x01;  // The "tweak" for AD's CMAC
+  CHECK_ERROR_(uw_cmac_clone_(&scratch_state, fresh_state));
+  CHECK_ERROR_(
+      uw_cmac_update_(&scratch_state, tweak, UWP_CRYPTO_AES128_BLOCK_SIZE));
+  if (ad != NULL && ad_length > 0) {
+    CHECK_ERROR_(uw_cmac_update_(&scratch_state, ad, ad_length));
+  }
+  CHECK_ERROR_(uw_cmac_final_(&scratch_state, prefix->ad_mac));
+
+  tweak[UWP_CRYPTO_AES128_BLOCK_SIZE - 1] = 0x02;  // "tweak" for ciphertext MAC
+  CHECK_ERROR_(uw_cmac_update_(&prefix->ciphertext_cmac, tweak,
+                               UWP_CRYPTO_AES128_BLOCK_SIZE));
+  CHECK_ERROR_(uw_cmac_clone_(&scratch_state, &prefix->ciphertext_cmac));
+  CHECK_ERROR_(uw_cmac_final_(&scratch_state, prefix->empty_ciphertext_mac));
+  CHECK_ERROR_(uw_cmac_flush_(&prefix->ciphertext_cmac));
+
+  return true;
+}
+
+bool uw_eax_encrypt_with_prefix_(const UwEaxPrefixState* prefix,
+                                 const UwpCryptoAes128Key* key,
+                                 size_t tag_length,
+                                 const uint8_t* nonce_suffix,
+                                 size_t nonce_suffix_length,
+                                 UwBuffer* input,
+                                 UwBuffer* output) {
+  if (input == NULL || output == NULL) {
+    return false;
+  }
+  EaxState_ state;
+  CHECK_ERROR_(eax_init_with_prefix_(prefix, key, tag_length, nonce_suffix,
+                                     nonce_suffix_length, &state));
+  return eax_encrypt_with_state_(&state, prefix, key, tag_length, input,
+                                 output);
+}
+
+bool uw_eax_decrypt_with_prefix_(const UwEaxPrefixState* prefix,
+                                 const UwpCryptoAes128Key* key,
+                                 size_t tag_length,
+                                 const uint8_t* nonce_suffix,
+                                 size_t nonce_suffix_length,
+                                 UwBuffer* input,
+                                 UwBuffer* output) {
+  if (input == NULL || output == NULL) {
+    return false;
+  }
+  EaxState_ state;
+  CHECK_ERROR_(eax_init_with_prefix_(prefix, key, tag_length, nonce_suffix,
+                                     nonce_suffix_length, &state));
+  return eax_decrypt_with_state_(&state, prefix, key, tag_length, input,
+                                 output);
+}
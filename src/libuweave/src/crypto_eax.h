@@ -9,14 +9,32 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "src/crypto_cmac.h"
 #include "uweave/buffer.h"
+#include "uweave/provider/crypto.h"
 
 /**
- * Encrypt. Input and output buffers may alias.
+ * Cached EAX work for a series of messages that share a key, a nonce prefix
+ * and associated data, and differ only in a non-empty nonce suffix.
+ */
+typedef struct {
+  // CMAC state after the nonce tweak block and the nonce prefix.
+  UwCmacState nonce_cmac;
+  // CMAC state after the ciphertext tweak block.
+  UwCmacState ciphertext_cmac;
+  // CMAC of the AD tweak block and the associated data.
+  uint8_t ad_mac[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  // CMAC of the ciphertext tweak block alone, for empty messages.
+  uint8_t empty_ciphertext_mac[UWP_CRYPTO_AES128_BLOCK_SIZE];
+} UwEaxPrefixState;
+
+/**
+ * Encrypt. Input and output buffers may alias. The key is an expanded schedule
+ * from uwp_crypto_aes128_key_init so it can be shared by many messages.
  * Capacity of output buffer must be state->tag_size more than the length of the
  * input buffer.
  */
-bool uw_eax_encrypt_(const uint8_t* key,
+bool uw_eax_encrypt_(const UwpCryptoAes128Key* key,
                      size_t tag_length,
                      const uint8_t* nonce,
                      size_t nonce_length,
@@ -29,7 +47,7 @@ bool uw_eax_encrypt_(const uint8_t* key,
  * Decrypt. Input and output buffers may alias. Returns false and overwrites
  * output with zeroes on signature error.
  */
-bool uw_eax_decrypt_(const uint8_t* key,
+bool uw_eax_decrypt_(const UwpCryptoAes128Key* key,
                      size_t tag_length,
                      const uint8_t* nonce,
                      size_t nonce_length,
@@ -38,4 +56,36 @@ bool uw_eax_decrypt_(const uint8_t* key,
                      UwBuffer* input,
                      UwBuffer* output);
 
+/**
+ * Precomputes the parts of EAX that depend only on the key, the nonce prefix
+ * and the associated data.  The key schedule must outlive the prefix state.
+ */
+bool uw_eax_prefix_init_(UwEaxPrefixState* prefix,
+                         const UwpCryptoAes128Key* key,
+                         const uint8_t* nonce_prefix,
+                         size_t nonce_prefix_length,
+                         const uint8_t* ad,
+                         size_t ad_length);
+
+/**
+ * Same as uw_eax_encrypt_, with the nonce formed by the cached prefix followed
+ * by nonce_suffix.  key must be the schedule the prefix was built with.
+ */
+bool uw_eax_encrypt_with_prefix_(const UwEaxPrefixState* prefix,
+                                 const UwpCryptoAes128Key* key,
+                                 size_t tag_length,
+                                 const uint8_t* nonce_suffix,
+                                 size_t nonce_suffix_length,
+                                 UwBuffer* input,
+                                 UwBuffer* output);
+
+/** Decrypt counterpart of uw_eax_encrypt_with_prefix_. */
+bool uw_eax_decrypt_with_prefix_(const UwEaxPrefixState* prefix,
+                                 const UwpCryptoAes128Key* key,
+                                 size_t tag_length,
+                                 const uint8_t* nonce_suffix,
+                                 size_t nonce_suffix_length,
+                                 UwBuffer* input,
+                                 UwBuffer* output);
+
 #endif /* LIBUWEAVE_SRC_CRYPTO_EAX_H_ */
@@ -13,26 +13,46 @@
 #define IPAD_BYTE 0x36
 #define OPAD_BYTE 0x5C
 
-bool uw_crypto_hmac_(const uint8_t* key,
-                     size_t key_len,
-                     const UwCryptoHmacMsg messages[],
-                     size_t num_messages,
-                     uint8_t* truncated_digest,
-                     size_t truncated_digest_len) {
-  if (key == NULL || key_len == 0 || truncated_digest == NULL ||
-      truncated_digest_len == 0 ||
-      truncated_digest_len > UWP_CRYPTO_SHA256_DIGEST_LEN ||
-      (num_messages != 0 && messages == NULL)) {
-    return false;
+// Jobs handled per pass of the batch functions, bounding their stack use.
+#define BATCH_LANES 8
+
+/**
+ * Feeds each lane into its hash, side by side where the provider can.
+ */
+static void sha256_update_lanes_(UwpCryptoSha256State* const states[],
+                                 const uint8_t* const data[],
+                                 const size_t data_len[],
+                                 size_t num_lanes) {
+#if UW_CRYPTO_PROVIDER_SHA256_LANES
+  uwp_crypto_sha256_update_lanes(states, data, data_len, num_lanes);
+#else
+  for (size_t i = 0; i < num_lanes; i++) {
+    uwp_crypto_sha256_update(states[i], data[i], data_len[i]);
   }
-  for (size_t i = 0; i < num_messages; i++) {
-    if (messages[i].num_bytes > 0 && messages[i].bytes == NULL) {
-      return false;
-    }
+#endif
+}
+
+/** Finalizes each lane, side by side where the provider can. */
+static void sha256_final_lanes_(UwpCryptoSha256State* const states[],
+                                uint8_t* const digests[],
+                                size_t num_lanes) {
+#if UW_CRYPTO_PROVIDER_SHA256_LANES
+  uwp_crypto_sha256_final_lanes(states, digests, num_lanes);
+#else
+  for (size_t i = 0; i < num_lanes; i++) {
+    uwp_crypto_sha256_final(states[i], digests[i]);
+  }
+#endif
+}
+
+bool uw_crypto_hmac_key_init_(UwCryptoHmacKey* hmac_key,
+                              const uint8_t* key,
+                              size_t key_len) {
+  if (hmac_key == NULL || key == NULL || key_len == 0) {
+    return false;
   }
 
   UwpCryptoSha256State sha256_state;
-  uint8_t digest[UWP_CRYPTO_SHA256_DIGEST_LEN] = {0};
 
   // Processing the key
   uint8_t key_state[UWP_CRYPTO_SHA256_BLOCK_SIZE] = {0};
@@ -44,13 +64,48 @@ bool uw_crypto_hmac_(const uint8_t* key,
     uwp_crypto_sha256_final(&sha256_state, key_state);
   }
 
-  // Inner hashing
-  uwp_crypto_sha256_init(&sha256_state);
+  // Inner pad
+  uwp_crypto_sha256_init(&hmac_key->inner);
   for (size_t i = 0; i < UWP_CRYPTO_SHA256_BLOCK_SIZE; i++) {
     key_state[i] ^= IPAD_BYTE;
   }
-  uwp_crypto_sha256_update(&sha256_state, key_state,
+  uwp_crypto_sha256_update(&hmac_key->inner, key_state,
                            UWP_CRYPTO_SHA256_BLOCK_SIZE);
+
+  // Outer pad
+  uwp_crypto_sha256_init(&hmac_key->outer);
+  for (size_t i = 0; i < UWP_CRYPTO_SHA256_BLOCK_SIZE; i++) {
+    key_state[i] ^= IPAD_BYTE ^ OPAD_BYTE;
+  }
+  uwp_crypto_sha256_update(&hmac_key->outer, key_state,
+                           UWP_CRYPTO_SHA256_BLOCK_SIZE);
+
+  memset(key_state, 0, sizeof(key_state));
+  return true;
+}
+
+bool uw_crypto_hmac_with_key_(const UwCryptoHmacKey* hmac_key,
+                              const UwCryptoHmacMsg messages[],
+                              size_t num_messages,
+                              uint8_t* truncated_digest,
+                              size_t truncated_digest_len) {
+  if (hmac_key == NULL || truncated_digest == NULL ||
+      truncated_digest_len == 0 ||
+      truncated_digest_len > UWP_CRYPTO_SHA256_DIGEST_LEN ||
+      (num_messages != 0 && messages == NULL)) {
+    return false;
+  }
+  for (size_t i = 0; i < num_messages; i++) {
+    if (messages[i].num_bytes > 0 && messages[i].bytes == NULL) {
+      return false;
+    }
+  }
+
+  UwpCryptoSha256State sha256_state;
+  uint8_t digest[UWP_CRYPTO_SHA256_DIGEST_LEN] = {0};
+
+  // Inner hashing
+  uwp_crypto_sha256_clone(&hmac_key->inner, &sha256_state);
   for (size_t i = 0; i < num_messages; i++) {
     if (messages[i].num_bytes != 0) {
       uwp_crypto_sha256_update(&sha256_state, messages[i].bytes,
@@ -60,15 +115,159 @@ bool uw_crypto_hmac_(const uint8_t* key,
   uwp_crypto_sha256_final(&sha256_state, digest);
 
   // Outer hashing
-  uwp_crypto_sha256_init(&sha256_state);
-  for (size_t i = 0; i < UWP_CRYPTO_SHA256_BLOCK_SIZE; i++) {
-    key_state[i] ^= IPAD_BYTE ^ OPAD_BYTE;
-  }
-  uwp_crypto_sha256_update(&sha256_state, key_state,
-                           UWP_CRYPTO_SHA256_BLOCK_SIZE);
+  uwp_crypto_sha256_clone(&hmac_key->outer, &sha256_state);
   uwp_crypto_sha256_update(&sha256_state, digest, UWP_CRYPTO_SHA256_DIGEST_LEN);
   uwp_crypto_sha256_final(&sha256_state, digest);
 
   memcpy(truncated_digest, digest, truncated_digest_len);
   return true;
 }
+
+static bool is_valid_job_(const UwCryptoHmacJob* job) {
+  if (job->key == NULL || job->truncated_digest == NULL ||
+      job->truncated_digest_len == 0 ||
+      job->truncated_digest_len > UWP_CRYPTO_SHA256_DIGEST_LEN ||
+      (job->num_messages != 0 && job->messages == NULL)) {
+    return false;
+  }
+  for (size_t i = 0; i < job->num_messages; i++) {
+    if (job->messages[i].num_bytes > 0 && job->messages[i].bytes == NULL) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Runs up to BATCH_LANES valid jobs. */
+static void hmac_lanes_(const UwCryptoHmacJob jobs[], size_t num_jobs) {
+  UwpCryptoSha256State states[BATCH_LANES];
+  UwpCryptoSha256State* lane_states[BATCH_LANES];
+  const uint8_t* lane_data[BATCH_LANES];
+  size_t lane_len[BATCH_LANES];
+  uint8_t digests[BATCH_LANES][UWP_CRYPTO_SHA256_DIGEST_LEN];
+  uint8_t* lane_digests[BATCH_LANES];
+
+  // Inner hashing, one message of every job per pass.
+  size_t max_messages = 0;
+  for (size_t i = 0; i < num_jobs; i++) {
+    uwp_crypto_sha256_clone(&jobs[i].key->inner, &states[i]);
+    if (jobs[i].num_messages > max_messages) {
+      max_messages = jobs[i].num_messages;
+    }
+  }
+  for (size_t m = 0; m < max_messages; m++) {
+    size_t num_lanes = 0;
+    for (size_t i = 0; i < num_jobs; i++) {
+      if (m < jobs[i].num_messages && jobs[i].messages[m].num_bytes != 0) {
+        lane_states[num_lanes] = &states[i];
+        lane_data[num_lanes] = jobs[i].messages[m].bytes;
+        lane_len[num_lanes++] = jobs[i].messages[m].num_bytes;
+      }
+    }
+    sha256_update_lanes_(lane_states, lane_data, lane_len, num_lanes);
+  }
+  for (size_t i = 0; i < num_jobs; i++) {
+    lane_states[i] = &states[i];
+    lane_digests[i] = digests[i];
+  }
+  sha256_final_lanes_(lane_states, lane_digests, num_jobs);
+
+  // Outer hashing
+  for (size_t i = 0; i < num_jobs; i++) {
+    uwp_crypto_sha256_clone(&jobs[i].key->outer, &states[i]);
+    lane_data[i] = digests[i];
+    lane_len[i] = UWP_CRYPTO_SHA256_DIGEST_LEN;
+  }
+  sha256_update_lanes_(lane_states, lane_data, lane_len, num_jobs);
+  sha256_final_lanes_(lane_states, lane_digests, num_jobs);
+
+  for (size_t i = 0; i < num_jobs; i++) {
+    memcpy(jobs[i].truncated_digest, digests[i], jobs[i].truncated_digest_len);
+  }
+}
+
+bool uw_crypto_hmac_batch_with_key_(const UwCryptoHmacJob jobs[],
+                                    size_t num_jobs) {
+  if (num_jobs != 0 && jobs == NULL) {
+    return false;
+  }
+  for (size_t i = 0; i < num_jobs; i++) {
+    if (!is_valid_job_(&jobs[i])) {
+      return false;
+    }
+  }
+
+  for (size_t first = 0; first < num_jobs; first += BATCH_LANES) {
+    size_t count = num_jobs - first;
+    hmac_lanes_(jobs + first, count < BATCH_LANES ? count : BATCH_LANES);
+  }
+  return true;
+}
+
+bool uw_crypto_hmac_key_init_batch_(UwCryptoHmacKey hmac_keys[],
+                                    const uint8_t* const keys[],
+                                    size_t key_len,
+                                    size_t num_keys) {
+  if (key_len == 0 || key_len > UWP_CRYPTO_SHA256_BLOCK_SIZE ||
+      (num_keys != 0 && (hmac_keys == NULL || keys == NULL))) {
+    return false;
+  }
+  for (size_t i = 0; i < num_keys; i++) {
+    if (keys[i] == NULL) {
+      return false;
+    }
+  }
+
+  // Both pads of a key go through at once: lane 2i inner, lane 2i+1 outer.
+  uint8_t pads[2 * BATCH_LANES][UWP_CRYPTO_SHA256_BLOCK_SIZE];
+  UwpCryptoSha256State* lane_states[2 * BATCH_LANES];
+  const uint8_t* lane_data[2 * BATCH_LANES];
+  size_t lane_len[2 * BATCH_LANES];
+  for (size_t first = 0; first < num_keys; first += BATCH_LANES) {
+    size_t count = num_keys - first;
+    if (count > BATCH_LANES) {
+      count = BATCH_LANES;
+    }
+    for (size_t i = 0; i < count; i++) {
+      UwCryptoHmacKey* hmac_key = &hmac_keys[first + i];
+      uint8_t* inner_pad = pads[2 * i];
+      uint8_t* outer_pad = pads[2 * i + 1];
+      memset(inner_pad, IPAD_BYTE, UWP_CRYPTO_SHA256_BLOCK_SIZE);
+      memset(outer_pad, OPAD_BYTE, UWP_CRYPTO_SHA256_BLOCK_SIZE);
+      for (size_t j = 0; j < key_len; j++) {
+        inner_pad[j] ^= keys[first + i][j];
+        outer_pad[j] ^= keys[first + i][j];
+      }
+
+      uwp_crypto_sha256_init(&hmac_key->inner);
+      uwp_crypto_sha256_init(&hmac_key->outer);
+      lane_states[2 * i] = &hmac_key->inner;
+      lane_states[2 * i + 1] = &hmac_key->outer;
+      lane_data[2 * i] = inner_pad;
+      lane_data[2 * i + 1] = outer_pad;
+      lane_len[2 * i] = UWP_CRYPTO_SHA256_BLOCK_SIZE;
+      lane_len[2 * i + 1] = UWP_CRYPTO_SHA256_BLOCK_SIZE;
+    }
+    sha256_update_lanes_(lane_states, lane_data, lane_len, 2 * count);
+  }
+
+  memset(pads, 0, sizeof(pads));
+  return true;
+}
+
+bool uw_crypto_hmac_(const uint8_t* key,
+                     size_t key_len,
+                     const UwCryptoHmacMsg messages[],
+                     size_t num_messages,
+                     uint8_t* truncated_digest,
+                     size_t truncated_digest_len) {
+  UwCryptoHmacKey hmac_key;
+  if (!uw_crypto_hmac_key_init_(&hmac_key, key, key_len)) {
+    return false;
+  }
+  bool result =
+      uw_crypto_hmac_with_key_(&hmac_key, messages, num_messages,
+                               truncated_digest, truncated_digest_len);
+  memset(&hmac_key, 0, sizeof(hmac_key));
+  return result;
+}
@@ -9,11 +9,65 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "uweave/provider/crypto.h"
+
 typedef struct {
   const uint8_t* bytes;
   size_t num_bytes;
 } UwCryptoHmacMsg;
 
+/**
+ * A key prepared for repeated HMAC use: the SHA256 midstates after absorbing
+ * the ipad and opad blocks, which saves two compressions per HMAC.
+ */
+typedef struct {
+  UwpCryptoSha256State inner;
+  UwpCryptoSha256State outer;
+} UwCryptoHmacKey;
+
+/**
+ * Precomputes hmac_key from key.  The raw key is not retained.
+ */
+bool uw_crypto_hmac_key_init_(UwCryptoHmacKey* hmac_key,
+                              const uint8_t* key,
+                              size_t key_len);
+
+/**
+ * Same as uw_crypto_hmac_, but with a key from uw_crypto_hmac_key_init_.
+ */
+bool uw_crypto_hmac_with_key_(const UwCryptoHmacKey* hmac_key,
+                              const UwCryptoHmacMsg messages[],
+                              size_t num_messages,
+                              uint8_t* truncated_digest,
+                              size_t truncated_digest_len);
+
+/** One HMAC of a batch for uw_crypto_hmac_batch_with_key_. */
+typedef struct {
+  const UwCryptoHmacKey* key;
+  const UwCryptoHmacMsg* messages;
+  size_t num_messages;
+  uint8_t* truncated_digest;
+  size_t truncated_digest_len;
+} UwCryptoHmacJob;
+
+/**
+ * Same as uw_crypto_hmac_with_key_ on each job, but with the jobs hashed side
+ * by side through uwp_crypto_sha256_update_lanes when the provider has it (see
+ * UW_CRYPTO_PROVIDER_SHA256_LANES).  Returns false, writing no digests, if any
+ * job is invalid.
+ */
+bool uw_crypto_hmac_batch_with_key_(const UwCryptoHmacJob jobs[],
+                                    size_t num_jobs);
+
+/**
+ * Same as uw_crypto_hmac_key_init_ on each key, with the pad blocks of all the
+ * keys hashed side by side.  Every key is key_len bytes, at most one block.
+ */
+bool uw_crypto_hmac_key_init_batch_(UwCryptoHmacKey hmac_keys[],
+                                    const uint8_t* const keys[],
+                                    size_t key_len,
+                                    size_t num_keys);
+
 /**
  * Compute HMAC over a list of messages, which is equivalent to computing HMAC
  * over the concatenation of all the messages. The HMAC output will be truncated
@@ -22,19 +22,19 @@
  */
 
 static const p224_point kM = {
-    {174237515, 77186811, 235213682, 33849492, 33188520, 48266885, 177021753,
-     81038478},
-    {104523827, 245682244, 266509668, 236196369, 28372046, 145351378, 198520366,
-     113345994},
-    {1, 0, 0, 0, 0, 0, 0, 0},
+    P224_FELEM(174237515, 77186811, 235213682, 33849492, 33188520, 48266885,
+               177021753, 81038478),
+    P224_FELEM(104523827, 245682244, 266509668, 236196369, 28372046, 145351378,
+               198520366, 113345994),
+    P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
 };
 
 static const p224_point kN = {
-    {136176322, 263523628, 251628795, 229292285, 5034302, 185981975, 171998428,
-     11653062},
-    {197567436, 51226044, 60372156, 175772188, 42075930, 8083165, 160827401,
-     65097570},
-    {1, 0, 0, 0, 0, 0, 0, 0},
+    P224_FELEM(136176322, 263523628, 251628795, 229292285, 5034302, 185981975,
+               171998428, 11653062),
+    P224_FELEM(197567436, 51226044, 60372156, 175772188, 42075930, 8083165,
+               160827401, 65097570),
+    P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
 };
 
 bool uw_spake_init_(UwSpakeState* state,
@@ -42,6 +42,11 @@ bool uw_spake_init_(UwSpakeState* state,
                     const uint8_t* password,
                     size_t password_length) {
   state->is_server = is_server;
+  state->masks = NULL;
+  state->recorded_masks = NULL;
+  state->has_X = false;
+  state->pending = kUwSpakePendingNone;
+  state->mult = NULL;
 
   uint8_t buf[UWP_CRYPTO_SHA256_DIGEST_LEN];
   UwpCryptoSha256State sha;
@@ -58,32 +63,147 @@ bool uw_spake_init_(UwSpakeState* state,
   return true;
 }
 
-bool uw_spake_compute_commitment_(UwSpakeState* state, UwBuffer* commitment) {
-  p224_point X, mask, Xmasked;
+bool uw_spake_compute_masks_(const UwSpakeState* state, UwSpakeMasks* masks) {
+  p224_point mask, unmask;
 
-  p224_base_point_mul(state->x, &X);
   p224_point_mul(state->is_server ? &kN : &kM, state->pw, &mask);
-  p224_point_add(&mask, &X, &Xmasked);
+  p224_point_to_bin(&mask, masks->local_mask);
+
+  p224_point_mul(state->is_server ? &kM : &kN, state->pw, &mask);
+  p224_point_negate(&mask, &unmask);
+  p224_point_to_bin(&unmask, masks->remote_unmask);
+  return true;
+}
+
+void uw_spake_use_masks_(UwSpakeState* state, const UwSpakeMasks* masks) {
+  state->masks = masks;
+}
+
+void uw_spake_record_masks_(UwSpakeState* state, UwSpakeMasks* masks) {
+  state->recorded_masks = masks;
+}
+
+bool uw_spake_keypair_begin_(UwSpakeKeypair* keypair,
+                             p224_scalar_mult_state* mult) {
+  if (!uwp_crypto_getrandom(keypair->x, sizeof(keypair->x))) {
+    UW_LOG_ERROR("Could not get random data");
+    return false;
+  }
+
+  p224_base_point_mult_begin(mult, keypair->x);
+  return true;
+}
+
+bool uw_spake_keypair_step_(UwSpakeKeypair* keypair,
+                            p224_scalar_mult_state* mult,
+                            int max_nibbles) {
+  if (!p224_scalar_mult_step(mult, max_nibbles)) {
+    return false;
+  }
+
+  p224_point X;
+  p224_scalar_mult_finish(mult, &X);
+  p224_point_to_bin(&X, keypair->X);
+  return true;
+}
+
+bool uw_spake_generate_keypair_(UwSpakeKeypair* keypair) {
+  p224_scalar_mult_state mult;
+  return uw_spake_keypair_begin_(keypair, &mult) &&
+         uw_spake_keypair_step_(keypair, &mult, UW_SPAKE_P224_SCALAR_SIZE);
+}
+
+void uw_spake_use_keypair_(UwSpakeState* state, const UwSpakeKeypair* keypair) {
+  memcpy(state->x, keypair->x, sizeof(state->x));
+  memcpy(state->X, keypair->X, sizeof(state->X));
+  state->has_X = true;
+}
+
+/** Sets Xmasked = mask + X, the local commitment. */
+static bool mask_commitment_(UwSpakeState* state, const p224_point* mask) {
+  p224_point X, Xmasked;
+
+  if (0 == p224_point_from_bin(state->X, sizeof(state->X), &X)) {
+    UW_LOG_ERROR("Could not parse the precomputed spake key.\n");
+    return false;
+  }
+  p224_point_add(mask, &X, &Xmasked);
   p224_point_to_bin(&Xmasked, state->Xmasked);
+  return true;
+}
 
-  if (!uw_buffer_append(commitment, state->Xmasked, sizeof(state->Xmasked))) {
-    UW_LOG_ERROR("Could not write commitment. Buffer too small?\n");
+/** Starts the DH multiplication once the remote mask is removed. */
+static bool begin_secret_(UwSpakeState* state, const p224_point* unmask) {
+  p224_point Ymasked, Y;
+
+  // Ymasked, remote's public key + mask point
+  if (0 == p224_point_from_bin(state->Ymasked, sizeof(state->Ymasked),
+                               &Ymasked)) {
+    UW_LOG_ERROR("Could not parse a P224 public key from remote.");
     return false;
   }
 
+  // Y = Ymasked - mask point
+  p224_point_add(&Ymasked, unmask, &Y);
+
+  p224_scalar_mult_begin(state->mult, &Y, state->x);
+  state->pending = kUwSpakePendingFinalizeSecret;
   return true;
 }
 
-bool uw_spake_finalize_(UwSpakeState* state,
-                        const UwBuffer* remote_commitment,
-                        uint8_t* key,
-                        size_t key_size) {
-  p224_point p1, p2, Y;
+/** Masks X, or starts computing the mask if it is not precomputed. */
+static bool begin_commitment_mask_(UwSpakeState* state) {
+  if (state->masks != NULL) {
+    p224_point mask;
+    if (0 == p224_point_from_bin(state->masks->local_mask,
+                                 sizeof(state->masks->local_mask), &mask)) {
+      UW_LOG_ERROR("Could not parse the cached spake mask.\n");
+      return false;
+    }
+    return mask_commitment_(state, &mask);
+  }
+
+  p224_scalar_mult_begin(state->mult, state->is_server ? &kN : &kM,
+                         state->pw);
+  state->pending = kUwSpakePendingCommitmentMask;
+  return true;
+}
+
+void uw_spake_use_mult_state_(UwSpakeState* state,
+                              p224_scalar_mult_state* mult) {
+  state->mult = mult;
+}
+
+bool uw_spake_is_using_mult_state_(const UwSpakeState* state,
+                                   const p224_scalar_mult_state* mult) {
+  return state->pending != kUwSpakePendingNone && state->mult == mult;
+}
+
+bool uw_spake_commitment_begin_(UwSpakeState* state) {
+  state->pending = kUwSpakePendingNone;
+  if (state->mult == NULL) {
+    UW_LOG_ERROR("No state lent for the spake multiplications.\n");
+    return false;
+  }
+  if (!state->has_X) {
+    p224_base_point_mult_begin(state->mult, state->x);
+    state->pending = kUwSpakePendingCommitmentBase;
+    return true;
+  }
+  return begin_commitment_mask_(state);
+}
 
+bool uw_spake_finalize_begin_(UwSpakeState* state,
+                              const UwBuffer* remote_commitment) {
   const uint8_t* in_bytes;
   size_t in_length;
   uw_buffer_get_const_bytes(remote_commitment, &in_bytes, &in_length);
 
+  state->pending = kUwSpakePendingNone;
+  if (state->mult == NULL) {
+    UW_LOG_ERROR("No state lent for the spake multiplications.\n");
+    return false;
+  }
   if (in_length != UW_SPAKE_P224_POINT_SIZE) {
     UW_LOG_ERROR("Received spake commitment has incorrect size %d != %d.\n",
                  (int)in_length, (int)UW_SPAKE_P224_POINT_SIZE);
@@ -91,28 +211,125 @@ bool uw_spake_finalize_(UwSpakeState* state,
   }
   memcpy(state->Ymasked, in_bytes, UW_SPAKE_P224_POINT_SIZE);
 
-  // p1 = mask point (pw * N or pw * M)
-  p224_point_mul(state->is_server ? &kM : &kN, state->pw, &p1);
+  if (state->masks != NULL) {
+    // Negative of mask point, precomputed
+    p224_point unmask;
+    if (0 == p224_point_from_bin(state->masks->remote_unmask,
+                                 sizeof(state->masks->remote_unmask),
+                                 &unmask)) {
+      UW_LOG_ERROR("Could not parse the cached spake mask.\n");
+      return false;
+    }
+    return begin_secret_(state, &unmask);
+  }
 
-  // p2 = negative of mask point
-  p224_point_negate(&p1, &p2);
+  // Mask point (pw * N or pw * M)
+  p224_scalar_mult_begin(state->mult, state->is_server ? &kM : &kN,
+                         state->pw);
+  state->pending = kUwSpakePendingFinalizeUnmask;
+  return true;
+}
 
-  // p1 = Ymasked, remote's public key + mask point
-  if (0 == p224_point_from_bin(state->Ymasked, sizeof(state->Ymasked), &p1)) {
-    UW_LOG_ERROR("Could not parse a P224 public key from remote.");
-    return false;
+UwSpakeStepResult uw_spake_step_(UwSpakeState* state, int max_nibbles) {
+  if (state->pending == kUwSpakePendingNone) {
+    return kUwSpakeStepDone;
+  }
+  if (!p224_scalar_mult_step(state->mult, max_nibbles)) {
+    return kUwSpakeStepBusy;
   }
 
-  // Y = p1 + p2 = Ymasked - mask point
-  p224_point_add(&p1, &p2, &Y);
+  p224_point product, negated;
+  UwSpakePending finished = state->pending;
+  state->pending = kUwSpakePendingNone;
+  p224_scalar_mult_finish(state->mult, &product);
+
+  switch (finished) {
+    case kUwSpakePendingCommitmentBase:
+      p224_point_to_bin(&product, state->X);
+      state->has_X = true;
+      if (!begin_commitment_mask_(state)) {
+        return kUwSpakeStepError;
+      }
+      return state->pending == kUwSpakePendingNone ? kUwSpakeStepDone
+                                                   : kUwSpakeStepBusy;
+    case kUwSpakePendingCommitmentMask:
+      if (state->recorded_masks != NULL) {
+        p224_point_to_bin(&product, state->recorded_masks->local_mask);
+      }
+      if (!mask_commitment_(state, &product)) {
+        return kUwSpakeStepError;
+      }
+      return kUwSpakeStepDone;
+    case kUwSpakePendingFinalizeUnmask:
+      p224_point_negate(&product, &negated);
+      if (state->recorded_masks != NULL) {
+        p224_point_to_bin(&negated, state->recorded_masks->remote_unmask);
+      }
+      if (!begin_secret_(state, &negated)) {
+        return kUwSpakeStepError;
+      }
+      return kUwSpakeStepBusy;
+    case kUwSpakePendingFinalizeSecret:
+      p224_point_to_bin(&product, state->key);
+      return kUwSpakeStepDone;
+    default:
+      return kUwSpakeStepError;
+  }
+}
 
-  // p1 = DH secret
-  p224_point_mul(&Y, state->x, &p1);
-  p224_point_to_bin(&p1, state->key);
+bool uw_spake_get_commitment_(const UwSpakeState* state, UwBuffer* commitment) {
+  if (!uw_buffer_append(commitment, state->Xmasked, sizeof(state->Xmasked))) {
+    UW_LOG_ERROR("Could not write commitment. Buffer too small?\n");
+    return false;
+  }
+  return true;
+}
 
+void uw_spake_get_key_(const UwSpakeState* state,
+                       uint8_t* key,
+                       size_t key_size) {
   UW_ASSERT(key != NULL && key_size > 0, "Nowhere to put SPAKE key.\n");
   // TODO(arnarb): This should probably be limited to the x-coordinate.
   UW_ASSERT(key_size <= sizeof(state->key), "Requested key is too large.\n");
   memcpy(key, state->key, key_size);
+}
+
+/** Runs the pending computation to completion. */
+static bool run_to_completion_(UwSpakeState* state) {
+  UwSpakeStepResult result;
+  do {
+    result = uw_spake_step_(state, 2 * UW_SPAKE_P224_SCALAR_SIZE);
+  } while (result == kUwSpakeStepBusy);
+  return result == kUwSpakeStepDone;
+}
+
+// The blocking forms run their multiplications in a state on the stack, and
+// leave any lent one as it was.
+
+bool uw_spake_compute_commitment_(UwSpakeState* state, UwBuffer* commitment) {
+  p224_scalar_mult_state mult;
+  p224_scalar_mult_state* lent_mult = state->mult;
+  state->mult = &mult;
+  bool success = uw_spake_commitment_begin_(state) &&
+                 run_to_completion_(state) &&
+                 uw_spake_get_commitment_(state, commitment);
+  state->mult = lent_mult;
+  return success;
+}
+
+bool uw_spake_finalize_(UwSpakeState* state,
+                        const UwBuffer* remote_commitment,
+                        uint8_t* key,
+                        size_t key_size) {
+  p224_scalar_mult_state mult;
+  p224_scalar_mult_state* lent_mult = state->mult;
+  state->mult = &mult;
+  bool success = uw_spake_finalize_begin_(state, remote_commitment) &&
+                 run_to_completion_(state);
+  state->mult = lent_mult;
+  if (!success) {
+    return false;
+  }
+  uw_spake_get_key_(state, key, key_size);
   return true;
 }
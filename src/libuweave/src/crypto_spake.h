@@ -8,12 +8,45 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "omaha-crypto/p224.h"
 #include "uweave/buffer.h"
 #include "uweave/provider/crypto.h"
 
 #define UW_SPAKE_P224_SCALAR_SIZE 28
 #define UW_SPAKE_P224_POINT_SIZE (2 * UW_SPAKE_P224_SCALAR_SIZE)
 
+/**
+ * The password-dependent points of the exchange: the mask added to the local
+ * commitment and the negated mask that is added to the remote commitment.  They
+ * depend only on the password and the role, so they can be computed once for a
+ * fixed password and reused (see uw_spake_use_masks_).
+ */
+typedef struct {
+  uint8_t local_mask[UW_SPAKE_P224_POINT_SIZE];     // pw * N or pw * M
+  uint8_t remote_unmask[UW_SPAKE_P224_POINT_SIZE];  // -(pw * M) or -(pw * N)
+} UwSpakeMasks;
+
+/** An ephemeral private key and its public point, for a single exchange. */
+typedef struct {
+  uint8_t x[UW_SPAKE_P224_SCALAR_SIZE];  // Ephemeral private key
+  uint8_t X[UW_SPAKE_P224_POINT_SIZE];   // x * G
+} UwSpakeKeypair;
+
+/** The scalar multiplication a resumable computation is waiting on. */
+typedef enum {
+  kUwSpakePendingNone = 0,
+  kUwSpakePendingCommitmentMask = 1,  // Mask for the local commitment
+  kUwSpakePendingFinalizeUnmask = 2,  // Mask to remove from the remote one
+  kUwSpakePendingFinalizeSecret = 3,  // DH secret
+  kUwSpakePendingCommitmentBase = 4,  // X, when no keypair was precomputed
+} UwSpakePending;
+
+typedef enum {
+  kUwSpakeStepError = 0,
+  kUwSpakeStepBusy = 1,
+  kUwSpakeStepDone = 2,
+} UwSpakeStepResult;
+
 typedef struct UwSpakeState_ {
   bool is_server;                             // Protocol role
   uint8_t x[UW_SPAKE_P224_SCALAR_SIZE];       // Ephemeral private key
@@ -21,6 +54,12 @@ typedef struct UwSpakeState_ {
   uint8_t Ymasked[UW_SPAKE_P224_POINT_SIZE];  // Remote commitment
   uint8_t pw[UW_SPAKE_P224_SCALAR_SIZE];      // Hashed password
   uint8_t key[UW_SPAKE_P224_POINT_SIZE];      // DH Secret
+  const UwSpakeMasks* masks;                  // Precomputed masks, or NULL
+  UwSpakeMasks* recorded_masks;               // Receives masks, or NULL
+  bool has_X;                                 // Whether X is precomputed
+  uint8_t X[UW_SPAKE_P224_POINT_SIZE];        // x * G, if has_X
+  UwSpakePending pending;                     // Multiplication in progress
+  p224_scalar_mult_state* mult;               // Lent; in use while pending
 } UwSpakeState;
 
 /**
@@ -46,6 +85,53 @@ bool uw_spake_init_(UwSpakeState* state,
                     const uint8_t* password,
                     size_t password_length);
 
+/**
+ * Computes the mask points for the password and role given to uw_spake_init_.
+ * This costs two of the four scalar multiplications of an exchange, run at
+ * once; see uw_spake_record_masks_ for a resumable way to get them.
+ */
+bool uw_spake_compute_masks_(const UwSpakeState* state, UwSpakeMasks* masks);
+
+/**
+ * Makes the exchange use precomputed masks instead of computing them.  masks
+ * must have been computed for the same password and role, and must outlive the
+ * exchange.  Call after uw_spake_init_, which clears it.
+ */
+void uw_spake_use_masks_(UwSpakeState* state, const UwSpakeMasks* masks);
+
+/**
+ * Makes an exchange without precomputed masks write the masks it computes to
+ * masks, to be reused by later exchanges with the same password and role.
+ * local_mask is written when the commitment is done and remote_unmask once the
+ * finalize step removes it.  Call after uw_spake_init_, which clears it.
+ */
+void uw_spake_record_masks_(UwSpakeState* state, UwSpakeMasks* masks);
+
+/**
+ * Draws a fresh ephemeral key and computes its public point.  This is the
+ * base-point multiplication of uw_spake_compute_commitment_, done ahead of
+ * time.
+ */
+bool uw_spake_generate_keypair_(UwSpakeKeypair* keypair);
+
+/**
+ * Resumable form of uw_spake_generate_keypair_.  After a successful begin,
+ * call uw_spake_keypair_step_ with the same mult until it returns true, at
+ * which point keypair->X is set.  A full keypair is 28 steps.
+ */
+bool uw_spake_keypair_begin_(UwSpakeKeypair* keypair,
+                             p224_scalar_mult_state* mult);
+
+bool uw_spake_keypair_step_(UwSpakeKeypair* keypair,
+                            p224_scalar_mult_state* mult,
+                            int max_nibbles);
+
+/**
+ * Replaces the ephemeral key drawn by uw_spake_init_ with a precomputed one.
+ * Each keypair must be used for at most one exchange.
+ */
+void uw_spake_use_keypair_(UwSpakeState* state, const UwSpakeKeypair* keypair);
+
 /**
  * Computes this party's commitment, i.e., C_a, descrbied in the header comment
  * above.
@@ -62,4 +148,44 @@ bool uw_spake_finalize_(UwSpakeState* state,
                         uint8_t* key,
                         size_t key_size);
 
+/**
+ * Lends the resumable functions below the working state of their scalar
+ * multiplications, which holds a window table of about 1.6 KB.  It is only in
+ * use while a multiplication is pending (see uw_spake_is_using_mult_state_),
+ * so exchanges that take turns can share one.  Call after uw_spake_init_,
+ * which clears it, and before each *_begin_ call.
+ */
+void uw_spake_use_mult_state_(UwSpakeState* state,
+                              p224_scalar_mult_state* mult);
+
+/** Whether state has a multiplication pending in mult. */
+bool uw_spake_is_using_mult_state_(const UwSpakeState* state,
+                                   const p224_scalar_mult_state* mult);
+
+/**
+ * Resumable forms of uw_spake_compute_commitment_ and uw_spake_finalize_ for
+ * callers that must keep an event loop responsive.  After a successful
+ * *_begin_ call, call uw_spake_step_ until it returns kUwSpakeStepDone, then
+ * read the result with uw_spake_get_commitment_ or uw_spake_get_key_.  Both
+ * fail without a state from uw_spake_use_mult_state_.
+ */
+bool uw_spake_commitment_begin_(UwSpakeState* state);
+
+bool uw_spake_finalize_begin_(UwSpakeState* state,
+                              const UwBuffer* remote_commitment);
+
+/**
+ * Runs the pending computation for at most `max_nibbles` 4-bit windows of
+ * scalar multiplication; a full multiplication is 56 of them, and the
+ * base-point one of a commitment without a precomputed keypair is 28 cheaper
+ * comb rows.
+ */
+UwSpakeStepResult uw_spake_step_(UwSpakeState* state, int max_nibbles);
+
+bool uw_spake_get_commitment_(const UwSpakeState* state, UwBuffer* commitment);
+
+void uw_spake_get_key_(const UwSpakeState* state,
+                       uint8_t* key,
+                       size_t key_size);
+
 #endif  // LIBUWEAVE_SRC_CRYPTO_SPAKE_H_
@@ -22,6 +22,7 @@
 #include "src/settings.h"
 #include "src/setup_request.h"
 #include "src/state_reply.h"
+#include "src/time.h"
 #include "src/trace.h"
 #include "src/uw_assert.h"
 #include "uweave/config.h"
@@ -58,6 +59,10 @@ void uw_device_init(UwDevice* device,
   uw_settings_read_from_storage_(settings);
 
   uw_device_crypto_init_(&device->device_crypto);
+#if UW_ADMISSION_DEVICE_WIDE_SCALE
+  uw_admission_init_(&device->admission, UW_ADMISSION_DEVICE_WIDE_SCALE,
+                     uw_time_get_uptime_seconds_());
+#endif
 
   if (device->settings->supported_pairing_types == 0) {
     UW_LOG_WARN("Device has no supported pairing types.\n");
@@ -101,6 +106,8 @@ void uw_device_start(UwDevice* device) {
 }
 
 UwDeviceWorkState uw_device_handle_events(UwDevice* device) {
+  // Cleared before the services look for work; see uw_device_notify_work.
+  device->work_pending = false;
   bool work_remaining = false;
   if (device->first_service != NULL) {
     work_remaining |= uw_service_handle_events_(device->first_service);
@@ -108,8 +115,18 @@ UwDeviceWorkState uw_device_handle_events(UwDevice* device) {
   if (device->counter_set != NULL) {
     uw_counter_set_try_coalesce_(device->counter_set);
   }
+  // Precompute pairing keys only when nothing else is waiting.
+  if (!work_remaining) {
+    work_remaining |=
+        uw_device_crypto_refill_spake_pool_(&device->device_crypto);
+  }
   device->work_state =
       work_remaining ? kUwDeviceWorkStateBusy : kUwDeviceWorkStateIdle;
+  // A notification since the pass began may have seen the busy state and
+  // skipped the handler, so the next pass must come without one.
+  if (device->work_pending) {
+    device->work_state = kUwDeviceWorkStateBusy;
+  }
   return device->work_state;
 }
 
@@ -202,6 +219,28 @@ UwStatus uw_device_dispatch_request_(UwDevice* device,
   UwPrivetRequestApiId api_id = uw_privet_request_get_api_id_(privet_request);
 
   uw_trace_call_begin(device, api_id);
+
+  // Charge expensive calls once, not again when a pending one is resumed.
+  if (!privet_request->session->exchange_pending) {
+#if UW_ADMISSION_DEVICE_WIDE_SCALE
+    UwAdmission* device_admission = &device->admission;
+#else
+    UwAdmission* device_admission = NULL;
+#endif
+    UwStatus admission_status = uw_admission_acquire_(
+        privet_request->session->admission, device_admission, api_id,
+        uw_time_get_uptime_seconds_());
+    if (!uw_status_is_success(admission_status)) {
+      uw_device_increment_uw_counter_(
+          device, uw_admission_get_rejection_counter_(api_id));
+      uw_trace_call_end(device, api_id, admission_status);
+      return uw_privet_request_reply_privet_error_(privet_request,
+                                                   admission_status,
+                                                   /* error message */ NULL,
+                                                   /* error data */ NULL);
+    }
+  }
+
   // Breaking from the loop results in a successful completion.
   switch (api_id) {
     case kUwPrivetRequestApiIdInfo: {
@@ -212,6 +251,10 @@ UwStatus uw_device_dispatch_request_(UwDevice* device,
     }
     case kUwPrivetRequestApiIdPairingStart: {
       UwStatus pairing_start_status = uw_pairing_start_reply_(privet_request);
+      if (pairing_start_status == kUwStatusPending) {
+        // Called again from the transport's event loop until it finishes.
+        return uw_trace_call_end(device, api_id, pairing_start_status);
+      }
       if (!uw_status_is_success(pairing_start_status)) {
         uw_privet_request_reply_privet_error_(privet_request,
                                               pairing_start_status,
@@ -227,6 +270,10 @@ UwStatus uw_device_dispatch_request_(UwDevice* device,
     case kUwPrivetRequestApiIdPairingConfirm: {
       UwStatus pairing_confirm_status =
           uw_pairing_confirm_reply_(privet_request, &device->device_crypto);
+      if (pairing_confirm_status == kUwStatusPending) {
+        // Called again from the transport's event loop until it finishes.
+        return uw_trace_call_end(device, api_id, pairing_confirm_status);
+      }
       if (!uw_status_is_success(pairing_confirm_status)) {
         uw_privet_request_reply_privet_error_(privet_request,
                                               pairing_confirm_status,
@@ -404,6 +451,9 @@ UwStatus uw_device_dispatch_request_(UwDevice* device,
 }
 
 void uw_device_notify_work(UwDevice* device) {
+  // Set first: uw_device_handle_events reads it after writing work_state, so
+  // either it sees the flag or this sees the idle state and notifies.
+  device->work_pending = true;
   // Only notify once per idle->work transition.
   if (device->work_state == kUwDeviceWorkStateBusy) {
     return;
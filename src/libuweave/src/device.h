@@ -5,6 +5,7 @@
 #ifndef LIBUWEAVE_SRC_DEVICE_H_
 #define LIBUWEAVE_SRC_DEVICE_H_
 
+#include "src/admission.h"
 #include "src/device_crypto.h"
 #include "src/trace.h"
 #include "uweave/device.h"
@@ -18,8 +19,15 @@ struct UwSession_;
 struct UwDevice_ {
   UwSettings* settings;
   UwDeviceHandlers* device_handlers;
-  UwDeviceWorkState work_state;
+  // Both may be written by uw_device_notify_work from an interrupt handler.
+  // work_pending records every notification, so that one arriving while
+  // uw_device_handle_events runs is not lost when the pass ends idle.
+  volatile UwDeviceWorkState work_state;
+  volatile bool work_pending;
   UwDeviceCrypto device_crypto;
+#if UW_ADMISSION_DEVICE_WIDE_SCALE
+  UwAdmission admission;
+#endif
   UwCommandList* command_list;
   UwCounterSet* counter_set;
   struct UwService_* first_service;
@@ -38,8 +38,12 @@ void uw_device_channel_reset_(UwDeviceChannel* device_channel) {
   uw_channel_reset_(&device_channel->channel);
 }
 
-void uw_device_channel_complete_exchange_(UwDeviceChannel* device_channel) {
-  uw_channel_reset_messages_(&device_channel->channel);
+bool uw_device_channel_release_request_(UwDeviceChannel* device_channel) {
+  return uw_channel_release_message_in_(&device_channel->channel);
+}
+
+void uw_device_channel_complete_reply_(UwDeviceChannel* device_channel) {
+  uw_message_out_reset_(&device_channel->channel.message_out);
 }
 
 bool uw_device_channel_is_connected(UwDeviceChannel* device_channel) {
@@ -94,6 +98,12 @@ static bool handle_connection_request_(UwDeviceChannel* device_channel) {
   UwChannel* channel = uw_device_channel_get_channel_(device_channel);
   UwMessageIn* message_in = &channel->message_in;
 
+  if (uw_message_out_get_state_(&channel->message_out) !=
+      kUwMessageStateEmpty) {
+    UW_LOG_WARN("Connection request while a reply is being sent\n");
+    return false;
+  }
+
   uint16_t min_version = 0;
   if (!uw_message_in_read_uint16_(message_in, &min_version) ||
       min_version != 1) {
@@ -50,11 +50,15 @@ void uw_device_channel_init_(UwDeviceChannel* device_channel,
 
 void uw_device_channel_reset_(UwDeviceChannel* device_channel);
 
-/** Completes the current message exchange.
- *
- * Resets the message buffers and potentially modifies other state.
+/**
+ * Releases the request in message_in once it has been handled, so that the
+ * next one can come in while the reply is sent.  Returns false if the next
+ * request, already complete, is invalid.
  */
-void uw_device_channel_complete_exchange_(UwDeviceChannel* device_channel);
+bool uw_device_channel_release_request_(UwDeviceChannel* device_channel);
+
+/** Resets message_out once the reply has been sent. */
+void uw_device_channel_complete_reply_(UwDeviceChannel* device_channel);
 
 /** Returns true if the channel is connected. */
 bool uw_device_channel_is_connected(UwDeviceChannel* channel);
@@ -5,7 +5,10 @@
 #include "src/device_crypto.h"
 
 #include "src/buffer.h"
+#include "src/crypto_eax.h"
+#include "src/crypto_utils.h"
 #include "src/log.h"
+#include "src/time.h"
 #include "src/value.h"
 #include "src/value_scan.h"
 #include "uweave/provider/storage.h"
@@ -144,10 +147,155 @@ static UwStatus save_keys_(UwDeviceCrypto* device_crypto) {
   return uwp_storage_put(kUwStorageFileNameKeys, key_cbor_buf, len);
 }
 
+static void try_loading_spake_masks_(UwDeviceCrypto* device_crypto) {
+  uint8_t masks_cbor_buf[UW_DEVICE_CRYPTO_SPAKE_MASKS_BUFFER_LEN];
+  size_t result_len = 0;
+
+  UwStatus file_status =
+      uwp_storage_get(kUwStorageFileNameSpakeMasks, masks_cbor_buf,
+                      sizeof(masks_cbor_buf), &result_len);
+  // A missing cache is normal; it is rebuilt on the next embedded pairing.
+  if (!uw_status_is_success(file_status) || result_len == 0) {
+    return;
+  }
+
+  UwValue tag_param = uw_value_undefined();
+  UwValue local_param = uw_value_undefined();
+  UwValue remote_param = uw_value_undefined();
+
+  UwMapFormat masks_format[] = {
+      {.key = uw_value_int(UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_TAG),
+       .type = kUwValueTypeByteString,
+       .value = &tag_param},
+      {.key = uw_value_int(UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_LOCAL),
+       .type = kUwValueTypeByteString,
+       .value = &local_param},
+      {.key = uw_value_int(UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_REMOTE),
+       .type = kUwValueTypeByteString,
+       .value = &remote_param},
+  };
+
+  UwBuffer buffer;
+  uw_buffer_init(&buffer, masks_cbor_buf, sizeof(masks_cbor_buf));
+  uw_buffer_set_length_(&buffer, result_len);
+
+  UwStatus scan_result = uw_value_scan_map(
+      &buffer, masks_format, uw_value_scan_map_count(sizeof(masks_format)));
+  if (!uw_status_is_success(scan_result)) {
+    UW_LOG_WARN("Error scanning spake masks file: %d\n", scan_result);
+    return;
+  }
+
+  if (tag_param.length != sizeof(device_crypto->spake_masks_tag) ||
+      local_param.length != sizeof(device_crypto->spake_masks.local_mask) ||
+      remote_param.length != sizeof(device_crypto->spake_masks.remote_unmask)) {
+    UW_LOG_WARN("Invalid spake masks file\n");
+    return;
+  }
+
+  memcpy(device_crypto->spake_masks_tag, tag_param.value.byte_string_value,
+         sizeof(device_crypto->spake_masks_tag));
+  memcpy(device_crypto->spake_masks.local_mask,
+         local_param.value.byte_string_value,
+         sizeof(device_crypto->spake_masks.local_mask));
+  memcpy(device_crypto->spake_masks.remote_unmask,
+         remote_param.value.byte_string_value,
+         sizeof(device_crypto->spake_masks.remote_unmask));
+  device_crypto->has_spake_masks = true;
+}
+
+static UwStatus save_spake_masks_(UwDeviceCrypto* device_crypto) {
+  UwMapValue masks_data[] = {
+      {.key = uw_value_int(UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_TAG),
+       .value = uw_value_byte_array(device_crypto->spake_masks_tag,
+                                    sizeof(device_crypto->spake_masks_tag))},
+      {.key = uw_value_int(UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_LOCAL),
+       .value = uw_value_byte_array(
+           device_crypto->spake_masks.local_mask,
+           sizeof(device_crypto->spake_masks.local_mask))},
+      {.key = uw_value_int(UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_REMOTE),
+       .value = uw_value_byte_array(
+           device_crypto->spake_masks.remote_unmask,
+           sizeof(device_crypto->spake_masks.remote_unmask))},
+  };
+
+  UwValue persisted_value =
+      uw_value_map(masks_data, uw_value_map_count(sizeof(masks_data)));
+
+  uint8_t masks_cbor_buf[UW_DEVICE_CRYPTO_SPAKE_MASKS_BUFFER_LEN];
+  memset(masks_cbor_buf, 0, sizeof(masks_cbor_buf));
+
+  CborEncoder encoder;
+  cbor_encoder_init(&encoder, masks_cbor_buf, sizeof(masks_cbor_buf), 0);
+  UwStatus encoding_result = uw_value_encode_value_(&encoder, &persisted_value);
+  if (!uw_status_is_success(encoding_result)) {
+    return encoding_result;
+  }
+
+  size_t len = uwp_storage_size_align(encoder.ptr - masks_cbor_buf);
+  return uwp_storage_put(kUwStorageFileNameSpakeMasks, masks_cbor_buf, len);
+}
+
+/** Empties the mask cache file, which storage providers cannot delete. */
+static UwStatus erase_spake_masks_() {
+  uint8_t empty[UW_STORAGE_ALIGNMENT] = {};
+  return uwp_storage_put(kUwStorageFileNameSpakeMasks, empty, 0);
+}
+
+/** Tags the masks of the hashed code pw, without the code being recoverable. */
+static bool compute_spake_masks_tag_(
+    UwDeviceCrypto* device_crypto,
+    const uint8_t pw[UW_SPAKE_P224_SCALAR_SIZE],
+    uint8_t tag[UW_DEVICE_CRYPTO_SPAKE_MASKS_TAG_LEN]) {
+  UwCryptoHmacMsg messages[] = {
+      {.bytes = pw, .num_bytes = UW_SPAKE_P224_SCALAR_SIZE}};
+  return uw_crypto_hmac_with_key_(
+      &device_crypto->device_authentication_hmac_key, messages,
+      sizeof(messages) / sizeof(messages[0]), tag,
+      UW_DEVICE_CRYPTO_SPAKE_MASKS_TAG_LEN);
+}
+
+/**
+ * Replaces the ticket key, which revokes every ticket sealed with the old one.
+ * Without a new key, tickets are simply not issued.
+ */
+static void rotate_ticket_key_(UwDeviceCrypto* device_crypto) {
+  uint8_t ticket_key[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  device_crypto->has_ticket_key =
+      uwp_crypto_getrandom(ticket_key, sizeof(ticket_key)) &&
+      uwp_crypto_aes128_key_init(&device_crypto->ticket_key, ticket_key);
+  memset(ticket_key, 0, sizeof(ticket_key));
+}
+
+/** Refreshes the HMAC form of a changed key. */
+static UwStatus prepare_hmac_key_(UwCryptoHmacKey* hmac_key,
+                                  const uint8_t* key,
+                                  size_t key_len) {
+  if (!uw_crypto_hmac_key_init_(hmac_key, key, key_len)) {
+    return UW_STATUS_AND_LOG_WARN(kUwStatusInvalidArgument,
+                                  "Error preparing HMAC key\n");
+  }
+  return kUwStatusSuccess;
+}
+
+/**
+ * Drops what a new device auth or client authz key invalidates: the cached
+ * macaroon prefixes, and the resumption tickets, which stand in for tokens
+ * that the old key may have signed.  A new ephemeral pairing key does not come
+ * here, since any nearby client can have /pairing/confirm set one; tickets do
+ * not depend on it, and cached prefixes under the old one are never looked up
+ * again, as the cache ids cover the key.
+ */
+static void revoke_root_key_state_(UwDeviceCrypto* device_crypto) {
+  uw_macaroon_cache_clear_(&device_crypto->macaroon_cache);
+  rotate_ticket_key_(device_crypto);
+}
+
 UwStatus uw_device_crypto_init_(UwDeviceCrypto* device_crypto) {
   *device_crypto = (UwDeviceCrypto){};
 
   try_loading_keys_(device_crypto);
+  try_loading_spake_masks_(device_crypto);
 
   bool do_save = false;
 
@@ -179,12 +327,31 @@ UwStatus uw_device_crypto_init_(UwDeviceCrypto* device_crypto) {
     }
   }
 
-  return kUwStatusSuccess;
+  // The keys are fixed from here until pairing or claiming replaces them.
+  revoke_root_key_state_(device_crypto);
+  UwStatus prepare_status =
+      prepare_hmac_key_(&device_crypto->device_authentication_hmac_key,
+                        device_crypto->device_authentication_key,
+                        sizeof(device_crypto->device_authentication_key));
+  if (!uw_status_is_success(prepare_status)) {
+    return prepare_status;
+  }
+  prepare_status =
+      prepare_hmac_key_(&device_crypto->client_authorization_hmac_key,
+                        device_crypto->client_authorization_key,
+                        sizeof(device_crypto->client_authorization_key));
+  if (!uw_status_is_success(prepare_status)) {
+    return prepare_status;
+  }
+  return prepare_hmac_key_(&device_crypto->ephemeral_pairing_hmac_key,
+                           device_crypto->ephemeral_pairing_key,
+                           sizeof(device_crypto->ephemeral_pairing_key));
 }
 
 void uw_device_crypto_reset_(UwDeviceCrypto* device_crypto) {
   *device_crypto = (UwDeviceCrypto){};
   save_keys_(device_crypto);
+  erase_spake_masks_();
   uw_device_crypto_init_(device_crypto);
 }
 
@@ -203,6 +370,196 @@ UwStatus uw_device_crypto_remember_pairing_key_(UwDeviceCrypto* device_crypto,
   device_crypto->ephemeral_issue_timestamp = timestamp;
   memcpy(device_crypto->ephemeral_pairing_key, pairing_key,
          sizeof(device_crypto->ephemeral_pairing_key));
+  return prepare_hmac_key_(&device_crypto->ephemeral_pairing_hmac_key,
+                           device_crypto->ephemeral_pairing_key,
+                           sizeof(device_crypto->ephemeral_pairing_key));
+}
+
+UwStatus uw_device_crypto_use_cached_spake_masks_(UwDeviceCrypto* device_crypto,
+                                                  UwSpakeState* spake_state) {
+  uint8_t tag[UW_DEVICE_CRYPTO_SPAKE_MASKS_TAG_LEN];
+  if (!compute_spake_masks_tag_(device_crypto, spake_state->pw, tag)) {
+    return UW_STATUS_AND_LOG_WARN(kUwStatusInvalidArgument,
+                                  "Error tagging spake masks\n");
+  }
+  if (!device_crypto->has_spake_masks ||
+      !uw_crypto_utils_equal_(device_crypto->spake_masks_tag, tag,
+                              sizeof(tag))) {
+    // The exchange computes the masks a step at a time anyway, so it fills the
+    // cache rather than computing them here all at once.
+    device_crypto->has_spake_masks = false;
+    memcpy(device_crypto->spake_masks_tag, tag, sizeof(tag));
+    uw_spake_record_masks_(spake_state, &device_crypto->spake_masks);
+    return kUwStatusSuccess;
+  }
+
+  uw_spake_use_masks_(spake_state, &device_crypto->spake_masks);
+  return kUwStatusSuccess;
+}
+
+UwStatus uw_device_crypto_save_spake_masks_(UwDeviceCrypto* device_crypto,
+                                            const UwSpakeState* spake_state) {
+  if (device_crypto->has_spake_masks ||
+      spake_state->recorded_masks != &device_crypto->spake_masks) {
+    return kUwStatusSuccess;
+  }
+  // Another exchange may have started recording for a new code since.
+  uint8_t tag[UW_DEVICE_CRYPTO_SPAKE_MASKS_TAG_LEN];
+  if (!compute_spake_masks_tag_(device_crypto, spake_state->pw, tag) ||
+      !uw_crypto_utils_equal_(device_crypto->spake_masks_tag, tag,
+                              sizeof(tag))) {
+    return kUwStatusSuccess;
+  }
+  device_crypto->has_spake_masks = true;
+
+  // The in-memory copy is still good if the write fails.
+  UwStatus save_status = save_spake_masks_(device_crypto);
+  if (!uw_status_is_success(save_status)) {
+    UW_LOG_WARN("Spake masks not saved: %d\n", save_status);
+  }
+  return save_status;
+}
+
+/** Whether a pairing exchange has a multiplication pending in spake_mult. */
+static bool is_spake_mult_borrowed_(const UwDeviceCrypto* device_crypto) {
+  return device_crypto->spake_mult_borrower != NULL &&
+         uw_spake_is_using_mult_state_(device_crypto->spake_mult_borrower,
+                                       &device_crypto->spake_mult);
+}
+
+bool uw_device_crypto_lend_spake_mult_(UwDeviceCrypto* device_crypto,
+                                       UwSpakeState* spake_state) {
+  if (device_crypto->spake_mult_borrower != spake_state &&
+      is_spake_mult_borrowed_(device_crypto)) {
+    return false;
+  }
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  // Pairing is waiting, so the pool starts its keypair over later.
+  device_crypto->spake_pool_filling = false;
+#endif
+  device_crypto->spake_mult_borrower = spake_state;
+  uw_spake_use_mult_state_(spake_state, &device_crypto->spake_mult);
+  return true;
+}
+
+bool uw_device_crypto_refill_spake_pool_(UwDeviceCrypto* device_crypto) {
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  if (device_crypto->spake_pool_count >= UW_SPAKE_KEYPAIR_POOL_SIZE ||
+      is_spake_mult_borrowed_(device_crypto)) {
+    return false;
+  }
+  if (!device_crypto->spake_pool_filling) {
+    if (!uw_spake_keypair_begin_(&device_crypto->spake_pool_next,
+                                 &device_crypto->spake_mult)) {
+      // Leave it for pairing to fall back on rather than spinning here.
+      return false;
+    }
+    device_crypto->spake_mult_borrower = NULL;
+    device_crypto->spake_pool_filling = true;
+  }
+  if (!uw_spake_keypair_step_(&device_crypto->spake_pool_next,
+                              &device_crypto->spake_mult,
+                              UW_SPAKE_STEP_NIBBLES)) {
+    return true;
+  }
+  device_crypto->spake_pool_filling = false;
+  device_crypto->spake_pool[device_crypto->spake_pool_count++] =
+      device_crypto->spake_pool_next;
+  memset(&device_crypto->spake_pool_next, 0,
+         sizeof(device_crypto->spake_pool_next));
+  return device_crypto->spake_pool_count < UW_SPAKE_KEYPAIR_POOL_SIZE;
+#else
+  return false;
+#endif
+}
+
+bool uw_device_crypto_take_spake_keypair_(UwDeviceCrypto* device_crypto,
+                                          UwSpakeKeypair* keypair) {
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  if (device_crypto->spake_pool_count == 0) {
+    return false;
+  }
+  UwSpakeKeypair* slot =
+      &device_crypto->spake_pool[--device_crypto->spake_pool_count];
+  *keypair = *slot;
+  memset(slot, 0, sizeof(*slot));
+  return true;
+#else
+  return false;
+#endif
+}
+
+#define TICKET_NONCE_LEN 8
+#define TICKET_TAG_LEN 12
+#define TICKET_PLAINTEXT_LEN (4 + UW_DEVICE_CRYPTO_TICKET_SECRET_LEN)
+
+UwStatus uw_device_crypto_issue_ticket_(
+    UwDeviceCrypto* device_crypto,
+    const uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN],
+    uint8_t ticket[UW_DEVICE_CRYPTO_TICKET_LEN]) {
+  if (!device_crypto->has_ticket_key) {
+    return kUwStatusDeviceCryptoNoKeys;
+  }
+  if (!uwp_crypto_getrandom(ticket, TICKET_NONCE_LEN)) {
+    return kUwStatusCryptoRandomNumberFailure;
+  }
+
+  uint8_t* body = ticket + TICKET_NONCE_LEN;
+  uint32_t issued = (uint32_t)uw_time_get_uptime_seconds_();
+  body[0] = (uint8_t)(issued >> 24);
+  body[1] = (uint8_t)(issued >> 16);
+  body[2] = (uint8_t)(issued >> 8);
+  body[3] = (uint8_t)issued;
+  memcpy(body + 4, secret, UW_DEVICE_CRYPTO_TICKET_SECRET_LEN);
+
+  UwBuffer body_buffer;
+  uw_buffer_init(&body_buffer, body,
+                 UW_DEVICE_CRYPTO_TICKET_LEN - TICKET_NONCE_LEN);
+  uw_buffer_set_length_(&body_buffer, TICKET_PLAINTEXT_LEN);
+  if (!uw_eax_encrypt_(&device_crypto->ticket_key, TICKET_TAG_LEN, ticket,
+                       TICKET_NONCE_LEN, NULL, 0, &body_buffer, &body_buffer)) {
+    return UW_STATUS_AND_LOG_WARN(kUwStatusCryptoEncryptionFailed,
+                                  "Could not seal resumption ticket\n");
+  }
+  return kUwStatusSuccess;
+}
+
+UwStatus uw_device_crypto_redeem_ticket_(
+    UwDeviceCrypto* device_crypto,
+    const uint8_t* ticket,
+    size_t ticket_len,
+    uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN]) {
+  if (!device_crypto->has_ticket_key) {
+    return kUwStatusDeviceCryptoNoKeys;
+  }
+  if (ticket_len != UW_DEVICE_CRYPTO_TICKET_LEN) {
+    return UW_STATUS_AND_LOG_WARN(kUwStatusCryptoIncomingMessageInvalid,
+                                  "Invalid ticket length %d\n",
+                                  (int)ticket_len);
+  }
+
+  uint8_t body[UW_DEVICE_CRYPTO_TICKET_LEN - TICKET_NONCE_LEN];
+  memcpy(body, ticket + TICKET_NONCE_LEN, sizeof(body));
+  UwBuffer body_buffer;
+  uw_buffer_init(&body_buffer, body, sizeof(body));
+  uw_buffer_set_length_(&body_buffer, sizeof(body));
+  if (!uw_eax_decrypt_(&device_crypto->ticket_key, TICKET_TAG_LEN, ticket,
+                       TICKET_NONCE_LEN, NULL, 0, &body_buffer, &body_buffer)) {
+    return UW_STATUS_AND_LOG_WARN(kUwStatusVerificationFailed,
+                                  "Resumption ticket is invalid\n");
+  }
+
+  uint32_t issued = (uint32_t)body[0] << 24 | (uint32_t)body[1] << 16 |
+                    (uint32_t)body[2] << 8 | (uint32_t)body[3];
+  uint32_t age = (uint32_t)uw_time_get_uptime_seconds_() - issued;
+  if (age > UW_SESSION_TICKET_LIFETIME_SECONDS) {
+    memset(body, 0, sizeof(body));
+    return UW_STATUS_AND_LOG_WARN(kUwStatusSessionExpired,
+                                  "Resumption ticket expired\n");
+  }
+
+  memcpy(secret, body + 4, UW_DEVICE_CRYPTO_TICKET_SECRET_LEN);
+  memset(body, 0, sizeof(body));
   return kUwStatusSuccess;
 }
 
@@ -236,6 +593,14 @@ UwStatus uw_device_crypto_commit_pending_client_authz_key_(
          device_crypto->pending_client_authorization_key,
          sizeof(device_crypto->client_authorization_key));
   device_crypto->has_client_authz_key = true;
+  revoke_root_key_state_(device_crypto);
+  UwStatus prepare_status =
+      prepare_hmac_key_(&device_crypto->client_authorization_hmac_key,
+                        device_crypto->client_authorization_key,
+                        sizeof(device_crypto->client_authorization_key));
+  if (!uw_status_is_success(prepare_status)) {
+    return prepare_status;
+  }
   UwStatus save_status = save_keys_(device_crypto);
   if (!uw_status_is_success(save_status)) {
     return save_status;
@@ -8,8 +8,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "src/crypto_hmac.h"
 #include "src/crypto_spake.h"
 #include "src/macaroon.h"
+#include "uweave/config.h"
 #include "uweave/status.h"
 
 #define UW_DEVICE_CRYPTO_BUFFER_LEN 128
@@ -22,6 +24,21 @@
 #define UW_DEVICE_CRYPTO_KEY_CLIENT_AUTHZ_KEY 2
 #define UW_DEVICE_CRYPTO_KEY_DEVICE_ID 3
 
+#define UW_DEVICE_CRYPTO_SPAKE_MASKS_BUFFER_LEN 160
+#define UW_DEVICE_CRYPTO_SPAKE_MASKS_TAG_LEN 16
+
+#define UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_TAG 1
+#define UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_LOCAL 2
+#define UW_DEVICE_CRYPTO_SPAKE_MASKS_KEY_REMOTE 3
+
+#define UW_DEVICE_CRYPTO_TICKET_SECRET_LEN 16
+// nonce (8), issue uptime (4), secret (16), tag (12)
+#define UW_DEVICE_CRYPTO_TICKET_LEN 40
+
+/**
+ * Each macaroon root key is kept alongside its precomputed HMAC form (see
+ * uw_crypto_hmac_key_init_), which must be refreshed whenever the key changes.
+ */
 typedef struct {
   // The device_id is unique per-pairing, and is reset when the device is
   // claimed.
@@ -31,21 +48,58 @@ typedef struct {
   // To identify the device.
   bool has_device_auth_key;
   uint8_t device_authentication_key[UW_DEVICE_CRYPTO_MACAROON_KEY_LEN];
+  UwCryptoHmacKey device_authentication_hmac_key;
 
   // To authorize the client.
   bool has_client_authz_key;
   uint8_t client_authorization_key[UW_DEVICE_CRYPTO_MACAROON_KEY_LEN];
+  UwCryptoHmacKey client_authorization_hmac_key;
 
   // The key generated by the pairing process to bootstrap into /auth and
   // proceed with /accessControl.
   uint64_t ephemeral_issue_timestamp;
   uint8_t ephemeral_pairing_key[UW_SPAKE_P224_POINT_SIZE];
+  UwCryptoHmacKey ephemeral_pairing_hmac_key;
 
   // The new client_authz key is held in memory until it has been
   // correctly acknowledged by the client.  This is to ensure that communication
   // errors do not render the device inoperable without repeating pairing
   bool has_pending_client_authz_key;
   uint8_t pending_client_authorization_key[UW_DEVICE_CRYPTO_MACAROON_KEY_LEN];
+
+  // SPAKE mask points for the embedded code, which does not change between
+  // pairings.  Tagged with an HMAC of the hashed code under the device auth
+  // key, so that a new code or key replaces them and the code is not stored.
+  bool has_spake_masks;
+  uint8_t spake_masks_tag[UW_DEVICE_CRYPTO_SPAKE_MASKS_TAG_LEN];
+  UwSpakeMasks spake_masks;
+
+  // The one P-224 multiplication state of the device, about 1.6 KB, shared by
+  // the pairing exchanges of every session and the keypair pool.  Lent to
+  // spake_mult_borrower, if that exchange is still using it, or else to the
+  // pool if spake_pool_filling.
+  p224_scalar_mult_state spake_mult;
+  const UwSpakeState* spake_mult_borrower;
+
+#if UW_SPAKE_KEYPAIR_POOL_SIZE > 0
+  // Ephemeral SPAKE keypairs computed ahead of time while idle, and the one
+  // in progress, if spake_pool_filling.
+  size_t spake_pool_count;
+  UwSpakeKeypair spake_pool[UW_SPAKE_KEYPAIR_POOL_SIZE];
+  bool spake_pool_filling;
+  UwSpakeKeypair spake_pool_next;
+#endif
+
+  // Seals session resumption tickets.  Held only in memory and replaced along
+  // with the device auth or client authz key, so a reboot, factory reset or
+  // new root key revokes every outstanding ticket.  Pairing leaves it alone.
+  bool has_ticket_key;
+  UwpCryptoAes128Key ticket_key;
+
+  // Verified macaroon prefixes under any of the keys above, flushed along with
+  // the ticket key.  Entries under an old ephemeral pairing key miss, as the
+  // key is part of their id, and age out.
+  UwMacaroonCache macaroon_cache;
 } UwDeviceCrypto;
 
 /**
@@ -61,13 +115,76 @@ void uw_device_crypto_reset_(UwDeviceCrypto* device_crypto);
 
 /**
  * Records the pairing key computed in /pairing/confirm in memory for future
- * authentication. Sets a timestamp to enable expiration.
+ * authentication. Sets a timestamp to enable expiration.  Resumption tickets
+ * and cached macaroon prefixes under the root keys stay valid.
  */
 UwStatus uw_device_crypto_remember_pairing_key_(UwDeviceCrypto* device_crypto,
                                                 uint8_t* pairing_key,
                                                 size_t pairing_key_len,
                                                 uint64_t timestamp);
 
+/**
+ * Makes spake_state use cached mask points for its password.  If the cache
+ * holds masks for a different password, the exchange computes its masks as
+ * usual and records them into the cache instead; see
+ * uw_device_crypto_save_spake_masks_.  Only worthwhile for a fixed password
+ * such as the embedded code.
+ */
+UwStatus uw_device_crypto_use_cached_spake_masks_(UwDeviceCrypto* device_crypto,
+                                                  UwSpakeState* spake_state);
+
+/**
+ * Persists the masks recorded by an exchange that missed the cache in
+ * uw_device_crypto_use_cached_spake_masks_, once its finalize step is done.
+ * Does nothing for any other exchange.
+ */
+UwStatus uw_device_crypto_save_spake_masks_(UwDeviceCrypto* device_crypto,
+                                            const UwSpakeState* spake_state);
+
+/**
+ * Lends the device's multiplication state to spake_state for its next
+ * *_begin_ call (see uw_spake_use_mult_state_), dropping any keypair the pool
+ * had in progress.  Returns false, lending nothing, while the exchange of
+ * another session is still using it.
+ */
+bool uw_device_crypto_lend_spake_mult_(UwDeviceCrypto* device_crypto,
+                                       UwSpakeState* spake_state);
+
+/**
+ * Advances the keypair being added to the SPAKE pool by UW_SPAKE_STEP_NIBBLES
+ * comb rows, so that a single call costs a bounded part of one base-point
+ * multiplication.  Returns true if the pool is still not full, or false while
+ * a pairing exchange is using the multiplication state.
+ */
+bool uw_device_crypto_refill_spake_pool_(UwDeviceCrypto* device_crypto);
+
+/**
+ * Removes a precomputed keypair from the SPAKE pool into keypair.  Returns
+ * false if the pool is empty.
+ */
+bool uw_device_crypto_take_spake_keypair_(UwDeviceCrypto* device_crypto,
+                                          UwSpakeKeypair* keypair);
+
+/**
+ * Seals secret into a session resumption ticket that only this device can
+ * open, stamped with the current uptime.
+ */
+UwStatus uw_device_crypto_issue_ticket_(
+    UwDeviceCrypto* device_crypto,
+    const uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN],
+    uint8_t ticket[UW_DEVICE_CRYPTO_TICKET_LEN]);
+
+/**
+ * Opens a ticket from uw_device_crypto_issue_ticket_ and copies its secret
+ * out.  Fails if the ticket is forged, was sealed with an earlier ticket key,
+ * or is older than UW_SESSION_TICKET_LIFETIME_SECONDS.
+ */
+UwStatus uw_device_crypto_redeem_ticket_(
+    UwDeviceCrypto* device_crypto,
+    const uint8_t* ticket,
+    size_t ticket_len,
+    uint8_t secret[UW_DEVICE_CRYPTO_TICKET_SECRET_LEN]);
+
 /**
  * Generates a new client authorization key without overriding the existing one
  * for use in the /accessControl/claim flow.
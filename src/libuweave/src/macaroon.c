@@ -11,14 +11,17 @@
 #include "src/macaroon_caveat_internal.h"
 #include "src/macaroon_encoding.h"
 
-static bool create_mac_tag_(const uint8_t* key,
-                            size_t key_len,
+// Macaroons whose MAC chains are computed together by
+// uw_macaroon_validate_batch_.
+#define BATCH_LANES 8
+
+static bool create_mac_tag_(const UwCryptoHmacKey* key,
                             const UwMacaroonContext* context,
                             const UwMacaroonCaveat* const caveats[],
                             size_t num_caveats,
                             uint8_t mac_tag[UW_MACAROON_MAC_LEN]) {
-  if (key == NULL || key_len == 0 || context == NULL || caveats == NULL ||
-      num_caveats == 0 || mac_tag == NULL) {
+  if (key == NULL || context == NULL || caveats == NULL || num_caveats == 0 ||
+      mac_tag == NULL) {
     return false;
   }
 
@@ -30,8 +33,8 @@ static bool create_mac_tag_(const uint8_t* key,
   uint8_t mac_tag_buff[UW_MACAROON_MAC_LEN];
 
   // Compute the first tag by using the key
-  if (!uw_macaroon_caveat_sign_(key, key_len, context, caveats[0], mac_tag_buff,
-                                sizeof(mac_tag_buff))) {
+  if (!uw_macaroon_caveat_sign_with_key_(key, context, caveats[0], mac_tag_buff,
+                                         sizeof(mac_tag_buff))) {
     return false;
   }
 
@@ -48,24 +51,82 @@ static bool create_mac_tag_(const uint8_t* key,
   return true;
 }
 
-static bool verify_mac_tag_(const uint8_t* root_key,
-                            size_t root_key_len,
+/**
+ * Whether the MAC of a caveat depends only on its own bytes, and not on the
+ * session or challenge in the validation context.
+ */
+static bool is_context_free_caveat_(const UwMacaroonCaveat* caveat) {
+  UwMacaroonCaveatType caveat_type;
+  return uw_macaroon_caveat_get_type_(caveat, &caveat_type) &&
+         caveat_type != kUwMacaroonCaveatTypeBleSessionID &&
+         caveat_type != kUwMacaroonCaveatTypeAuthenticationChallenge;
+}
+
+static bool verify_mac_tag_(const UwCryptoHmacKey* root_key,
                             const UwMacaroonContext* context,
                             const UwMacaroonCaveat* const caveats[],
                             size_t num_caveats,
-                            const uint8_t mac_tag[UW_MACAROON_MAC_LEN]) {
-  if (root_key == NULL || root_key_len == 0 || context == NULL ||
-      caveats == NULL || num_caveats == 0 || mac_tag == 0) {
+                            const uint8_t mac_tag[UW_MACAROON_MAC_LEN],
+                            UwMacaroonCache* cache) {
+  if (root_key == NULL || context == NULL || caveats == NULL ||
+      num_caveats == 0 || mac_tag == 0) {
     return false;
   }
 
+  // Only the leading context-free caveats can be reused across validations.
+  size_t cacheable_count = 0;
+  while (cache != NULL && cacheable_count < num_caveats &&
+         is_context_free_caveat_(caveats[cacheable_count])) {
+    cacheable_count++;
+  }
+
+  // Resume from the longest prefix that an earlier validation verified.
   uint8_t computed_mac_tag[UW_MACAROON_MAC_LEN] = {0};
-  if (!create_mac_tag_(root_key, root_key_len, context, caveats, num_caveats,
-                       computed_mac_tag)) {
+  uint8_t prefix_id[UW_MACAROON_CACHE_ID_LEN] = {0};
+  size_t resume_index = 0;
+  if (cacheable_count > 0) {
+    UwpCryptoSha256State id_state;
+    uw_macaroon_cache_id_init_(&id_state, root_key);
+    for (size_t i = 0; i < cacheable_count; i++) {
+      uw_macaroon_cache_id_add_caveat_(&id_state, caveats[i], prefix_id);
+      if (uw_macaroon_cache_lookup_(cache, prefix_id, computed_mac_tag)) {
+        resume_index = i + 1;
+      }
+    }
+  }
+
+  if (resume_index == 0) {
+    if (!uw_macaroon_caveat_sign_with_key_(root_key, context, caveats[0],
+                                           computed_mac_tag,
+                                           sizeof(computed_mac_tag))) {
+      return false;
+    }
+    resume_index = 1;
+  }
+
+  uint8_t prefix_mac_tag[UW_MACAROON_MAC_LEN];
+  memcpy(prefix_mac_tag, computed_mac_tag, sizeof(prefix_mac_tag));
+  for (size_t i = resume_index; i < num_caveats; i++) {
+    if (!uw_macaroon_caveat_sign_(computed_mac_tag, sizeof(computed_mac_tag),
+                                  context, caveats[i], computed_mac_tag,
+                                  sizeof(computed_mac_tag))) {
+      return false;
+    }
+    if (i + 1 == cacheable_count) {
+      memcpy(prefix_mac_tag, computed_mac_tag, sizeof(prefix_mac_tag));
+    }
+  }
+
+  if (!uw_crypto_utils_equal_(mac_tag, computed_mac_tag,
+                              UW_MACAROON_MAC_LEN)) {
     return false;
   }
 
-  return uw_crypto_utils_equal_(mac_tag, computed_mac_tag, UW_MACAROON_MAC_LEN);
+  // Only a prefix of a fully verified macaroon is trusted for next time.
+  if (cacheable_count > 0) {
+    uw_macaroon_cache_insert_(cache, prefix_id, prefix_mac_tag);
+  }
+  return true;
 }
 
 bool uw_macaroon_create_from_root_key_(UwMacaroon* new_macaroon,
@@ -79,7 +140,25 @@ bool uw_macaroon_create_from_root_key_(UwMacaroon* new_macaroon,
     return false;
   }
 
-  if (!create_mac_tag_(root_key, root_key_len, context, caveats, num_caveats,
+  UwCryptoHmacKey hmac_key;
+  if (!uw_crypto_hmac_key_init_(&hmac_key, root_key, root_key_len)) {
+    return false;
+  }
+  return uw_macaroon_create_from_hmac_key_(new_macaroon, &hmac_key, context,
+                                           caveats, num_caveats);
+}
+
+bool uw_macaroon_create_from_hmac_key_(UwMacaroon* new_macaroon,
+                                       const UwCryptoHmacKey* root_key,
+                                       const UwMacaroonContext* context,
+                                       const UwMacaroonCaveat* const caveats[],
+                                       size_t num_caveats) {
+  if (new_macaroon == NULL || root_key == NULL || context == NULL ||
+      caveats == NULL || num_caveats == 0) {
+    return false;
+  }
+
+  if (!create_mac_tag_(root_key, context, caveats, num_caveats,
                        new_macaroon->mac_tag)) {
     return false;
   }
@@ -124,9 +203,13 @@ bool uw_macaroon_extend_(const UwMacaroon* old_macaroon,
   new_macaroon->caveats = (const UwMacaroonCaveat* const*)extended_list;
 
   // Compute the new MAC tag
-  return create_mac_tag_(old_macaroon->mac_tag, UW_MACAROON_MAC_LEN, context,
-                         new_macaroon->caveats + old_count, 1,
-                         new_macaroon->mac_tag);
+  UwCryptoHmacKey hmac_key;
+  if (!uw_crypto_hmac_key_init_(&hmac_key, old_macaroon->mac_tag,
+                                UW_MACAROON_MAC_LEN)) {
+    return false;
+  }
+  return create_mac_tag_(&hmac_key, context, new_macaroon->caveats + old_count,
+                         1, new_macaroon->mac_tag);
 }
 
 static void init_validation_result(UwMacaroonValidationResult* result) {
@@ -169,13 +252,99 @@ bool uw_macaroon_validate_(const UwMacaroon* macaroon,
   }
   init_validation_result(result);
 
-  if (root_key == NULL || root_key_len == 0 || macaroon == NULL ||
-      context == NULL || result == NULL ||
-      !verify_mac_tag_(root_key, root_key_len, context, macaroon->caveats,
-                       macaroon->num_caveats, macaroon->mac_tag)) {
+  UwCryptoHmacKey hmac_key;
+  if (root_key == NULL || root_key_len == 0 ||
+      !uw_crypto_hmac_key_init_(&hmac_key, root_key, root_key_len)) {
     return false;
   }
+  return uw_macaroon_validate_with_hmac_key_(macaroon, &hmac_key, context,
+                                             result);
+}
+
+bool uw_macaroon_validate_with_hmac_key_(const UwMacaroon* macaroon,
+                                         const UwCryptoHmacKey* root_key,
+                                         const UwMacaroonContext* context,
+                                         UwMacaroonValidationResult* result) {
+  return uw_macaroon_validate_with_cache_(macaroon, root_key, NULL, context,
+                                          result);
+}
 
+/**
+ * Checks the MAC tags of up to BATCH_LANES jobs together: every pass signs the
+ * next caveat of each job whose chain is still running, keyed by the tag of
+ * its previous caveat.
+ */
+static void verify_mac_tags_batch_(UwMacaroonValidationJob jobs[],
+                                   size_t num_jobs) {
+  uint8_t tags[BATCH_LANES][UW_MACAROON_MAC_LEN];
+  const uint8_t* tag_ptrs[BATCH_LANES];
+  UwCryptoHmacKey tag_keys[BATCH_LANES];
+  UwMacaroonCaveatSignInput inputs[BATCH_LANES];
+  UwCryptoHmacJob hmac_jobs[BATCH_LANES];
+  size_t lanes[BATCH_LANES];
+
+  size_t max_caveats = 0;
+  for (size_t i = 0; i < num_jobs; i++) {
+    if (jobs[i].is_valid && jobs[i].macaroon->num_caveats > max_caveats) {
+      max_caveats = jobs[i].macaroon->num_caveats;
+    }
+  }
+
+  for (size_t c = 0; c < max_caveats; c++) {
+    size_t num_lanes = 0;
+    for (size_t i = 0; i < num_jobs; i++) {
+      if (jobs[i].is_valid && c < jobs[i].macaroon->num_caveats) {
+        lanes[num_lanes] = i;
+        tag_ptrs[num_lanes++] = tags[i];
+      }
+    }
+
+    // Past the first caveat the key is the previous tag.
+    if (c > 0 && !uw_crypto_hmac_key_init_batch_(tag_keys, tag_ptrs,
+                                                 UW_MACAROON_MAC_LEN,
+                                                 num_lanes)) {
+      for (size_t l = 0; l < num_lanes; l++) {
+        jobs[lanes[l]].is_valid = false;
+      }
+      continue;
+    }
+
+    size_t num_hmacs = 0;
+    for (size_t l = 0; l < num_lanes; l++) {
+      UwMacaroonValidationJob* job = &jobs[lanes[l]];
+      if (!uw_macaroon_caveat_sign_input_(job->context,
+                                          job->macaroon->caveats[c],
+                                          &inputs[l])) {
+        job->is_valid = false;
+        continue;
+      }
+      hmac_jobs[num_hmacs++] = (UwCryptoHmacJob){
+          .key = (c == 0) ? job->root_key : &tag_keys[l],
+          .messages = inputs[l].messages,
+          .num_messages = inputs[l].num_messages,
+          .truncated_digest = tags[lanes[l]],
+          .truncated_digest_len = UW_MACAROON_MAC_LEN};
+    }
+    if (!uw_crypto_hmac_batch_with_key_(hmac_jobs, num_hmacs)) {
+      for (size_t l = 0; l < num_lanes; l++) {
+        jobs[lanes[l]].is_valid = false;
+      }
+    }
+  }
+
+  for (size_t i = 0; i < num_jobs; i++) {
+    if (jobs[i].is_valid) {
+      jobs[i].is_valid = uw_crypto_utils_equal_(
+          jobs[i].macaroon->mac_tag, tags[i], UW_MACAROON_MAC_LEN);
+    }
+  }
+  memset(tag_keys, 0, sizeof(tag_keys));
+}
+
+/** Checks every caveat of a macaroon whose MAC tag has been verified. */
+static bool validate_caveats_(const UwMacaroon* macaroon,
+                              const UwMacaroonContext* context,
+                              UwMacaroonValidationResult* result) {
   UwMacaroonValidationState state;
   if (!uw_macaroon_caveat_init_validation_state_(&state)) {
     return false;
@@ -192,6 +361,54 @@ bool uw_macaroon_validate_(const UwMacaroon* macaroon,
   return true;
 }
 
+void uw_macaroon_validate_batch_(UwMacaroonValidationJob jobs[],
+                                 size_t num_jobs) {
+  for (size_t i = 0; i < num_jobs; i++) {
+    UwMacaroonValidationJob* job = &jobs[i];
+    job->is_valid = job->result != NULL;
+    if (!job->is_valid) {
+      continue;
+    }
+    init_validation_result(job->result);
+    job->is_valid = job->root_key != NULL && job->macaroon != NULL &&
+                    job->context != NULL && job->macaroon->caveats != NULL &&
+                    job->macaroon->num_caveats != 0;
+  }
+
+  for (size_t first = 0; first < num_jobs; first += BATCH_LANES) {
+    size_t count = num_jobs - first;
+    verify_mac_tags_batch_(jobs + first,
+                           count < BATCH_LANES ? count : BATCH_LANES);
+  }
+
+  for (size_t i = 0; i < num_jobs; i++) {
+    UwMacaroonValidationJob* job = &jobs[i];
+    if (job->is_valid) {
+      job->is_valid = validate_caveats_(job->macaroon, job->context,
+                                        job->result);
+    }
+  }
+}
+
+bool uw_macaroon_validate_with_cache_(const UwMacaroon* macaroon,
+                                      const UwCryptoHmacKey* root_key,
+                                      UwMacaroonCache* cache,
+                                      const UwMacaroonContext* context,
+                                      UwMacaroonValidationResult* result) {
+  if (result == NULL) {
+    return false;
+  }
+  init_validation_result(result);
+
+  if (root_key == NULL || macaroon == NULL || context == NULL ||
+      !verify_mac_tag_(root_key, context, macaroon->caveats,
+                       macaroon->num_caveats, macaroon->mac_tag, cache)) {
+    return false;
+  }
+
+  return validate_caveats_(macaroon, context, result);
+}
+
 // Encode a Macaroon to a byte string
 bool uw_macaroon_serialize_(const UwMacaroon* macaroon,
                             uint8_t* out,
@@ -10,6 +10,8 @@
 #include <stdint.h>
 #include <time.h>
 
+#include "src/crypto_hmac.h"
+#include "src/macaroon_cache.h"
 #include "src/macaroon_caveat.h"
 #include "src/macaroon_context.h"
 
@@ -63,6 +65,16 @@ bool uw_macaroon_create_from_root_key_(UwMacaroon* new_macaroon,
                                        const UwMacaroonCaveat* const caveats[],
                                        size_t num_caveats);
 
+/**
+ * Same as uw_macaroon_create_from_root_key_, with the root key already
+ * prepared by uw_crypto_hmac_key_init_.
+ */
+bool uw_macaroon_create_from_hmac_key_(UwMacaroon* new_macaroon,
+                                       const UwCryptoHmacKey* root_key,
+                                       const UwMacaroonContext* context,
+                                       const UwMacaroonCaveat* const caveats[],
+                                       size_t num_caveats);
+
 /**
  * Creates a new macaroon with a new caveat. The buffer must be large enough to
  * hold the count of caveats in the old_macaroon plus one.
@@ -85,6 +97,44 @@ bool uw_macaroon_validate_(const UwMacaroon* macaroon,
                            const UwMacaroonContext* context,
                            UwMacaroonValidationResult* result);
 
+/**
+ * Same as uw_macaroon_validate_, with the root key already prepared by
+ * uw_crypto_hmac_key_init_.  Use this for long-lived device keys.
+ */
+bool uw_macaroon_validate_with_hmac_key_(const UwMacaroon* macaroon,
+                                         const UwCryptoHmacKey* root_key,
+                                         const UwMacaroonContext* context,
+                                         UwMacaroonValidationResult* result);
+
+/**
+ * Same as uw_macaroon_validate_with_hmac_key_, but reuses the MAC of a caveat
+ * prefix verified by an earlier call with the same cache and key, so that only
+ * the caveats appended since are signed.  The cache must be cleared whenever
+ * root_key changes.  A NULL cache disables caching.
+ */
+bool uw_macaroon_validate_with_cache_(const UwMacaroon* macaroon,
+                                      const UwCryptoHmacKey* root_key,
+                                      UwMacaroonCache* cache,
+                                      const UwMacaroonContext* context,
+                                      UwMacaroonValidationResult* result);
+
+/** One macaroon of a batch for uw_macaroon_validate_batch_. */
+typedef struct {
+  const UwMacaroon* macaroon;
+  const UwCryptoHmacKey* root_key;
+  const UwMacaroonContext* context;
+  UwMacaroonValidationResult* result;
+  bool is_valid;  // Set by uw_macaroon_validate_batch_.
+} UwMacaroonValidationJob;
+
+/**
+ * Same as uw_macaroon_validate_with_hmac_key_ on each job, but the MAC chains
+ * of the jobs are computed side by side with the batched HMAC functions, which
+ * raises throughput where many tokens are checked at once.
+ */
+void uw_macaroon_validate_batch_(UwMacaroonValidationJob jobs[],
+                                 size_t num_jobs);
+
 /** Encode a Macaroon to a byte string. */
 bool uw_macaroon_serialize_(const UwMacaroon* macaroon,
                             uint8_t* out,
@@ -0,0 +1,85 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "src/macaroon_cache.h"
+
+#include <string.h>
+
+#include "src/crypto_utils.h"
+
+void uw_macaroon_cache_id_init_(UwpCryptoSha256State* id_state,
+                                const UwCryptoHmacKey* root_key) {
+  // The pad midstates identify the key without the raw key being available.
+  uwp_crypto_sha256_init(id_state);
+  uwp_crypto_sha256_update(id_state, (const uint8_t*)root_key->inner.state,
+                           sizeof(root_key->inner.state));
+  uwp_crypto_sha256_update(id_state, (const uint8_t*)root_key->outer.state,
+                           sizeof(root_key->outer.state));
+}
+
+void uw_macaroon_cache_id_add_caveat_(UwpCryptoSha256State* id_state,
+                                      const UwMacaroonCaveat* caveat,
+                                      uint8_t id[UW_MACAROON_CACHE_ID_LEN]) {
+  // Length-prefix each caveat so that different splits of the same bytes do
+  // not collide.
+  uint8_t length[4] = {
+      (uint8_t)(caveat->num_bytes >> 24), (uint8_t)(caveat->num_bytes >> 16),
+      (uint8_t)(caveat->num_bytes >> 8), (uint8_t)caveat->num_bytes};
+  uwp_crypto_sha256_update(id_state, length, sizeof(length));
+  uwp_crypto_sha256_update(id_state, caveat->bytes, caveat->num_bytes);
+
+  UwpCryptoSha256State final_state;
+  uint8_t digest[UWP_CRYPTO_SHA256_DIGEST_LEN];
+  uwp_crypto_sha256_clone(id_state, &final_state);
+  uwp_crypto_sha256_final(&final_state, digest);
+  memcpy(id, digest, UW_MACAROON_CACHE_ID_LEN);
+}
+
+bool uw_macaroon_cache_lookup_(UwMacaroonCache* cache,
+                               const uint8_t id[UW_MACAROON_CACHE_ID_LEN],
+                               uint8_t mac_tag[UW_MACAROON_CACHE_TAG_LEN]) {
+#if UW_MACAROON_CACHE_SIZE > 0
+  for (size_t i = 0; i < UW_MACAROON_CACHE_SIZE; ++i) {
+    UwMacaroonCacheEntry* entry = &cache->entries[i];
+    if (entry->valid &&
+        uw_crypto_utils_equal_(entry->id, id, UW_MACAROON_CACHE_ID_LEN)) {
+      entry->last_used = ++cache->use_count;
+      memcpy(mac_tag, entry->mac_tag, UW_MACAROON_CACHE_TAG_LEN);
+      return true;
+    }
+  }
+#endif
+  return false;
+}
+
+void uw_macaroon_cache_insert_(
+    UwMacaroonCache* cache,
+    const uint8_t id[UW_MACAROON_CACHE_ID_LEN],
+    const uint8_t mac_tag[UW_MACAROON_CACHE_TAG_LEN]) {
+#if UW_MACAROON_CACHE_SIZE > 0
+  UwMacaroonCacheEntry* victim = &cache->entries[0];
+  for (size_t i = 0; i < UW_MACAROON_CACHE_SIZE; ++i) {
+    UwMacaroonCacheEntry* entry = &cache->entries[i];
+    if (entry->valid &&
+        uw_crypto_utils_equal_(entry->id, id, UW_MACAROON_CACHE_ID_LEN)) {
+      victim = entry;
+      break;
+    }
+    if (!entry->valid) {
+      victim = entry;
+    } else if (victim->valid && entry->last_used < victim->last_used) {
+      victim = entry;
+    }
+  }
+
+  victim->valid = true;
+  victim->last_used = ++cache->use_count;
+  memcpy(victim->id, id, UW_MACAROON_CACHE_ID_LEN);
+  memcpy(victim->mac_tag, mac_tag, UW_MACAROON_CACHE_TAG_LEN);
+#endif
+}
+
+void uw_macaroon_cache_clear_(UwMacaroonCache* cache) {
+  memset(cache, 0, sizeof(*cache));
+}
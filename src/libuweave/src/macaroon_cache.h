@@ -0,0 +1,68 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_SRC_MACAROON_CACHE_H_
+#define LIBUWEAVE_SRC_MACAROON_CACHE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "src/crypto_hmac.h"
+#include "src/macaroon_caveat.h"
+#include "uweave/config.h"
+
+#define UW_MACAROON_CACHE_ID_LEN 16
+// Matches UW_MACAROON_MAC_LEN; macaroon.h includes this header.
+#define UW_MACAROON_CACHE_TAG_LEN 16
+
+/**
+ * A verified caveat prefix: the identity of a root key and the caveats signed
+ * with it, and the MAC tag they chain to.
+ */
+typedef struct {
+  bool valid;
+  uint32_t last_used;
+  uint8_t id[UW_MACAROON_CACHE_ID_LEN];
+  uint8_t mac_tag[UW_MACAROON_CACHE_TAG_LEN];
+} UwMacaroonCacheEntry;
+
+/**
+ * A small LRU cache of macaroon MAC tags over caveat prefixes, so that a token
+ * presented again only needs its new caveats signed.  Only prefixes of
+ * macaroons that verified completely are stored.
+ */
+typedef struct {
+  uint32_t use_count;
+#if UW_MACAROON_CACHE_SIZE > 0
+  UwMacaroonCacheEntry entries[UW_MACAROON_CACHE_SIZE];
+#endif
+} UwMacaroonCache;
+
+/**
+ * Hashes the identity of a prefix incrementally: start with the root key,
+ * then add one caveat at a time, reading out the id after each.
+ */
+void uw_macaroon_cache_id_init_(UwpCryptoSha256State* id_state,
+                                const UwCryptoHmacKey* root_key);
+
+void uw_macaroon_cache_id_add_caveat_(UwpCryptoSha256State* id_state,
+                                      const UwMacaroonCaveat* caveat,
+                                      uint8_t id[UW_MACAROON_CACHE_ID_LEN]);
+
+/** Copies the tag stored for id into mac_tag.  Returns false on a miss. */
+bool uw_macaroon_cache_lookup_(UwMacaroonCache* cache,
+                               const uint8_t id[UW_MACAROON_CACHE_ID_LEN],
+                               uint8_t mac_tag[UW_MACAROON_CACHE_TAG_LEN]);
+
+/** Stores the tag for id, evicting the least recently used entry if full. */
+void uw_macaroon_cache_insert_(
+    UwMacaroonCache* cache,
+    const uint8_t id[UW_MACAROON_CACHE_ID_LEN],
+    const uint8_t mac_tag[UW_MACAROON_CACHE_TAG_LEN]);
+
+/** Drops every entry, e.g. when a root key changes. */
+void uw_macaroon_cache_clear_(UwMacaroonCache* cache);
+
+#endif  // LIBUWEAVE_SRC_MACAROON_CACHE_H_
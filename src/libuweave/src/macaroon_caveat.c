@@ -352,8 +352,35 @@ bool uw_macaroon_caveat_sign_(const uint8_t* key,
                               const UwMacaroonCaveat* caveat,
                               uint8_t* mac_tag,
                               size_t mac_tag_size) {
-  if (key == NULL || key_len == 0 || context == NULL || caveat == NULL ||
-      mac_tag == NULL || mac_tag_size == 0) {
+  UwCryptoHmacKey hmac_key;
+  if (!uw_crypto_hmac_key_init_(&hmac_key, key, key_len)) {
+    return false;
+  }
+  return uw_macaroon_caveat_sign_with_key_(&hmac_key, context, caveat, mac_tag,
+                                           mac_tag_size);
+}
+
+bool uw_macaroon_caveat_sign_with_key_(const UwCryptoHmacKey* key,
+                                       const UwMacaroonContext* context,
+                                       const UwMacaroonCaveat* caveat,
+                                       uint8_t* mac_tag,
+                                       size_t mac_tag_size) {
+  if (key == NULL || mac_tag == NULL || mac_tag_size == 0) {
+    return false;
+  }
+
+  UwMacaroonCaveatSignInput input;
+  if (!uw_macaroon_caveat_sign_input_(context, caveat, &input)) {
+    return false;
+  }
+  return uw_crypto_hmac_with_key_(key, input.messages, input.num_messages,
+                                  mac_tag, mac_tag_size);
+}
+
+bool uw_macaroon_caveat_sign_input_(const UwMacaroonContext* context,
+                                    const UwMacaroonCaveat* caveat,
+                                    UwMacaroonCaveatSignInput* input) {
+  if (context == NULL || caveat == NULL || input == NULL) {
     return false;
   }
 
@@ -366,24 +393,20 @@ bool uw_macaroon_caveat_sign_(const uint8_t* key,
 
   // If there is no additional value from the context, just compute the HMAC on
   // the current byte string.
-  uint8_t caveat_cbor_prefix[UW_MACAROON_ENCODING_MAX_UINT_CBOR_LEN] = {0};
   size_t caveat_cbor_prefix_len = 0;
   if (caveat_type != kUwMacaroonCaveatTypeBleSessionID &&
       caveat_type != kUwMacaroonCaveatTypeAuthenticationChallenge) {
     if (!uw_macaroon_encoding_encode_byte_str_len_(
-            (uint32_t)(caveat->num_bytes), caveat_cbor_prefix,
-            sizeof(caveat_cbor_prefix), &caveat_cbor_prefix_len)) {
+            (uint32_t)(caveat->num_bytes), input->caveat_cbor_prefix,
+            sizeof(input->caveat_cbor_prefix), &caveat_cbor_prefix_len)) {
       return false;
     }
 
-    UwCryptoHmacMsg messages[] = {
-        {caveat_cbor_prefix, caveat_cbor_prefix_len},
-        {caveat->bytes, caveat->num_bytes},
-    };
-
-    return uw_crypto_hmac_(key, key_len, messages,
-                           sizeof(messages) / sizeof(messages[0]), mac_tag,
-                           mac_tag_size);
+    input->messages[0] =
+        (UwCryptoHmacMsg){input->caveat_cbor_prefix, caveat_cbor_prefix_len};
+    input->messages[1] = (UwCryptoHmacMsg){caveat->bytes, caveat->num_bytes};
+    input->num_messages = 2;
+    return true;
   }
 
   // If there is additional value from the context.
@@ -406,11 +429,10 @@ bool uw_macaroon_caveat_sign_(const uint8_t* key,
     additional_value_str_len = context->auth_challenge_str_len;
   }
 
-  uint8_t value_cbor_prefix[UW_MACAROON_ENCODING_MAX_UINT_CBOR_LEN] = {0};
   size_t value_cbor_prefix_len = 0;
   if (!uw_macaroon_encoding_encode_byte_str_len_(
-          (uint32_t)additional_value_str_len, value_cbor_prefix,
-          sizeof(value_cbor_prefix), &value_cbor_prefix_len)) {
+          (uint32_t)additional_value_str_len, input->value_cbor_prefix,
+          sizeof(input->value_cbor_prefix), &value_cbor_prefix_len)) {
     return false;
   }
 
@@ -419,21 +441,20 @@ bool uw_macaroon_caveat_sign_(const uint8_t* key,
   size_t total_length =
       caveat->num_bytes + value_cbor_prefix_len + additional_value_str_len;
   if (!uw_macaroon_encoding_encode_byte_str_len_(
-          (uint32_t)total_length, caveat_cbor_prefix,
-          sizeof(caveat_cbor_prefix), &caveat_cbor_prefix_len)) {
+          (uint32_t)total_length, input->caveat_cbor_prefix,
+          sizeof(input->caveat_cbor_prefix), &caveat_cbor_prefix_len)) {
     return false;
   }
 
-  UwCryptoHmacMsg messages[] = {
-      {caveat_cbor_prefix, caveat_cbor_prefix_len},
-      {caveat->bytes, caveat->num_bytes},
-      {value_cbor_prefix, value_cbor_prefix_len},
-      {additional_value_str, additional_value_str_len},
-  };
-
-  return uw_crypto_hmac_(key, key_len, messages,
-                         sizeof(messages) / sizeof(messages[0]), mac_tag,
-                         mac_tag_size);
+  input->messages[0] =
+      (UwCryptoHmacMsg){input->caveat_cbor_prefix, caveat_cbor_prefix_len};
+  input->messages[1] = (UwCryptoHmacMsg){caveat->bytes, caveat->num_bytes};
+  input->messages[2] =
+      (UwCryptoHmacMsg){input->value_cbor_prefix, value_cbor_prefix_len};
+  input->messages[3] =
+      (UwCryptoHmacMsg){additional_value_str, additional_value_str_len};
+  input->num_messages = 4;
+  return true;
 }
 
 static bool update_and_check_expiration_time(
@@ -9,8 +9,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "src/crypto_hmac.h"
 #include "src/macaroon.h"
 #include "src/macaroon_caveat.h"
+#include "src/macaroon_encoding.h"
 
 bool uw_macaroon_caveat_sign_(const uint8_t* key,
                               size_t key_len,
@@ -19,6 +21,29 @@ bool uw_macaroon_caveat_sign_(const uint8_t* key,
                               uint8_t* mac_tag,
                               size_t mac_tag_size);
 
+/** Same as uw_macaroon_caveat_sign_ with a precomputed HMAC key. */
+bool uw_macaroon_caveat_sign_with_key_(const UwCryptoHmacKey* key,
+                                       const UwMacaroonContext* context,
+                                       const UwMacaroonCaveat* caveat,
+                                       uint8_t* mac_tag,
+                                       size_t mac_tag_size);
+
+/** The HMAC messages that sign a caveat, and the CBOR headers they use. */
+typedef struct {
+  uint8_t caveat_cbor_prefix[UW_MACAROON_ENCODING_MAX_UINT_CBOR_LEN];
+  uint8_t value_cbor_prefix[UW_MACAROON_ENCODING_MAX_UINT_CBOR_LEN];
+  UwCryptoHmacMsg messages[4];
+  size_t num_messages;
+} UwMacaroonCaveatSignInput;
+
+/**
+ * Lays out what uw_macaroon_caveat_sign_with_key_ signs, so that callers can
+ * batch the HMACs.  The messages point into input, caveat and context.
+ */
+bool uw_macaroon_caveat_sign_input_(const UwMacaroonContext* context,
+                                    const UwMacaroonCaveat* caveat,
+                                    UwMacaroonCaveatSignInput* input);
+
 typedef struct {
   uint32_t issued_time;  // 0 when invalid or not set.
 } UwMacaroonValidationState;
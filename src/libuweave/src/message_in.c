@@ -121,9 +121,20 @@ UwBuffer* uw_message_in_get_buffer_(UwMessageIn* message_in) {
   return message_in->buffer;
 }
 
-UwMessageState uw_message_in_append_packet_(UwMessageIn* message_in,
+uint8_t* uw_message_in_get_append_cursor_(UwMessageIn* message_in,
+                                          size_t data_length) {
+  uint8_t* bytes = NULL;
+  size_t size = 0;
+  uw_buffer_get_bytes_(message_in->buffer, &bytes, &size);
+  size_t length = uw_buffer_get_length(message_in->buffer);
+  if (data_length > size - length) {
+    return NULL;
+  }
+  return bytes + length;
+}
+
+UwMessageState uw_message_in_commit_packet_(UwMessageIn* message_in,
                                             uint8_t packet_header,
-                                            const uint8_t* data_bytes,
                                             size_t data_length) {
   bool first_packet;
   bool last_packet;
@@ -150,16 +161,30 @@ UwMessageState uw_message_in_append_packet_(UwMessageIn* message_in,
     UW_LOG_ERROR("Expected first packet.\n");
     message_in->state = kUwMessageStateError;
 
+  } else if (uw_message_in_get_append_cursor_(message_in, data_length) ==
+             NULL) {
+    UW_LOG_ERROR("Error appending packet data.\n");
+    message_in->state = kUwMessageStateError;
+
   } else {
-    if (uw_buffer_append(message_in->buffer, data_bytes, data_length)) {
-      message_in->type = type;
-      message_in->state =
-          last_packet ? kUwMessageStateComplete : kUwMessageStateBusy;
-    } else {
-      UW_LOG_ERROR("Error appending packet data.\n");
-      message_in->state = kUwMessageStateError;
-    }
+    uw_buffer_set_length_(
+        message_in->buffer,
+        uw_buffer_get_length(message_in->buffer) + data_length);
+    message_in->type = type;
+    message_in->state =
+        last_packet ? kUwMessageStateComplete : kUwMessageStateBusy;
   }
 
   return message_in->state;
 }
+
+UwMessageState uw_message_in_append_packet_(UwMessageIn* message_in,
+                                            uint8_t packet_header,
+                                            const uint8_t* data_bytes,
+                                            size_t data_length) {
+  uint8_t* cursor = uw_message_in_get_append_cursor_(message_in, data_length);
+  if (cursor != NULL) {
+    memcpy(cursor, data_bytes, data_length);
+  }
+  return uw_message_in_commit_packet_(message_in, packet_header, data_length);
+}
@@ -71,6 +71,22 @@ UwMessageState uw_message_in_get_state_(UwMessageIn* message_in);
 /** Returns a pointer the message buffer passed into init_(). */
 UwBuffer* uw_message_in_get_buffer_(UwMessageIn* message_in);
 
+/**
+ * Returns where the next packet's data_length bytes belong in the message
+ * buffer, so that they can be received in place, or NULL if they do not fit.
+ * Nothing is appended until uw_message_in_commit_packet_().
+ */
+uint8_t* uw_message_in_get_append_cursor_(UwMessageIn* message_in,
+                                          size_t data_length);
+
+/**
+ * Appends the next packet, whose data_length bytes have already been written
+ * at the append cursor, and returns the new message state.
+ */
+UwMessageState uw_message_in_commit_packet_(UwMessageIn* message_in,
+                                            uint8_t packet_header,
+                                            size_t data_length);
+
 /**
  * Appends the next packet to this message and returns the new message state.
  */
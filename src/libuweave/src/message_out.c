@@ -114,16 +114,12 @@ UwBuffer* uw_message_out_get_buffer_(UwMessageOut* message_out) {
   return message_out->buffer;
 }
 
-UwMessageState uw_message_out_get_next_packet_(UwMessageOut* message_out,
-                                               UwBuffer* packet_buffer,
-                                               size_t max_packet_size,
-                                               uint8_t packet_counter) {
-  if (uw_buffer_get_length(packet_buffer) != 0) {
-    UW_ASSERT(false, "Expected empty packet buffer.\n");
-    message_out->state = kUwMessageStateError;
-    return message_out->state;
-  }
-
+UwMessageState uw_message_out_take_next_packet_(UwMessageOut* message_out,
+                                                size_t max_packet_size,
+                                                uint8_t packet_counter,
+                                                uint8_t* packet_header,
+                                                const uint8_t** data_bytes,
+                                                size_t* data_length) {
   if (message_out->state != kUwMessageStateBusy) {
     UW_ASSERT(false, "Expected message state to be busy: %i\n",
               (int)message_out->state);
@@ -131,22 +127,6 @@ UwMessageState uw_message_out_get_next_packet_(UwMessageOut* message_out,
     return message_out->state;
   }
 
-  size_t packet_buffer_size = uw_buffer_get_size(packet_buffer);
-
-  if (packet_buffer_size < max_packet_size) {
-    UW_ASSERT(false, "Expected larger packet buffer.\n");
-    message_out->state = kUwMessageStateError;
-    return message_out->state;
-  }
-
-  if (message_out->state == kUwMessageStateError ||
-      message_out->state == kUwMessageStateComplete) {
-    UW_ASSERT(false, "Can't get next packet, current state: %i\n",
-              (int)message_out->state);
-    message_out->state = kUwMessageStateError;
-    return message_out->state;
-  }
-
   const uint8_t* message_bytes = NULL;
   size_t message_length = 0;
   uw_buffer_get_const_bytes(message_out->buffer, &message_bytes,
@@ -170,10 +150,8 @@ UwMessageState uw_message_out_get_next_packet_(UwMessageOut* message_out,
     is_last = true;
   }
 
-  uint8_t packet_header;
-
   if (message_out->type == kUwMessageTypeData) {
-    packet_header = uw_packet_header_new_data_(
+    *packet_header = uw_packet_header_new_data_(
         /* is_first */ message_out->packet_offset == 0,
         is_last, packet_counter);
   } else {
@@ -183,19 +161,45 @@ UwMessageState uw_message_out_get_next_packet_(UwMessageOut* message_out,
       return message_out->state;
     }
 
-    packet_header = uw_packet_header_new_control_(
+    *packet_header = uw_packet_header_new_control_(
         uw_message_type_to_header_cmd_(message_out->type), packet_counter);
   }
 
-  if (uw_buffer_append(packet_buffer, &packet_header, 1) &&
-      uw_buffer_append(packet_buffer,
-                       message_bytes + message_out->packet_offset,
-                       packet_data_length)) {
-    message_out->packet_offset += packet_data_length;
-    message_out->state =
-        is_last ? kUwMessageStateComplete : kUwMessageStateBusy;
+  *data_bytes = message_bytes + message_out->packet_offset;
+  *data_length = packet_data_length;
+  message_out->packet_offset += packet_data_length;
+  message_out->state = is_last ? kUwMessageStateComplete : kUwMessageStateBusy;
+  return message_out->state;
+}
 
-  } else {
+UwMessageState uw_message_out_get_next_packet_(UwMessageOut* message_out,
+                                               UwBuffer* packet_buffer,
+                                               size_t max_packet_size,
+                                               uint8_t packet_counter) {
+  if (uw_buffer_get_length(packet_buffer) != 0) {
+    UW_ASSERT(false, "Expected empty packet buffer.\n");
+    message_out->state = kUwMessageStateError;
+    return message_out->state;
+  }
+
+  if (uw_buffer_get_size(packet_buffer) < max_packet_size) {
+    UW_ASSERT(false, "Expected larger packet buffer.\n");
+    message_out->state = kUwMessageStateError;
+    return message_out->state;
+  }
+
+  uint8_t packet_header = 0;
+  const uint8_t* data_bytes = NULL;
+  size_t data_length = 0;
+  if (uw_message_out_take_next_packet_(message_out, max_packet_size,
+                                       packet_counter, &packet_header,
+                                       &data_bytes, &data_length) ==
+      kUwMessageStateError) {
+    return message_out->state;
+  }
+
+  if (!uw_buffer_append(packet_buffer, &packet_header, 1) ||
+      !uw_buffer_append(packet_buffer, data_bytes, data_length)) {
     UW_ASSERT(false, "Error appending packet data.\n");
     message_out->state = kUwMessageStateError;
   }
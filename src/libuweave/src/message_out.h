@@ -83,6 +83,18 @@ void uw_message_out_discard_(UwMessageOut* message_out);
 /** Returns a pointer the message buffer passed into init_(). */
 UwBuffer* uw_message_out_get_buffer_(UwMessageOut* message_out);
 
+/**
+ * Takes the next portion of the message without copying it: returns its packet
+ * header, and the span of the message buffer that follows the header in the
+ * packet.  The span stays valid until the message is reset.
+ */
+UwMessageState uw_message_out_take_next_packet_(UwMessageOut* message_out,
+                                                size_t max_packet_size,
+                                                uint8_t packet_counter,
+                                                uint8_t* packet_header,
+                                                const uint8_t** data_bytes,
+                                                size_t* data_length);
+
 /**
  * Copies the next portion of the message into the given packet buffer.
  *
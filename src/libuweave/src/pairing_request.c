@@ -7,6 +7,7 @@
 #include <string.h>
 
 #include "src/buffer.h"
+#include "src/counters.h"
 #include "src/crypto_eax.h"
 #include "src/crypto_spake.h"
 #include "src/device.h"
@@ -19,6 +20,7 @@
 #include "src/time.h"
 #include "src/value.h"
 #include "tinycbor/src/cbor.h"
+#include "uweave/config.h"
 #include "uweave/embedded_code.h"
 #include "uweave/pairing_callback.h"
 #include "uweave/pairing_type.h"
@@ -71,7 +73,11 @@ bool get_embedded_code_(UwSettings* settings, char** embedded_code_str) {
   }
 }
 
-UwStatus uw_pairing_start_reply_(UwPrivetRequest* privet_request) {
+/**
+ * Validates a /pairing/start request, sets up the SPAKE exchange and starts
+ * computing the device commitment.
+ */
+static UwStatus begin_pairing_start_(UwPrivetRequest* privet_request) {
   UwBuffer* privet_param_buffer =
       uw_privet_request_get_param_buffer_(privet_request);
 
@@ -174,21 +180,34 @@ UwStatus uw_pairing_start_reply_(UwPrivetRequest* privet_request) {
   }
 
   UwSession* session = uw_privet_request_get_session_(privet_request);
+  UwDevice* device = session->device;
   UwSpakeState* spake_state = &session->server_spake_state;
   uw_spake_init_(spake_state, true, pairing_buf,
                  uw_buffer_get_length(&pairing_passcode_buffer));
-  uint8_t* device_commitment_buf = session->device_commitment_buf;
-  UwBuffer device_commitment;
-  uw_buffer_init(&device_commitment, device_commitment_buf,
-                 UW_SPAKE_P224_POINT_SIZE);
 
-  if (!uw_spake_compute_commitment_(spake_state, &device_commitment)) {
-    return kUwStatusPrivetInvalidParam;
+  // Use a keypair computed while idle if there is one; the pool is refilled
+  // by uw_device_handle_events.
+  UwSpakeKeypair keypair;
+  if (uw_device_crypto_take_spake_keypair_(&device->device_crypto, &keypair)) {
+    uw_spake_use_keypair_(spake_state, &keypair);
+    memset(&keypair, 0, sizeof(keypair));
+    uw_device_increment_uw_counter_(device, kUwInternalCounterSpakePoolHit);
+  } else {
+    uw_device_increment_uw_counter_(device, kUwInternalCounterSpakePoolMiss);
+  }
+  if (pairing_type == kUwPairingTypeEmbeddedCode) {
+    // The embedded code rarely changes, so its mask points are cached.
+    UwStatus masks_status = uw_device_crypto_use_cached_spake_masks_(
+        &device->device_crypto, spake_state);
+    if (!uw_status_is_success(masks_status)) {
+      return masks_status;
+    }
   }
 
   session->pairing_session_id = generate_session_id();
 
-  // Inform the pairing callback that pairing is beginning.
+  // Inform the pairing callback that pairing is beginning.  This runs before
+  // the commitment is computed so the passcode can be shown meanwhile.
   UwSettings* settings = privet_request->session->device->settings;
   if (settings->pairing_callback.begin != NULL) {
     UwPairingBegin pairing_begin_callback = settings->pairing_callback.begin;
@@ -199,6 +218,52 @@ UwStatus uw_pairing_start_reply_(UwPrivetRequest* privet_request) {
     }
   }
 
+  return kUwStatusSuccess;
+}
+
+UwStatus uw_pairing_start_reply_(UwPrivetRequest* privet_request) {
+  UwSession* session = uw_privet_request_get_session_(privet_request);
+  UwSpakeState* spake_state = &session->server_spake_state;
+
+  // The first call sets up the exchange; later calls only continue the
+  // commitment, which is spread over several event loop passes.
+  if (!session->exchange_pending) {
+    UwStatus begin_status = begin_pairing_start_(privet_request);
+    if (!uw_status_is_success(begin_status)) {
+      return begin_status;
+    }
+    session->spake_step_started = false;
+  }
+  if (!session->spake_step_started) {
+    // Waits while another session's exchange uses the multiplication state.
+    if (!uw_device_crypto_lend_spake_mult_(&session->device->device_crypto,
+                                           spake_state)) {
+      return kUwStatusPending;
+    }
+    if (!uw_spake_commitment_begin_(spake_state)) {
+      return kUwStatusPrivetInvalidParam;
+    }
+    session->spake_step_started = true;
+  }
+
+  switch (uw_spake_step_(spake_state, UW_SPAKE_STEP_NIBBLES)) {
+    case kUwSpakeStepBusy:
+      return kUwStatusPending;
+    case kUwSpakeStepDone:
+      break;
+    default:
+      return kUwStatusPrivetInvalidParam;
+  }
+
+  uint8_t* device_commitment_buf = session->device_commitment_buf;
+  UwBuffer device_commitment;
+  uw_buffer_init(&device_commitment, device_commitment_buf,
+                 UW_SPAKE_P224_POINT_SIZE);
+
+  if (!uw_spake_get_commitment_(spake_state, &device_commitment)) {
+    return kUwStatusPrivetInvalidParam;
+  }
+
   UwMapValue result[] = {
       {.key = uw_value_int(PRIVET_PAIRING_START_KEY_SESSION_ID),
        .value = uw_value_int(session->pairing_session_id)},
@@ -284,8 +349,14 @@ static UwStatus set_time_from_encrypted_timestamp_(
 
   static const uint8_t timestamp_nonce = 0;
 
-  if (!uw_eax_decrypt_(ephemeral_pairing_key, /* tag_length */ 12,
-                       &timestamp_nonce, sizeof(timestamp_nonce), /* ad */ NULL,
+  UwpCryptoAes128Key pairing_key;
+  if (!uwp_crypto_aes128_key_init(&pairing_key, ephemeral_pairing_key)) {
+    return UW_STATUS_AND_LOG_WARN(kUwStatusInvalidArgument,
+                                  "Error expanding pairing key.\n");
+  }
+
+  if (!uw_eax_decrypt_(&pairing_key, /* tag_length */ 12, &timestamp_nonce,
+                       sizeof(timestamp_nonce), /* ad */ NULL,
                        /* ad_length */ 0, &encrypted_buffer,
                        &decrypted_buffer)) {
     return UW_STATUS_AND_LOG_WARN(kUwStatusInvalidArgument,
@@ -373,26 +444,51 @@ UwStatus uw_pairing_confirm_reply_(UwPrivetRequest* privet_request,
         (unsigned int)session_id);
   }
 
-  uint8_t client_commitment_bytes[UW_SPAKE_P224_POINT_SIZE];
+  UwSpakeState* spake_state = &session->server_spake_state;
 
-  // The client commitment comes in as a request parameter.
-  UwBuffer client_commitment;
-  uw_buffer_init(&client_commitment, client_commitment_bytes,
-                 UW_SPAKE_P224_POINT_SIZE);
-  uw_buffer_append(&client_commitment,
-                   client_commitment_param.value.byte_string_value,
+  // The parameters are parsed again on every call, but the exchange is only
+  // started once, when the device's multiplication state is free (another
+  // session's exchange may be using it); the calls after continue it.
+  if (!session->exchange_pending) {
+    session->spake_step_started = false;
+  }
+  if (!session->spake_step_started) {
+    if (!uw_device_crypto_lend_spake_mult_(device_crypto, spake_state)) {
+      return kUwStatusPending;
+    }
+    uint8_t client_commitment_bytes[UW_SPAKE_P224_POINT_SIZE];
+
+    // The client commitment comes in as a request parameter.
+    UwBuffer client_commitment;
+    uw_buffer_init(&client_commitment, client_commitment_bytes,
                    UW_SPAKE_P224_POINT_SIZE);
+    uw_buffer_append(&client_commitment,
+                     client_commitment_param.value.byte_string_value,
+                     UW_SPAKE_P224_POINT_SIZE);
 
-  UwSpakeState* spake_state = &session->server_spake_state;
+    // Merge in the client_commitment to start computing the pairing key.
+    if (!uw_spake_finalize_begin_(spake_state, &client_commitment)) {
+      return UW_STATUS_AND_LOG_WARN(kUwStatusPrivetInvalidParam,
+                                    "Error finalizing SPAKE exchange.");
+    }
+    session->spake_step_started = true;
+  }
 
-  // Merge in the client_commitment get the pairing the key.
-  uint8_t ephemeral_pairing_key[UW_SPAKE_P224_POINT_SIZE];
-  if (!uw_spake_finalize_(spake_state, &client_commitment,
-                          ephemeral_pairing_key,
-                          sizeof(ephemeral_pairing_key))) {
-    return UW_STATUS_AND_LOG_WARN(kUwStatusPrivetInvalidParam,
-                                  "Error finalizing SPAKE exchange.");
+  switch (uw_spake_step_(spake_state, UW_SPAKE_STEP_NIBBLES)) {
+    case kUwSpakeStepBusy:
+      return kUwStatusPending;
+    case kUwSpakeStepDone:
+      break;
+    default:
+      return UW_STATUS_AND_LOG_WARN(kUwStatusPrivetInvalidParam,
+                                    "Error finalizing SPAKE exchange.");
   }
+
+  uw_device_crypto_save_spake_masks_(device_crypto, spake_state);
+
+  uint8_t ephemeral_pairing_key[UW_SPAKE_P224_POINT_SIZE];
+  uw_spake_get_key_(spake_state, ephemeral_pairing_key,
+                    sizeof(ephemeral_pairing_key));
   uw_device_crypto_remember_pairing_key_(device_crypto, ephemeral_pairing_key,
                                          sizeof(ephemeral_pairing_key),
                                          uw_time_get_timestamp_seconds_());
@@ -472,9 +568,15 @@ UwStatus uw_pairing_confirm_reply_(UwPrivetRequest* privet_request,
 
   static const uint8_t tokens_nonce = 1;
 
-  if (!uw_eax_encrypt_(device_crypto->ephemeral_pairing_key,
-                       /* tag_length */ 12, &tokens_nonce, sizeof(tokens_nonce),
-                       /* ad */ NULL, /* ad_length */ 0,
+  UwpCryptoAes128Key pairing_key;
+  if (!uwp_crypto_aes128_key_init(&pairing_key,
+                                  device_crypto->ephemeral_pairing_key)) {
+    return UW_STATUS_AND_LOG_WARN(kUwStatusInvalidArgument,
+                                  "Error expanding pairing key.\n");
+  }
+
+  if (!uw_eax_encrypt_(&pairing_key, /* tag_length */ 12, &tokens_nonce,
+                       sizeof(tokens_nonce), /* ad */ NULL, /* ad_length */ 0,
                        &serialized_macaroons_buffer,
                        &encrypted_tokens_buffer)) {
     return UW_STATUS_AND_LOG_WARN(kUwStatusInvalidArgument,
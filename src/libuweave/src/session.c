@@ -71,6 +71,50 @@ bool uw_session_handshake_exchange_(UwSession* session,
   return true;
 }
 
+/**
+ * Hands a decrypted request to the device and encrypts its reply.  A handler
+ * that returns kUwStatusPending leaves the request in place, and is called
+ * again with it from uw_session_resume_exchange_.
+ */
+static UwStatus dispatch_and_encrypt_(UwSession* session,
+                                      UwBuffer* request,
+                                      UwBuffer* reply) {
+  // Dispatch the decrypted message to the device
+  UwStatus dispatch_status =
+      uw_device_message_exchange_(session->device, session, request, reply);
+  session->exchange_pending = (dispatch_status == kUwStatusPending);
+  if (session->exchange_pending) {
+    // Anything written so far is redone when the handler resumes.
+    uw_buffer_reset(reply);
+    return dispatch_status;
+  }
+  if (!uw_status_is_success(dispatch_status)) {
+    UW_LOG_ERROR("Device could not handle message.\n");
+    return uw_trace_session(session->device, kUwTraceSessionDispatch,
+                            dispatch_status);
+  }
+
+#if CHANNEL_VERBOSE > CHANNEL_VERBOSE_NONE
+  uw_buffer_dump_for_debug_(reply, "Outgoing message before encryption");
+#endif
+
+  // Encrypt the outgoing message
+  UwStatus out_status =
+      uw_channel_encryption_process_out_(&session->crypto_state, reply);
+  if (!uw_status_is_success(out_status)) {
+    UW_LOG_ERROR("Encryption layer failed to handle outgoing message.\n");
+    uw_device_increment_uw_counter_(session->device,
+                                    kUwInternalCounterSessionEncryptionFailure);
+    return uw_trace_session(session->device, kUwTraceSessionProcessOut,
+                            out_status);
+  }
+#if CHANNEL_VERBOSE > CHANNEL_VERBOSE_PLAINTEXT
+  uw_buffer_dump_for_debug_(reply, "Outgoing message after encryption");
+#endif
+
+  return dispatch_status;
+}
+
 UwStatus uw_session_message_exchange_(UwSession* session,
                                       UwBuffer* request,
                                       UwBuffer* reply) {
@@ -105,43 +149,30 @@ UwStatus uw_session_message_exchange_(UwSession* session,
   uw_buffer_dump_for_debug_(request, "Incoming message after decryption");
 #endif
 
-  // Dispatch the decrypted message to the device
-  UwStatus dispatch_status =
-      uw_device_message_exchange_(session->device, session, request, reply);
-  if (!uw_status_is_success(dispatch_status)) {
-    UW_LOG_ERROR("Device could not handle message.\n");
-    return uw_trace_session(session->device, kUwTraceSessionDispatch,
-                            dispatch_status);
-  }
-
-#if CHANNEL_VERBOSE > CHANNEL_VERBOSE_NONE
-  uw_buffer_dump_for_debug_(reply, "Outgoing message before encryption");
-#endif
+  return dispatch_and_encrypt_(session, request, reply);
+}
 
-  // Encrypt the outgoing message
-  UwStatus out_status =
-      uw_channel_encryption_process_out_(&session->crypto_state, reply);
-  if (!uw_status_is_success(out_status)) {
-    UW_LOG_ERROR("Encryption layer failed to handle outgoing message.\n");
-    uw_device_increment_uw_counter_(session->device,
-                                    kUwInternalCounterSessionEncryptionFailure);
-    return uw_trace_session(session->device, kUwTraceSessionProcessOut,
-                            out_status);
+UwStatus uw_session_resume_exchange_(UwSession* session,
+                                     UwBuffer* request,
+                                     UwBuffer* reply) {
+  if (!session->valid || !session->exchange_pending) {
+    UW_LOG_ERROR("Attempt to resume an exchange that is not pending.\n");
+    return kUwStatusInvalidArgument;
   }
-#if CHANNEL_VERBOSE > CHANNEL_VERBOSE_PLAINTEXT
-  uw_buffer_dump_for_debug_(reply, "Outgoing message after encryption");
-#endif
-
-  return dispatch_status;
+  return dispatch_and_encrypt_(session, request, reply);
 }
 
 void uw_session_invalidate_(UwSession* session) {
-  *session = (UwSession){.device = session->device, .role = kUwRoleUnspecified};
+  *session = (UwSession){.device = session->device,
+                         .role = kUwRoleUnspecified,
+                         .admission = session->admission};
 }
 
 void uw_session_start_valid_(UwSession* session) {
-  *session = (UwSession){
-      .device = session->device, .valid = true, .role = kUwRoleUnspecified};
+  *session = (UwSession){.device = session->device,
+                         .valid = true,
+                         .role = kUwRoleUnspecified,
+                         .admission = session->admission};
 }
 
 UwStatus uw_session_role_at_least(UwSession* session, UwRole minimum_role) {
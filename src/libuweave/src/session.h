@@ -39,10 +39,19 @@ struct UwSession_ {
   uint8_t device_commitment_buf[UW_SPAKE_P224_POINT_SIZE];
   // The session ID established during pairing.
   uint32_t pairing_session_id;
+  // Whether the last request was left pending by its handler and must be
+  // finished with uw_session_resume_exchange_ before the next one is read.
+  bool exchange_pending;
+  // Whether the pending pairing request has begun its SPAKE step, rather than
+  // waiting for the device's multiplication state.
+  bool spake_step_started;
   // Time when the session expires as seconds from the unix epoch.
   time_t expiration_time;
   // The encryption layer state
   UwChannelEncryptionState crypto_state;
+  // Admission buckets of the connection (see src/admission.h), kept across
+  // session resets, or NULL if the transport does not limit its connections.
+  struct UwAdmission_* admission;
 };
 
 void uw_session_init_(UwSession* session, UwDevice* device);
@@ -67,12 +76,23 @@ bool uw_session_handshake_exchange_(UwSession* session,
  *
  * Inbound message is given in the `request` buffer, response should be appended
  * to the `reply` buffer.  There are no size restrictions on the reply other
- * than the available space in the reply buffer.
+ * than the available space in the reply buffer.  Returns kUwStatusPending with
+ * an empty reply if the handler needs more time; see
+ * uw_session_resume_exchange_.
  */
 UwStatus uw_session_message_exchange_(UwSession* session,
                                       UwBuffer* request,
                                       UwBuffer* reply);
 
+/**
+ * Calls the handler of a request that uw_session_message_exchange_ left
+ * pending again.  `request` must still hold the decrypted message.  Returns
+ * kUwStatusPending until the handler has produced its reply.
+ */
+UwStatus uw_session_resume_exchange_(UwSession* session,
+                                     UwBuffer* request,
+                                     UwBuffer* reply);
+
 /** Clears a session on client disconnect or timeout. */
 void uw_session_invalidate_(UwSession* session);
 /** Marks a new session as valid. */
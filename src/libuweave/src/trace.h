@@ -30,6 +30,7 @@ typedef enum {
   kUwTraceBleEventConnect = 1,
   kUwTraceBleEventDisconnect = 2,
   kUwTraceBleEventDisconnectDrop = 3,
+  kUwTraceBleEventConnectRefused = 4,
 } UwTraceBleEvent;
 
 typedef enum {
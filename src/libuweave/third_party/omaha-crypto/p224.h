@@ -25,10 +25,48 @@ extern "C" {
 typedef uint8_t u8;
 typedef uint32_t u32;
 
+// Hosts with a 128-bit integer type (64-bit GCC and Clang targets) use four
+// 56-bit limbs per coordinate; everything else uses eight 28-bit limbs.
+// Define P224_LIMB64 to 0 to force the 32-bit code; it changes the layout of
+// p224_point, so it must be the same for every file that includes this one.
+#ifndef P224_LIMB64
+#if defined(__SIZEOF_INT128__)
+#define P224_LIMB64 1
+#else
+#define P224_LIMB64 0
+#endif
+#endif
+
+#if P224_LIMB64
+typedef uint64_t p224_limb;
+#define P224_NLIMBS 4
+// Packs a field element written as eight 28-bit limbs, each < 2**28, into
+// the native limbs, so that constants can be shared by both layouts.
+#define P224_FELEM(l0, l1, l2, l3, l4, l5, l6, l7) \
+  {(l0) | ((p224_limb)(l1) << 28), (l2) | ((p224_limb)(l3) << 28), \
+   (l4) | ((p224_limb)(l5) << 28), (l6) | ((p224_limb)(l7) << 28)}
+#else
+typedef u32 p224_limb;
+#define P224_NLIMBS 8
+#define P224_FELEM(l0, l1, l2, l3, l4, l5, l6, l7) \
+  {l0, l1, l2, l3, l4, l5, l6, l7}
+#endif
+
 typedef struct {
-  u32 x[8], y[8], z[8];
+  p224_limb x[P224_NLIMBS], y[P224_NLIMBS], z[P224_NLIMBS];
 } p224_point;
 
+// In-progress p224_point_mul, for callers that cannot afford to run a whole
+// multiplication at once.
+typedef struct {
+  p224_point tbl[16];
+  p224_point out;
+  u32 out_is_infinity_mask;
+  u8 scalar[28];
+  int position;  // Next 4-bit window of scalar, 0 to length.
+  int length;    // 56 windows, or 28 comb rows for the generator.
+} p224_scalar_mult_state;
+
 // Parse and check validity of a point from binary input.
 // Input size should be 2 * 28 (56) bytes.
 // Returns 0 on failure.
@@ -47,6 +85,22 @@ void p224_point_mul(const p224_point* input,
                     const u8 scalar[28],
                     p224_point* out);
 
+// Resumable form of p224_point_mul. Begin builds the window table, each step
+// processes up to max_nibbles of the 56 4-bit windows of scalar and returns
+// nonzero once all of them are done, and finish writes the product and clears
+// the state. The result is identical to p224_point_mul.
+void p224_scalar_mult_begin(p224_scalar_mult_state* state,
+                            const p224_point* input,
+                            const u8 scalar[28]);
+int p224_scalar_mult_step(p224_scalar_mult_state* state, int max_nibbles);
+void p224_scalar_mult_finish(p224_scalar_mult_state* state, p224_point* out);
+
+// Resumable form of p224_base_point_mul, driven by p224_scalar_mult_step and
+// p224_scalar_mult_finish. Each of its 28 steps is one row of the generator
+// comb, which costs less than a 4-bit window of p224_point_mul.
+void p224_base_point_mult_begin(p224_scalar_mult_state* state,
+                                const u8 scalar[28]);
+
 // Add two points.
 // out cannot point to a or b.
 void p224_point_add(const p224_point* a, const p224_point* b, p224_point* out);
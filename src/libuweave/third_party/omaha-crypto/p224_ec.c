@@ -44,33 +44,250 @@ typedef uint64_t u64;
 // Using 28-bit limbs means that there's only 4 bits of headroom, which is less
 // than we would really like. But it has the useful feature that we hit 2**224
 // exactly, making the reflections during a reduce much nicer.
-
-typedef u32 limb;
-#define NLIMBS 8
+//
+// When P224_LIMB64 is set (see p224.h), a felem is instead an array of 4 u64's
+// holding 56-bit limbs:
+//   a[0] + 2**56·a[1] + 2**112·a[2] + 2**168·a[3]
+// Mul and Square then need 16 and 10 64x64->128 bit products rather than 64
+// and 36 32x32->64 bit ones, and there are 8 bits of headroom per limb. The
+// point arithmetic below is shared by both layouts; only the field element
+// functions differ.
+
+typedef p224_limb limb;
+#define NLIMBS P224_NLIMBS
 typedef limb felem[NLIMBS];
 
 // kP is the P224 prime.
-static const felem kP = {
+static const felem kP = P224_FELEM(
   1, 0, 0, 268431360,
-  268435455, 268435455, 268435455, 268435455,
-};
+  268435455, 268435455, 268435455, 268435455);
 
 // kB is parameter of the elliptic curve.
-static const felem kB = {
+static const felem kB = P224_FELEM(
   55967668, 11768882, 265861671, 185302395,
-  39211076, 180311059, 84673715, 188764328,
-};
+  39211076, 180311059, 84673715, 188764328);
+
+static void Contract(felem inout);
+
+#if P224_LIMB64
+
+typedef unsigned __int128 u128;
+
+static const limb kBottom56Bits = 0xffffffffffffff;
 
-// kBasep224_point is the base point (generator) of the elliptic curve group.
-static const p224_point kBasep224_point = {
-  {22813985, 52956513, 34677300, 203240812,
-   12143107, 133374265, 225162431, 191946955},
-  {83918388, 223877528, 122119236, 123340192,
-   266784067, 263504429, 146143011, 198407736},
-  {1, 0, 0, 0, 0, 0, 0, 0},
+// IsZero returns 0xffffffff if a == 0 mod p and 0 otherwise.
+static u32 IsZero(const felem a) {
+  int i;
+
+  felem minimal;
+  memcpy(minimal, a, sizeof(minimal));
+  Contract(minimal);
+
+  limb is_zero = 0, is_p = 0;
+  for (i = 0; i < NLIMBS; i++) {
+    is_zero |= minimal[i];
+    is_p |= minimal[i] ^ kP[i];
+  }
+
+  // Both are < 2**56, so x-1 has its MSB set iff x is 0.
+  return (u32)(0 - (((is_zero - 1) | (is_p - 1)) >> 63));
+}
+
+// Add computes *out = a+b
+//
+// a[i] + b[i] < 2**64
+static void Add(felem out, const felem a, const felem b) {
+  int i;
+  for (i = 0; i < NLIMBS; i++) {
+    out[i] = a[i] + b[i];
+  }
+}
+
+#define kTwo60p4  (1ull<<60) + (1ull<<4)
+#define kTwo60m4  (1ull<<60) - (1ull<<4)
+#define kTwo60m44m4  (1ull<<60) - (1ull<<44) - (1ull<<4)
+// kZero60ModP is 16·p with bit 60 set in all limbs so that we can subtract
+// smaller amounts without underflow.
+static const felem kZero60ModP = {
+  kTwo60p4, kTwo60m44m4, kTwo60m4, kTwo60m4
 };
 
-static void Contract(felem inout);
+// Subtract computes *out = a-b
+//
+// a[i] < 2**62, b[i] < 2**59
+// out[i] < 2**63
+static void Subtract(felem out, const felem a, const felem b) {
+  int i;
+  for (i = 0; i < NLIMBS; i++) {
+    out[i] = a[i] + kZero60ModP[i] - b[i];
+  }
+}
+
+// lfelem holds the 7 coefficients of a product, still 56 bits apart.
+typedef u128 lfelem[7];
+
+// ReduceLarge converts a lfelem to a felem. This is the reduction from
+// OpenSSL's ecp_nistp224.c.
+//
+// in[i] < 2**126
+// out[0..2] < 2**56, out[3] < 2**57
+static void ReduceLarge(felem out, const lfelem in) {
+  static const u128 kTwo127p15 = ((u128)1 << 127) + ((u128)1 << 15);
+  static const u128 kTwo127m71 = ((u128)1 << 127) - ((u128)1 << 71);
+  static const u128 kTwo127m71m55 =
+      ((u128)1 << 127) - ((u128)1 << 71) - ((u128)1 << 55);
+  u128 acc[5];
+
+  // Add 0 mod p (2**15·p) so that the differences below stay positive.
+  acc[0] = in[0] + kTwo127p15;
+  acc[1] = in[1] + kTwo127m71m55;
+  acc[2] = in[2] + kTwo127m71;
+  acc[3] = in[3];
+  acc[4] = in[4];
+
+  // Eliminate in[6], in[5] and then acc[4] using 2**224 = 2**96 - 1 mod p.
+  acc[4] += in[6] >> 16;
+  acc[3] += (in[6] & 0xffff) << 40;
+  acc[2] -= in[6];
+
+  acc[3] += in[5] >> 16;
+  acc[2] += (in[5] & 0xffff) << 40;
+  acc[1] -= in[5];
+
+  acc[2] += acc[4] >> 16;
+  acc[1] += (acc[4] & 0xffff) << 40;
+  acc[0] -= acc[4];
+
+  // Carry 2 -> 3 -> 4.
+  acc[3] += acc[2] >> 56;
+  acc[2] &= kBottom56Bits;
+
+  acc[4] = acc[3] >> 56;
+  acc[3] &= kBottom56Bits;
+  // acc[2] < 2**56, acc[3] < 2**56, acc[4] < 2**72
+
+  // Eliminate acc[4] again.
+  acc[2] += acc[4] >> 16;
+  acc[1] += (acc[4] & 0xffff) << 40;
+  acc[0] -= acc[4];
+
+  // Carry 0 -> 1 -> 2 -> 3.
+  acc[1] += acc[0] >> 56;
+  out[0] = (limb)(acc[0] & kBottom56Bits);
+
+  acc[2] += acc[1] >> 56;
+  out[1] = (limb)(acc[1] & kBottom56Bits);
+
+  acc[3] += acc[2] >> 56;
+  out[2] = (limb)(acc[2] & kBottom56Bits);
+
+  // acc[3] <= 2**56 + 2**17
+  out[3] = (limb)acc[3];
+}
+
+// Mul computes *out = a*b
+//
+// a[i] < 2**61, b[i] < 2**61
+// out[i] < 2**57
+static void Mul(felem out, const felem a, const felem b) {
+  lfelem tmp;
+
+  tmp[0] = (u128)a[0] * b[0];
+  tmp[1] = (u128)a[0] * b[1] + (u128)a[1] * b[0];
+  tmp[2] = (u128)a[0] * b[2] + (u128)a[1] * b[1] + (u128)a[2] * b[0];
+  tmp[3] = (u128)a[0] * b[3] + (u128)a[1] * b[2] + (u128)a[2] * b[1] +
+           (u128)a[3] * b[0];
+  tmp[4] = (u128)a[1] * b[3] + (u128)a[2] * b[2] + (u128)a[3] * b[1];
+  tmp[5] = (u128)a[2] * b[3] + (u128)a[3] * b[2];
+  tmp[6] = (u128)a[3] * b[3];
+
+  ReduceLarge(out, tmp);
+}
+
+// Square computes *out = a*a
+//
+// a[i] < 2**61
+// out[i] < 2**57
+static void Square(felem out, const felem a) {
+  lfelem tmp;
+
+  tmp[0] = (u128)a[0] * a[0];
+  tmp[1] = (u128)a[0] * (a[1] << 1);
+  tmp[2] = (u128)a[0] * (a[2] << 1) + (u128)a[1] * a[1];
+  tmp[3] = (u128)a[0] * (a[3] << 1) + (u128)a[1] * (a[2] << 1);
+  tmp[4] = (u128)a[1] * (a[3] << 1) + (u128)a[2] * a[2];
+  tmp[5] = (u128)a[2] * (a[3] << 1);
+  tmp[6] = (u128)a[3] * a[3];
+
+  ReduceLarge(out, tmp);
+}
+
+// Reduce reduces the coefficients of in_out to smaller bounds.
+//
+// On entry: a[i] < 2**63
+// On exit: a[i] < 2**57
+static void Reduce(felem a) {
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    a[i+1] += a[i] >> 56;
+    a[i] &= kBottom56Bits;
+  }
+  limb top = a[3] >> 56;
+  a[3] &= kBottom56Bits;
+
+  // top < 2**8. Eliminate it while maintaining the same value mod p.
+  a[0] -= top;
+  a[1] += top << 40;
+
+  // If that made a[0] negative then top was non-zero, so a[1] >= 2**40 and we
+  // can carry down to a[0].
+  limb mask = 0 - (a[0] >> 63);
+  a[0] += mask & ((limb)1 << 56);
+  a[1] -= mask & 1;
+}
+
+// Contract converts a felem to its minimal, distinguished form.
+//
+// On entry, in[i] < 2**63
+// On exit, in[i] < 2**56
+static void Contract(felem out) {
+  int i;
+
+  Reduce(out);
+
+  // Only out[1] may still be >= 2**56. Carrying it can push out[3] over 2**56
+  // once more, but then out[1] is left < 2**48.
+  for (i = 1; i < 3; i++) {
+    out[i+1] += out[i] >> 56;
+    out[i] &= kBottom56Bits;
+  }
+  limb top = out[3] >> 56;
+  out[3] &= kBottom56Bits;
+
+  out[0] -= top;
+  out[1] += top << 40;
+  limb mask = 0 - (out[0] >> 63);
+  out[0] += mask & ((limb)1 << 56);
+  out[1] -= mask & 1;
+
+  // The value is < 2**224, but maybe greater than p. Compute out - p and keep
+  // it unless the subtraction borrowed.
+  felem diff;
+  limb borrow = 0;
+  for (i = 0; i < NLIMBS; i++) {
+    diff[i] = out[i] - kP[i] - borrow;
+    borrow = diff[i] >> 63;
+    diff[i] &= kBottom56Bits;
+  }
+
+  mask = borrow - 1;
+  for (i = 0; i < NLIMBS; i++) {
+    out[i] ^= mask & (out[i] ^ diff[i]);
+  }
+}
+
+#else  // P224_LIMB64
 
 // IsZero returns 0xffffffff if a == 0 mod p and 0 otherwise.
 static u32 IsZero(const felem a) {
@@ -280,6 +497,8 @@ static void Reduce(felem a) {
   a[0] += mask & (1<<28);
 }
 
+#endif  // P224_LIMB64
+
 // Invert calcuates *out = in**-1 by computing in**(2**224 - 2**96 - 1), i.e.
 // Fermat's little theorem.
 static void Invert(felem out, const felem in) {
@@ -331,6 +550,8 @@ static void Invert(felem out, const felem in) {
   Mul(out, f1, f3);                      // 2**224 - 2**96 - 1
 }
 
+#if !P224_LIMB64
+
 // Contract converts a felem to its minimal, distinguished form.
 //
 // On entry, in[i] < 2**29
@@ -450,6 +671,8 @@ static void Contract(felem out) {
   out[7] -= 0xfffffff & mask;
 }
 
+#endif  // !P224_LIMB64
+
 
 // Group element functions.
 //
@@ -513,7 +736,7 @@ static void AddJacobian(p224_point *out,
   // All variables we test here are output from IsZero(), thus either 0 or -1.
   // We use a fixed timing evaluation of the total expression.
   // The if() body never gets executed during private scalar multiplies,
-  // (e.g. ScalarMult()) but might trigger during public ecdsa verify computation.
+  // (e.g. AddNibble()) but might trigger during public ecdsa verify computation.
   if (x_equal & y_equal & ~z1_is_zero & ~z2_is_zero) {
     // The two input points are the same (and finite),
     // therefore we must use the dedicated doubling function
@@ -625,10 +848,11 @@ static void CopyConditional(p224_point* out,
                             const p224_point* a,
                             u32 mask) {
   int i;
+  limb limb_mask = 0 - (limb)(mask & 1);
   for (i = 0; i < NLIMBS; i++) {
-    out->x[i] ^= mask & (a->x[i] ^ out->x[i]);
-    out->y[i] ^= mask & (a->y[i] ^ out->y[i]);
-    out->z[i] ^= mask & (a->z[i] ^ out->z[i]);
+    out->x[i] ^= limb_mask & (a->x[i] ^ out->x[i]);
+    out->y[i] ^= limb_mask & (a->y[i] ^ out->y[i]);
+    out->z[i] ^= limb_mask & (a->z[i] ^ out->z[i]);
   }
 }
 
@@ -653,66 +877,374 @@ static void SelectJacobian(const p224_point table[16],
   }
 }
 
-// ScalarMult calculates *out = a*scalar where scalar is a big-endian number of
-// length scalar_len and != 0.
-static void ScalarMult(p224_point* out,
-                       const p224_point* a,
-                       const u8* scalar,
-                       int scalar_len) {
-  p224_point tbl[16], tmp;
-  u32 out_is_infinity_mask, tmp_is_noninfinite_mask, mask;
+// AddNibble folds the next 4-bit window of the scalar into state->out. The
+// first window skips the doublings, since out is still the point at infinity.
+static void AddNibble(p224_scalar_mult_state* state, u32 idx) {
+  p224_point* out = &state->out;
+  p224_point tmp;
+  u32 tmp_is_noninfinite_mask, mask;
+
+  if (state->position) {
+    DoubleJacobian(out, out);
+    DoubleJacobian(out, out);
+    DoubleJacobian(out, out);
+    DoubleJacobian(out, out);
+  }
+
+  SelectJacobian(state->tbl, idx, &tmp);
+  AddJacobian(&state->tbl[0], &tmp, out);
+  CopyConditional(out, &tmp, state->out_is_infinity_mask);
+
+  tmp_is_noninfinite_mask = NON_ZERO_TO_ALL_ONES(idx);
+  mask = tmp_is_noninfinite_mask & ~state->out_is_infinity_mask;
+
+  CopyConditional(out, &state->tbl[0], mask);
+
+  state->out_is_infinity_mask &= ~tmp_is_noninfinite_mask;
+}
+
+void p224_scalar_mult_begin(p224_scalar_mult_state* state,
+                            const p224_point* a,
+                            const u8 scalar[28]) {
   int i;
 
-  memset(out, 0, sizeof(*out));
-  tbl[0] = *out;
-  tbl[1] = *a;
+  memset(&state->out, 0, sizeof(state->out));
+  state->tbl[0] = state->out;
+  state->tbl[1] = *a;
   for (i = 2; i < 16; i += 2) {
-    DoubleJacobian(&tbl[i], &tbl[i / 2]);
-    AddJacobian(&tbl[i + 1], &tbl[i], a);
+    DoubleJacobian(&state->tbl[i], &state->tbl[i / 2]);
+    AddJacobian(&state->tbl[i + 1], &state->tbl[i], a);
   }
-  out_is_infinity_mask = -1;
+  state->out_is_infinity_mask = -1;
+  memcpy(state->scalar, scalar, sizeof(state->scalar));
+  state->position = 0;
+  state->length = 2 * 28;
+}
 
-  for (i = 0; i < scalar_len; i++) {
-    u32 idx;
+static void AddCombRow(p224_scalar_mult_state* state);
 
-    if (i) {
-      DoubleJacobian(out, out);
-      DoubleJacobian(out, out);
-      DoubleJacobian(out, out);
-      DoubleJacobian(out, out);
+int p224_scalar_mult_step(p224_scalar_mult_state* state, int max_nibbles) {
+  for (; max_nibbles > 0 && state->position < state->length; --max_nibbles) {
+    if (state->length == 28) {
+      AddCombRow(state);
+    } else {
+      u8 byte = state->scalar[state->position / 2];
+      AddNibble(state, (state->position & 1) ? byte & 15 : (byte >> 4) & 15);
     }
+    state->position++;
+  }
+  return state->position == state->length;
+}
 
-    idx = (scalar[i] >> 4) & 15;
-    SelectJacobian(tbl, idx, &tmp);
-    AddJacobian(&tbl[0], &tmp, out);
-    CopyConditional(out, &tmp, out_is_infinity_mask);
-
-    tmp_is_noninfinite_mask = NON_ZERO_TO_ALL_ONES(idx);
-    mask = tmp_is_noninfinite_mask & ~out_is_infinity_mask;
+void p224_scalar_mult_finish(p224_scalar_mult_state* state, p224_point* out) {
+  *out = state->out;
+  memset(state, 0, sizeof(*state));
+}
 
-    CopyConditional(out, &tbl[0], mask);
+// kBaseCombTable holds the fixed-base comb for the generator G (which is
+// kBaseCombTable[0][1]). Entry
+// kBaseCombTable[t][i] is
+//   sum over j in 0..3 with bit j of i set of 2**(28*t + 56*j)·G,
+// in affine form (z = 1), with entry 0 being the point at infinity. The
+// scalar is split into eight 28-bit columns, so p224_base_point_mul needs 27
+// doublings and 56 additions instead of the 224 doublings of the windowed
+// multiplication in p224_scalar_mult_step.
+static const p224_point kBaseCombTable[2][16] = {
+  {
+    {{0}, {0}, {0}},
+    {
+      P224_FELEM(22813985, 52956513, 34677300, 203240812,
+                 12143107, 133374265, 225162431, 191946955),
+      P224_FELEM(83918388, 223877528, 122119236, 123340192,
+                 266784067, 263504429, 146143011, 198407736),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(107920361, 265906006, 222350942, 197817956,
+                 227158595, 35925496, 16358341, 32807867),
+      P224_FELEM(48012355, 43912073, 70706786, 248415752,
+                 139661520, 231233777, 246993697, 159460820),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(224235192, 114550392, 213082865, 89779921,
+                 198085183, 24025659, 146974536, 250465485),
+      P224_FELEM(223356525, 253360398, 258341343, 180300619,
+                 110079980, 51611220, 177277463, 97204123),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(212543203, 6560102, 33206432, 153072281,
+                 81869323, 251576954, 174034622, 4823720),
+      P224_FELEM(124170077, 122749959, 17650768, 139301526,
+                 243463942, 136148906, 70487131, 110194541),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(186586566, 245979843, 6193876, 8781833,
+                 80857265, 231941038, 242648483, 154318187),
+      P224_FELEM(170253247, 166695902, 15962352, 68576662,
+                 199403687, 266258285, 1639978, 86239247),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(108211315, 136510930, 52124943, 167888949,
+                 75242404, 56882035, 210006620, 205069125),
+      P224_FELEM(47623460, 196959771, 27130604, 232766686,
+                 237120127, 205077927, 15589956, 32487305),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(169967009, 80341260, 126966203, 219266762,
+                 46762876, 267965244, 67762249, 39914297),
+      P224_FELEM(180768160, 72160082, 205960443, 215726002,
+                 192232585, 157728889, 136360210, 266763854),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(234172717, 237554402, 24075374, 208778781,
+                 171867212, 127628825, 9018183, 6058788),
+      P224_FELEM(46612026, 167245368, 96824282, 25564438,
+                 18283862, 104987314, 45122452, 120083848),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(253107209, 4624770, 147853237, 122329290,
+                 76129248, 193583763, 150670365, 68982902),
+      P224_FELEM(187882113, 241082463, 197814357, 64809471,
+                 264198630, 30401235, 8861863, 15065140),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(53733503, 229319346, 173921014, 71500087,
+                 121159352, 235121567, 230903588, 212911568),
+      P224_FELEM(13172133, 124037087, 66723908, 25541212,
+                 146587216, 153623912, 260651137, 205533981),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(158273376, 193549063, 40438179, 182358717,
+                 189301978, 27314239, 44411268, 24534002),
+      P224_FELEM(123580574, 124955118, 130990447, 37471942,
+                 145837615, 79818170, 157356905, 237642077),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(263581619, 91350281, 104924498, 182356073,
+                 182088958, 210430047, 138132963, 113763518),
+      P224_FELEM(101664338, 268039441, 156919097, 189255204,
+                 62227188, 170477253, 65968736, 42390235),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(135939247, 67878224, 185832044, 10047875,
+                 256374480, 198114214, 164364375, 34955678),
+      P224_FELEM(185463902, 146576595, 57233263, 252822858,
+                 216000693, 140712851, 9973177, 243154763),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(188619899, 186057866, 267952600, 180588342,
+                 70636230, 29530137, 256641001, 209793330),
+      P224_FELEM(84128031, 42538021, 5742570, 8880387,
+                 97293940, 257173178, 25518780, 31624895),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(214459627, 166926743, 42688076, 7133469,
+                 110209395, 267481142, 21593176, 253423413),
+      P224_FELEM(353535, 231862998, 185860827, 233492595,
+                 56350355, 122316868, 261498200, 250246257),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+  },
+  {
+    {{0}, {0}, {0}},
+    {
+      P224_FELEM(232650068, 157700710, 190902061, 157367672,
+                 215720983, 216169012, 225115185, 221621108),
+      P224_FELEM(48148830, 140299730, 138046123, 34831959,
+                 227316678, 169090303, 15273773, 55943555),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(229301861, 27563242, 125822268, 225289434,
+                 111930502, 242848409, 207655139, 106706259),
+      P224_FELEM(263230278, 262541489, 193612463, 253519168,
+                 215206827, 206676284, 186172042, 2725297),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(242390511, 126305640, 199462148, 141246879,
+                 123014554, 230713610, 79604787, 221865636),
+      P224_FELEM(204018479, 45557774, 167980531, 199926710,
+                 182718976, 231202184, 65249536, 220586577),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(187628285, 153388414, 19018128, 180534500,
+                 72700924, 149793300, 221602517, 136675343),
+      P224_FELEM(245982753, 148345160, 232385933, 37355971,
+                 261363381, 184070681, 41409258, 227389644),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(27721968, 124427323, 197650065, 245026089,
+                 174785319, 110236369, 266425534, 103952023),
+      P224_FELEM(106783402, 74054740, 143145733, 148119249,
+                 113585032, 33090278, 52805201, 240110569),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(138193942, 136707573, 209388090, 2144343,
+                 72024421, 109298039, 47903473, 22019338),
+      P224_FELEM(138549497, 52671329, 238766036, 76828356,
+                 8657615, 202748680, 1714363, 12381515),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(51246532, 153797154, 6548904, 86979508,
+                 118230163, 213119384, 195449395, 67134706),
+      P224_FELEM(38766994, 266432265, 183874839, 1235493,
+                 83305382, 27622322, 108400111, 7310279),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(125926585, 78055503, 149854840, 197832819,
+                 31048486, 65802721, 235870894, 230751888),
+      P224_FELEM(100238224, 217463274, 36698996, 96686250,
+                 171984823, 162508440, 102235205, 156691501),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(146914922, 70282596, 197764194, 153386200,
+                 125644590, 257267171, 267494702, 198296522),
+      P224_FELEM(119802320, 4579652, 7927667, 43990551,
+                 187518845, 122004994, 140304315, 26313590),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(78171001, 95874597, 257847334, 76887091,
+                 30531316, 237107947, 140249566, 206316119),
+      P224_FELEM(195159320, 50843259, 17001912, 52105819,
+                 142843535, 75403654, 238270963, 209082470),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(83454214, 62909666, 69095571, 75058598,
+                 261479206, 233168740, 158419717, 43511000),
+      P224_FELEM(196264874, 117554494, 87863765, 117914447,
+                 106475286, 20731493, 224853592, 159993993),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(126633872, 16707679, 61889838, 47674211,
+                 177544340, 155331011, 256446907, 196859661),
+      P224_FELEM(220991848, 187459939, 120262003, 17167482,
+                 23150720, 167638545, 60712880, 129493323),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(251388595, 181512150, 202221213, 251733122,
+                 37978949, 112442865, 226141401, 67990872),
+      P224_FELEM(190606653, 144744447, 228588856, 161699557,
+                 256875292, 93798165, 258196458, 231563097),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(207398827, 181352948, 207607607, 80217884,
+                 46993796, 207938400, 80325562, 11326564),
+      P224_FELEM(114868078, 113250723, 170189610, 267180155,
+                 91552472, 27225942, 216896517, 5288452),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+    {
+      P224_FELEM(243112598, 248836554, 227853322, 97447802,
+                 200535963, 125363363, 230929758, 121657219),
+      P224_FELEM(28764358, 52721606, 118423947, 189180277,
+                 176068049, 152139472, 206339342, 64983291),
+      P224_FELEM(1, 0, 0, 0, 0, 0, 0, 0),
+    },
+  },
+};
 
-    out_is_infinity_mask &= ~tmp_is_noninfinite_mask;
+// GetBit returns bit i (0 being the least significant) of a 28-byte big-endian
+// scalar.
+static u32 GetBit(const u8* scalar, int i) {
+  return (scalar[27 - (i >> 3)] >> (i & 7)) & 1;
+}
 
+// AddCombRow folds row 27 - position of the comb into state->out: one
+// doubling, then one table addition per half of the comb. The table lookups
+// and additions follow the same constant-time pattern as AddNibble.
+static void AddCombRow(p224_scalar_mult_state* state) {
+  p224_point* out = &state->out;
+  p224_point sum, tmp;
+  u32 tmp_is_noninfinite_mask, mask;
+  int i = 27 - state->position;
+  int t;
+
+  if (state->position) {
     DoubleJacobian(out, out);
-    DoubleJacobian(out, out);
-    DoubleJacobian(out, out);
-    DoubleJacobian(out, out);
+  }
 
-    idx = scalar[i] & 15;
-    SelectJacobian(tbl, idx, &tmp);
-    AddJacobian(&tbl[0], &tmp, out);
-    CopyConditional(out, &tmp, out_is_infinity_mask);
+  for (t = 0; t < 2; t++) {
+    u32 idx = GetBit(state->scalar, i + 28 * t) |
+              (GetBit(state->scalar, i + 28 * t + 56) << 1) |
+              (GetBit(state->scalar, i + 28 * t + 112) << 2) |
+              (GetBit(state->scalar, i + 28 * t + 168) << 3);
+    SelectJacobian(kBaseCombTable[t], idx, &tmp);
+    AddJacobian(&sum, &tmp, out);
+    CopyConditional(out, &tmp, state->out_is_infinity_mask);
 
     tmp_is_noninfinite_mask = NON_ZERO_TO_ALL_ONES(idx);
-    mask = tmp_is_noninfinite_mask & ~out_is_infinity_mask;
+    mask = tmp_is_noninfinite_mask & ~state->out_is_infinity_mask;
+
+    CopyConditional(out, &sum, mask);
+
+    state->out_is_infinity_mask &= ~tmp_is_noninfinite_mask;
+  }
+}
+
+void p224_base_point_mult_begin(p224_scalar_mult_state* state,
+                                const u8 scalar[28]) {
+  memset(&state->out, 0, sizeof(state->out));
+  state->out_is_infinity_mask = -1;
+  memcpy(state->scalar, scalar, sizeof(state->scalar));
+  state->position = 0;
+  state->length = 28;
+}
 
-    CopyConditional(out, &tbl[0], mask);
+#if P224_LIMB64
 
-    out_is_infinity_mask &= ~tmp_is_noninfinite_mask;
+// Get224Bits reads 28 big-endian bytes from in into the four 56-bit limbs of
+// out, 7 bytes per limb.
+static void Get224Bits(felem out, const u8* in) {
+  int i, j;
+  for (i = 0; i < NLIMBS; i++) {
+    const u8* limb_bytes = &in[7 * (NLIMBS - 1 - i)];
+    out[i] = 0;
+    for (j = 0; j < 7; j++) {
+      out[i] = (out[i] << 8) | limb_bytes[j];
+    }
   }
 }
 
+// Put224Bits performs the inverse operation to Get224Bits.
+static void Put224Bits(u8* out, const felem in) {
+  int i, j;
+  for (i = 0; i < NLIMBS; i++) {
+    u8* limb_bytes = &out[7 * (NLIMBS - 1 - i)];
+    limb v = in[i];
+    for (j = 6; j >= 0; j--) {
+      limb_bytes[j] = (u8)v;
+      v >>= 8;
+    }
+  }
+}
+
+#else  // P224_LIMB64
+
 static u32 u32_from_bin(const u8* v) {
   return (v[0] << 24) |
          (v[1] << 16) |
@@ -759,6 +1291,8 @@ static void Put224Bits(u8* out, const felem in) {
   u32_to_bin(&out[4*0], (in[6] >> 24) | (in[7] << 4));
 }
 
+#endif  // P224_LIMB64
+
 // Public API functions.
 
 int p224_point_from_bin(const void* in, int size, p224_point* out) {
@@ -782,7 +1316,7 @@ int p224_point_from_bin(const void* in, int size, p224_point* out) {
   Mul(rhs, out->x, rhs);
 
   felem three_x;
-  for (i = 0; i < 8; i++) {
+  for (i = 0; i < NLIMBS; i++) {
     three_x[i] = out->x[i] * 3;
   }
   Reduce(three_x);
@@ -820,11 +1354,17 @@ void p224_point_to_bin(const p224_point* in, void* out) {
 void p224_point_mul(const p224_point* in,
                     const u8 scalar[28],
                     p224_point* out) {
-  ScalarMult(out, in, scalar, 28);
+  p224_scalar_mult_state state;
+  p224_scalar_mult_begin(&state, in, scalar);
+  p224_scalar_mult_step(&state, 2 * 28);
+  p224_scalar_mult_finish(&state, out);
 }
 
 void p224_base_point_mul(const u8 scalar[28], p224_point* out) {
-  ScalarMult(out, &kBasep224_point, scalar, 28);
+  p224_scalar_mult_state state;
+  p224_base_point_mult_begin(&state, scalar);
+  p224_scalar_mult_step(&state, 28);
+  p224_scalar_mult_finish(&state, out);
 }
 
 void p224_point_add(const p224_point* a, const p224_point* b, p224_point* out) {
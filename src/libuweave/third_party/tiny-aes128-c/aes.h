@@ -22,14 +22,27 @@
 
 #if defined(ECB) && ECB
 
+// The ECB functions keep no state between calls and may be used concurrently.
 void AES128_ECB_encrypt(uint8_t* input, const uint8_t* key, uint8_t *output);
 void AES128_ECB_decrypt(uint8_t* input, const uint8_t* key, uint8_t *output);
 
+// Size in bytes of an expanded AES-128 key schedule (11 round keys).
+#define AES128_ROUND_KEY_SIZE 176
+
+// Expands key into round_key (AES128_ROUND_KEY_SIZE bytes) so that it can be
+// reused across calls to AES128_ECB_encrypt_expanded.
+void AES128_ECB_expand_key(const uint8_t* key, uint8_t* round_key);
+// Encrypts one block with a schedule from AES128_ECB_expand_key.  input and
+// output may point to the same block.
+void AES128_ECB_encrypt_expanded(const uint8_t* input, const uint8_t* round_key, uint8_t* output);
+
 #endif // #if defined(ECB) && ECB
 
 
 #if defined(CBC) && CBC
 
+// The CBC functions keep the key schedule and IV between calls (see the 0 key
+// and iv handling in aes.c) and are therefore not reentrant.
 void AES128_CBC_encrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, const uint8_t* key, const uint8_t* iv);
 void AES128_CBC_decrypt_buffer(uint8_t* output, uint8_t* input, uint32_t length, const uint8_t* key, const uint8_t* iv);
 
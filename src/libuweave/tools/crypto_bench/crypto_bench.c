@@ -0,0 +1,561 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "tools/crypto_bench/crypto_bench.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "omaha-crypto/p224.h"
+#include "src/buffer.h"
+#include "src/crypto_cmac.h"
+#include "src/crypto_eax.h"
+#include "src/crypto_hkdf.h"
+#include "src/crypto_hmac.h"
+#include "src/crypto_spake.h"
+#include "src/macaroon.h"
+#include "src/macaroon_caveat.h"
+#include "src/macaroon_context.h"
+#include "uweave/provider/crypto.h"
+
+#define MAX_MESSAGE_LEN 512
+#define EAX_NONCE_LEN 16
+#define EAX_TAG_LEN 16
+#define MAX_CAVEATS 8
+#define CAVEAT_BUFFER_LEN 16
+#define MACAROON_KEY_LEN 16
+
+// Iteration counts double until a run reaches min_cycles; stop doubling here
+// in case the cycle counter does not advance.
+#define MAX_ITERATIONS (1UL << 30)
+
+static const size_t kMessageSizes[] = {16, 64, 256, 512};
+
+/** Fixtures shared by all operations, set up once by init_fixtures_. */
+typedef struct {
+  UwpCryptoAes128Key aes_key;
+  uint8_t key[16];
+  uint8_t block[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  uint8_t message[MAX_MESSAGE_LEN];
+  uint8_t output[MAX_MESSAGE_LEN + EAX_TAG_LEN];
+  uint8_t ciphertext[MAX_MESSAGE_LEN + EAX_TAG_LEN];
+  uint8_t nonce[EAX_NONCE_LEN];
+  uint8_t keystream[MAX_MESSAGE_LEN];
+  size_t message_len;  // Size of the current sized operation
+
+  UwCmacState cmac;
+
+  uint8_t scalar[UW_SPAKE_P224_SCALAR_SIZE];
+  uint8_t point_bin[UW_SPAKE_P224_POINT_SIZE];
+  p224_point point_a;
+  p224_point point_b;
+  p224_point point_out;
+  p224_scalar_mult_state mult;
+
+  uint8_t caveat_buffers[MAX_CAVEATS][CAVEAT_BUFFER_LEN];
+  UwMacaroonCaveat caveats[MAX_CAVEATS];
+  const UwMacaroonCaveat* caveat_list[MAX_CAVEATS];
+  UwMacaroon macaroons[MAX_CAVEATS];
+  UwMacaroonContext macaroon_context;
+  size_t macaroon_index;  // Index of the macaroon for the current operation
+} Fixtures_;
+
+static Fixtures_ fixtures_;
+
+typedef bool (*BenchOp_)(Fixtures_* f);
+
+static bool aes128_key_init_op_(Fixtures_* f) {
+  UwpCryptoAes128Key key;
+  return uwp_crypto_aes128_key_init(&key, f->key);
+}
+
+static bool aes128_block_op_(Fixtures_* f) {
+  return uwp_crypto_aes128_encrypt_block(&f->aes_key, f->block, f->block);
+}
+
+/**
+ * AES-CTR over the message: all of its counter blocks in one provider call,
+ * then XORed in, as EAX does a batch at a time.
+ */
+static bool aes128_ctr_op_(Fixtures_* f) {
+  size_t num_blocks = f->message_len / UWP_CRYPTO_AES128_BLOCK_SIZE;
+  for (size_t i = 0; i < num_blocks; i++) {
+    uint8_t* block = f->keystream + i * UWP_CRYPTO_AES128_BLOCK_SIZE;
+    memcpy(block, f->nonce, UWP_CRYPTO_AES128_BLOCK_SIZE);
+    block[UWP_CRYPTO_AES128_BLOCK_SIZE - 1] ^= (uint8_t)i;
+  }
+  if (!uwp_crypto_aes128_encrypt_blocks(&f->aes_key, f->keystream,
+                                        f->keystream, num_blocks)) {
+    return false;
+  }
+  for (size_t i = 0; i < f->message_len; i++) {
+    f->output[i] = f->message[i] ^ f->keystream[i];
+  }
+  return true;
+}
+
+static bool cmac_op_(Fixtures_* f) {
+  return uw_cmac_reset_(&f->cmac) &&
+         uw_cmac_update_(&f->cmac, f->message, f->message_len) &&
+         uw_cmac_final_(&f->cmac, f->block);
+}
+
+static bool eax_encrypt_op_(Fixtures_* f) {
+  UwBuffer input;
+  UwBuffer output;
+  uw_buffer_init(&input, f->message, sizeof(f->message));
+  uw_buffer_set_length_(&input, f->message_len);
+  uw_buffer_init(&output, f->output, sizeof(f->output));
+  return uw_eax_encrypt_(&f->aes_key, EAX_TAG_LEN, f->nonce, sizeof(f->nonce),
+                         NULL, 0, &input, &output);
+}
+
+/** One block with the raw key, which the provider expands again each time. */
+static bool rekeyed_block_(const Fixtures_* f,
+                           const uint8_t* in,
+                           uint8_t* out) {
+  return uwp_crypto_aes128_ecb_encrypt(f->key, in, out);
+}
+
+/** Doubles block in GF(2^128), for the CMAC subkeys. */
+static void double_block_(uint8_t block[UWP_CRYPTO_AES128_BLOCK_SIZE]) {
+  uint8_t carry = block[0] >> 7;
+  for (size_t i = 0; i + 1 < UWP_CRYPTO_AES128_BLOCK_SIZE; i++) {
+    block[i] = (uint8_t)(block[i] << 1 | block[i + 1] >> 7);
+  }
+  block[UWP_CRYPTO_AES128_BLOCK_SIZE - 1] =
+      (uint8_t)(block[UWP_CRYPTO_AES128_BLOCK_SIZE - 1] << 1) ^
+      (carry ? 0x87 : 0);
+}
+
+/** CMAC of the tweak block [tweak] followed by data, as EAX uses it. */
+static bool rekeyed_omac_(const Fixtures_* f,
+                          uint8_t tweak,
+                          const uint8_t* data,
+                          size_t length,
+                          uint8_t mac[UWP_CRYPTO_AES128_BLOCK_SIZE]) {
+  uint8_t subkey[UWP_CRYPTO_AES128_BLOCK_SIZE] = {0};
+  if (!rekeyed_block_(f, subkey, subkey)) {
+    return false;
+  }
+  double_block_(subkey);
+  memset(mac, 0, UWP_CRYPTO_AES128_BLOCK_SIZE);
+  mac[UWP_CRYPTO_AES128_BLOCK_SIZE - 1] = tweak;
+  if (length > 0) {
+    if (!rekeyed_block_(f, mac, mac)) {
+      return false;
+    }
+    for (; length > UWP_CRYPTO_AES128_BLOCK_SIZE;
+         length -= UWP_CRYPTO_AES128_BLOCK_SIZE) {
+      for (size_t i = 0; i < UWP_CRYPTO_AES128_BLOCK_SIZE; i++) {
+        mac[i] ^= *data++;
+      }
+      if (!rekeyed_block_(f, mac, mac)) {
+        return false;
+      }
+    }
+    for (size_t i = 0; i < length; i++) {
+      mac[i] ^= data[i];
+    }
+    if (length < UWP_CRYPTO_AES128_BLOCK_SIZE) {
+      mac[length] ^= 0x80;
+      double_block_(subkey);
+    }
+  }
+  for (size_t i = 0; i < UWP_CRYPTO_AES128_BLOCK_SIZE; i++) {
+    mac[i] ^= subkey[i];
+  }
+  return rekeyed_block_(f, mac, mac);
+}
+
+/**
+ * EAX as it was computed before the provider took key schedules: every CTR
+ * and CMAC block goes through uwp_crypto_aes128_ecb_encrypt with the raw key.
+ * The baseline for eax_encrypt.
+ */
+static bool eax_encrypt_rekeyed_op_(Fixtures_* f) {
+  uint8_t nonce_mac[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  uint8_t ad_mac[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  uint8_t ciphertext_mac[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  uint8_t counter[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  uint8_t keystream[UWP_CRYPTO_AES128_BLOCK_SIZE];
+  if (!rekeyed_omac_(f, 0, f->nonce, sizeof(f->nonce), nonce_mac) ||
+      !rekeyed_omac_(f, 1, NULL, 0, ad_mac)) {
+    return false;
+  }
+  memcpy(counter, nonce_mac, sizeof(counter));
+  for (size_t offset = 0; offset < f->message_len;
+       offset += UWP_CRYPTO_AES128_BLOCK_SIZE) {
+    if (!rekeyed_block_(f, counter, keystream)) {
+      return false;
+    }
+    for (size_t i = 0; i < UWP_CRYPTO_AES128_BLOCK_SIZE &&
+                       offset + i < f->message_len;
+         i++) {
+      f->output[offset + i] = f->message[offset + i] ^ keystream[i];
+    }
+    // The counter is one big-endian number.
+    for (size_t i = UWP_CRYPTO_AES128_BLOCK_SIZE; i-- > 0;) {
+      if (++counter[i] != 0) {
+        break;
+      }
+    }
+  }
+  if (!rekeyed_omac_(f, 2, f->output, f->message_len, ciphertext_mac)) {
+    return false;
+  }
+  for (size_t i = 0; i < EAX_TAG_LEN; i++) {
+    f->output[f->message_len + i] =
+        nonce_mac[i] ^ ad_mac[i] ^ ciphertext_mac[i];
+  }
+  return true;
+}
+
+static bool eax_decrypt_op_(Fixtures_* f) {
+  UwBuffer input;
+  UwBuffer output;
+  uw_buffer_init(&input, f->ciphertext, sizeof(f->ciphertext));
+  uw_buffer_set_length_(&input, f->message_len + EAX_TAG_LEN);
+  uw_buffer_init(&output, f->output, sizeof(f->output));
+  return uw_eax_decrypt_(&f->aes_key, EAX_TAG_LEN, f->nonce, sizeof(f->nonce),
+                         NULL, 0, &input, &output);
+}
+
+static bool sha256_op_(Fixtures_* f) {
+  UwpCryptoSha256State state;
+  uint8_t digest[UWP_CRYPTO_SHA256_DIGEST_LEN];
+  uwp_crypto_sha256_init(&state);
+  uwp_crypto_sha256_update(&state, f->message, f->message_len);
+  uwp_crypto_sha256_final(&state, digest);
+  return true;
+}
+
+static bool hmac_op_(Fixtures_* f) {
+  UwCryptoHmacMsg message = {.bytes = f->message, .num_bytes = f->message_len};
+  return uw_crypto_hmac_(f->key, sizeof(f->key), &message, 1, f->block,
+                         sizeof(f->block));
+}
+
+static bool hkdf_op_(Fixtures_* f) {
+  uint8_t salt[UWP_CRYPTO_SHA256_DIGEST_LEN] = {0};
+  uint8_t output[UWP_CRYPTO_SHA256_DIGEST_LEN];
+  uw_crypto_hkdf_(f->message, 32, (const uint8_t*)"bench", 5, salt, output);
+  return true;
+}
+
+static bool p224_point_from_bin_op_(Fixtures_* f) {
+  return p224_point_from_bin(f->point_bin, sizeof(f->point_bin),
+                             &f->point_out) != 0;
+}
+
+static bool p224_point_to_bin_op_(Fixtures_* f) {
+  uint8_t out[UW_SPAKE_P224_POINT_SIZE];
+  p224_point_to_bin(&f->point_a, out);
+  return true;
+}
+
+static bool p224_base_point_mul_op_(Fixtures_* f) {
+  p224_base_point_mul(f->scalar, &f->point_out);
+  return true;
+}
+
+static bool p224_point_mul_op_(Fixtures_* f) {
+  p224_point_mul(&f->point_a, f->scalar, &f->point_out);
+  return true;
+}
+
+static bool p224_scalar_mult_op_(Fixtures_* f) {
+  p224_scalar_mult_begin(&f->mult, &f->point_a, f->scalar);
+  while (!p224_scalar_mult_step(&f->mult, 8)) {
+  }
+  p224_scalar_mult_finish(&f->mult, &f->point_out);
+  return true;
+}
+
+static bool p224_point_add_op_(Fixtures_* f) {
+  p224_point_add(&f->point_a, &f->point_b, &f->point_out);
+  return true;
+}
+
+static bool p224_point_negate_op_(Fixtures_* f) {
+  p224_point_negate(&f->point_a, &f->point_out);
+  return true;
+}
+
+/** A complete exchange, computing both the device and the client side. */
+static bool spake_pairing_op_(Fixtures_* f) {
+  static const uint8_t kPassword[] = "1234";
+  UwSpakeState server;
+  UwSpakeState client;
+  uint8_t server_commitment_bytes[UW_SPAKE_P224_POINT_SIZE];
+  uint8_t client_commitment_bytes[UW_SPAKE_P224_POINT_SIZE];
+  UwBuffer server_commitment;
+  UwBuffer client_commitment;
+  uint8_t server_key[UWP_CRYPTO_SHA256_DIGEST_LEN];
+  uint8_t client_key[UWP_CRYPTO_SHA256_DIGEST_LEN];
+
+  uw_buffer_init(&server_commitment, server_commitment_bytes,
+                 sizeof(server_commitment_bytes));
+  uw_buffer_init(&client_commitment, client_commitment_bytes,
+                 sizeof(client_commitment_bytes));
+  if (!uw_spake_init_(&server, true, kPassword, sizeof(kPassword) - 1) ||
+      !uw_spake_init_(&client, false, kPassword, sizeof(kPassword) - 1) ||
+      !uw_spake_compute_commitment_(&server, &server_commitment) ||
+      !uw_spake_compute_commitment_(&client, &client_commitment) ||
+      !uw_spake_finalize_(&server, &client_commitment, server_key,
+                          sizeof(server_key)) ||
+      !uw_spake_finalize_(&client, &server_commitment, client_key,
+                          sizeof(client_key))) {
+    return false;
+  }
+  return memcmp(server_key, client_key, sizeof(server_key)) == 0;
+}
+
+static bool macaroon_validate_op_(Fixtures_* f) {
+  UwMacaroonValidationResult result;
+  return uw_macaroon_validate_(&f->macaroons[f->macaroon_index], f->key,
+                               MACAROON_KEY_LEN, &f->macaroon_context,
+                               &result);
+}
+
+static bool init_fixtures_(Fixtures_* f) {
+  memset(f, 0, sizeof(*f));
+  for (size_t i = 0; i < sizeof(f->message); i++) {
+    f->message[i] = (uint8_t)(i * 31 + 7);
+  }
+  for (size_t i = 0; i < sizeof(f->key); i++) {
+    f->key[i] = (uint8_t)(i * 13 + 1);
+    f->nonce[i] = (uint8_t)(i * 5 + 3);
+  }
+  for (size_t i = 0; i < sizeof(f->scalar); i++) {
+    f->scalar[i] = (uint8_t)(i * 101 + 17);
+  }
+  if (!uwp_crypto_aes128_key_init(&f->aes_key, f->key) ||
+      !uw_cmac_init_(&f->cmac, &f->aes_key)) {
+    return false;
+  }
+
+  // The baseline must compute the same EAX as the library.
+  f->message_len = MAX_MESSAGE_LEN - 1;
+  if (!eax_encrypt_op_(f)) {
+    return false;
+  }
+  memcpy(f->ciphertext, f->output, f->message_len + EAX_TAG_LEN);
+  if (!eax_encrypt_rekeyed_op_(f) ||
+      memcmp(f->ciphertext, f->output, f->message_len + EAX_TAG_LEN) != 0) {
+    return false;
+  }
+
+  // Two distinct points on the curve, a, b = k * G.
+  p224_base_point_mul(f->scalar, &f->point_a);
+  p224_point_to_bin(&f->point_a, f->point_bin);
+  f->scalar[0] ^= 0x55;
+  p224_base_point_mul(f->scalar, &f->point_b);
+
+  // Macaroons with 1 to MAX_CAVEATS caveats that are all satisfied.
+  if (!uw_macaroon_context_create_with_timestamp_(1000,
+                                                  &f->macaroon_context)) {
+    return false;
+  }
+  for (size_t i = 0; i < MAX_CAVEATS; i++) {
+    if (!uw_macaroon_caveat_create_expiration_absolute_(
+            (uint32_t)(100000 + i), f->caveat_buffers[i],
+            sizeof(f->caveat_buffers[i]), &f->caveats[i])) {
+      return false;
+    }
+    f->caveat_list[i] = &f->caveats[i];
+  }
+  for (size_t i = 0; i < MAX_CAVEATS; i++) {
+    if (!uw_macaroon_create_from_root_key_(&f->macaroons[i], f->key,
+                                           MACAROON_KEY_LEN,
+                                           &f->macaroon_context,
+                                           f->caveat_list, i + 1)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** Writes the CSV header or opens the JSON array. */
+static void write_prologue_(const CryptoBenchConfig* config) {
+  if (config->format == kCryptoBenchFormatJson) {
+    config->write_line("[");
+  } else {
+    config->write_line(
+        "backend,operation,bytes,iterations,cycles_per_op,cycles_per_byte,"
+        "ops_per_second");
+  }
+}
+
+static void write_epilogue_(const CryptoBenchConfig* config) {
+  if (config->format == kCryptoBenchFormatJson) {
+    config->write_line("]");
+  }
+}
+
+/** Formats value / divisor with two decimals, without floating point. */
+static void format_ratio_(uint64_t value,
+                          uint64_t divisor,
+                          char* out,
+                          size_t out_len) {
+  uint64_t hundredths =
+      divisor == 0 ? 0 : (value * 100 + divisor / 2) / divisor;
+  snprintf(out, out_len, "%" PRIu64 ".%02" PRIu64, hundredths / 100,
+           hundredths % 100);
+}
+
+static void write_result_(const CryptoBenchConfig* config,
+                          bool* is_first,
+                          const char* name,
+                          size_t bytes,
+                          uint64_t iterations,
+                          uint64_t cycles) {
+  char cycles_per_op[24];
+  char cycles_per_byte[24] = "";
+  uint64_t ops_per_second =
+      cycles == 0 ? 0 : config->cycles_per_second * iterations / cycles;
+  format_ratio_(cycles, iterations, cycles_per_op, sizeof(cycles_per_op));
+  if (bytes > 0) {
+    format_ratio_(cycles, iterations * bytes, cycles_per_byte,
+                  sizeof(cycles_per_byte));
+  }
+
+  char line[256];
+  if (config->format == kCryptoBenchFormatJson) {
+    snprintf(line, sizeof(line),
+             "%s{\"backend\": \"%s\", \"operation\": \"%s\", "
+             "\"bytes\": %u, \"iterations\": %" PRIu64
+             ", \"cycles_per_op\": %s, \"cycles_per_byte\": %s, "
+             "\"ops_per_second\": %" PRIu64 "}",
+             *is_first ? "  " : ", ", config->backend, name, (unsigned)bytes,
+             iterations, cycles_per_op, bytes > 0 ? cycles_per_byte : "null",
+             ops_per_second);
+  } else {
+    snprintf(line, sizeof(line), "%s,%s,%u,%" PRIu64 ",%s,%s,%" PRIu64,
+             config->backend, name, (unsigned)bytes, iterations,
+             cycles_per_op, cycles_per_byte, ops_per_second);
+  }
+  *is_first = false;
+  config->write_line(line);
+}
+
+/**
+ * Runs op once to warm up, then doubles the iteration count until a run takes
+ * at least min_cycles, and reports that run.  bytes is 0 for operations
+ * without a message size.
+ */
+static bool measure_(const CryptoBenchConfig* config,
+                     bool* is_first,
+                     const char* name,
+                     size_t bytes,
+                     BenchOp_ op) {
+  if (!op(&fixtures_)) {
+    return false;
+  }
+  for (uint64_t iterations = 1;; iterations *= 2) {
+    uint64_t start = config->read_cycles();
+    for (uint64_t i = 0; i < iterations; i++) {
+      if (!op(&fixtures_)) {
+        return false;
+      }
+    }
+    uint64_t cycles = config->read_cycles() - start;
+    if (cycles >= config->min_cycles || iterations >= MAX_ITERATIONS) {
+      write_result_(config, is_first, name, bytes, iterations, cycles);
+      return true;
+    }
+  }
+}
+
+static bool measure_sizes_(const CryptoBenchConfig* config,
+                           bool* is_first,
+                           const char* name,
+                           BenchOp_ op) {
+  bool success = true;
+  for (size_t i = 0; i < sizeof(kMessageSizes) / sizeof(kMessageSizes[0]);
+       i++) {
+    fixtures_.message_len = kMessageSizes[i];
+    success &= measure_(config, is_first, name, kMessageSizes[i], op);
+  }
+  return success;
+}
+
+/** Encrypts the message at every size ahead of the decryption runs. */
+static bool measure_eax_decrypt_(const CryptoBenchConfig* config,
+                                 bool* is_first) {
+  bool success = true;
+  for (size_t i = 0; i < sizeof(kMessageSizes) / sizeof(kMessageSizes[0]);
+       i++) {
+    fixtures_.message_len = kMessageSizes[i];
+    if (!eax_encrypt_op_(&fixtures_)) {
+      return false;
+    }
+    memcpy(fixtures_.ciphertext, fixtures_.output,
+           kMessageSizes[i] + EAX_TAG_LEN);
+    success &= measure_(config, is_first, "eax_decrypt", kMessageSizes[i],
+                        eax_decrypt_op_);
+  }
+  return success;
+}
+
+static bool measure_macaroons_(const CryptoBenchConfig* config,
+                               bool* is_first) {
+  bool success = true;
+  for (size_t i = 0; i < MAX_CAVEATS; i++) {
+    char name[32];
+    snprintf(name, sizeof(name), "macaroon_validate_%u_caveats",
+             (unsigned)(i + 1));
+    fixtures_.macaroon_index = i;
+    success &= measure_(config, is_first, name, 0, macaroon_validate_op_);
+  }
+  return success;
+}
+
+bool crypto_bench_run(const CryptoBenchConfig* config) {
+  if (config == NULL || config->read_cycles == NULL ||
+      config->write_line == NULL || config->backend == NULL) {
+    return false;
+  }
+
+  bool is_first = true;
+  write_prologue_(config);
+  bool success = init_fixtures_(&fixtures_);
+  if (success) {
+    success &= measure_(config, &is_first, "aes128_key_init", 0,
+                        aes128_key_init_op_);
+    success &= measure_(config, &is_first, "aes128_block",
+                        UWP_CRYPTO_AES128_BLOCK_SIZE, aes128_block_op_);
+    success &= measure_sizes_(config, &is_first, "aes128_ctr", aes128_ctr_op_);
+    success &= measure_sizes_(config, &is_first, "cmac", cmac_op_);
+    success &= measure_sizes_(config, &is_first, "eax_encrypt",
+                              eax_encrypt_op_);
+    success &= measure_sizes_(config, &is_first, "eax_encrypt_rekeyed",
+                              eax_encrypt_rekeyed_op_);
+    success &= measure_eax_decrypt_(config, &is_first);
+    success &= measure_sizes_(config, &is_first, "sha256", sha256_op_);
+    success &= measure_sizes_(config, &is_first, "hmac_sha256", hmac_op_);
+    success &= measure_(config, &is_first, "hkdf_sha256", 0, hkdf_op_);
+    success &= measure_(config, &is_first, "p224_point_from_bin", 0,
+                        p224_point_from_bin_op_);
+    success &= measure_(config, &is_first, "p224_point_to_bin", 0,
+                        p224_point_to_bin_op_);
+    success &= measure_(config, &is_first, "p224_point_add", 0,
+                        p224_point_add_op_);
+    success &= measure_(config, &is_first, "p224_point_negate", 0,
+                        p224_point_negate_op_);
+    success &= measure_(config, &is_first, "p224_base_point_mul", 0,
+                        p224_base_point_mul_op_);
+    success &= measure_(config, &is_first, "p224_point_mul", 0,
+                        p224_point_mul_op_);
+    success &= measure_(config, &is_first, "p224_scalar_mult_resumable", 0,
+                        p224_scalar_mult_op_);
+    success &= measure_(config, &is_first, "spake_pairing", 0,
+                        spake_pairing_op_);
+    success &= measure_macaroons_(config, &is_first);
+  }
+  write_epilogue_(config);
+  memset(&fixtures_, 0, sizeof(fixtures_));
+  return success;
+}
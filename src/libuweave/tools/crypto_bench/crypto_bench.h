@@ -0,0 +1,48 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef LIBUWEAVE_TOOLS_CRYPTO_BENCH_CRYPTO_BENCH_H_
+#define LIBUWEAVE_TOOLS_CRYPTO_BENCH_CRYPTO_BENCH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Microbenchmarks for the crypto primitives used by the library.  The suite
+ * has no dependency on the host, so device firmware can link it and call
+ * crypto_bench_run with its own cycle counter (e.g. a free-running core cycle
+ * register) and an output function that writes to a console.
+ */
+
+typedef enum {
+  kCryptoBenchFormatCsv = 0,
+  kCryptoBenchFormatJson = 1,
+} CryptoBenchFormat;
+
+typedef struct {
+  /** Returns a monotonic cycle count.  Wrapping is not handled. */
+  uint64_t (*read_cycles)(void);
+  /** Rate of read_cycles, used to report operations per second. */
+  uint64_t cycles_per_second;
+  /** Each operation is repeated until it has run for at least this long. */
+  uint64_t min_cycles;
+  CryptoBenchFormat format;
+  /**
+   * Label copied into every result, e.g. the provider backend, so that runs
+   * from different builds can be told apart when diffed.
+   */
+  const char* backend;
+  /** Receives the report, one complete line per call. */
+  void (*write_line)(const char* line);
+} CryptoBenchConfig;
+
+/**
+ * Runs every benchmark and writes one result per operation and message size:
+ * cycles per operation, cycles per byte (for sized operations) and operations
+ * per second.  uwp_crypto_init must have been called.  Returns false if an
+ * operation failed; the report is still well-formed.
+ */
+bool crypto_bench_run(const CryptoBenchConfig* config);
+
+#endif  // LIBUWEAVE_TOOLS_CRYPTO_BENCH_CRYPTO_BENCH_H_
@@ -0,0 +1,149 @@
+// Copyright 2016 The Weave Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Host driver for the crypto benchmarks.
+//
+// Usage: crypto_bench [--format=csv|json] [--backend=NAME] [--min-ms=N]
+//                     [--portable]
+//
+// --portable masks AES-NI, the SHA extensions and AVX2, so that the same
+// build also measures the portable code the provider falls back on.  The
+// backend label defaults to the AES-128 and SHA-256 code the provider
+// dispatches to, e.g. host-aesni-shani or host-ttable-sha256_portable; see
+// the Makefile for building with each software AES.
+//
+// On x86 the cycle counter is the time-stamp counter, calibrated against the
+// monotonic clock; it counts reference cycles, which differ from core cycles
+// when the core frequency changes.  Elsewhere results are in nanoseconds.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_TSC 1
+#else
+#define HAS_TSC 0
+#endif
+
+#include "devices/host/provider/crypto_x86.h"
+#include "tools/crypto_bench/crypto_bench.h"
+#include "uweave/config.h"
+#include "uweave/provider/crypto.h"
+
+#define DEFAULT_MIN_MS 100
+#define CALIBRATION_NS 50000000
+
+static uint64_t now_ns_(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+#if HAS_TSC
+static uint64_t read_cycles_(void) {
+  return __rdtsc();
+}
+
+static uint64_t cycles_per_second_(void) {
+  uint64_t start_ns = now_ns_();
+  uint64_t start_cycles = read_cycles_();
+  while (now_ns_() - start_ns < CALIBRATION_NS) {
+  }
+  uint64_t cycles = read_cycles_() - start_cycles;
+  uint64_t ns = now_ns_() - start_ns;
+  return cycles * 1000000000 / ns;
+}
+#else
+static uint64_t read_cycles_(void) {
+  return now_ns_();
+}
+
+static uint64_t cycles_per_second_(void) {
+  return 1000000000;
+}
+#endif
+
+/** Names the AES-128 and SHA-256 code the host provider dispatches to. */
+static void describe_backend_(char* out, size_t out_len) {
+  const char* aes = !UW_CRYPTO_AES_TTABLE           ? "tiny_aes"
+                    : UW_CRYPTO_AES_TTABLE_COMPACT ? "ttable_compact"
+                                                   : "ttable";
+  const char* sha = "sha256_portable";
+#if UW_CRYPTO_X86_ACCEL
+  if (crypto_x86_has_aesni()) {
+    aes = "aesni";
+  }
+  if (crypto_x86_has_shani()) {
+    sha = "shani";
+  }
+#endif
+  snprintf(out, out_len, "host-%s-%s", aes, sha);
+}
+
+static void write_line_(const char* line) {
+  puts(line);
+}
+
+static void usage_(const char* program) {
+  fprintf(stderr,
+          "Usage: %s [--format=csv|json] [--backend=NAME] [--min-ms=N] "
+          "[--portable]\n",
+          program);
+}
+
+int main(int argc, char* argv[]) {
+  CryptoBenchConfig config = {.read_cycles = read_cycles_,
+                              .format = kCryptoBenchFormatCsv,
+                              .write_line = write_line_};
+  char backend[64];
+  unsigned long min_ms = DEFAULT_MIN_MS;
+  bool portable = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--format=csv") == 0) {
+      config.format = kCryptoBenchFormatCsv;
+    } else if (strcmp(argv[i], "--format=json") == 0) {
+      config.format = kCryptoBenchFormatJson;
+    } else if (strncmp(argv[i], "--backend=", 10) == 0) {
+      config.backend = argv[i] + 10;
+    } else if (strncmp(argv[i], "--min-ms=", 9) == 0) {
+      min_ms = strtoul(argv[i] + 9, NULL, 10);
+    } else if (strcmp(argv[i], "--portable") == 0) {
+      portable = true;
+    } else {
+      usage_(argv[0]);
+      return 2;
+    }
+  }
+
+  if (!uwp_crypto_init()) {
+    fprintf(stderr, "uwp_crypto_init failed\n");
+    return 1;
+  }
+  if (portable) {
+#if UW_CRYPTO_X86_ACCEL
+    // Before crypto_bench_run expands its AES keys.
+    crypto_x86_disable_features(CRYPTO_X86_FEATURE_AESNI |
+                                CRYPTO_X86_FEATURE_SHANI |
+                                CRYPTO_X86_FEATURE_AVX2);
+#endif
+  }
+  if (config.backend == NULL) {
+    describe_backend_(backend, sizeof(backend));
+    config.backend = backend;
+  }
+  config.cycles_per_second = cycles_per_second_();
+  config.min_cycles = config.cycles_per_second / 1000 * min_ms;
+  fprintf(stderr, "%llu cycles per second\n",
+          (unsigned long long)config.cycles_per_second);
+
+  if (!crypto_bench_run(&config)) {
+    fprintf(stderr, "benchmark failed\n");
+    return 1;
+  }
+  return 0;
+}